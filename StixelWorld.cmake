@@ -8,7 +8,7 @@ set (CMAKE_MODULE_PATH ${CMAKE_MODULE_PATH} ${STIXEL_WORLD_PATH})
 set(Boost_USE_STATIC_LIBS OFF) 
 set(Boost_USE_MULTITHREADED ON)  
 set(Boost_USE_STATIC_RUNTIME OFF) 
-find_package(Boost 1.49.0 COMPONENTS filesystem system program_options iostreams)
+find_package(Boost 1.49.0 COMPONENTS filesystem system program_options iostreams thread)
 find_package(OpenCV  REQUIRED )
 find_package(Protobuf REQUIRED)
 find_package(Threads REQUIRED)
@@ -18,6 +18,28 @@ find_package(SDL REQUIRED)
 find_package(PNG REQUIRED)
 find_package(Doppia REQUIRED)
 
+# Per stage timings (see stagetimings.h). When disabled, the instrumentation is compiled out
+option(STIXEL_WORLD_TIMING "Collect per stage timing statistics" ON)
+if (STIXEL_WORLD_TIMING)
+    add_definitions(-DSTIXEL_WORLD_WITH_TIMING)
+endif (STIXEL_WORLD_TIMING)
+
+# Chrome trace export of the pipeline (see pipelinetracer.h)
+option(STIXEL_WORLD_TRACING "Record a trace of the pipeline stages" ON)
+if (STIXEL_WORLD_TRACING)
+    add_definitions(-DSTIXEL_WORLD_WITH_TRACING)
+endif (STIXEL_WORLD_TRACING)
+
+# LZ4 is optional, without it packed stereo sequences can only store raw frames
+find_path(LZ4_INCLUDE_DIR lz4.h)
+find_library(LZ4_LIBRARY lz4)
+if (LZ4_INCLUDE_DIR AND LZ4_LIBRARY)
+    add_definitions(-DSTIXEL_WORLD_WITH_LZ4)
+else (LZ4_INCLUDE_DIR AND LZ4_LIBRARY)
+    set(LZ4_INCLUDE_DIR "")
+    set(LZ4_LIBRARY "")
+endif (LZ4_INCLUDE_DIR AND LZ4_LIBRARY)
+
 INCLUDE("${POLAR_CALIBRATION_PATH}/PolarCalibration.cmake")
 INCLUDE("${DENSE_TRACKER_PATH}/DenseTracker.cmake")
 
@@ -25,10 +47,17 @@ set(STIXEL_WORLD_SRC
     ${STIXEL_WORLD_PATH}/src/doppia/stixel3d.cpp
     ${STIXEL_WORLD_PATH}/src/stixelstracker.cpp 
     ${STIXEL_WORLD_PATH}/src/fundamentalmatrixestimator.cpp 
+    ${STIXEL_WORLD_PATH}/src/robustfundamentalmatrix.cpp
+    ${STIXEL_WORLD_PATH}/src/sampsonerrors.cpp
     ${STIXEL_WORLD_PATH}/src/utils.cpp
+    ${STIXEL_WORLD_PATH}/src/stagetimings.cpp
+    ${STIXEL_WORLD_PATH}/src/pipelinetracer.cpp
+    ${STIXEL_WORLD_PATH}/src/visualizationsink.cpp
     ${STIXEL_WORLD_PATH}/src/stixelsapplication.cpp 
-#     ${STIXEL_WORLD_PATH}/src/doppia/groundestimator.cpp 
+    ${STIXEL_WORLD_PATH}/src/doppia/groundestimator.cpp
+    ${STIXEL_WORLD_PATH}/src/doppia/vdisparitycosts.cpp
     ${STIXEL_WORLD_PATH}/src/rectification.cpp
+    ${STIXEL_WORLD_PATH}/src/processingband.cpp
     ${STIXEL_WORLD_PATH}/src/doppia/extendedfaststixelworldestimator.cpp 
     ${STIXEL_WORLD_PATH}/src/doppia/extendedstixelworldestimatorfactory.cpp
     ${STIXEL_WORLD_PATH}/src/doppia/extendedfastgroundplaneestimator.cpp
@@ -53,6 +82,7 @@ set(STIXEL_WORLD_INCLUDE_DIRS
     /usr/include/pcl-1.7  # This line is just to help kdevelop to index PCL includes (remove)
     ${DOPPIA_INCLUDE_DIRS}
     ${DENSETRACKER_INCLUDE_DIRS}
+    ${LZ4_INCLUDE_DIR}
 )
 
 set(STIXEL_WORLD_LIBRARIES
@@ -66,5 +96,6 @@ set(STIXEL_WORLD_LIBRARIES
   ${PNG_LIBRARIES}
   ${DOPPIA_LIB}
   ${DENSETRACKER_LIBRARIES}
+  ${LZ4_LIBRARY}
   emon
 )
\ No newline at end of file
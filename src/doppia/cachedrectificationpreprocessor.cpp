@@ -0,0 +1,123 @@
+/*
+    Copyright 2014 Néstor Morales Hernández <email>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#include "cachedrectificationpreprocessor.h"
+
+#include "helpers/get_option_value.hpp"
+
+#include <boost/program_options.hpp>
+#include <boost/gil/image_view_factory.hpp>
+
+#include <stdexcept>
+
+using namespace std;
+using namespace boost::program_options;
+
+namespace doppia
+{
+
+/// The options of CpuPreprocessor, without its own rectification
+static variables_map get_cpu_preprocessor_options(const variables_map &options)
+{
+    variables_map cpu_options = options;
+    cpu_options.erase("preprocess.rectify");
+    cpu_options.insert(std::make_pair("preprocess.rectify", variable_value(boost::any(false), false)));
+    return cpu_options;
+}
+
+static cv::Mat get_camera_matrix(const CameraCalibration &calibration)
+{
+    const InternalCameraParameters &parameters = calibration.get_internal_parameters();
+
+    cv::Mat K = cv::Mat::eye(3, 3, CV_64FC1);
+    K.at<double>(0, 0) = parameters.get_focal_length_x();
+    K.at<double>(1, 1) = parameters.get_focal_length_y();
+    K.at<double>(0, 2) = parameters.get_image_center_x();
+    K.at<double>(1, 2) = parameters.get_image_center_y();
+    return K;
+}
+
+options_description
+CachedRectificationPreprocessor::get_args_options()
+{
+    options_description desc("CachedRectificationPreprocessor options");
+
+    desc.add_options()
+
+    ("preprocess.rectification_cache_dir", value<string>()->default_value(""),
+        "folder where the rectification maps of each calibration are kept. "
+        "If empty, CpuPreprocessor computes them at every start")
+    ;
+
+    return desc;
+}
+
+CachedRectificationPreprocessor::CachedRectificationPreprocessor(const dimensions_t &dimensions,
+                                                                 const StereoCameraCalibration &stereo_calibration,
+                                                                 const variables_map &options)
+    : CpuPreprocessor(dimensions, stereo_calibration, get_cpu_preprocessor_options(options))
+{
+    const CameraCalibration &left_calibration = stereo_calibration.get_left_camera_calibration();
+    const CameraCalibration &right_calibration = stereo_calibration.get_right_camera_calibration();
+
+    // undistort is done by CpuPreprocessor, so only the camera matrices are used
+    m_rectification.setIntrinsicCoeffs(get_camera_matrix(left_calibration), 0);
+    m_rectification.setIntrinsicCoeffs(get_camera_matrix(right_calibration), 1);
+    m_rectification.setDistCoeffs(cv::Mat::zeros(1, 4, CV_64FC1), 0);
+    m_rectification.setDistCoeffs(cv::Mat::zeros(1, 4, CV_64FC1), 1);
+
+    // the poses go from the world to each camera, stereoRectify wants the right camera from the left one
+    const Pose &left_pose = left_calibration.get_pose();
+    const Pose &right_pose = right_calibration.get_pose();
+    const RotationMatrix R = right_pose.R * left_pose.R.transpose();
+    const TranslationVector t = right_pose.t - R * left_pose.t;
+
+    cv::Mat R_mat(3, 3, CV_64FC1), t_mat(3, 1, CV_64FC1);
+    for (int i = 0; i < 3; i++)
+    {
+        t_mat.at<double>(i) = t(i);
+        for (int j = 0; j < 3; j++)
+            R_mat.at<double>(i, j) = R(i, j);
+    }
+    m_rectification.setRotationMatrix(R_mat);
+    m_rectification.setTranslationMatrix(t_mat);
+
+    m_rectification.setMapCacheDir(get_option_value<string>(options, "preprocess.rectification_cache_dir"));
+    // both cameras are run afterwards, the maps are only read from then on
+    m_rectification.prepareMaps(cv::Size(dimensions.x, dimensions.y));
+}
+
+CachedRectificationPreprocessor::~CachedRectificationPreprocessor()
+{
+
+}
+
+void CachedRectificationPreprocessor::run(const input_image_view_t& input, const int camera_index,
+                                          const output_image_view_t &output)
+{
+    CpuPreprocessor::run(input, camera_index, output);
+
+    // the maps do not depend on the channel order, the output view is remapped in place
+    cv::Mat image(output.height(), output.width(), CV_8UC3,
+                  boost::gil::interleaved_view_get_raw_data(output), output.pixels().row_size());
+    cv::Mat rectified;
+    if (! m_rectification.rectifyImage(image, camera_index, rectified))
+        throw std::runtime_error("CachedRectificationPreprocessor::run received an image of an unexpected size");
+    rectified.copyTo(image);
+}
+
+}
@@ -0,0 +1,52 @@
+/*
+    Copyright 2014 Néstor Morales Hernández <email>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#ifndef CACHEDRECTIFICATIONPREPROCESSOR_H
+#define CACHEDRECTIFICATIONPREPROCESSOR_H
+
+#include "video_input/preprocessing/CpuPreprocessor.hpp"
+
+#include "rectification.h"
+
+namespace doppia
+{
+
+///
+/// CpuPreprocessor whose rectification step is done with stixel_world::Rectification, so the
+/// rectification maps are read from preprocess.rectification_cache_dir when that calibration was
+/// already seen, instead of being computed at every start. The rest of the steps (unbayer, undistort,
+/// smooth, ...) are the ones of CpuPreprocessor. Images keep their size, as with CpuPreprocessor.
+///
+class CachedRectificationPreprocessor : public CpuPreprocessor
+{
+public:
+    static boost::program_options::options_description get_args_options();
+
+    CachedRectificationPreprocessor(const dimensions_t &dimensions,
+                                    const StereoCameraCalibration &stereo_calibration,
+                                    const boost::program_options::variables_map &options);
+    ~CachedRectificationPreprocessor();
+
+    void run(const input_image_view_t& input, const int camera_index,
+             const output_image_view_t &output);
+
+protected:
+    stixel_world::Rectification m_rectification;
+};
+}
+
+#endif // CACHEDRECTIFICATIONPREPROCESSOR_H
@@ -16,31 +16,101 @@
 
 
 #include "extendedfastgroundplaneestimator.h"
+#include "utils.h"
 
-#include "extendedfastgroundplaneestimator.h"
+#include "helpers/get_option_value.hpp"
 
 #include <boost/foreach.hpp>
 #include <iostream>
+#include <cmath>
 
 namespace stixel_world {
 
 typedef doppia::FastGroundPlaneEstimator::points_t points_t;
     
 using namespace std;
+
+boost::program_options::options_description ExtendedFastGroundPlaneEstimator::get_args_options()
+{
+    boost::program_options::options_description desc("ExtendedFastGroundPlaneEstimator options");
+    
+    desc.add_options()
+    
+    ("ground_plane_estimator.asynchronous", boost::program_options::value<bool>()->default_value(false),
+        "estimate the ground plane on a background thread, and predict it between estimates")
+    
+    ("ground_plane_estimator.period", boost::program_options::value<int>()->default_value(5),
+        "frames between the start of two background estimations")
+    
+    ("ground_plane_estimator.max_pitch_change", boost::program_options::value<float>()->default_value(0.02),
+        "difference with the predicted pitch (radians) that makes the next estimation start right away")
+    
+    ("ground_plane_estimator.use_ground_estimator", boost::program_options::value<bool>()->default_value(false),
+        "compute the v-disparity and fit the ground line with GroundEstimator")
+    
+    ("ground_plane_estimator.tracking", boost::program_options::value<bool>()->default_value(false),
+        "GroundEstimator only searches around the last ground line while it is tracked")
+    
+    ("ground_plane_estimator.pyramid", boost::program_options::value<bool>()->default_value(false),
+        "GroundEstimator refines the ground line found at half resolution")
+    
+    ;
+    
+    return desc;
+}
     
 ExtendedFastGroundPlaneEstimator::ExtendedFastGroundPlaneEstimator(
     const boost::program_options::variables_map &options,
     const doppia::StereoCameraCalibration &stereo_calibration) :
         FastGroundPlaneEstimator(options, stereo_calibration)
 {
+    init(options, stereo_calibration, doppia::get_option_value<bool>(options, "ground_plane_estimator.asynchronous"));
+}
+
+ExtendedFastGroundPlaneEstimator::ExtendedFastGroundPlaneEstimator(
+    const boost::program_options::variables_map &options,
+    const doppia::StereoCameraCalibration &stereo_calibration, const bool & asynchronous) :
+        FastGroundPlaneEstimator(options, stereo_calibration)
+{
+    init(options, stereo_calibration, asynchronous);
+}
 
+void ExtendedFastGroundPlaneEstimator::init(const boost::program_options::variables_map &options,
+                                            const doppia::StereoCameraCalibration &stereo_calibration,
+                                            const bool & asynchronous)
+{
+    m_numIterations = 0;
+    m_cumulatedTime = 0.0;
     
+    m_asynchronous = asynchronous;
+    m_period = std::max(1, doppia::get_option_value<int>(options, "ground_plane_estimator.period"));
+    m_maxPitchChange = doppia::get_option_value<float>(options, "ground_plane_estimator.max_pitch_change");
+    if (m_asynchronous)
+        mp_worker.reset(new ExtendedFastGroundPlaneEstimator(options, stereo_calibration, false));
+    
+    // In asynchronous mode, only the worker estimates the plane
+    if ((! m_asynchronous) && doppia::get_option_value<bool>(options, "ground_plane_estimator.use_ground_estimator")) {
+        mp_groundEstimator.reset(new GroundEstimator(options, getRectification(stereo_calibration)));
+        mp_groundEstimator->setTrackingMode(doppia::get_option_value<bool>(options, "ground_plane_estimator.tracking"));
+        mp_groundEstimator->setPyramidMode(doppia::get_option_value<bool>(options, "ground_plane_estimator.pyramid"));
+        mp_groundEstimator->setGroundPlanePrior(estimated_ground_plane);
+    }
+    m_resultReady = false;
     
+    m_hasEstimate = false;
+    m_refreshRequested = false;
+    m_framesSinceStart = 0;
+    m_startInterval = 0;
+    m_estimateAge = 0;
+    m_predictedFrames = 0;
+    m_lastCoeffs.setZero();
+    m_coeffsRate.setZero();
 }
 
 ExtendedFastGroundPlaneEstimator::~ExtendedFastGroundPlaneEstimator()
 {
-
+    if (mp_workerThread)
+        mp_workerThread->join();
 }
 
 void set_points_weights(const points_t &points,
@@ -61,34 +131,70 @@ void set_points_weights(const points_t &points,
 }
 
 void ExtendedFastGroundPlaneEstimator::compute()
-{    
-    static int num_iterations = 0;
-    static double cumulated_time = 0;
+{
+    if (! m_asynchronous) {
+        computeSynchronous();
+        return;
+    }
+    
+    m_framesSinceStart++;
+    m_estimateAge++;
     
+    if ((! fetchEstimate()) && m_hasEstimate) {
+        predict();
+        m_predictedFrames++;
+    }
+    
+    if ((! mp_workerThread) && ((! m_hasEstimate) || m_refreshRequested || (m_framesSinceStart >= m_period))) {
+        startEstimation();
+        
+        // Nothing to predict from yet, the first plane is waited for
+        if (! m_hasEstimate) {
+            mp_workerThread->join();
+            fetchEstimate();
+        }
+    }
+    
+    confidence_is_up_to_date = false;
+}
+
+void ExtendedFastGroundPlaneEstimator::computeSynchronous()
+{
     const int num_iterations_for_timing = 50;
     const double start_wall_time = omp_get_wtime();
     
-    // compute v_disparity --
-    compute_v_disparity_data();
-    
-    set_points_weights(points, row_weights, points_weights);
-    // compute line --
-    estimate_ground_plane();
+    if (mp_groundEstimator) {
+        cv::Mat left, right;
+        gil2opencv(input_left_view, left);
+        gil2opencv(input_right_view, right);
+        
+        // The prior is given to doppia's estimator after the construction, and it bounds the ground lines
+        if (m_numIterations == 0)
+            mp_groundEstimator->setGroundPlanePrior(estimated_ground_plane);
+        mp_groundEstimator->setImagePair(left, right);
+        // Without a ground line, the estimator keeps the previous plane
+        mp_groundEstimator->compute();
+        estimated_ground_plane = mp_groundEstimator->getGroundPlane();
+    } else {
+        // compute v_disparity --
+        compute_v_disparity_data();
+        
+        set_points_weights(points, row_weights, points_weights);
+        // compute line --
+        estimate_ground_plane();
+    }
     
     confidence_is_up_to_date = false;
     
     // timing ---
-    cumulated_time += omp_get_wtime() - start_wall_time;
-    num_iterations += 1;
-    
-    const doppia::GroundPlane & gp = get_ground_plane();
-    cout << "H = " << gp.get_height() << ", P = " << gp.get_pitch() << endl;
-//     cout << "Ground plane " << get_ground_plane() << endl;
+    m_cumulatedTime += omp_get_wtime() - start_wall_time;
+    m_numIterations += 1;
+
     
-    if((silent_mode == false) and ((num_iterations % num_iterations_for_timing) == 0))
+    if((silent_mode == false) and ((m_numIterations % num_iterations_for_timing) == 0))
     {
-        printf("Average FastGroundPlaneEstimator::compute speed  %.2lf [Hz] (in the last %i iterations)\n",
-               num_iterations / cumulated_time, num_iterations );
+        printf("Average FastGroundPlaneEstimator::compute speed  %.2lf [Hz] (in the last %lu iterations)\n",
+               m_numIterations / m_cumulatedTime, (unsigned long)m_numIterations );
     }
     
 //     doppia::GroundPlane ground_plane_prior;
@@ -102,4 +208,111 @@ void ExtendedFastGroundPlaneEstimator::compute()
     return;
 }
 
+/// Rectification with the cameras of the (rectified) stereo pair, for GroundEstimator
+Rectification ExtendedFastGroundPlaneEstimator::getRectification(const doppia::StereoCameraCalibration& stereo_calibration)
+{
+    Rectification rectification;
+    for (uint32_t cameraId = 0; cameraId < 2; cameraId++) {
+        const doppia::InternalCameraParameters & parameters = (cameraId == 0)?
+                                stereo_calibration.get_left_camera_calibration().get_internal_parameters() :
+                                stereo_calibration.get_right_camera_calibration().get_internal_parameters();
+        
+        cv::Mat K = cv::Mat::eye(3, 3, CV_64FC1);
+        K.at<double>(0, 0) = parameters.get_focal_length_x();
+        K.at<double>(1, 1) = parameters.get_focal_length_y();
+        K.at<double>(0, 2) = parameters.get_image_center_x();
+        K.at<double>(1, 2) = parameters.get_image_center_y();
+        rectification.setIntrinsicCoeffs(K, cameraId);
+        rectification.setDistCoeffs(cv::Mat::zeros(1, 4, CV_64FC1), cameraId);
+    }
+    rectification.setRotationMatrix(cv::Mat::eye(3, 3, CV_64FC1));
+    cv::Mat t = cv::Mat::zeros(3, 1, CV_64FC1);
+    t.at<double>(0) = stereo_calibration.get_baseline();
+    rectification.setTranslationMatrix(t);
+    
+    return rectification;
+}
+
+void ExtendedFastGroundPlaneEstimator::startEstimation()
+{
+    // The input views are only valid during this frame
+    m_workerLeft.recreate(input_left_view.dimensions());
+    m_workerRight.recreate(input_right_view.dimensions());
+    boost::gil::copy_pixels(input_left_view, boost::gil::view(m_workerLeft));
+    boost::gil::copy_pixels(input_right_view, boost::gil::view(m_workerRight));
+    
+    doppia::AbstractVideoInput::input_image_view_t
+                        left_view(boost::gil::view(m_workerLeft)),
+                        right_view(boost::gil::view(m_workerRight));
+    mp_worker->set_rectified_images_pair(left_view, right_view);
+    if (! m_hasEstimate)
+        mp_worker->set_ground_plane_prior(estimated_ground_plane);
+    
+    m_startInterval = m_framesSinceStart;
+    m_framesSinceStart = 0;
+    m_refreshRequested = false;
+    mp_workerThread.reset(new boost::thread(&ExtendedFastGroundPlaneEstimator::runEstimation, this));
+}
+
+void ExtendedFastGroundPlaneEstimator::runEstimation()
+{
+    mp_worker->compute();
+    
+    boost::mutex::scoped_lock lock(m_resultMutex);
+    m_result = mp_worker->get_ground_plane();
+    m_resultReady = true;
+}
+
+bool ExtendedFastGroundPlaneEstimator::fetchEstimate()
+{
+    doppia::GroundPlane result;
+    {
+        boost::mutex::scoped_lock lock(m_resultMutex);
+        if (! m_resultReady)
+            return false;
+        result = m_result;
+        m_resultReady = false;
+    }
+    
+    mp_workerThread->join();
+    mp_workerThread.reset();
+    m_numIterations++;
+    
+    applyEstimate(result);
+    
+    return true;
+}
+
+void ExtendedFastGroundPlaneEstimator::applyEstimate(const doppia::GroundPlane& groundPlane)
+{
+    // The estimate is from the images of m_framesSinceStart frames ago
+    if (m_hasEstimate) {
+        predict();
+        if (fabs(groundPlane.get_pitch() - estimated_ground_plane.get_pitch()) > m_maxPitchChange) {
+            // Not the expected motion, it is not extrapolated and it is checked again right away
+            m_coeffsRate.setZero();
+            m_refreshRequested = true;
+        } else if (m_startInterval != 0) {
+            m_coeffsRate = (groundPlane.coeffs() - m_lastCoeffs) / m_startInterval;
+        }
+    }
+    
+    m_lastCoeffs = groundPlane.coeffs();
+    m_estimateAge = m_framesSinceStart;
+    m_hasEstimate = true;
+    
+    estimated_ground_plane = groundPlane;
+    if (! m_refreshRequested)
+        predict();
+}
+
+void ExtendedFastGroundPlaneEstimator::predict()
+{
+    if (! m_hasEstimate)
+        return;
+    
+    estimated_ground_plane.coeffs() = m_lastCoeffs + m_coeffsRate * m_estimateAge;
+    estimated_ground_plane.normalize();
+}
+
 }
@@ -17,8 +17,24 @@
 #ifndef EXTENDEDFASTGROUNDPLANEESTIMATOR_H
 #define EXTENDEDFASTGROUNDPLANEESTIMATOR_H
 #include <stereo_matching/ground_plane/FastGroundPlaneEstimator.hpp>
+#include "video_input/AbstractVideoInput.hpp"
+#include "groundestimator.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
 
 namespace stixel_world {
+
+///
+/// FastGroundPlaneEstimator with an asynchronous mode (ground_plane_estimator.asynchronous).
+/// In that mode, the v-disparity and the line fit run on a background thread, on a copy of the images,
+/// every ground_plane_estimator.period frames. Meanwhile, the plane is extrapolated from the last two
+/// estimates of the worker, at a constant rate per frame. An estimate whose pitch is more than
+/// ground_plane_estimator.max_pitch_change away from the prediction is taken as is, and the next
+/// estimation is started in the next frame.
+/// With ground_plane_estimator.use_ground_estimator, the v-disparity and the line fit are done by
+/// GroundEstimator (vectorized matching costs, tracking and pyramid modes) instead of doppia's code.
+///
 class ExtendedFastGroundPlaneEstimator : public doppia::FastGroundPlaneEstimator
 {
 
@@ -27,7 +43,55 @@ public:
                                      const doppia::StereoCameraCalibration &stereo_calibration);
     virtual ~ExtendedFastGroundPlaneEstimator();
     
+    static boost::program_options::options_description get_args_options();
+    
     void compute();
+    
+    uint64_t getEstimations() const { return m_numIterations; }
+    /// Frames whose plane is extrapolated, as no estimate arrived in them (asynchronous mode)
+    uint64_t getPredictedFrames() const { return m_predictedFrames; }
+private:
+    /// Background worker, always synchronous
+    ExtendedFastGroundPlaneEstimator(const boost::program_options::variables_map &options,
+                                     const doppia::StereoCameraCalibration &stereo_calibration,
+                                     const bool & asynchronous);
+    void init(const boost::program_options::variables_map &options,
+              const doppia::StereoCameraCalibration &stereo_calibration, const bool & asynchronous);
+    
+    void computeSynchronous();
+    void startEstimation();
+    void runEstimation();
+    bool fetchEstimate();
+    void applyEstimate(const doppia::GroundPlane & groundPlane);
+    void predict();
+    static Rectification getRectification(const doppia::StereoCameraCalibration &stereo_calibration);
+    
+    // Per instance timing, reported every num_iterations_for_timing estimations
+    uint64_t m_numIterations;
+    double m_cumulatedTime;
+    
+    bool m_asynchronous;
+    uint32_t m_period;
+    float m_maxPitchChange;
+    
+    boost::shared_ptr<GroundEstimator> mp_groundEstimator;
+    
+    // Background estimation, on its own synchronous estimator and images
+    boost::shared_ptr<ExtendedFastGroundPlaneEstimator> mp_worker;
+    doppia::AbstractVideoInput::input_image_t m_workerLeft, m_workerRight;
+    boost::shared_ptr<boost::thread> mp_workerThread;
+    boost::mutex m_resultMutex;
+    bool m_resultReady;
+    doppia::GroundPlane m_result;
+    
+    // Prediction between estimates: the plane coefficients change at a constant rate per frame
+    bool m_hasEstimate;
+    bool m_refreshRequested;            // after an unexpected estimate, the next one is started right away
+    uint32_t m_framesSinceStart;        // since the images of the last started estimation
+    uint32_t m_startInterval;           // frames between the images of the last two estimations
+    uint32_t m_estimateAge;             // frames since the images of the last applied estimate
+    uint64_t m_predictedFrames;
+    Eigen::Vector4f m_lastCoeffs, m_coeffsRate;
 };
 }
 #endif // EXTENDEDFASTGROUNDPLANEESTIMATOR_H
@@ -108,11 +108,6 @@ ExtendedStixelWorldEstimatorFactory::new_instance(const boost::program_options::
     // create the stixel_world_estimator instance
     const string method = get_option_value<string>(options, "stixel_world.method");
     
-    if(video_input_p == NULL)
-    {
-        throw std::invalid_argument("video_input_p is NULL!!!");
-    }
-    
     GroundPlane ground_plane_prior;
     ground_plane_prior.set_from_metric_units(
         ground_plane_prior_pitch, ground_plane_prior_roll, ground_plane_prior_height);
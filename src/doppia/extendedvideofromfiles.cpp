@@ -38,9 +38,8 @@
 #include "helpers/get_option_value.hpp"
 #include "helpers/get_section_options.hpp"
 
-#include <ros/ros.h>
-
 #include <string>
+#include <algorithm>
 
 using namespace std;
 using namespace boost;
@@ -91,11 +90,14 @@ ExtendedVideoFromFiles::get_args_options()
 
 ExtendedVideoFromFiles::ExtendedVideoFromFiles(const program_options::variables_map &options,
                                const shared_ptr<StereoCameraCalibration> &stereo_calibration_p)
-                    : VideoFromFiles(options, stereo_calibration_p)
+                    : VideoFromFiles(options, stereo_calibration_p), m_increment(1)
 {
     
-    ros::NodeHandle nh("~");
-    nh.param("increment", m_increment, 1);
+}
+
+void ExtendedVideoFromFiles::set_increment(const int increment)
+{
+    m_increment = std::max(1, increment);
 }
     
 /// Advance in stream, return true if successful
@@ -51,6 +51,10 @@ public:
     bool next_frame();
     
     bool previous_frame();
+    
+    /// Number of frames advanced by next_frame() (and moved back by previous_frame())
+    void set_increment(const int increment);
+    int get_increment() const { return m_increment; }
 protected:
     
     int m_increment;
@@ -16,6 +16,8 @@
 
 #include "extendedvideoinputfactory.h"
 #include "extendedvideofromfiles.h"
+#include "videofrompackedsequence.h"
+#include "cachedrectificationpreprocessor.h"
 
 #include "video_input/VideoInputFactory.hpp"
 
@@ -44,7 +46,7 @@ ExtendedVideoInputFactory::get_args_options()
     desc.add_options()
     
     ("video_input.source", value<string>()->default_value("directory"),
-                                                            "video input source: directory, movie or camera")
+                                                            "video input source: directory, directory_skip, packed, movie or camera")
     
     ("video_input.calibration_filename", value<string>(),
         "filename protocol buffer text description of the stereo rig calibration. See calibration.proto for mor details")
@@ -53,8 +55,10 @@ ExtendedVideoInputFactory::get_args_options()
     
     desc.add(AbstractVideoInput::get_args_options());
     desc.add(VideoFromFiles::get_args_options());
+    desc.add(VideoFromPackedSequence::get_args_options());
     desc.add(AbstractPreprocessor::get_args_options());
     desc.add(CpuPreprocessor::get_args_options());
+    desc.add(CachedRectificationPreprocessor::get_args_options());
     
     //        desc.add(get_section_options("video_input", "AbstractVideoInput options", AbstractVideoInput::get_args_options()));
     //        desc.add(get_section_options("video_input", "VideoFromFiles options", VideoFromFiles::get_args_options()));
@@ -67,17 +71,43 @@ ExtendedVideoInputFactory::get_args_options()
 shared_ptr<AbstractPreprocessor> new_preprocessor_instance(const variables_map &options, AbstractVideoInput &video_input)
 {
     shared_ptr<AbstractPreprocessor> preprocess_p;
-    preprocess_p.reset(new CpuPreprocessor(video_input.get_left_image().dimensions(),
-                                            video_input.get_stereo_calibration(),
-                                            options));
+    // with a cache folder, the rectification maps are only computed the first time a calibration is seen
+    if (get_option_value<bool>(options, "preprocess.rectify") and
+        (options.count("preprocess.rectification_cache_dir") > 0) and
+        (not get_option_value<string>(options, "preprocess.rectification_cache_dir").empty()))
+    {
+        preprocess_p.reset(new CachedRectificationPreprocessor(video_input.get_left_image().dimensions(),
+                                                               video_input.get_stereo_calibration(),
+                                                               options));
+    }
+    else
+    {
+        preprocess_p.reset(new CpuPreprocessor(video_input.get_left_image().dimensions(),
+                                                video_input.get_stereo_calibration(),
+                                                options));
+    }
     return preprocess_p;
 }
 
+void
+ExtendedVideoInputFactory::set_rectification_cache_dir(variables_map &options, const string &cache_dir)
+{
+    options.erase("preprocess.rectification_cache_dir");
+    options.insert(std::make_pair("preprocess.rectification_cache_dir", variable_value(boost::any(cache_dir), false)));
+}
+
 AbstractVideoInput*
 ExtendedVideoInputFactory::new_instance(const variables_map &options)
 {
     // create the stereo matcher instance
     const string source = get_option_value<std::string>(options, "video_input.source");
+    
+    // packed sequences carry their own calibration and are stored already preprocessed
+    if (source.compare("packed") == 0)
+    {
+        return new VideoFromPackedSequence(options);
+    }
+    
     const string calibration_filename = get_option_value<std::string>(options, "video_input.calibration_filename");
     
     // the calibration object is temporary, used only to precompute data inside the CpuPreprocessor
@@ -113,4 +143,25 @@ ExtendedVideoInputFactory::new_instance(const variables_map &options)
     
     return video_source_p;
 }
-}
\ No newline at end of file
+
+bool
+ExtendedVideoInputFactory::set_frame_increment(AbstractVideoInput &video_input, const int increment)
+{
+    ExtendedVideoFromFiles * const video_from_files_p = dynamic_cast<ExtendedVideoFromFiles *>(&video_input);
+    if (video_from_files_p != NULL)
+    {
+        video_from_files_p->set_increment(increment);
+        return true;
+    }
+    
+    VideoFromPackedSequence * const video_from_packed_p = dynamic_cast<VideoFromPackedSequence *>(&video_input);
+    if (video_from_packed_p != NULL)
+    {
+        video_from_packed_p->set_increment(increment);
+        return true;
+    }
+    
+    return (increment == 1);
+}
+
+}
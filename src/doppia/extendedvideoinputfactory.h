@@ -26,6 +26,15 @@ class ExtendedVideoInputFactory : public VideoInputFactory
 public:
     static boost::program_options::options_description get_args_options();
     static AbstractVideoInput* new_instance(const boost::program_options::variables_map &options);
+    
+    /// Sets the number of frames advanced on each next_frame() call.
+    /// Returns false if the input does not support skipping frames.
+    static bool set_frame_increment(AbstractVideoInput &video_input, const int increment);
+    
+    /// Sets preprocess.rectification_cache_dir, for the programs that take it from their own parameters.
+    /// Must be called before new_instance.
+    static void set_rectification_cache_dir(boost::program_options::variables_map &options,
+                                            const std::string &cache_dir);
 };
 }
 
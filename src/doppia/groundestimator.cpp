@@ -16,16 +16,98 @@
 
 
 #include "groundestimator.h"
+#include "vdisparitycosts.h"
+#include "visualizationsink.h"
+#include "pipelinetracer.h"
 #include "omp.h"
 
+#include <cmath>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+
+// Census window of (2 * CENSUS_RADIUS + 1)^2 pixels, 24 bits
+#define CENSUS_RADIUS 2
+// Saturation of the SAD of a pixel (3 channels). The row costs are divided by 3, so a saturated pixel costs 80
+#define SAD_COST_SATURATION (5 * 3 * 16) // 5 * number_*of_pixels * levels_by_disparity
+// Saturation of the Hamming distance of a pixel (out of 24 bits). The census row costs are scaled to the
+// units of the SAD ones (a saturated pixel costs SAD_COST_SATURATION / 3), so DELTA_COST means the same
+#define CENSUS_COST_SATURATION 12
+// Points within this distance (disparities) of the ground line count for its confidence
+#define GROUND_LINE_INLIER_DISTANCE 2.0
+// Ground lines are only taken between the lines of the prior plane with these margins in height (meters)
+// and pitch (radians), and with a slope up to GROUND_PRIOR_DIRECTION_FRACTION times beyond them
+#define GROUND_PRIOR_HEIGHT_MARGIN 0.3
+#define GROUND_PRIOR_PITCH_MARGIN 0.05
+#define GROUND_PRIOR_DIRECTION_FRACTION 1.5 // as doppia's FastGroundPlaneEstimator
+
 using namespace std;
 using namespace stixel_world;
 
-GroundEstimator::GroundEstimator(const Rectification & rectification) : m_rectification(rectification)
+/// Census transform of the gray image: one bit per pixel of the window, set when it is darker than the
+/// center. Pixels without a whole window are 0
+static void computeCensus(const cv::Mat & img, cv::Mat & census)
 {
+    cv::Mat gray;
+    cv::cvtColor(img, gray, CV_BGR2GRAY);
+    census = cv::Mat::zeros(gray.size(), CV_32SC1);
+    
+    #pragma omp parallel
+    {
+        STIXEL_TRACE_OMP_REGION("GroundEstimator::computeCensus");
+
+        #pragma omp for schedule(static)
+        for (int32_t y = CENSUS_RADIUS; y < gray.rows - CENSUS_RADIUS; y++) {
+            uint32_t * censusRow = census.ptr<uint32_t>(y);
+            for (int32_t x = CENSUS_RADIUS; x < gray.cols - CENSUS_RADIUS; x++) {
+                const uint8_t center = gray.at<uint8_t>(y, x);
+                uint32_t bits = 0;
+                for (int32_t dy = -CENSUS_RADIUS; dy <= CENSUS_RADIUS; dy++) {
+                    const uint8_t * grayRow = gray.ptr<uint8_t>(y + dy);
+                    for (int32_t dx = -CENSUS_RADIUS; dx <= CENSUS_RADIUS; dx++) {
+                        if ((dx != 0) || (dy != 0))
+                            bits = (bits << 1) | ((grayRow[x + dx] < center)? 1 : 0);
+                    }
+                }
+                censusRow[x] = bits;
+            }
+        }
+    }
+}
+
+const uint8_t GroundEstimator::COST_SAD;
+const uint8_t GroundEstimator::COST_CENSUS;
+
+GroundEstimator::GroundEstimator(const boost::program_options::variables_map & options, 
+                                 const Rectification & rectification) : m_rectification(rectification)
+{
+    m_pIrlsLinesDetector.reset(new doppia::IrlsLinesDetector(options));
+    m_groundPlaneFound = false;
+    m_hasPriorBounds = false;
+    m_numIterations = 0;
+    m_cumulatedTime = 0.0;
+    
     m_justHalfImage = true;
+    m_firstRow = 0;
     m_yStride = 1;
     m_maxDisparity = 128;
+    m_costMode = COST_SAD;
+    
+    m_trackingMode = false;
+    m_trackingMargin = 8;
+    m_minTrackingConfidence = 0.5;
+    m_fullSearchPeriod = 30;
+    m_groundLineTracked = false;
+    m_searchAroundGroundLine = false;
+    m_framesSinceFullSearch = 0;
+    m_groundLineConfidence = 0.0;
+    m_restrictSearch = false;
+    m_searchMargin = 0;
+    
+    m_pyramidMode = false;
+    m_pyramidMargin = 4;
+    m_coarseLineUsed = false;
+    m_levelScale = 1;
     
     // alpha and v0 as defined in section II of the V-disparity paper of Labayrade, Aubert and Tarel 2002.
     m_stereoAlpha = (
@@ -46,69 +128,150 @@ GroundEstimator::~GroundEstimator()
 
 }
 
+void GroundEstimator::setCostMode(const uint8_t& costMode)
+{
+    if ((costMode != COST_SAD) && (costMode != COST_CENSUS))
+        throw std::invalid_argument("Unknown v-disparity cost mode");
+    
+    m_costMode = costMode;
+}
+
+void GroundEstimator::setTrackingMode(const bool& tracking, const uint32_t& disparityMargin, 
+                                      const double& minConfidence, const uint32_t& fullSearchPeriod)
+{
+    m_trackingMode = tracking;
+    m_trackingMargin = disparityMargin;
+    m_minTrackingConfidence = minConfidence;
+    m_fullSearchPeriod = std::max(1u, fullSearchPeriod);
+}
+
+void GroundEstimator::setPyramidMode(const bool& pyramid, const uint32_t& refinementMargin)
+{
+    m_pyramidMode = pyramid;
+    m_pyramidMargin = refinementMargin;
+}
+
 void GroundEstimator::setImagePair(const cv::Mat& img1, const cv::Mat& img2)
 {
-    if (m_justHalfImage) {
-        m_left = img1(cv::Range(img1.rows / 2.0, img1.rows), cv::Range::all());
-        m_right = img2(cv::Range(img2.rows / 2.0, img2.rows), cv::Range::all());
+    cv::Range rows = m_processingBand.getRows(img1.rows);
+    if (m_justHalfImage && m_processingBand.isWholeImage())
+        rows = cv::Range(img1.rows / 2.0, img1.rows);
+    
+    m_firstRow = rows.start;
+    m_fullLeft = img1(rows, cv::Range::all());
+    m_fullRight = img2(rows, cv::Range::all());
+}
+
+void GroundEstimator::prepareLevel(const cv::Mat& left, const cv::Mat& right, const uint32_t& scale)
+{
+    m_levelScale = scale;
+    m_left = left;
+    m_right = right;
+    if (m_costMode == COST_CENSUS) {
+        computeCensus(m_left, m_leftCensus);
+        computeCensus(m_right, m_rightCensus);
     } else {
-        m_left = img1;
-        m_right = img2;
+        // One plane per channel for the vectorized costs
+        cv::split(m_left, m_leftChannels);
+        cv::split(m_right, m_rightChannels);
     }
 
-    m_disparity = cv::Mat::zeros(m_left.rows, m_maxDisparity, CV_16UC1);
+    m_disparity = cv::Mat::zeros(m_left.rows, (m_maxDisparity + scale - 1) / scale, CV_16UC1);
     m_selectedPoints.clear();
-    m_rowWeights.resize(m_disparity.rows);
+    m_rowWeights.assign(m_disparity.rows, 0.0);
+    m_rowPoints.resize(m_disparity.rows * ROW_POINT_SLOTS);
+    m_rowPointsCount.assign(m_disparity.rows, 0);
 }
 
 bool GroundEstimator::compute()
 {
-    static int num_iterations = 0;
-    static double cumulated_time = 0;
-    
-    const int num_iterations_for_timing = 50;
     const double start_wall_time = omp_get_wtime();
     
+    m_searchAroundGroundLine = m_trackingMode && m_groundLineTracked && (m_framesSinceFullSearch < m_fullSearchPeriod);
+    m_framesSinceFullSearch = m_searchAroundGroundLine? m_framesSinceFullSearch + 1 : 0;
+    m_restrictSearch = m_searchAroundGroundLine;
+    m_searchLine = m_vDisparityGroundLine;
+    m_searchMargin = m_trackingMargin;
+    
+    // Without a tracked line, the full resolution search is limited to the band around the coarse line
+    line_t coarseLine;
+    m_coarseLineUsed = m_pyramidMode && (! m_searchAroundGroundLine) && findCoarseGroundLine(coarseLine);
+    if (m_coarseLineUsed) {
+        m_restrictSearch = true;
+        m_searchLine = coarseLine;
+        m_searchMargin = m_pyramidMargin;
+    }
+    
     // compute v_disparity --
+    prepareLevel(m_fullLeft, m_fullRight, 1);
     computeVDisparityData();
     
     setPointsWeights(m_pointWeights);
     // compute line --
     estimateGroundPlane();
-//     
-//     confidence_is_up_to_date = false;
-//     
-//     // timing ---
-//     cumulated_time += omp_get_wtime() - start_wall_time;
-//     num_iterations += 1;
-//     
-//     if((silent_mode == false) and ((num_iterations % num_iterations_for_timing) == 0))
-//     {
-//         printf("Average FastGroundPlaneEstimator::compute speed  %.2lf [Hz] (in the last %i iterations)\n",
-//                num_iterations / cumulated_time, 0/*num_iterations*/ );
-//     }
-    cout << "Time " << omp_get_wtime() - start_wall_time << endl;
     
-    return true;
+    // The coarse line was wrong by more than the margin, the whole range is searched
+    if (m_coarseLineUsed && (! m_groundLineTracked)) {
+        m_restrictSearch = false;
+        m_coarseLineUsed = false;
+        prepareLevel(m_fullLeft, m_fullRight, 1);
+        computeVDisparityData();
+        setPointsWeights(m_pointWeights);
+        estimateGroundPlane();
+    }
+    
+    // timing ---
+    m_cumulatedTime += omp_get_wtime() - start_wall_time;
+    m_numIterations += 1;
+    
+    return m_groundPlaneFound;
+}
+
+/// Line of the v-disparity of the images at half resolution, over all the disparities, in full image coordinates
+bool GroundEstimator::findCoarseGroundLine(line_t& coarseLine)
+{
+    cv::Mat left, right;
+    cv::pyrDown(m_fullLeft, left);
+    cv::pyrDown(m_fullRight, right);
+    
+    prepareLevel(left, right, 2);
+    m_restrictSearch = false;
+    computeVDisparityData();
+    setPointsWeights(m_pointWeights);
+    
+    return findGroundLine(coarseLine);
 }
 
 void GroundEstimator::computeVDisparityData()
 {
     // for each pixel and each disparity value
-    #pragma omp parallel for
-    for(uint32_t rowIdx = 0; rowIdx < m_left.rows; rowIdx += m_yStride) {
-        computeVDisparityRow(rowIdx);
+    #pragma omp parallel
+    {
+        STIXEL_TRACE_OMP_REGION("GroundEstimator::computeVDisparityData");
+
+        #pragma omp for
+        for(uint32_t rowIdx = 0; rowIdx < m_left.rows; rowIdx += m_yStride) {
+            computeVDisparityRow(rowIdx);
+        }
+    }
+    
+    // The points of each row, in row order, so the line fit does not depend on the threads
+    m_selectedPoints.reserve(m_rowPoints.size());
+    for (uint32_t rowIdx = 0; rowIdx < m_rowPointsCount.size(); rowIdx++) {
+        const points_t::value_type * rowPoints = &m_rowPoints[rowIdx * ROW_POINT_SLOTS];
+        m_selectedPoints.insert(m_selectedPoints.end(), rowPoints, rowPoints + m_rowPointsCount[rowIdx]);
     }
     
     //TODO: Debug
-    cv::Mat visualizePoints = cv::Mat::zeros(m_disparity.rows, m_disparity.cols, CV_8UC3);
-    for (uint32_t i = 0; i < m_selectedPoints.size(); i++)
-        visualizePoints.at<cv::Vec3b>(m_selectedPoints[i].y, m_selectedPoints[i].x) = cv::Vec3b(0, 0, 255);
-    
-    cv::namedWindow("vdisparity");
-    cv::imshow("vdisparity", m_disparity);
-    cv::namedWindow("visualizePoints");
-    cv::imshow("visualizePoints", visualizePoints);
+    if (VisualizationSink::isAttached() && (m_levelScale == 1)) {
+        cv::Mat visualizePoints = cv::Mat::zeros(m_disparity.rows, m_disparity.cols, CV_8UC3);
+        for (uint32_t i = 0; i < m_selectedPoints.size(); i++)
+            visualizePoints.at<cv::Vec3b>(m_selectedPoints[i].second, m_selectedPoints[i].first) = cv::Vec3b(0, 0, 255);
+        
+        // m_disparity is reused by the next frame
+        VisualizationSink::show("vdisparity", m_disparity.clone());
+        VisualizationSink::show("visualizePoints", visualizePoints);
+    }
     //TODO: End of Debug
     
     //printf("num_points == %i\n", points.size());
@@ -117,64 +280,88 @@ void GroundEstimator::computeVDisparityData()
 
 inline void GroundEstimator::computeVDisparityRow(const uint32_t& rowIdx)
 {
-    const int disparityOffset = m_rectification.getDisparityOffsetX();
-    const uint16_t costSumSaturation = 5 * 3 * 16; // 5 * number_*of_pixels * levels_by_disparity
-    assert(m_maxDisparity <= m_disparity.cols);
-    
+    const int disparityOffset = m_rectification.getDisparityOffsetX() / (int)m_levelScale;
     uint16_t minCost = std::numeric_limits<uint16_t>::max();
     
+    uint32_t firstDisparity = 0, lastDisparity = m_disparity.cols;
+    if (m_restrictSearch) {
+        // The disparities out of the range are never selected
+        m_disparity.row(rowIdx).setTo(cv::Scalar::all(std::numeric_limits<uint16_t>::max()));
+        if (! getSearchDisparityRange(rowIdx, firstDisparity, lastDisparity))
+            return;
+    }
+    
+    const uint8_t * left[3], * right[3];
+    if (m_costMode == COST_SAD) {
+        for (uint32_t c = 0; c < 3; c++) {
+            left[c] = m_leftChannels[c].ptr<uint8_t>(rowIdx);
+            right[c] = m_rightChannels[c].ptr<uint8_t>(rowIdx);
+        }
+    }
+    
     // a pixel (x,y) on the left image should be matched on the right image on the range ([0,x],y)
     //const int first_right_x = first_left_x - disparity;
-    for(uint32_t d = 0; d < m_maxDisparity; d ++) {
-        uint16_t disparityCost = 0;
-        
-        for (uint32_t iL = d + disparityOffset, iR = 0; iL < m_left.cols; iL++, iR++) {
-            const uint16_t cost = sad_cost_uint16(m_left.at<cv::Vec3b>(rowIdx, iL), m_right.at<cv::Vec3b>(rowIdx, iR));
-            disparityCost += std::min(cost, costSumSaturation);
+    uint32_t costs[VDISPARITY_DISPARITIES_PER_PASS];
+    for(uint32_t d = firstDisparity; d < lastDisparity; d += VDISPARITY_DISPARITIES_PER_PASS) {
+        const uint32_t numDisparities = std::min((uint32_t)VDISPARITY_DISPARITIES_PER_PASS, lastDisparity - d);
+        if (m_costMode == COST_CENSUS) {
+            computeCensusRowCosts(m_leftCensus.ptr<uint32_t>(rowIdx), m_rightCensus.ptr<uint32_t>(rowIdx), m_left.cols,
+                                  d + disparityOffset, numDisparities, CENSUS_COST_SATURATION, costs);
+            for (uint32_t i = 0; i < numDisparities; i++)
+                costs[i] = costs[i] * (SAD_COST_SATURATION / 3) / CENSUS_COST_SATURATION;
+        } else {
+            computeSADRowCosts(left, right, m_left.cols, d + disparityOffset, numDisparities, SAD_COST_SATURATION, costs);
+            // we divide once at the end of the sums, the sums are kept in 32 bits
+            for (uint32_t i = 0; i < numDisparities; i++)
+                costs[i] /= 3;
         }
         
-        // we divide once at the end of the sums
-        // this is ok to delay the division because
-        // log2(1024*255*3) ~= 20 [bits]
-        // so there is no risk of overflow inside 32bits
-        disparityCost /= 3;
-        m_disparity.at<uint16_t>(rowIdx, d) = disparityCost;
-        
-        minCost = std::min(disparityCost, minCost);
+        for (uint32_t i = 0; i < numDisparities; i++) {
+            const uint16_t disparityCost = cv::saturate_cast<uint16_t>(costs[i]);
+            m_disparity.at<uint16_t>(rowIdx, d + i) = disparityCost;
+            
+            minCost = std::min(disparityCost, minCost);
+        }
     } // end of "for each disparity"
     
     // select points to use for ground estimation --
-    selectPointsAndWeights(rowIdx, minCost);
+    selectPointsAndWeights(rowIdx, minCost, firstDisparity, lastDisparity);
     
     return;
 }
 
-// compute the raw SAD (without doing a division by the number of channels)
-inline uint16_t GroundEstimator::sad_cost_uint16(const cv::Vec3b& pixel_a, const cv::Vec3b& pixel_b)
+/// Disparities within m_searchMargin of m_searchLine in the row. False if the line is not in the range
+bool GroundEstimator::getSearchDisparityRange(const uint32_t& rowIdx, 
+                                              uint32_t& firstDisparity, uint32_t& lastDisparity) const
 {
-    const int16_t delta_r = pixel_a[0] - pixel_b[0];
-    const int16_t delta_g = pixel_a[1] - pixel_b[1];
-    const int16_t delta_b = pixel_a[2] - pixel_b[2];
+    const line_t searchLine = toLevelLine(m_searchLine);
+    const float slope = searchLine.direction()(0);
+    if (slope == 0.0f)
+        return false;
+    
+    const float disparity = ((float)rowIdx - searchLine.origin()(0)) / slope;
+    const int32_t first = std::max(0, (int32_t)floor(disparity) - (int32_t)m_searchMargin);
+    const int32_t last = std::min(m_disparity.cols, (int32_t)ceil(disparity) + (int32_t)m_searchMargin + 1);
+    if (first >= last)
+        return false;
     
-    // SAD
-    const uint16_t distance = std::abs(delta_r) + std::abs(delta_g) + std::abs(delta_b);
-    const uint16_t &cost = distance; // we skip the /3
+    firstDisparity = first;
+    lastDisparity = last;
     
-    return cost;
+    return true;
 }
 
-inline void GroundEstimator::selectPointsAndWeights(const uint32_t& rowIdx, const uint16_t& minCost)
+inline void GroundEstimator::selectPointsAndWeights(const uint32_t& rowIdx, const uint16_t& minCost, 
+                                                    const uint32_t& firstDisparity, const uint32_t& lastDisparity)
 {
-// vector<cv::Point2f> &points, vector<double> &row_weights
     const uint16_t & threshCost = minCost + DELTA_COST;
     uint32_t pointsInRow = 0;
+    // Only this row writes to its slots, no synchronization is needed
+    points_t::value_type * rowPoints = &m_rowPoints[rowIdx * ROW_POINT_SLOTS];
     
-    for(uint32_t d = 0; d < m_maxDisparity; d++) {
+    for(uint32_t d = firstDisparity; d < lastDisparity; d++) {
         if (m_disparity.at<uint16_t>(rowIdx, d) <= threshCost) {
-            #pragma omp critical
-            {
-                m_selectedPoints.push_back( cv::Point2f(d, rowIdx) );
-            }
+            rowPoints[pointsInRow] = points_t::value_type(d, rowIdx);
             pointsInRow++;
             
             if(pointsInRow > MAX_POINTS_IN_ROW) {
@@ -187,6 +374,7 @@ inline void GroundEstimator::selectPointsAndWeights(const uint32_t& rowIdx, cons
         }
     } // end of "for each disparity"
     
+    m_rowPointsCount[rowIdx] = pointsInRow;
     if(pointsInRow > 0) {
         // rows with less points give more confidence
         m_rowWeights[rowIdx] = 1.0 / (double)pointsInRow;
@@ -200,84 +388,66 @@ void GroundEstimator::setPointsWeights(Eigen::VectorXf & pointWeights)
     pointWeights.resize(m_selectedPoints.size());
     
     for (uint32_t i = 0; i < m_selectedPoints.size(); i++) {
-        pointWeights[i] = m_rowWeights[m_selectedPoints[i].y];
+        pointWeights[i] = m_rowWeights[m_selectedPoints[i].second];
     }
         
     return;
 }
 
-void GroundEstimator::estimateGroundPlane()
+/// From full image coordinates to the v-disparity of the current level: rows from m_firstRow, and rows
+/// and disparities divided by m_levelScale. The slope does not change
+GroundEstimator::line_t GroundEstimator::toLevelLine(const line_t& line) const
 {
-    const bool found_ground_plane = findGroundLine(m_vDisparityGroundLine);
+    line_t levelLine = line;
+    levelLine.origin()(0) = (line.origin()(0) - m_firstRow) / m_levelScale;
     
-    /*const float weight = std::max(0.0f, 1.0f - get_confidence());
+    return levelLine;
+}
+
+GroundEstimator::line_t GroundEstimator::fromLevelLine(const line_t& levelLine) const
+{
+    line_t line = levelLine;
+    line.origin()(0) = levelLine.origin()(0) * m_levelScale + m_firstRow;
     
-    const float minimum_weight = rejection_threshold;
-    //const float minimum_weight = 0.0015;
+    return line;
+}
+
+double GroundEstimator::computeGroundLineConfidence(const line_t& groundLine) const
+{
+    const line_t levelLine = toLevelLine(groundLine);
+    const float slope = levelLine.direction()(0);
+    if ((m_selectedPoints.empty()) || (slope == 0.0f))
+        return 0.0;
     
-    // retrieve ground plane parameters --
-    if((found_ground_plane == true) and (weight >  minimum_weight))
-    {
-        set_ground_plane_estimate(
-            v_disparity_line_to_ground_plane(v_disparity_ground_line), weight);
-        
-        const bool print_estimated_plane = false;
-        if(print_estimated_plane)
-        {
-            log_debug() << "Found a ground plane with " <<
-            "heigth == " << estimated_ground_plane.get_height() << " [meters]"
-            " and pitch == " << estimated_ground_plane.get_pitch() * 180 / M_PI << " [degrees]" <<
-            std::endl;
-            log_debug() << "Ground plane comes from line with " <<
-            "origin == " << v_disparity_ground_line.origin()(0) << " [pixels]"
-            " and direction == " << v_disparity_ground_line.direction()(0) << " [-]" <<
-            std::endl;
-        }
+    uint32_t closePoints = 0;
+    for (uint32_t i = 0; i < m_selectedPoints.size(); i++) {
+        const float disparity = (m_selectedPoints[i].second - levelLine.origin()(0)) / slope;
+        if (fabs(disparity - m_selectedPoints[i].first) <= GROUND_LINE_INLIER_DISTANCE)
+            closePoints++;
     }
-    else
-    {
-        num_ground_plane_estimation_failures += 1;
-        
-        // in case this happened during the first call
-        // we set the v_disparity_ground_line using the current ground plane estimate
-        v_disparity_ground_line = ground_plane_to_v_disparity_line( get_ground_plane() );
-        
-        static int num_ground_warnings = 0;
-        //const int max_num_ground_warnings = 1000;
-        //const int max_num_ground_warnings = 50;
-        const int max_num_ground_warnings = 25;
-        
-        if(num_ground_warnings < max_num_ground_warnings)
-        {
-            log_warning() << "Did not find a ground plane, keeping previous estimate." << std::endl;
-            num_ground_warnings += 1;
-        }
-        else if(num_ground_warnings == max_num_ground_warnings)
-        {
-            log_warning() << "Warned too many times about problems finding ground plane, going silent." << std::endl;
-            num_ground_warnings += 1;
-        }
-        else
-        {
-            // we do nothing
-        }
-        
-        const float weight = 1.0;
-        // we keep previous estimate
-        set_ground_plane_estimate(estimated_ground_plane, weight);
-        
-        
-        //        const bool save_failures_v_disparity_image = false;
-        //        if(save_failures_v_disparity_image)
-        //        {
-        //            const std::string filename = boost::str(
-        //                        boost::format("failure_v_disparity_%i.png") % num_ground_plane_estimation_failures );
-        //            log_info() << "Created image " << filename << std::endl;
-        //            boost::gil::png_write_view(filename, v_disparity_image_view);
-        //        }
+    
+    return (double)closePoints / m_selectedPoints.size();
+}
+
+void GroundEstimator::estimateGroundPlane()
+{
+    line_t groundLine;
+    const bool found_ground_plane = findGroundLine(groundLine);
+    
+    // The next frames search around the line while it explains the points
+    m_groundLineConfidence = found_ground_plane? computeGroundLineConfidence(groundLine) : 0.0;
+    m_groundLineTracked = found_ground_plane && (m_groundLineConfidence >= m_minTrackingConfidence);
+    
+    // retrieve ground plane parameters --
+    if (found_ground_plane) {
+        m_vDisparityGroundLine = groundLine;
+        m_estimatedGroundPlane = vDisparityLineToGroundPlane(groundLine);
+    } else {
+        // we keep previous estimate, and the line matches it
+        m_vDisparityGroundLine = groundPlaneToVDisparityLine(m_estimatedGroundPlane);
     }
     
-    return;*/
+    m_groundPlaneFound = found_ground_plane;
 }
 
 bool GroundEstimator::findGroundLine(line_t &groundLine) {
@@ -285,98 +455,78 @@ bool GroundEstimator::findGroundLine(line_t &groundLine) {
     vector<line_t> foundLines;
     bool foundGroundPlane = false;
     
-    // we correct the origin of our estimate lines
-    // since we computed them using the lower half of the image
-    const int originOffset = m_left.rows;
-    
+    // we correct the origin (and the scale) of our estimate lines
+    // since we computed them using the rows from m_firstRow in the current level
     const line_t linePrior = groundPlaneToVDisparityLine(m_estimatedGroundPlane);
     
-    line_t linePriorWithOffset = linePrior;
-    linePriorWithOffset.origin()(0) -= originOffset;
-    cout << "m_estimatedGroundPlane " << m_estimatedGroundPlane.get_pitch() << ", " << m_estimatedGroundPlane.get_height() << endl;
-    cout << "linePrior " << linePrior.direction() << endl;
+    if ((! m_pIrlsLinesDetector) || (m_selectedPoints.empty()))
+        return false;
     
-    m_pIrlsLinesDetector->set_initial_estimate(linePriorWithOffset);
-    
-    exit(0);
+    m_pIrlsLinesDetector->set_initial_estimate(toLevelLine(linePrior));
     (*m_pIrlsLinesDetector)(m_selectedPoints, m_pointWeights, foundLines);
     
-    printf("irls_lines_detector_p found %zi lines\n", foundLines.size());
-    
-    /*BOOST_FOREACH(line_t &line, found_lines)
-    {
-        line.origin()(0) += origin_offset;
-    }
-    
-    // given two bounding lines we verify the x=0 line and the y=max_y line
-    // this checks bound quite well the desired ground line
-    
-    const float direction_fraction = 1.5; // FIXME hardcoded value
-    const float max_line_direction = prior_max_v_disparity_line.direction()(0)*direction_fraction,
-    min_line_direction = prior_min_v_disparity_line.direction()(0)/direction_fraction;
-    
-    const float max_line_y0 = prior_max_v_disparity_line.origin()(0),
-    min_line_y0 = prior_min_v_disparity_line.origin()(0);
-    
-    const float min_y0 = max_line_y0, max_y0 = min_line_y0;
-    
-    const float y_intercept = input_left_view.height();
-    const float max_x_intercept = (y_intercept - max_line_y0) / max_line_direction,
-    min_x_intercept = (y_intercept - min_line_y0) / min_line_direction;
-    
-    assert(min_y0 < max_y0);
-    assert(min_x_intercept < max_x_intercept);
-    
-    BOOST_FOREACH(line_t t_ground_line, found_lines)
-    {
-        const float t_y0 = t_ground_line.origin()(0);
-        const float t_direction =  t_ground_line.direction()(0);
-        const float t_x_intercept = (y_intercept - t_y0) / t_direction;
-        
-        const bool print_xy_check = false;
-        if(print_xy_check)
-        {
-            printf("prior origin == %.3f, direction == %.3f\n",
-                   line_prior.origin()(0), line_prior.direction()(0));
-            
-            printf("line origin == %.3f, direction == %.3f\n",
-                   t_ground_line.origin()(0), t_ground_line.direction()(0));
-            
-            printf("max_y0 == %.3f, t_y0 == %.3f, min_y0 = %.3f\n",
-                   max_y0, t_y0, min_y0);
-            
-            printf("max_x_intercept == %.3f, t_x_intercept == %.3f, min_x_intercept = %.3f\n",
-                   max_x_intercept, t_x_intercept, min_x_intercept);
-            
-            printf("max_line_direction == %.3f, t_direction == %.3f, min_line_direction = %.3f\n",
-                   max_line_direction, t_direction, min_line_direction);
-        }
-        
-        if(t_y0 <= max_y0 and t_y0 >= min_y0 and
-            t_x_intercept <= max_x_intercept and t_x_intercept >= min_x_intercept and
-            t_direction <= max_line_direction and t_direction >= min_line_direction )
-        {
-            ground_line = t_ground_line;
-            found_ground_plane = true;
+    // The first line within the bounds of the prior is taken, so a line fit to something else than the
+    // ground (a wall, a close vehicle) does not replace the plane
+    for (uint32_t i = 0; i < foundLines.size(); i++) {
+        const line_t line = fromLevelLine(foundLines[i]);
+        if ((! m_hasPriorBounds) || isWithinPriorBounds(line)) {
+            groundLine = line;
+            foundGroundPlane = true;
             break;
         }
-        else
-        {
-            continue;
-        }
-        
-    } // end of "for each found line"*/
+    }
     
     return foundGroundPlane;
 }
 
+/// Given the two bounding lines, the origin (row of disparity 0), the slope and the disparity in the last
+/// row are checked, this bounds the ground line quite well
+bool GroundEstimator::isWithinPriorBounds(const line_t& line) const
+{
+    const float maxDirection = m_priorMaxLine.direction()(0) * GROUND_PRIOR_DIRECTION_FRACTION;
+    const float minDirection = m_priorMinLine.direction()(0) / GROUND_PRIOR_DIRECTION_FRACTION;
+    const float minY0 = m_priorMaxLine.origin()(0);
+    const float maxY0 = m_priorMinLine.origin()(0);
+    
+    const float yIntercept = m_firstRow + m_fullLeft.rows;
+    const float maxLineXIntercept = (yIntercept - minY0) / maxDirection;
+    const float minLineXIntercept = (yIntercept - maxY0) / minDirection;
+    const float minXIntercept = min(maxLineXIntercept, minLineXIntercept);
+    const float maxXIntercept = max(maxLineXIntercept, minLineXIntercept);
+    
+    const float y0 = line.origin()(0);
+    const float direction = line.direction()(0);
+    if (direction == 0.0f)
+        return false;
+    const float xIntercept = (yIntercept - y0) / direction;
+    
+    return (y0 >= minY0) && (y0 <= maxY0) && 
+           (direction >= minDirection) && (direction <= maxDirection) &&
+           (xIntercept >= minXIntercept) && (xIntercept <= maxXIntercept);
+}
+
+void GroundEstimator::setGroundPlanePrior(const doppia::GroundPlane& groundPlane)
+{
+    m_estimatedGroundPlane = groundPlane;
+    m_vDisparityGroundLine = groundPlaneToVDisparityLine(groundPlane);
+    
+    // The plane with the highest line has the lowest camera and looks the most up
+    const float height = groundPlane.get_height();
+    const float pitch = groundPlane.get_pitch();
+    m_hasPriorBounds = (height > GROUND_PRIOR_HEIGHT_MARGIN);
+    if (m_hasPriorBounds) {
+        doppia::GroundPlane minPlane, maxPlane;
+        minPlane.set_from_metric_units(pitch + GROUND_PRIOR_PITCH_MARGIN, 0.0, height - GROUND_PRIOR_HEIGHT_MARGIN);
+        maxPlane.set_from_metric_units(pitch - GROUND_PRIOR_PITCH_MARGIN, 0.0, height + GROUND_PRIOR_HEIGHT_MARGIN);
+        m_priorMinLine = groundPlaneToVDisparityLine(minPlane);
+        m_priorMaxLine = groundPlaneToVDisparityLine(maxPlane);
+    }
+}
+
 GroundEstimator::line_t GroundEstimator::groundPlaneToVDisparityLine(const doppia::GroundPlane &groundPlane) {
     const float & theta = -groundPlane.get_pitch();
     const float & heigth = groundPlane.get_height();
     
-    cout << "theta " << theta << endl;
-    cout << "heigth " << heigth << endl;
-    
     line_t line;
     
     // based on equations 10 and 11 from V-disparity paper of Labayrade, Aubert and Tarel 2002.
@@ -386,8 +536,16 @@ GroundEstimator::line_t GroundEstimator::groundPlaneToVDisparityLine(const doppi
     line.origin()(0) = v_origin;
     line.direction()(0) = 1.0 / c_r;
     
+    return line;
+}
+
+/// Inverse of groundPlaneToVDisparityLine, the roll is not observable in the v-disparity
+doppia::GroundPlane GroundEstimator::vDisparityLineToGroundPlane(const line_t& line) {
+    const float theta = std::atan((m_stereoV0 - line.origin()(0)) / m_stereoAlpha);
+    const float heigth = m_rectification.getBaseline() * cos(theta) * line.direction()(0);
     
-    exit(0);
+    doppia::GroundPlane groundPlane;
+    groundPlane.set_from_metric_units(-theta, 0, heigth);
     
-    return line;
-}
\ No newline at end of file
+    return groundPlane;
+}
@@ -23,12 +23,19 @@
 #include <opencv2/opencv.hpp>
 #include<Eigen/Geometry>
 #include <boost/shared_ptr.hpp>
+#include <boost/program_options/variables_map.hpp>
 
 #include "stereo_matching/ground_plane/GroundPlane.hpp"
+#include "stereo_matching/ground_plane/FastGroundPlaneEstimator.hpp"
 #include "image_processing/IrlsLinesDetector.hpp"
 #include "rectification.h"
+#include "processingband.h"
 
 #define MAX_POINTS_IN_ROW 20
+// The point that goes over MAX_POINTS_IN_ROW, and stops the search in the row, is kept
+#define ROW_POINT_SLOTS (MAX_POINTS_IN_ROW + 1)
+// Row costs up to this over the minimum of the row are selected, in the units of the SAD costs (the census
+// costs are scaled to them)
 #define DELTA_COST 1 //2 //5
 
 namespace stixel_world {
@@ -37,38 +44,118 @@ class GroundEstimator
     
     
 public:
-    GroundEstimator(const Rectification & rectification);
+    typedef doppia::FastGroundPlaneEstimator::points_t points_t;   // (disparity, row)
+    
+    /// Matching cost of the v-disparity
+    static const uint8_t COST_SAD = 0;          // color SAD
+    static const uint8_t COST_CENSUS = 1;       // Hamming distance of the census transforms, robust to exposure differences
+    
+    /// options are those of doppia::IrlsLinesDetector, which fits the ground line
+    GroundEstimator(const boost::program_options::variables_map & options, const Rectification & rectification);
     virtual ~GroundEstimator();
     void setImagePair(const cv::Mat & img1, const cv::Mat & img2);
+    /// Returns false when no ground line is found, the ground plane is then the previous one
     bool compute();
     
+    /// Starting estimate of the ground plane, kept until a ground line is found. Lines too far from this
+    /// plane are not taken, the previous plane is kept instead
+    void setGroundPlanePrior(const doppia::GroundPlane & groundPlane);
+    const doppia::GroundPlane & getGroundPlane() const { return m_estimatedGroundPlane; }
+    
     void toggleJustHalfImage(const bool & justHalfImage) { m_justHalfImage = justHalfImage; }
+    /// Rows used for the v-disparity instead of the lower half of the image
+    void setProcessingBand(const ProcessingBand & band) { m_processingBand = band; }
     void setYStride(const double & yStride) { m_yStride = yStride; }
     void setMaxDisparity(const uint32_t & maxDisparity) { m_maxDisparity = maxDisparity; }
+    void setCostMode(const uint8_t & costMode);
+    /// Once a ground line is found, the next frames only evaluate the disparities within disparityMargin
+    /// of it in each row. The whole range is searched again when no line is found, when the fraction of
+    /// points close to the line goes below minConfidence, and every fullSearchPeriod frames
+    void setTrackingMode(const bool & tracking, const uint32_t & disparityMargin = 8, 
+                         const double & minConfidence = 0.5, const uint32_t & fullSearchPeriod = 30);
+    /// Without a tracked line, the ground line is first found in the v-disparity of the images at half
+    /// resolution, over all the disparities. The full resolution v-disparity is then only computed within
+    /// refinementMargin disparities of that line, so the result is the same as with the whole range as long
+    /// as the coarse line is within refinementMargin of it. When the refined line does not explain the points
+    /// (the tracking minConfidence), the whole range is searched again
+    void setPyramidMode(const bool & pyramid, const uint32_t & refinementMargin = 4);
+    double getGroundLineConfidence() const { return m_groundLineConfidence; }
+    bool isSearchingAroundGroundLine() const { return m_searchAroundGroundLine; }
+    /// The last frame was refined around the coarse line
+    bool isCoarseLineUsed() const { return m_coarseLineUsed; }
+    /// Points of the v-disparity given to the line fit in the last frame (rows of the processed rows), and
+    /// their weights
+    const points_t & getSelectedPoints() const { return m_selectedPoints; }
+    const Eigen::VectorXf & getPointWeights() const { return m_pointWeights; }
+    /// Calls to compute() of this instance, and their total time (seconds)
+    uint64_t getEstimations() const { return m_numIterations; }
+    double getCumulatedTime() const { return m_cumulatedTime; }
 private:
     typedef Eigen::ParametrizedLine<float, 2> line_t;
     
+    void prepareLevel(const cv::Mat & left, const cv::Mat & right, const uint32_t & scale);
+    bool findCoarseGroundLine(line_t & coarseLine);
     void computeVDisparityData();
     void computeVDisparityRow(const uint32_t & rowIdx);
-    uint16_t sad_cost_uint16(const cv::Vec3b &pixel_a, const cv::Vec3b  &pixel_b);
-    void selectPointsAndWeights(const uint32_t & rowIdx, const uint16_t & minCost);
+    bool getSearchDisparityRange(const uint32_t & rowIdx, uint32_t & firstDisparity, uint32_t & lastDisparity) const;
+    line_t toLevelLine(const line_t & line) const;
+    line_t fromLevelLine(const line_t & levelLine) const;
+    void selectPointsAndWeights(const uint32_t & rowIdx, const uint16_t & minCost, 
+                                const uint32_t & firstDisparity, const uint32_t & lastDisparity);
+    double computeGroundLineConfidence(const line_t & groundLine) const;
     void setPointsWeights(Eigen::VectorXf & pointWeights);
     void estimateGroundPlane();
     bool findGroundLine(line_t &groundLine);
+    bool isWithinPriorBounds(const line_t & line) const;
     line_t groundPlaneToVDisparityLine(const doppia::GroundPlane &groundPlane);
+    doppia::GroundPlane vDisparityLineToGroundPlane(const line_t & line);
     
-    cv::Mat m_left, m_right, m_disparity;
+    cv::Mat m_fullLeft, m_fullRight;                   // rows of the input images
+    cv::Mat m_left, m_right, m_disparity;              // of the current level
+    cv::Mat m_leftChannels[3], m_rightChannels[3];     // COST_SAD
+    cv::Mat m_leftCensus, m_rightCensus;               // COST_CENSUS
+    uint8_t m_costMode;
     bool m_justHalfImage;
+    ProcessingBand m_processingBand;
+    int32_t m_firstRow;         // of m_fullLeft and m_fullRight in the input images
+    uint32_t m_levelScale;      // of m_left and m_right, 1 at full resolution
     uint32_t m_yStride;
     uint32_t m_maxDisparity;
     Rectification m_rectification;
-    vector<cv::Point2f> m_selectedPoints;
+    points_t m_selectedPoints;
     vector<double> m_rowWeights;
+    // ROW_POINT_SLOTS points for each row, written by the thread of the row and compacted in row order
+    points_t m_rowPoints;
+    vector<uint32_t> m_rowPointsCount;
     Eigen::VectorXf m_pointWeights;
-    line_t m_vDisparityGroundLine;
+    line_t m_vDisparityGroundLine;         // rows in full image coordinates
+    
+    bool m_trackingMode;
+    uint32_t m_trackingMargin;
+    double m_minTrackingConfidence;
+    uint32_t m_fullSearchPeriod;
+    bool m_groundLineTracked;               // m_vDisparityGroundLine can be searched around
+    bool m_searchAroundGroundLine;          // in the current frame
+    uint32_t m_framesSinceFullSearch;
+    double m_groundLineConfidence;
+    
+    // Disparities evaluated in each row, around m_searchLine (full image coordinates) in the current level
+    bool m_restrictSearch;
+    line_t m_searchLine;
+    uint32_t m_searchMargin;
+    
+    bool m_pyramidMode;
+    uint32_t m_pyramidMargin;
+    bool m_coarseLineUsed;
     
     double m_stereoAlpha, m_stereoV0;
     doppia::GroundPlane m_estimatedGroundPlane;
+    bool m_groundPlaneFound;                // in the last frame
+    bool m_hasPriorBounds;
+    line_t m_priorMinLine, m_priorMaxLine;  // v-disparity lines of the bounds of the prior (full image coordinates)
+    
+    uint64_t m_numIterations;
+    double m_cumulatedTime;
     boost::shared_ptr<doppia::IrlsLinesDetector> m_pIrlsLinesDetector;
 };
 }
@@ -0,0 +1,265 @@
+/*
+    Copyright 2014 Néstor Morales Hernández <email>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#include "packedstereosequence.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string.h>
+#include <stdexcept>
+
+#ifdef STIXEL_WORLD_WITH_LZ4
+#include <lz4.h>
+#endif
+
+namespace doppia
+{
+
+static const char PACKED_MAGIC[8] = { 'S', 'W', 'P', 'A', 'C', 'K', '0', '1' };
+
+const uint8_t PackedStereoSequence::COMPRESSION_RAW;
+const uint8_t PackedStereoSequence::COMPRESSION_LZ4;
+const uint32_t PackedStereoSequence::PACKED_VERSION;
+const uint32_t PackedStereoSequence::PACKED_ALIGNMENT;
+const uint32_t PackedStereoSequence::FLAG_RECTIFIED;
+
+PackedStereoSequence::PackedStereoSequence(const std::string& filename) : mp_data(NULL), m_size(0)
+{
+    m_fd = open(filename.c_str(), O_RDONLY);
+    if (m_fd < 0)
+        throw std::invalid_argument("Could not open the packed sequence " + filename);
+
+    struct stat fileStat;
+    if ((fstat(m_fd, &fileStat) != 0) || (fileStat.st_size < (off_t)sizeof(t_packed_header))) {
+        ::close(m_fd);
+        throw std::invalid_argument("Invalid packed sequence " + filename);
+    }
+    m_size = fileStat.st_size;
+
+    // Private writable mapping, so image views can be handed out as mutable views.
+    // Pages are only copied if somebody actually writes on them.
+    void * mapping = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, m_fd, 0);
+    if (mapping == MAP_FAILED) {
+        ::close(m_fd);
+        throw std::runtime_error("Could not map the packed sequence " + filename);
+    }
+    mp_data = (uint8_t *)mapping;
+    madvise(mp_data, m_size, MADV_RANDOM);
+
+    mp_header = (const t_packed_header *)mp_data;
+    mp_index = (const t_packed_index_entry *)(mp_data + mp_header->indexOffset);
+
+    try {
+        validate();
+    } catch (...) {
+        munmap(mp_data, m_size);
+        ::close(m_fd);
+        throw;
+    }
+}
+
+PackedStereoSequence::~PackedStereoSequence()
+{
+    munmap(mp_data, m_size);
+    ::close(m_fd);
+}
+
+void PackedStereoSequence::validate() const
+{
+    if (memcmp(mp_header->magic, PACKED_MAGIC, sizeof(PACKED_MAGIC)) != 0)
+        throw std::invalid_argument("The file is not a packed stereo sequence");
+    if (mp_header->version != PACKED_VERSION)
+        throw std::invalid_argument("Unsupported packed stereo sequence version");
+    if (mp_header->channels != 3)
+        throw std::invalid_argument("Packed stereo sequences are expected to be RGB");
+    if (! compressionAvailable(mp_header->compression))
+        throw std::runtime_error("The packed sequence compression is not supported by this build");
+    if ((mp_header->indexOffset + (uint64_t)mp_header->numFrames * sizeof(t_packed_index_entry) > m_size) ||
+        (mp_header->calibrationOffset + mp_header->calibrationSize > m_size))
+        throw std::invalid_argument("Truncated packed stereo sequence");
+
+    const uint64_t frameSize = (uint64_t)mp_header->width * mp_header->height * mp_header->channels;
+    for (uint32_t i = 0; i < mp_header->numFrames; i++) {
+        for (uint32_t camera = 0; camera < 2; camera++) {
+            if (mp_index[i].offset[camera] + mp_index[i].size[camera] > m_size)
+                throw std::invalid_argument("Truncated packed stereo sequence");
+            if ((! isCompressed()) && (mp_index[i].size[camera] != frameSize))
+                throw std::invalid_argument("Wrong frame size in packed stereo sequence");
+        }
+    }
+}
+
+bool PackedStereoSequence::compressionAvailable(const uint8_t& compression)
+{
+    switch (compression) {
+        case COMPRESSION_RAW:
+            return true;
+        case COMPRESSION_LZ4:
+#ifdef STIXEL_WORLD_WITH_LZ4
+            return true;
+#else
+            return false;
+#endif
+        default:
+            return false;
+    }
+}
+
+std::string PackedStereoSequence::getCalibration() const
+{
+    return std::string((const char *)(mp_data + mp_header->calibrationOffset), mp_header->calibrationSize);
+}
+
+uint8_t* PackedStereoSequence::getImage(const uint32_t& frameIdx, const uint8_t& camera)
+{
+    if ((frameIdx >= mp_header->numFrames) || (camera > 1))
+        throw std::out_of_range("Frame out of the packed stereo sequence");
+
+    uint8_t * data = mp_data + mp_index[frameIdx].offset[camera];
+    if (! isCompressed())
+        return data;
+
+#ifdef STIXEL_WORLD_WITH_LZ4
+    const int frameSize = mp_header->width * mp_header->height * mp_header->channels;
+    m_decoded[camera].resize(frameSize);
+    const int decoded = LZ4_decompress_safe((const char *)data, (char *)&m_decoded[camera][0],
+                                            mp_index[frameIdx].size[camera], frameSize);
+    if (decoded != frameSize)
+        throw std::runtime_error("Corrupted frame in packed stereo sequence");
+
+    return &m_decoded[camera][0];
+#else
+    throw std::runtime_error("The packed sequence compression is not supported by this build");
+#endif
+}
+
+PackedStereoSequenceWriter::PackedStereoSequenceWriter(const std::string& filename,
+                                                       const uint32_t& width, const uint32_t& height,
+                                                       const int32_t& firstFrameNumber,
+                                                       const uint8_t& compression) : m_offset(0)
+{
+    if (! PackedStereoSequence::compressionAvailable(compression))
+        throw std::invalid_argument("The requested compression is not supported by this build");
+
+    mp_file = fopen(filename.c_str(), "wb");
+    if (mp_file == NULL)
+        throw std::invalid_argument("Could not create the packed sequence " + filename);
+
+    memset(&m_header, 0, sizeof(m_header));
+    memcpy(m_header.magic, PACKED_MAGIC, sizeof(PACKED_MAGIC));
+    m_header.version = PackedStereoSequence::PACKED_VERSION;
+    m_header.width = width;
+    m_header.height = height;
+    m_header.channels = 3;
+    m_header.compression = compression;
+    m_header.firstFrameNumber = firstFrameNumber;
+
+    // Placeholder, rewritten on close
+    write(&m_header, sizeof(m_header));
+}
+
+PackedStereoSequenceWriter::~PackedStereoSequenceWriter()
+{
+    if (mp_file != NULL) {
+        try {
+            close();
+        } catch (std::exception & e) {
+            fclose(mp_file);
+        }
+    }
+}
+
+void PackedStereoSequenceWriter::write(const void* data, const uint64_t& size)
+{
+    if (fwrite(data, 1, size, mp_file) != size)
+        throw std::runtime_error("Error writing the packed stereo sequence");
+    m_offset += size;
+}
+
+void PackedStereoSequenceWriter::pad()
+{
+    static const uint8_t zeros[PackedStereoSequence::PACKED_ALIGNMENT] = { 0 };
+    const uint64_t remainder = m_offset % PackedStereoSequence::PACKED_ALIGNMENT;
+    if (remainder != 0)
+        write(zeros, PackedStereoSequence::PACKED_ALIGNMENT - remainder);
+}
+
+uint64_t PackedStereoSequenceWriter::writeImage(const uint8_t* data, uint64_t& size)
+{
+    const int frameSize = m_header.width * m_header.height * m_header.channels;
+
+    pad();
+    const uint64_t offset = m_offset;
+    if (m_header.compression == PackedStereoSequence::COMPRESSION_RAW) {
+        write(data, frameSize);
+        size = frameSize;
+    } else {
+#ifdef STIXEL_WORLD_WITH_LZ4
+        m_compressed.resize(LZ4_compressBound(frameSize));
+        const int compressedSize = LZ4_compress_default((const char *)data, (char *)&m_compressed[0],
+                                                        frameSize, m_compressed.size());
+        if (compressedSize <= 0)
+            throw std::runtime_error("Error compressing a frame of the packed stereo sequence");
+        write(&m_compressed[0], compressedSize);
+        size = compressedSize;
+#endif
+    }
+
+    return offset;
+}
+
+void PackedStereoSequenceWriter::setRectified(const bool& rectified)
+{
+    if (rectified)
+        m_header.flags |= PackedStereoSequence::FLAG_RECTIFIED;
+    else
+        m_header.flags &= ~PackedStereoSequence::FLAG_RECTIFIED;
+}
+
+void PackedStereoSequenceWriter::addFrame(const uint8_t* left, const uint8_t* right)
+{
+    PackedStereoSequence::t_packed_index_entry entry;
+    entry.offset[0] = writeImage(left, entry.size[0]);
+    entry.offset[1] = writeImage(right, entry.size[1]);
+
+    m_index.push_back(entry);
+}
+
+void PackedStereoSequenceWriter::close()
+{
+    m_header.numFrames = m_index.size();
+
+    m_header.calibrationOffset = m_offset;
+    m_header.calibrationSize = m_calibration.size();
+    write(m_calibration.data(), m_calibration.size());
+
+    pad();
+    m_header.indexOffset = m_offset;
+    if (! m_index.empty())
+        write(&m_index[0], m_index.size() * sizeof(PackedStereoSequence::t_packed_index_entry));
+
+    if ((fseek(mp_file, 0, SEEK_SET) != 0) || (fwrite(&m_header, sizeof(m_header), 1, mp_file) != 1))
+        throw std::runtime_error("Error writing the packed stereo sequence header");
+
+    fclose(mp_file);
+    mp_file = NULL;
+}
+
+}
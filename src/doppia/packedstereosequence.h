@@ -0,0 +1,143 @@
+/*
+    Copyright 2014 Néstor Morales Hernández <email>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#ifndef PACKEDSTEREOSEQUENCE_H
+#define PACKEDSTEREOSEQUENCE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+namespace doppia
+{
+
+///
+/// Single file container for stereo sequences.
+///
+/// Layout (little endian):
+///   t_packed_header
+///   frame data, each image starting at a PACKED_ALIGNMENT boundary
+///   calibration (protobuf text, as in video_input.calibration_filename)
+///   index: numFrames x t_packed_index_entry
+///
+/// Raw frames are stored as interleaved RGB rows, so a reader can build
+/// image views directly on top of the mapped memory. FLAG_RECTIFIED in the
+/// flags of the header marks frames stored after the rectification, whose
+/// calibration must not be applied to them again.
+///
+class PackedStereoSequence
+{
+public:
+    static const uint8_t COMPRESSION_RAW = 0;
+    static const uint8_t COMPRESSION_LZ4 = 1;
+
+    static const uint32_t PACKED_VERSION = 1;
+    static const uint32_t PACKED_ALIGNMENT = 64;
+
+    static const uint32_t FLAG_RECTIFIED = 1;
+
+    typedef struct {
+        char magic[8];
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t channels;
+        uint32_t compression;
+        uint32_t numFrames;
+        int32_t firstFrameNumber;
+        uint32_t flags;
+        uint64_t calibrationOffset;
+        uint64_t calibrationSize;
+        uint64_t indexOffset;
+    } t_packed_header;
+
+    typedef struct {
+        uint64_t offset[2];
+        uint64_t size[2];
+    } t_packed_index_entry;
+
+    PackedStereoSequence(const std::string & filename);
+    ~PackedStereoSequence();
+
+    uint32_t getWidth() const { return mp_header->width; }
+    uint32_t getHeight() const { return mp_header->height; }
+    uint32_t getChannels() const { return mp_header->channels; }
+    uint32_t getNumberOfFrames() const { return mp_header->numFrames; }
+    int32_t getFirstFrameNumber() const { return mp_header->firstFrameNumber; }
+    bool isCompressed() const { return mp_header->compression != COMPRESSION_RAW; }
+    bool isRectified() const { return (mp_header->flags & FLAG_RECTIFIED) != 0; }
+    std::string getCalibration() const;
+
+    /// Returns a pointer to the image (0 = left, 1 = right) of the given frame index.
+    /// Raw sequences point straight into the mapping, compressed ones are decoded into
+    /// an internal buffer that stays valid until the next call for the same camera.
+    uint8_t * getImage(const uint32_t & frameIdx, const uint8_t & camera);
+
+    static bool compressionAvailable(const uint8_t & compression);
+protected:
+    void validate() const;
+
+    int m_fd;
+    uint8_t * mp_data;
+    size_t m_size;
+
+    const t_packed_header * mp_header;
+    const t_packed_index_entry * mp_index;
+
+    std::vector<uint8_t> m_decoded[2];
+};
+
+///
+/// Appends stereo frames to a packed sequence. The calibration and the
+/// index are written when the writer is closed.
+///
+class PackedStereoSequenceWriter
+{
+public:
+    PackedStereoSequenceWriter(const std::string & filename,
+                               const uint32_t & width, const uint32_t & height,
+                               const int32_t & firstFrameNumber,
+                               const uint8_t & compression = PackedStereoSequence::COMPRESSION_RAW);
+    ~PackedStereoSequenceWriter();
+
+    /// Images are interleaved RGB rows of width * 3 bytes without padding
+    void addFrame(const uint8_t * left, const uint8_t * right);
+    void setCalibration(const std::string & calibration) { m_calibration = calibration; }
+    /// The frames added were already rectified with the calibration
+    void setRectified(const bool & rectified);
+    void close();
+
+    uint32_t getNumberOfFrames() const { return m_index.size(); }
+protected:
+    uint64_t writeImage(const uint8_t * data, uint64_t & size);
+    void write(const void * data, const uint64_t & size);
+    void pad();
+
+    FILE * mp_file;
+    uint64_t m_offset;
+
+    PackedStereoSequence::t_packed_header m_header;
+    std::vector<PackedStereoSequence::t_packed_index_entry> m_index;
+    std::string m_calibration;
+    std::vector<uint8_t> m_compressed;
+};
+
+}
+
+#endif // PACKEDSTEREOSEQUENCE_H
@@ -0,0 +1,225 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include "vdisparitycosts.h"
+
+#include <stdlib.h>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace stixel_world {
+
+/// min(SAD of the 3 channels, saturation) between the left pixel xL and the right pixel xR
+static inline uint32_t getPixelSADCost(const uint8_t * const left[3], const uint8_t * const right[3],
+                                       const int32_t & xL, const int32_t & xR, const uint32_t & saturation)
+{
+    const uint32_t cost = std::abs((int32_t)left[0][xL] - (int32_t)right[0][xR]) +
+                          std::abs((int32_t)left[1][xL] - (int32_t)right[1][xR]) +
+                          std::abs((int32_t)left[2][xL] - (int32_t)right[2][xR]);
+    return std::min(cost, saturation);
+}
+
+static inline uint32_t getPixelCensusCost(const uint32_t * left, const uint32_t * right,
+                                          const int32_t & xL, const int32_t & xR, const uint32_t & saturation)
+{
+    return std::min((uint32_t)__builtin_popcount(left[xL] ^ right[xR]), saturation);
+}
+
+/// The channels are in separate planes, so 32 (AVX2) or 16 (SSE2) pixels are compared at once: the
+/// saturating adds of the 3 channels (at 255) followed by the minimum with saturation (< 255) give the
+/// same as clamping the exact sum.
+void computeSADRowCosts(const uint8_t * const left[3], const uint8_t * const right[3], const int32_t & width,
+                        const int32_t & firstShift, const int32_t & numDisparities,
+                        const uint8_t & saturation, uint32_t * costs)
+{
+    // The first pixels are only reached by some of the disparities
+    const int32_t lastShift = firstShift + numDisparities - 1;
+    for (int32_t i = 0; i < numDisparities; i++) {
+        costs[i] = 0;
+        for (int32_t xL = firstShift + i; xL < std::min(lastShift, width); xL++)
+            costs[i] += getPixelSADCost(left, right, xL, xL - firstShift - i, saturation);
+    }
+    
+    int32_t x = lastShift;
+#if defined(__AVX2__)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i saturationVec = _mm256_set1_epi8((char)saturation);
+        __m256i acc[VDISPARITY_DISPARITIES_PER_PASS];
+        for (int32_t i = 0; i < numDisparities; i++)
+            acc[i] = zero;
+        
+        for (; x + 32 <= width; x += 32) {
+            const __m256i l0 = _mm256_loadu_si256((const __m256i *)(left[0] + x));
+            const __m256i l1 = _mm256_loadu_si256((const __m256i *)(left[1] + x));
+            const __m256i l2 = _mm256_loadu_si256((const __m256i *)(left[2] + x));
+            for (int32_t i = 0; i < numDisparities; i++) {
+                const int32_t xR = x - firstShift - i;
+                const __m256i r0 = _mm256_loadu_si256((const __m256i *)(right[0] + xR));
+                const __m256i r1 = _mm256_loadu_si256((const __m256i *)(right[1] + xR));
+                const __m256i r2 = _mm256_loadu_si256((const __m256i *)(right[2] + xR));
+                
+                __m256i cost = _mm256_adds_epu8(_mm256_or_si256(_mm256_subs_epu8(l0, r0), _mm256_subs_epu8(r0, l0)),
+                                                _mm256_or_si256(_mm256_subs_epu8(l1, r1), _mm256_subs_epu8(r1, l1)));
+                cost = _mm256_adds_epu8(cost, _mm256_or_si256(_mm256_subs_epu8(l2, r2), _mm256_subs_epu8(r2, l2)));
+                cost = _mm256_min_epu8(cost, saturationVec);
+                // Sums of 8 costs in each 64 bits lane
+                acc[i] = _mm256_add_epi64(acc[i], _mm256_sad_epu8(cost, zero));
+            }
+        }
+        
+        for (int32_t i = 0; i < numDisparities; i++) {
+            uint64_t lanes[4];
+            _mm256_storeu_si256((__m256i *)lanes, acc[i]);
+            costs[i] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i saturationVec = _mm_set1_epi8((char)saturation);
+        __m128i acc[VDISPARITY_DISPARITIES_PER_PASS];
+        for (int32_t i = 0; i < numDisparities; i++)
+            acc[i] = zero;
+        
+        for (; x + 16 <= width; x += 16) {
+            const __m128i l0 = _mm_loadu_si128((const __m128i *)(left[0] + x));
+            const __m128i l1 = _mm_loadu_si128((const __m128i *)(left[1] + x));
+            const __m128i l2 = _mm_loadu_si128((const __m128i *)(left[2] + x));
+            for (int32_t i = 0; i < numDisparities; i++) {
+                const int32_t xR = x - firstShift - i;
+                const __m128i r0 = _mm_loadu_si128((const __m128i *)(right[0] + xR));
+                const __m128i r1 = _mm_loadu_si128((const __m128i *)(right[1] + xR));
+                const __m128i r2 = _mm_loadu_si128((const __m128i *)(right[2] + xR));
+                
+                __m128i cost = _mm_adds_epu8(_mm_or_si128(_mm_subs_epu8(l0, r0), _mm_subs_epu8(r0, l0)),
+                                             _mm_or_si128(_mm_subs_epu8(l1, r1), _mm_subs_epu8(r1, l1)));
+                cost = _mm_adds_epu8(cost, _mm_or_si128(_mm_subs_epu8(l2, r2), _mm_subs_epu8(r2, l2)));
+                cost = _mm_min_epu8(cost, saturationVec);
+                acc[i] = _mm_add_epi64(acc[i], _mm_sad_epu8(cost, zero));
+            }
+        }
+        
+        for (int32_t i = 0; i < numDisparities; i++) {
+            uint64_t lanes[2];
+            _mm_storeu_si128((__m128i *)lanes, acc[i]);
+            costs[i] += lanes[0] + lanes[1];
+        }
+    }
+#endif
+    
+    for (; x < width; x++) {
+        for (int32_t i = 0; i < numDisparities; i++)
+            costs[i] += getPixelSADCost(left, right, x, x - firstShift - i, saturation);
+    }
+}
+
+/// 8 (AVX2) or 4 (SSE4.1) census values are compared at once. The bits set in each byte of the XOR are
+/// counted with a table of the 16 nibbles (pshufb), and the counts of the 4 bytes of each pixel are added
+/// with two multiply-adds, so there is no popcount instruction on the way.
+void computeCensusRowCosts(const uint32_t * left, const uint32_t * right, const int32_t & width,
+                           const int32_t & firstShift, const int32_t & numDisparities,
+                           const uint32_t & saturation, uint32_t * costs)
+{
+    // The first pixels are only reached by some of the disparities
+    const int32_t lastShift = firstShift + numDisparities - 1;
+    for (int32_t i = 0; i < numDisparities; i++) {
+        costs[i] = 0;
+        for (int32_t xL = firstShift + i; xL < std::min(lastShift, width); xL++)
+            costs[i] += getPixelCensusCost(left, right, xL, xL - firstShift - i, saturation);
+    }
+    
+    int32_t x = lastShift;
+#if defined(__AVX2__)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i nibbleMask = _mm256_set1_epi8(0x0F);
+        const __m256i nibbleBits = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i ones8 = _mm256_set1_epi8(1);
+        const __m256i ones16 = _mm256_set1_epi16(1);
+        const __m256i saturationVec = _mm256_set1_epi32(saturation);
+        __m256i acc[VDISPARITY_DISPARITIES_PER_PASS];
+        for (int32_t i = 0; i < numDisparities; i++)
+            acc[i] = zero;
+        
+        for (; x + 8 <= width; x += 8) {
+            const __m256i l = _mm256_loadu_si256((const __m256i *)(left + x));
+            for (int32_t i = 0; i < numDisparities; i++) {
+                const __m256i r = _mm256_loadu_si256((const __m256i *)(right + x - firstShift - i));
+                const __m256i diff = _mm256_xor_si256(l, r);
+                const __m256i bytes = _mm256_add_epi8(
+                                        _mm256_shuffle_epi8(nibbleBits, _mm256_and_si256(diff, nibbleMask)),
+                                        _mm256_shuffle_epi8(nibbleBits, 
+                                                            _mm256_and_si256(_mm256_srli_epi16(diff, 4), nibbleMask)));
+                const __m256i cost = _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, ones8), ones16);
+                acc[i] = _mm256_add_epi32(acc[i], _mm256_min_epu32(cost, saturationVec));
+            }
+        }
+        
+        for (int32_t i = 0; i < numDisparities; i++) {
+            uint32_t lanes[8];
+            _mm256_storeu_si256((__m256i *)lanes, acc[i]);
+            for (uint32_t j = 0; j < 8; j++)
+                costs[i] += lanes[j];
+        }
+    }
+#endif
+#if defined(__SSE4_1__)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+        const __m128i nibbleBits = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m128i ones8 = _mm_set1_epi8(1);
+        const __m128i ones16 = _mm_set1_epi16(1);
+        const __m128i saturationVec = _mm_set1_epi32(saturation);
+        __m128i acc[VDISPARITY_DISPARITIES_PER_PASS];
+        for (int32_t i = 0; i < numDisparities; i++)
+            acc[i] = zero;
+        
+        for (; x + 4 <= width; x += 4) {
+            const __m128i l = _mm_loadu_si128((const __m128i *)(left + x));
+            for (int32_t i = 0; i < numDisparities; i++) {
+                const __m128i r = _mm_loadu_si128((const __m128i *)(right + x - firstShift - i));
+                const __m128i diff = _mm_xor_si128(l, r);
+                const __m128i bytes = _mm_add_epi8(_mm_shuffle_epi8(nibbleBits, _mm_and_si128(diff, nibbleMask)),
+                                                   _mm_shuffle_epi8(nibbleBits, 
+                                                                    _mm_and_si128(_mm_srli_epi16(diff, 4), nibbleMask)));
+                const __m128i cost = _mm_madd_epi16(_mm_maddubs_epi16(bytes, ones8), ones16);
+                acc[i] = _mm_add_epi32(acc[i], _mm_min_epu32(cost, saturationVec));
+            }
+        }
+        
+        for (int32_t i = 0; i < numDisparities; i++) {
+            uint32_t lanes[4];
+            _mm_storeu_si128((__m128i *)lanes, acc[i]);
+            costs[i] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        }
+    }
+#endif
+    
+    for (; x < width; x++) {
+        for (int32_t i = 0; i < numDisparities; i++)
+            costs[i] += getPixelCensusCost(left, right, x, x - firstShift - i, saturation);
+    }
+}
+
+}
@@ -0,0 +1,44 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#ifndef VDISPARITYCOSTS_H
+#define VDISPARITYCOSTS_H
+
+#include <stdint.h>
+
+// Disparities computed in each pass over a row, so the left pixels are loaded once for all of them
+#define VDISPARITY_DISPARITIES_PER_PASS 4
+
+namespace stixel_world {
+
+/// Row costs of the v-disparity of GroundEstimator, without OpenCV so they can be checked on their own.
+/// For numDisparities (up to VDISPARITY_DISPARITIES_PER_PASS) consecutive shifts from firstShift, they
+/// give the sum along the row of the saturated cost between left(x) and right(x - shift).
+
+/// min(SAD of the 3 channels, saturation), with one plane per channel
+void computeSADRowCosts(const uint8_t * const left[3], const uint8_t * const right[3], const int32_t & width,
+                        const int32_t & firstShift, const int32_t & numDisparities,
+                        const uint8_t & saturation, uint32_t * costs);
+
+/// min(Hamming distance, saturation) between the census transforms
+void computeCensusRowCosts(const uint32_t * left, const uint32_t * right, const int32_t & width,
+                           const int32_t & firstShift, const int32_t & numDisparities,
+                           const uint32_t & saturation, uint32_t * costs);
+
+}
+
+#endif // VDISPARITYCOSTS_H
@@ -0,0 +1,176 @@
+/*
+    Copyright 2014 Néstor Morales Hernández <email>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#include "videofrompackedsequence.h"
+
+#include "video_input/calibration/calibration.pb.h"
+#include "video_input/preprocessing/CpuPreprocessor.hpp"
+
+#include "helpers/get_option_value.hpp"
+
+#include <boost/program_options.hpp>
+#include <boost/gil/image_view_factory.hpp>
+
+#include <google/protobuf/text_format.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+using namespace boost::program_options;
+
+namespace doppia
+{
+
+static void disable_preprocessing_step(variables_map &options, const string &step)
+{
+    options.erase(step);
+    options.insert(std::make_pair(step, variable_value(boost::any(false), false)));
+}
+
+options_description
+VideoFromPackedSequence::get_args_options()
+{
+    options_description desc("VideoFromPackedSequence options");
+
+    desc.add_options()
+
+    ("video_input.packed_filename", value<string>(),
+        "packed stereo sequence created with pack_stereo_sequence, used when video_input.source = packed")
+    ;
+
+    return desc;
+}
+
+VideoFromPackedSequence::VideoFromPackedSequence(const variables_map& options)
+                    : AbstractVideoInput(options), m_increment(1)
+{
+    const string filename = get_option_value<string>(options, "video_input.packed_filename");
+    mp_sequence.reset(new PackedStereoSequence(filename));
+
+    doppia_protobuf::StereoCameraCalibration calibration_data;
+    if (! google::protobuf::TextFormat::ParseFromString(mp_sequence->getCalibration(), &calibration_data))
+        throw std::runtime_error("Could not parse the calibration stored in " + filename);
+
+    mp_stereo_calibration.reset(new StereoCameraCalibration(calibration_data));
+    mp_stereo_camera.reset(new MetricStereoCamera(*mp_stereo_calibration));
+
+    // the packer applied the rest of the preprocessing steps, only the rectification can be missing
+    if (get_option_value<bool>(options, "preprocess.rectify") and (not mp_sequence->isRectified()))
+    {
+        variables_map rectification_options = options;
+        const char * const other_steps[] = { "preprocess.unbayer", "preprocess.undistort", "preprocess.smooth",
+                                             "preprocess.residual", "preprocess.specular" };
+        for (size_t i = 0; i < sizeof(other_steps) / sizeof(other_steps[0]); i++)
+            disable_preprocessing_step(rectification_options, other_steps[i]);
+
+        const dimensions_t dimensions(mp_sequence->getWidth(), mp_sequence->getHeight());
+        mp_preprocessor.reset(new CpuPreprocessor(dimensions, *mp_stereo_calibration, rectification_options));
+        m_left_image.recreate(dimensions);
+        m_right_image.recreate(dimensions);
+    }
+
+    // start_frame and end_frame are relative to the original sequence numbering
+    const int first_frame = mp_sequence->getFirstFrameNumber();
+    const int last_frame = first_frame + mp_sequence->getNumberOfFrames() - 1;
+
+    m_start_frame = std::max(first_frame, get_option_value<int>(options, "video_input.start_frame"));
+    m_end_frame = last_frame;
+    if (options.count("video_input.end_frame") > 0)
+        m_end_frame = std::min(last_frame, get_option_value<int>(options, "video_input.end_frame"));
+
+    if (m_start_frame > m_end_frame)
+        throw std::invalid_argument("video_input.start_frame is out of the packed stereo sequence");
+
+    // as VideoFromFiles, the start frame is available right after construction
+    set_frame(m_start_frame);
+}
+
+VideoFromPackedSequence::~VideoFromPackedSequence()
+{
+
+}
+
+bool VideoFromPackedSequence::next_frame()
+{
+    return set_frame(current_frame_number + m_increment);
+}
+
+bool VideoFromPackedSequence::previous_frame()
+{
+    return set_frame(current_frame_number - m_increment);
+}
+
+void VideoFromPackedSequence::set_increment(const int increment)
+{
+    m_increment = std::max(1, increment);
+}
+
+int VideoFromPackedSequence::get_number_of_frames()
+{
+    return m_end_frame - m_start_frame + 1;
+}
+
+bool VideoFromPackedSequence::set_frame(const int frame_number)
+{
+    if ((frame_number < m_start_frame) || (frame_number > m_end_frame))
+        return false;
+
+    const uint32_t frameIdx = frame_number - mp_sequence->getFirstFrameNumber();
+    const uint32_t width = mp_sequence->getWidth();
+    const uint32_t height = mp_sequence->getHeight();
+    const ptrdiff_t rowSize = width * sizeof(boost::gil::rgb8_pixel_t);
+
+    m_left_view = boost::gil::interleaved_view(width, height,
+                                               (boost::gil::rgb8_pixel_t *)mp_sequence->getImage(frameIdx, 0), rowSize);
+    m_right_view = boost::gil::interleaved_view(width, height,
+                                                (boost::gil::rgb8_pixel_t *)mp_sequence->getImage(frameIdx, 1), rowSize);
+
+    if (mp_preprocessor)
+    {
+        mp_preprocessor->run(m_left_view, 0, boost::gil::view(m_left_image));
+        mp_preprocessor->run(m_right_view, 1, boost::gil::view(m_right_image));
+        m_left_view = boost::gil::view(m_left_image);
+        m_right_view = boost::gil::view(m_right_image);
+    }
+
+    current_frame_number = frame_number;
+
+    return true;
+}
+
+const AbstractVideoInput::input_image_view_t& VideoFromPackedSequence::get_left_image()
+{
+    return m_left_view;
+}
+
+const AbstractVideoInput::input_image_view_t& VideoFromPackedSequence::get_right_image()
+{
+    return m_right_view;
+}
+
+const MetricStereoCamera& VideoFromPackedSequence::get_metric_camera() const
+{
+    return *mp_stereo_camera;
+}
+
+const StereoCameraCalibration& VideoFromPackedSequence::get_stereo_calibration() const
+{
+    return *mp_stereo_calibration;
+}
+
+}
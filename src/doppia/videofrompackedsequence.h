@@ -0,0 +1,88 @@
+/*
+    Copyright 2014 Néstor Morales Hernández <email>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#ifndef VIDEOFROMPACKEDSEQUENCE_H
+#define VIDEOFROMPACKEDSEQUENCE_H
+
+#include "video_input/AbstractVideoInput.hpp"
+#include "video_input/MetricStereoCamera.hpp"
+#include "video_input/calibration/StereoCameraCalibration.hpp"
+#include "video_input/preprocessing/AbstractPreprocessor.hpp"
+
+#include "packedstereosequence.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+
+namespace doppia
+{
+
+using boost::shared_ptr;
+
+///
+/// Reads a stereo sequence stored with PackedStereoSequenceWriter (see mainPackSequence.cpp).
+/// The file is memory mapped, so seeking is O(1) and raw frames are handed out without copies.
+/// Frames are stored already preprocessed. Only when preprocess.rectify is set and the packer did not
+/// rectify them (PackedStereoSequence::isRectified), they are rectified here with the stored calibration,
+/// so a sequence is never rectified twice.
+///
+class VideoFromPackedSequence : public AbstractVideoInput
+{
+public:
+    static boost::program_options::options_description get_args_options();
+
+    VideoFromPackedSequence(const boost::program_options::variables_map &options);
+    ~VideoFromPackedSequence();
+
+    bool next_frame();
+    bool previous_frame();
+
+    /// Number of frames advanced by next_frame(), as ExtendedVideoFromFiles
+    void set_increment(const int increment);
+    int get_increment() const { return m_increment; }
+
+    const input_image_view_t &get_left_image();
+    const input_image_view_t &get_right_image();
+
+    int get_number_of_frames();
+    bool set_frame(const int frame_number);
+
+    const MetricStereoCamera &get_metric_camera() const;
+    const StereoCameraCalibration &get_stereo_calibration() const;
+
+    /// The frames handed out are rectified, by the packer or here
+    bool is_rectified() const { return mp_sequence->isRectified() or mp_preprocessor; }
+
+protected:
+    boost::scoped_ptr<PackedStereoSequence> mp_sequence;
+
+    shared_ptr<StereoCameraCalibration> mp_stereo_calibration;
+    boost::scoped_ptr<MetricStereoCamera> mp_stereo_camera;
+
+    int m_start_frame, m_end_frame;
+    int m_increment;
+
+    input_image_view_t m_left_view, m_right_view;
+
+    // Rectification of frames packed without it
+    shared_ptr<AbstractPreprocessor> mp_preprocessor;
+    input_image_t m_left_image, m_right_image;
+};
+
+}
+
+#endif // VIDEOFROMPACKEDSEQUENCE_H
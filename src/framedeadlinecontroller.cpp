@@ -0,0 +1,74 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include "framedeadlinecontroller.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Weight of the last measurement in the smoothed latency
+#define LATENCY_SMOOTHING 0.3
+
+using namespace std;
+
+namespace stixel_world {
+
+FrameDeadlineController::FrameDeadlineController(const double& deadline, const uint32_t& maxFrameGap) :
+                            m_deadline(deadline), m_maxFrameGap(std::max(1u, maxFrameGap)),
+                            m_latency(0.0), m_frameGap(1), m_processedFrames(0),
+                            m_droppedFrames(0), m_deadlineMisses(0), m_maxObservedGap(1)
+{
+
+}
+
+uint32_t FrameDeadlineController::update(const double& latency)
+{
+    // The gap used to reach the frame just processed is accounted now
+    if (m_processedFrames != 0)
+        m_droppedFrames += m_frameGap - 1;
+    m_processedFrames++;
+
+    if (latency > m_deadline)
+        m_deadlineMisses++;
+
+    if (m_processedFrames == 1)
+        m_latency = latency;
+    else
+        m_latency = LATENCY_SMOOTHING * latency + (1.0 - LATENCY_SMOOTHING) * m_latency;
+
+    // While a frame is processed, the source keeps producing one frame per deadline. A single
+    // slow frame must not trigger drops, so the smoothed latency is used, but a long stall is
+    // caught up immediately.
+    const double expectedLatency = std::max(m_latency, latency > 2.0 * m_deadline? latency : 0.0);
+    const uint32_t gap = (uint32_t)ceil(expectedLatency / m_deadline - 1e-6);
+    m_frameGap = std::min(m_maxFrameGap, std::max(1u, gap));
+    m_maxObservedGap = std::max(m_maxObservedGap, m_frameGap);
+
+    return m_frameGap;
+}
+
+void FrameDeadlineController::printStatistics(ostream& out) const
+{
+    const uint64_t totalFrames = m_processedFrames + m_droppedFrames;
+    out << "Frames processed " << m_processedFrames << ", dropped " << m_droppedFrames
+        << " (" << (totalFrames == 0? 0.0 : 100.0 * m_droppedFrames / totalFrames) << "%)"
+        << ", deadline misses " << m_deadlineMisses
+        << ", max gap " << m_maxObservedGap
+        << ", smoothed latency " << m_latency << " s (deadline " << m_deadline << " s)";
+}
+
+}
@@ -0,0 +1,63 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#ifndef FRAMEDEADLINECONTROLLER_H
+#define FRAMEDEADLINECONTROLLER_H
+
+#include <stdint.h>
+#include <ostream>
+
+namespace stixel_world {
+
+///
+/// Decides how many input frames have to be skipped so the pipeline keeps up with
+/// a live source producing one frame each deadline seconds.
+///
+class FrameDeadlineController
+{
+public:
+    FrameDeadlineController(const double & deadline, const uint32_t & maxFrameGap);
+
+    /// Registers the latency of the last processed frame and returns the gap
+    /// (in input frames) until the next frame that should be processed.
+    uint32_t update(const double & latency);
+
+    uint32_t getFrameGap() const { return m_frameGap; }
+    double getDeadline() const { return m_deadline; }
+
+    uint64_t getProcessedFrames() const { return m_processedFrames; }
+    uint64_t getDroppedFrames() const { return m_droppedFrames; }
+    uint64_t getDeadlineMisses() const { return m_deadlineMisses; }
+    uint32_t getMaxFrameGap() const { return m_maxObservedGap; }
+
+    void printStatistics(std::ostream & out) const;
+private:
+    double m_deadline;
+    uint32_t m_maxFrameGap;
+
+    double m_latency;
+    uint32_t m_frameGap;
+
+    uint64_t m_processedFrames;
+    uint64_t m_droppedFrames;
+    uint64_t m_deadlineMisses;
+    uint32_t m_maxObservedGap;
+};
+
+}
+
+#endif // FRAMEDEADLINECONTROLLER_H
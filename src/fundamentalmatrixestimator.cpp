@@ -18,25 +18,183 @@
 
 #include "utils.h"
 #include <opencv2/nonfree/features2d.hpp>
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+#include <omp.h>
 
 using namespace stixel_world;
 
+const uint32_t OpticalFlowPyramids::IDX_LEFT_0;
+const uint32_t OpticalFlowPyramids::IDX_RIGHT_0;
+const uint32_t OpticalFlowPyramids::IDX_LEFT_1;
+const uint32_t OpticalFlowPyramids::IDX_RIGHT_1;
+
+bool OpticalFlowPyramids::isSameImage(const cv::Mat& img1, const cv::Mat& img2)
+{
+    if ((img1.data == NULL) || (img1.size() != img2.size()) || (img1.type() != img2.type()))
+        return false;
+    
+    const size_t rowSize = img1.cols * img1.elemSize();
+    for (int32_t y = 0; y < img1.rows; y++) {
+        if (memcmp(img1.ptr(y), img2.ptr(y), rowSize) != 0)
+            return false;
+    }
+    
+    return true;
+}
+
+void OpticalFlowPyramids::update(const cv::Mat& imgLt0, const cv::Mat& imgRt0, const cv::Mat& imgLt1, const cv::Mat& imgRt1)
+{
+    // The t1 pyramids of the last call become the t0 ones when the images are the same
+    bool valid[4] = { false, false, false, false };
+    if (isSameImage(imgLt0, m_images[IDX_LEFT_1])) {
+        std::swap(m_pyramids[IDX_LEFT_0], m_pyramids[IDX_LEFT_1]);
+        valid[IDX_LEFT_0] = true;
+    }
+    if (isSameImage(imgRt0, m_images[IDX_RIGHT_1])) {
+        std::swap(m_pyramids[IDX_RIGHT_0], m_pyramids[IDX_RIGHT_1]);
+        valid[IDX_RIGHT_0] = true;
+    }
+    
+    // Each pyramid is built by a different thread
+    const cv::Mat * images[4] = { &imgLt0, &imgRt0, &imgLt1, &imgRt1 };
+    #pragma omp parallel
+    {
+        STIXEL_TRACE_OMP_REGION("OpticalFlowPyramids::update");
+
+        #pragma omp for schedule(dynamic)
+        for (uint32_t i = 0; i < 4; i++) {
+            if (! valid[i]) {
+                // The kept pyramids must not point to the caller's images
+                cv::buildOpticalFlowPyramid(*images[i], m_pyramids[i], 
+                                            cv::Size(OFLOW_WINDOW_SIZE, OFLOW_WINDOW_SIZE), OFLOW_MAX_LEVEL, true,
+                                            cv::BORDER_REFLECT_101, cv::BORDER_CONSTANT, false);
+            }
+        }
+    }
+    
+    // Copies, since the caller could write the next images in the same buffers
+    m_images[IDX_LEFT_1] = imgLt1.clone();
+    m_images[IDX_RIGHT_1] = imgRt1.clone();
+    
+    const uint32_t numReused = (valid[IDX_LEFT_0]? 1 : 0) + (valid[IDX_RIGHT_0]? 1 : 0);
+    m_reusedPyramids += numReused;
+    m_builtPyramids += 4 - numReused;
+}
+
+FeatureTracks::FeatureTracks(const uint32_t& gridCols, const uint32_t& gridRows, const uint32_t& minTracksPerCell) : 
+                                m_gridCols(gridCols), m_gridRows(gridRows), m_minTracksPerCell(minTracksPerCell)
+{
+    if ((gridCols == 0) || (gridRows == 0))
+        throw std::invalid_argument("The feature tracks grid needs at least one cell");
+    
+    m_trackedPoints = 0;
+    m_detectedPoints = 0;
+}
+
+void FeatureTracks::getTracks(const cv::Mat& img, vector< cv::Point2f >& points, cv::Mat& detectionMask) const
+{
+    points.clear();
+    
+    if (! OpticalFlowPyramids::isSameImage(img, m_image)) {
+        detectionMask.release();
+        return;
+    }
+    
+    const float cellWidth = (float)img.cols / m_gridCols;
+    const float cellHeight = (float)img.rows / m_gridRows;
+    
+    vector<uint32_t> cellTracks(m_gridCols * m_gridRows, 0);
+    vector<uint32_t> cellIdx(m_points.size());
+    for (uint32_t i = 0; i < m_points.size(); i++) {
+        const uint32_t col = std::min((uint32_t)(m_points[i].x / cellWidth), m_gridCols - 1);
+        const uint32_t row = std::min((uint32_t)(m_points[i].y / cellHeight), m_gridRows - 1);
+        cellIdx[i] = row * m_gridCols + col;
+        cellTracks[cellIdx[i]]++;
+    }
+    
+    detectionMask = cv::Mat::zeros(img.rows, img.cols, CV_8UC1);
+    for (uint32_t row = 0; row < m_gridRows; row++) {
+        for (uint32_t col = 0; col < m_gridCols; col++) {
+            if (cellTracks[row * m_gridCols + col] < m_minTracksPerCell) {
+                const int32_t x0 = col * cellWidth, y0 = row * cellHeight;
+                const int32_t x1 = (col + 1 == m_gridCols)? img.cols : (int32_t)((col + 1) * cellWidth);
+                const int32_t y1 = (row + 1 == m_gridRows)? img.rows : (int32_t)((row + 1) * cellHeight);
+                detectionMask(cv::Rect(x0, y0, x1 - x0, y1 - y0)).setTo(cv::Scalar(255));
+            }
+        }
+    }
+    
+    points.reserve(m_points.size());
+    for (uint32_t i = 0; i < m_points.size(); i++) {
+        if (cellTracks[cellIdx[i]] >= m_minTracksPerCell)
+            points.push_back(m_points[i]);
+    }
+    m_trackedPoints += points.size();
+}
+
+void FeatureTracks::update(const cv::Mat& img, const vector< cv::Point2f >& points)
+{
+    // Copy, since the caller could write the next images in the same buffer
+    m_image = img.clone();
+    
+    m_points.clear();
+    m_points.reserve(points.size());
+    for (uint32_t i = 0; i < points.size(); i++) {
+        if ((points[i].x >= 0) && (points[i].y >= 0) && (points[i].x < img.cols) && (points[i].y < img.rows))
+            m_points.push_back(points[i]);
+    }
+}
+
+void FeatureTracks::reset()
+{
+    m_image.release();
+    m_points.clear();
+}
+
 bool FundamentalMatrixEstimator::findF(const cv::Mat& imgLt0, const cv::Mat& imgRt0, 
                                        const cv::Mat& imgLt1, const cv::Mat& imgRt1, 
                                        cv::Mat& FL, cv::Mat& FR, vector < vector < cv::Point2f > > & finalCorrespondences,
-                                       const uint8_t & method, const double & cornerThresh)
+                                       const uint8_t & method, const double & cornerThresh,
+                                       OpticalFlowPyramids * pyramids, FeatureTracks * tracks,
+                                       RobustFundamentalMatrix * robust)
 {
     vector < vector < cv::Point2f > > initialPoints(5), points;
     
-    findInitialPoints(imgLt0, initialPoints[0], cornerThresh);
-
-    findPairCorrespondencesOFlow(imgLt0, imgRt0, initialPoints[0], initialPoints[1], MATCH_STEREO_PAIR);
-    findPairCorrespondencesOFlow(imgRt0, imgRt1, initialPoints[1], initialPoints[2], MATCH_BETWEEN_FRAMES);
-    findPairCorrespondencesOFlow(imgRt1, imgLt1, initialPoints[2], initialPoints[3], MATCH_STEREO_PAIR);
-    findPairCorrespondencesOFlow(imgLt1, imgLt0, initialPoints[3], initialPoints[4], MATCH_BETWEEN_FRAMES);
+    OpticalFlowPyramids localPyramids;
+    if (pyramids == NULL)
+        pyramids = &localPyramids;
+    
+    if (method == METHOD_BINARY) {
+        findCorrespondencesBinary(imgLt0, imgRt0, imgLt1, imgRt1, initialPoints);
+        tracks = NULL;
+    } else if (tracks != NULL) {
+        // Corners are only detected where the tracks from the last call are not enough
+        cv::Mat detectionMask;
+        vector<cv::Point2f> newPoints;
+        tracks->getTracks(imgLt0, initialPoints[0], detectionMask);
+        if (detectionMask.empty() || (cv::countNonZero(detectionMask) != 0))
+            findInitialPoints(imgLt0, newPoints, cornerThresh, detectionMask);
+        initialPoints[0].insert(initialPoints[0].end(), newPoints.begin(), newPoints.end());
+        tracks->addDetectedPoints(newPoints.size());
+    } else {
+        findInitialPoints(imgLt0, initialPoints[0], cornerThresh);
+    }
+    
+    if (method != METHOD_BINARY) {
+        pyramids->update(imgLt0, imgRt0, imgLt1, imgRt1);
+        
+        // Lt0 -> Rt0 -> Rt1 -> Lt1 -> Lt0
+        findCorrespondencesChain(*pyramids, initialPoints);
+    }
     
     cleanCorrespondences(initialPoints, points);
     
+    // Only the points that passed the loop check go on
+    if (tracks != NULL)
+        tracks->update(imgLt1, points[3]);
+    
 //     drawMatches(imgLt0, imgRt0, points[0], points[1]);
     
     if (points[0].size() < 8) {
@@ -51,8 +209,13 @@ bool FundamentalMatrixEstimator::findF(const cv::Mat& imgLt0, const cv::Mat& img
         finalCorrespondences = points;
     }
     
-    FL = cv::findFundamentalMat(finalCorrespondences[0], finalCorrespondences[3], CV_FM_LMEDS);
-    FR = cv::findFundamentalMat(finalCorrespondences[1], finalCorrespondences[2], CV_FM_LMEDS);
+    // LMedS when there is no robust estimator, or when it could not find F in its budget
+    if ((robust == NULL) || 
+        (! robust->estimate(finalCorrespondences[0], finalCorrespondences[3], RobustFundamentalMatrix::SEED_LEFT, FL)))
+        FL = cv::findFundamentalMat(finalCorrespondences[0], finalCorrespondences[3], CV_FM_LMEDS);
+    if ((robust == NULL) || 
+        (! robust->estimate(finalCorrespondences[1], finalCorrespondences[2], RobustFundamentalMatrix::SEED_RIGHT, FR)))
+        FR = cv::findFundamentalMat(finalCorrespondences[1], finalCorrespondences[2], CV_FM_LMEDS);
     
 //     waitForKey();
 //     visualize(imgLt0, imgRt0, imgLt1, imgRt1, initialPoints[0], points, finalCorrespondences);
@@ -70,12 +233,15 @@ bool FundamentalMatrixEstimator::findF(const cv::Mat& imgLt0, const cv::Mat& img
 }
 
 inline 
-void FundamentalMatrixEstimator::findInitialPoints(const cv::Mat& img, vector< cv::Point2f >& points, const double & cornerThresh)
+void FundamentalMatrixEstimator::findInitialPoints(const cv::Mat& img, vector< cv::Point2f >& points, const double & cornerThresh,
+                                                   const cv::Mat & detectionMask)
 {
     
     cv::Mat mask;
     cv::Canny(img, mask, 100, 200);
     cv::dilate(mask, mask, cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(11, 11)));
+    if (! detectionMask.empty())
+        mask &= detectionMask;
     
     vector<cv::KeyPoint> keypoints;
     cv::FastFeatureDetector fastDetector(cornerThresh);
@@ -102,7 +268,8 @@ void FundamentalMatrixEstimator::findPairCorrespondencesOFlow(const cv::Mat& img
     vector<uint8_t> status, statusB;
     vector<float_t> error, errorB;
     
-    cv::calcOpticalFlowPyrLK(img1, img2, points1, points2, status, error, cv::Size(3, 3), 9);
+    cv::calcOpticalFlowPyrLK(img1, img2, points1, points2, status, error, 
+                             cv::Size(OFLOW_WINDOW_SIZE, OFLOW_WINDOW_SIZE), OFLOW_MAX_LEVEL);
         
 //     if (matchingMode == MATCH_STEREO_PAIR) {
 //         cleanMatchesStereoPair(points1, points2);
@@ -112,6 +279,187 @@ void FundamentalMatrixEstimator::findPairCorrespondencesOFlow(const cv::Mat& img
 //     drawMatches(img1, img2, points1, points2);
 }
 
+inline 
+void FundamentalMatrixEstimator::findPairCorrespondencesOFlow(const OpticalFlowPyramids::t_pyramid& pyramid1, 
+                                                              const OpticalFlowPyramids::t_pyramid& pyramid2, 
+                                                              const vector< cv::Point2f >& points1, vector< cv::Point2f >& points2)
+{
+    vector<uint8_t> status;
+    vector<float_t> error;
+    
+    cv::calcOpticalFlowPyrLK(pyramid1, pyramid2, points1, points2, status, error, 
+                             cv::Size(OFLOW_WINDOW_SIZE, OFLOW_WINDOW_SIZE), OFLOW_MAX_LEVEL);
+}
+
+void FundamentalMatrixEstimator::findCorrespondencesChain(const OpticalFlowPyramids& pyramids, 
+                                                          vector< vector< cv::Point2f > >& points)
+{
+    // Each leg needs the points of the previous one, but every point is tracked on its own, so the
+    // points are split in contiguous blocks and each thread runs the whole chain on its block.
+    // Joining the blocks gives the same points as running each leg on all of them.
+    static const uint32_t chain[5] = { OpticalFlowPyramids::IDX_LEFT_0, OpticalFlowPyramids::IDX_RIGHT_0, 
+                                       OpticalFlowPyramids::IDX_RIGHT_1, OpticalFlowPyramids::IDX_LEFT_1, 
+                                       OpticalFlowPyramids::IDX_LEFT_0 };
+    
+    const uint32_t numPoints = points[0].size();
+    for (uint32_t leg = 1; leg < 5; leg++)
+        points[leg].resize(numPoints);
+    if (numPoints == 0)
+        return;
+    
+    const uint32_t numBlocks = std::min((uint32_t)omp_get_max_threads(), numPoints);
+    
+    #pragma omp parallel
+    {
+        STIXEL_TRACE_OMP_REGION("FundamentalMatrixEstimator::findCorrespondencesChain");
+
+        #pragma omp for schedule(static, 1)
+        for (uint32_t block = 0; block < numBlocks; block++) {
+            const uint32_t first = (uint64_t)numPoints * block / numBlocks;
+            const uint32_t last = (uint64_t)numPoints * (block + 1) / numBlocks;
+        
+            vector<cv::Point2f> blockPoints1(points[0].begin() + first, points[0].begin() + last), blockPoints2;
+            for (uint32_t leg = 1; leg < 5; leg++) {
+                findPairCorrespondencesOFlow(pyramids.getPyramid(chain[leg - 1]), pyramids.getPyramid(chain[leg]), 
+                                             blockPoints1, blockPoints2);
+                std::copy(blockPoints2.begin(), blockPoints2.end(), points[leg].begin() + first);
+                blockPoints1.swap(blockPoints2);
+            }
+        }
+    }
+}
+
+static inline uint32_t hammingDistance(const uint8_t * descriptor1, const uint8_t * descriptor2, const uint32_t & numBytes)
+{
+    // 64 bits at a time, which is a single popcnt with -march=native
+    uint32_t distance = 0;
+    uint32_t i = 0;
+    for (; i + sizeof(uint64_t) <= numBytes; i += sizeof(uint64_t)) {
+        uint64_t word1, word2;
+        memcpy(&word1, descriptor1 + i, sizeof(uint64_t));
+        memcpy(&word2, descriptor2 + i, sizeof(uint64_t));
+        distance += __builtin_popcountll(word1 ^ word2);
+    }
+    for (; i < numBytes; i++)
+        distance += __builtin_popcount(descriptor1[i] ^ descriptor2[i]);
+    
+    return distance;
+}
+
+void FundamentalMatrixEstimator::findCorrespondencesBinary(const cv::Mat& imgLt0, const cv::Mat& imgRt0, 
+                                                           const cv::Mat& imgLt1, const cv::Mat& imgRt1, 
+                                                           vector< vector< cv::Point2f > >& points)
+{
+    // ORB has its own FAST threshold, so cornerThresh does not apply here
+    const cv::Mat * images[4] = { &imgLt0, &imgRt0, &imgRt1, &imgLt1 };
+    vector<cv::KeyPoint> keypoints[4];
+    cv::Mat descriptors[4];
+    
+    #pragma omp parallel
+    {
+        STIXEL_TRACE_OMP_REGION("FundamentalMatrixEstimator::findCorrespondencesBinary");
+
+        #pragma omp for schedule(dynamic)
+        for (uint32_t i = 0; i < 4; i++) {
+            cv::Mat mask;
+            cv::Canny(*images[i], mask, 100, 200);
+            cv::dilate(mask, mask, cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(11, 11)));
+        
+            cv::ORB orb(BINARY_MAX_FEATURES);
+            orb(*images[i], mask, keypoints[i], descriptors[i]);
+        }
+    }
+    
+    // Lt0 -> Rt0 -> Rt1 -> Lt1 -> Lt0, in the order of images
+    static const int matchingModes[4] = { MATCH_STEREO_PAIR, MATCH_BETWEEN_FRAMES, MATCH_STEREO_PAIR, MATCH_BETWEEN_FRAMES };
+    vector<int32_t> matches[4];
+    for (uint32_t leg = 0; leg < 4; leg++) {
+        const uint32_t next = (leg + 1) % 4;
+        matchBinary(keypoints[leg], descriptors[leg], keypoints[next], descriptors[next], matches[leg], matchingModes[leg]);
+    }
+    
+    // Only complete chains are kept. The last point is the one the chain ends in, for the loop check
+    for (uint32_t i = 0; i < 5; i++) {
+        points[i].clear();
+        points[i].reserve(keypoints[0].size());
+    }
+    for (uint32_t i = 0; i < keypoints[0].size(); i++) {
+        int32_t idx[5];
+        idx[0] = i;
+        bool complete = true;
+        for (uint32_t leg = 0; complete && (leg < 4); leg++) {
+            idx[leg + 1] = matches[leg][idx[leg]];
+            complete = (idx[leg + 1] >= 0);
+        }
+        if (! complete)
+            continue;
+        
+        for (uint32_t leg = 0; leg < 5; leg++)
+            points[leg].push_back(keypoints[leg % 4][idx[leg]].pt);
+    }
+}
+
+void FundamentalMatrixEstimator::matchBinary(const vector< cv::KeyPoint >& keypoints1, const cv::Mat& descriptors1, 
+                                             const vector< cv::KeyPoint >& keypoints2, const cv::Mat& descriptors2, 
+                                             vector< int32_t >& matches, const int& matchingMode)
+{
+    matches.assign(keypoints1.size(), -1);
+    if (keypoints2.empty())
+        return;
+    
+    // Candidates are only looked for in a window around each point: a row band with the disparity range
+    // in the stereo pair (as in cleanMatchesStereoPair), and MAX_FLOW_DIST between frames. Points in img2
+    // are indexed by row and sorted by x, so each point is only compared with the few inside its window
+    const float windowX = (matchingMode == MATCH_STEREO_PAIR)? BINARY_MAX_DISPARITY : MAX_FLOW_DIST;
+    const float windowY = (matchingMode == MATCH_STEREO_PAIR)? MAX_HORIZONTAL_DIST : MAX_FLOW_DIST;
+    
+    int32_t maxRow = 0;
+    for (uint32_t i = 0; i < keypoints2.size(); i++)
+        maxRow = std::max(maxRow, (int32_t)keypoints2[i].pt.y);
+    vector< vector< pair<float, int32_t> > > rows(maxRow + 1);
+    for (uint32_t i = 0; i < keypoints2.size(); i++)
+        rows[(int32_t)keypoints2[i].pt.y].push_back(make_pair(keypoints2[i].pt.x, (int32_t)i));
+    for (uint32_t y = 0; y < rows.size(); y++)
+        std::sort(rows[y].begin(), rows[y].end());
+    
+    const uint32_t descriptorSize = descriptors1.cols;
+    
+    #pragma omp parallel
+    {
+        STIXEL_TRACE_OMP_REGION("FundamentalMatrixEstimator::matchBinary");
+
+        #pragma omp for schedule(dynamic, 64)
+        for (uint32_t i = 0; i < keypoints1.size(); i++) {
+            const cv::Point2f & point = keypoints1[i].pt;
+            const uint8_t * descriptor = descriptors1.ptr<uint8_t>(i);
+        
+            const int32_t firstRow = std::max(0, (int32_t)floor(point.y - windowY));
+            const int32_t lastRow = std::min(maxRow, (int32_t)ceil(point.y + windowY));
+        
+            uint32_t bestDistance = BINARY_MAX_HAMMING + 1;
+            int32_t bestIdx = -1;
+            for (int32_t y = firstRow; y <= lastRow; y++) {
+                const vector< pair<float, int32_t> > & row = rows[y];
+                vector< pair<float, int32_t> >::const_iterator it = 
+                        std::lower_bound(row.begin(), row.end(), make_pair(point.x - windowX, (int32_t)-1));
+                for (; (it != row.end()) && (it->first <= point.x + windowX); it++) {
+                    const cv::Point2f & candidate = keypoints2[it->second].pt;
+                    if ((fabs(candidate.y - point.y) >= windowY) ||
+                        ((matchingMode == MATCH_BETWEEN_FRAMES) && (cv::norm(candidate - point) >= MAX_FLOW_DIST)))
+                        continue;
+                
+                    const uint32_t distance = hammingDistance(descriptor, descriptors2.ptr<uint8_t>(it->second), descriptorSize);
+                    if (distance < bestDistance) {
+                        bestDistance = distance;
+                        bestIdx = it->second;
+                    }
+                }
+            }
+            matches[i] = bestIdx;
+        }
+    }
+}
+
 inline 
 void FundamentalMatrixEstimator::cleanMatchesStereoPair(vector< cv::Point2f >& points1, vector< cv::Point2f >& points2)
 {
@@ -312,7 +660,6 @@ void FundamentalMatrixEstimator::select8Points(vector< vector< cv::Point2f > >&
         cout << "corresp " << finalCorrespondences[0][i] << endl;
 }
 
-inline
 double FundamentalMatrixEstimator::measureFundMatrixQuality(const vector< cv::Point2f >& points1, const vector< cv::Point2f >& points2, const cv::Mat& F)
 {
     vector<cv::Vec3f> lines1, lines2;
@@ -331,6 +678,79 @@ double FundamentalMatrixEstimator::measureFundMatrixQuality(const vector< cv::Po
 }
 
 
+double FundamentalMatrixEstimator::validateF(const cv::Mat& imgLt0, const cv::Mat& imgLt1, const cv::Mat& F,
+                                             const uint32_t& numPoints, const double& cornerThresh)
+{
+    // Only the strongest corners, checked forth and back as in findF
+    vector<cv::KeyPoint> keypoints;
+    cv::FastFeatureDetector fastDetector(cornerThresh);
+    fastDetector.detect(imgLt0, keypoints);
+    cv::KeyPointsFilter::retainBest(keypoints, numPoints);
+    if (keypoints.size() < 8)
+        return -1.0;
+    
+    vector<cv::Point2f> points0(keypoints.size()), points1, points0b;
+    for (uint32_t i = 0; i < keypoints.size(); i++)
+        points0[i] = keypoints[i].pt;
+    
+    findPairCorrespondencesOFlow(imgLt0, imgLt1, points0, points1, MATCH_BETWEEN_FRAMES);
+    findPairCorrespondencesOFlow(imgLt1, imgLt0, points1, points0b, MATCH_BETWEEN_FRAMES);
+    
+    vector<cv::Point2f> validPoints0, validPoints1;
+    validPoints0.reserve(points0.size());
+    validPoints1.reserve(points0.size());
+    for (uint32_t i = 0; i < points0.size(); i++) {
+        if (cv::norm(points0[i] - points0b[i]) < MAX_CICLE_DIST) {
+            validPoints0.push_back(points0[i]);
+            validPoints1.push_back(points1[i]);
+        }
+    }
+    if (validPoints0.size() < 8)
+        return -1.0;
+    
+    return measureFundMatrixQuality(validPoints0, validPoints1, F);
+}
+
+FundamentalMatrixReusePolicy::FundamentalMatrixReusePolicy(const double& maxEpipolarError, const uint32_t& maxReusedFrames,
+                                                           const uint32_t& numValidationPoints) :
+                                                           m_maxEpipolarError(maxEpipolarError),
+                                                           m_maxReusedFrames(maxReusedFrames),
+                                                           m_numValidationPoints(numValidationPoints)
+{
+    m_consecutiveReuses = 0;
+    m_lastEpipolarError = -1.0;
+    m_reusedFrames = 0;
+    m_recomputedFrames = 0;
+}
+
+bool FundamentalMatrixReusePolicy::canReuse(const cv::Mat& imgLt0, const cv::Mat& imgLt1)
+{
+    if ((! enabled()) || m_F.empty() || (m_consecutiveReuses >= m_maxReusedFrames))
+        return false;
+    
+    m_lastEpipolarError = FundamentalMatrixEstimator::validateF(imgLt0, imgLt1, m_F, m_numValidationPoints);
+    if ((m_lastEpipolarError < 0.0) || (m_lastEpipolarError > m_maxEpipolarError))
+        return false;
+    
+    m_consecutiveReuses++;
+    m_reusedFrames++;
+    
+    return true;
+}
+
+void FundamentalMatrixReusePolicy::setF(const cv::Mat& F)
+{
+    F.copyTo(m_F);
+    m_consecutiveReuses = 0;
+    m_recomputedFrames++;
+}
+
+void FundamentalMatrixReusePolicy::reset()
+{
+    m_F.release();
+    m_consecutiveReuses = 0;
+}
+
 void FundamentalMatrixEstimator::visualize(const cv::Mat & imgLt0, const cv::Mat & imgRt0, const cv::Mat & imgLt1, const cv::Mat & imgRt1, 
                                            const vector< cv::Point2f > & initialPoints, 
                                            const vector< vector< cv::Point2f > > & correspondences, 
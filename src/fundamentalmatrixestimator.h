@@ -20,6 +20,8 @@
 #include <opencv2/opencv.hpp>
 #include <vector>
 
+#include "robustfundamentalmatrix.h"
+
 using namespace std;
 
 namespace stixel_world {
@@ -30,6 +32,85 @@ namespace stixel_world {
 #define MAX_HORIZONTAL_DIST 1.0
 #define MAX_FLOW_DIST 20.0
 #define MAX_CICLE_DIST 1.0
+
+// Lucas-Kanade parameters of the correspondences
+#define OFLOW_WINDOW_SIZE 3
+#define OFLOW_MAX_LEVEL 9
+
+// Binary descriptors matching (METHOD_BINARY)
+#define BINARY_MAX_FEATURES 2000
+#define BINARY_MAX_HAMMING 64
+#define BINARY_MAX_DISPARITY 128
+
+///
+/// Optical flow pyramids (cv::buildOpticalFlowPyramid, with derivatives) of the four images findF
+/// works on: left and right at t0, then left and right at t1. Each pyramid is built once per call,
+/// all of them at the same time, and the ones of t1 are kept, so they are not built again when those
+/// images come back as the t0 pair of the next call.
+///
+class OpticalFlowPyramids
+{
+public:
+    typedef vector<cv::Mat> t_pyramid;
+    
+    static const uint32_t IDX_LEFT_0 = 0;
+    static const uint32_t IDX_RIGHT_0 = 1;
+    static const uint32_t IDX_LEFT_1 = 2;
+    static const uint32_t IDX_RIGHT_1 = 3;
+    
+    OpticalFlowPyramids() : m_reusedPyramids(0), m_builtPyramids(0) {}
+    
+    /// Pyramids for the given images. Those of imgLt0 and imgRt0 are reused if they are the same
+    /// images (same contents) as imgLt1 and imgRt1 in the previous call
+    void update(const cv::Mat & imgLt0, const cv::Mat & imgRt0, const cv::Mat & imgLt1, const cv::Mat & imgRt1);
+    
+    const t_pyramid & getPyramid(const uint32_t & idx) const { return m_pyramids[idx]; }
+    
+    uint64_t getReusedPyramids() const { return m_reusedPyramids; }
+    uint64_t getBuiltPyramids() const { return m_builtPyramids; }
+    
+    /// Same size, type and contents
+    static bool isSameImage(const cv::Mat & img1, const cv::Mat & img2);
+private:
+    /// Only the t1 images are kept, to be compared with the t0 ones of the next call
+    cv::Mat m_images[4];
+    t_pyramid m_pyramids[4];
+    
+    uint64_t m_reusedPyramids;
+    uint64_t m_builtPyramids;
+};
+
+///
+/// Corners followed through the frames for findF. The Lt1 points that pass the checks of findF are
+/// the Lt0 points of the next call, so corners are only detected again in the cells of a grid that
+/// are left with less than minTracksPerCell tracks. The tracks of those cells are dropped, so the new
+/// corners do not duplicate them.
+///
+class FeatureTracks
+{
+public:
+    FeatureTracks(const uint32_t & gridCols = 8, const uint32_t & gridRows = 6, const uint32_t & minTracksPerCell = 5);
+    
+    /// Tracks to start from in img, and the mask of the pixels where new corners are needed.
+    /// If img is not the image of the last update, there are no tracks and the mask is the whole image
+    void getTracks(const cv::Mat & img, vector<cv::Point2f> & points, cv::Mat & detectionMask) const;
+    /// Points in img that survived
+    void update(const cv::Mat & img, const vector<cv::Point2f> & points);
+    void reset();
+    
+    uint64_t getTrackedPoints() const { return m_trackedPoints; }
+    uint64_t getDetectedPoints() const { return m_detectedPoints; }
+    void addDetectedPoints(const uint32_t & numPoints) { m_detectedPoints += numPoints; }
+private:
+    uint32_t m_gridCols, m_gridRows;
+    uint32_t m_minTracksPerCell;
+    
+    cv::Mat m_image;
+    vector<cv::Point2f> m_points;
+    
+    mutable uint64_t m_trackedPoints;
+    uint64_t m_detectedPoints;
+};
     
 class FundamentalMatrixEstimator
 {
@@ -38,16 +119,36 @@ public:
     static const uint8_t METHOD_OFLOW = 0;
     static const uint8_t METHOD_SURF = 1;
     static const uint8_t METHOD_COMBINED = 2;
+    static const uint8_t METHOD_BINARY = 3;
     
     static bool findF(const cv::Mat & imgLt0, const cv::Mat & imgRt0, 
                     const cv::Mat & imgLt1, const cv::Mat & imgRt1, 
                     cv::Mat& FL, cv::Mat& FR, vector < vector < cv::Point2f > > & finalCorrespondences,
-                    const uint8_t & method = METHOD_OFLOW, const double & cornerThresh = 50);
+                    const uint8_t & method = METHOD_OFLOW, const double & cornerThresh = 50,
+                    OpticalFlowPyramids * pyramids = NULL, FeatureTracks * tracks = NULL,
+                    RobustFundamentalMatrix * robust = NULL);
+    
+    /// Mean epipolar error of F (from imgLt0 to imgLt1) on at most numPoints new correspondences.
+    /// Returns a negative value if there are not enough correspondences to tell.
+    static double validateF(const cv::Mat & imgLt0, const cv::Mat & imgLt1, const cv::Mat & F,
+                            const uint32_t & numPoints, const double & cornerThresh = 50);
+    static double measureFundMatrixQuality(const vector<cv::Point2f> & points1, const vector<cv::Point2f> & points2, const cv::Mat & F);
 private:
-    static void findInitialPoints(const cv::Mat & img, vector<cv::Point2f> & points, const double & cornerThresh);
+    static void findInitialPoints(const cv::Mat & img, vector<cv::Point2f> & points, const double & cornerThresh,
+                                  const cv::Mat & detectionMask = cv::Mat());
     static void findPairCorrespondencesOFlow(const cv::Mat & img1, const cv::Mat & img2, 
                                              vector<cv::Point2f> & points1, vector<cv::Point2f> & points2,
                                              const int & matchingMode = MATCH_STEREO_PAIR);
+    static void findPairCorrespondencesOFlow(const OpticalFlowPyramids::t_pyramid & pyramid1, 
+                                             const OpticalFlowPyramids::t_pyramid & pyramid2, 
+                                             const vector<cv::Point2f> & points1, vector<cv::Point2f> & points2);
+    static void findCorrespondencesChain(const OpticalFlowPyramids & pyramids, vector < vector < cv::Point2f > > & points);
+    static void findCorrespondencesBinary(const cv::Mat & imgLt0, const cv::Mat & imgRt0, 
+                                          const cv::Mat & imgLt1, const cv::Mat & imgRt1, 
+                                          vector < vector < cv::Point2f > > & points);
+    static void matchBinary(const vector<cv::KeyPoint> & keypoints1, const cv::Mat & descriptors1,
+                            const vector<cv::KeyPoint> & keypoints2, const cv::Mat & descriptors2,
+                            vector<int32_t> & matches, const int & matchingMode);
     static void findPairCorrespondencesSURF(const cv::Mat & img1, const cv::Mat & img2, 
                                             vector<cv::KeyPoint> & keypoints1, vector<cv::KeyPoint> & keypoints2,
                                             const int & matchingMode = MATCH_STEREO_PAIR);
@@ -69,7 +170,46 @@ private:
                    const vector< vector< cv::Point2f > > & finalCorrespondences);
     static void drawMatches(const cv::Mat & img1, const cv::Mat & img2, 
                      const vector<cv::Point2f> & points1, const vector<cv::Point2f> & points2);
-    static double measureFundMatrixQuality(const vector<cv::Point2f> & points1, const vector<cv::Point2f> & points2, const cv::Mat & F);
+};
+
+///
+/// Tells when the F between the previous and the current left images (and the polar maps built
+/// from it) can be kept for the next frame instead of being estimated again. This happens at low
+/// speed or when stopped, where F barely changes.
+///
+/// The kept F is checked on a few new correspondences at each frame, and it is estimated again if its
+/// epipolar error goes over maxEpipolarError, or after maxReusedFrames frames in a row.
+/// A maxEpipolarError of 0 disables the reuse.
+///
+class FundamentalMatrixReusePolicy
+{
+public:
+    FundamentalMatrixReusePolicy(const double & maxEpipolarError = 0.0, const uint32_t & maxReusedFrames = 30,
+                                 const uint32_t & numValidationPoints = 50);
+    
+    bool enabled() const { return m_maxEpipolarError > 0.0; }
+    
+    /// True if the last F is still valid for imgLt0 -> imgLt1
+    bool canReuse(const cv::Mat & imgLt0, const cv::Mat & imgLt1);
+    /// F was estimated again
+    void setF(const cv::Mat & F);
+    /// There is no valid F anymore
+    void reset();
+    
+    uint64_t getReusedFrames() const { return m_reusedFrames; }
+    uint64_t getRecomputedFrames() const { return m_recomputedFrames; }
+    double getLastEpipolarError() const { return m_lastEpipolarError; }
+private:
+    double m_maxEpipolarError;
+    uint32_t m_maxReusedFrames;
+    uint32_t m_numValidationPoints;
+    
+    cv::Mat m_F;
+    uint32_t m_consecutiveReuses;
+    double m_lastEpipolarError;
+    
+    uint64_t m_reusedFrames;
+    uint64_t m_recomputedFrames;
 };
 
 }
@@ -0,0 +1,89 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+// Runs the stixels pipeline on a sequence without ROS and without windows, and reports
+// the stage timings, frames per second, peak memory and a digest of the tracking output.
+// Everything printed by the pipeline is discarded unless --verbose is given.
+
+#include <iostream>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <boost/program_options.hpp>
+
+#include "stixelsbenchmark.h"
+#include "stagetimings.h"
+#include "pipelinetracer.h"
+
+using namespace std;
+using namespace stixel_world;
+
+int main(int argC, char * argV[]) {
+    boost::program_options::options_description desc("stixels_benchmark options");
+    desc.add_options()
+    ("help,h", "produce this help message")
+    ("configuration_file,c", boost::program_options::value<string>(), "stixel_world configuration file (.ini)")
+    ("timings_file", boost::program_options::value<string>()->default_value(""), "append the stage timings to this CSV file")
+    ("trace_file", boost::program_options::value<string>()->default_value(""), "write a Chrome trace of the pipeline")
+    ("verbose", boost::program_options::value<bool>()->default_value(false), "keep the output of the pipeline")
+    ;
+    desc.add(StixelsBenchmark::get_args_options());
+
+    boost::program_options::variables_map args;
+    boost::program_options::store(boost::program_options::parse_command_line(argC, argV, desc), args);
+    boost::program_options::notify(args);
+
+    if ((args.count("help") > 0) || (args.count("configuration_file") == 0)) {
+        cout << desc << endl;
+        return 1;
+    }
+
+    const StixelsBenchmark::t_benchmark_params params = StixelsBenchmark::get_params(args);
+
+    const string traceFile = args["trace_file"].as<string>();
+    if (! traceFile.empty())
+        PipelineTracer::enable(traceFile);
+
+    // Both iostreams and stdio end up in file descriptor 1
+    int stdoutFd = -1;
+    if (! args["verbose"].as<bool>()) {
+        cout.flush();
+        fflush(stdout);
+        stdoutFd = dup(STDOUT_FILENO);
+        const int nullFd = open("/dev/null", O_WRONLY);
+        dup2(nullFd, STDOUT_FILENO);
+        close(nullFd);
+    }
+
+    StixelsBenchmark benchmark(args["configuration_file"].as<string>(), params);
+    benchmark.run();
+
+    if (stdoutFd != -1) {
+        cout.flush();
+        fflush(stdout);
+        dup2(stdoutFd, STDOUT_FILENO);
+        close(stdoutFd);
+    }
+
+    benchmark.printReport(cout);
+
+    const string timingsFile = args["timings_file"].as<string>();
+    if ((! timingsFile.empty()) && (StageTimings::enabled()))
+        StageTimings::writeCsv(timingsFile, benchmark.getProcessedFrames());
+
+    return 0;
+}
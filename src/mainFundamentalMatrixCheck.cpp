@@ -0,0 +1,250 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+// Checks of the F estimation: the vectorized Sampson errors against a plain scalar version, and the
+// correspondences of findF with the optical flow pyramids kept between calls against building them every
+// time. Returns 1 when any check fails.
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "omp.h"
+
+#include <opencv2/opencv.hpp>
+
+#include "sampsonerrors.h"
+#include "fundamentalmatrixestimator.h"
+
+using namespace std;
+using namespace stixel_world;
+
+// Numbers of correspondences, so every tail of the vectorized loops is reached
+#define CHECK_MAX_POINTS 300
+#define CHECK_TIMING_POINTS 2000
+#define CHECK_TIMING_MODELS 5000
+// The reference is in double precision. The float terms are in the hundreds of pixels, so the error of the
+// epipolar distance is about 1e-4 pixels, far below the inlier threshold
+#define CHECK_MAX_RELATIVE_ERROR 1e-4
+#define CHECK_MAX_ABSOLUTE_ERROR 1e-3
+// Synthetic sequence of the correspondences check: a textured plane seen by a rectified pair, which moves
+// CHECK_SEQUENCE_MOTION pixels to the left (and a third of that down) in each frame
+#define CHECK_SEQUENCE_FRAMES 6
+#define CHECK_SEQUENCE_WIDTH 640
+#define CHECK_SEQUENCE_HEIGHT 480
+#define CHECK_SEQUENCE_BLOCK 8
+#define CHECK_SEQUENCE_DISPARITY 12.0
+#define CHECK_SEQUENCE_MOTION 3.5
+#define CHECK_MIN_CORRESPONDENCES 8
+
+/// Reference of computeSampsonErrors, in double precision
+static void computeSampsonErrorsScalar(const float F[9], const float * x1, const float * y1, const float * x2,
+                                       const float * y2, const uint32_t & numPoints, float * errors)
+{
+    for (uint32_t i = 0; i < numPoints; i++) {
+        const double l1 = (double)F[0] * x1[i] + (double)F[1] * y1[i] + F[2];
+        const double l2 = (double)F[3] * x1[i] + (double)F[4] * y1[i] + F[5];
+        const double l3 = (double)F[6] * x1[i] + (double)F[7] * y1[i] + F[8];
+        const double m1 = (double)F[0] * x2[i] + (double)F[3] * y2[i] + F[6];
+        const double m2 = (double)F[1] * x2[i] + (double)F[4] * y2[i] + F[7];
+
+        const double e = x2[i] * l1 + y2[i] * l2 + l3;
+        errors[i] = e * e / (l1 * l1 + l2 * l2 + m1 * m1 + m2 * m2 + 1e-12);
+    }
+}
+
+static float getRandom(const float & range)
+{
+    return range * (rand() / (float)RAND_MAX);
+}
+
+/// F of a rectified pair with a small rotation and some noise, with the scale of an image of 640x480
+static void makeFundamentalMatrix(float F[9])
+{
+    const float noise = 1e-4;
+    F[0] = getRandom(noise) * 1e-3; F[1] = getRandom(noise) * 1e-3; F[2] = getRandom(noise);
+    F[3] = getRandom(noise) * 1e-3; F[4] = getRandom(noise) * 1e-3; F[5] = -1.0 + getRandom(noise);
+    F[6] = getRandom(noise);        F[7] = 1.0 + getRandom(noise);  F[8] = getRandom(2.0) - 1.0;
+}
+
+static void makeCorrespondences(const uint32_t & numPoints, vector<float> & x1, vector<float> & y1,
+                                vector<float> & x2, vector<float> & y2)
+{
+    x1.resize(numPoints);
+    y1.resize(numPoints);
+    x2.resize(numPoints);
+    y2.resize(numPoints);
+    for (uint32_t i = 0; i < numPoints; i++) {
+        x1[i] = getRandom(640.0);
+        y1[i] = getRandom(480.0);
+        // Most of them close to the epipolar line, some far (outliers)
+        x2[i] = x1[i] - getRandom(100.0);
+        y2[i] = y1[i] + (((i % 5) == 0)? getRandom(60.0) - 30.0 : getRandom(2.0) - 1.0);
+    }
+}
+
+static bool checkSampsonErrors()
+{
+    vector<float> x1, y1, x2, y2;
+    uint32_t numChecks = 0;
+    for (uint32_t numPoints = 0; numPoints <= CHECK_MAX_POINTS; numPoints++) {
+        makeCorrespondences(numPoints, x1, y1, x2, y2);
+        // One more value at the end, that must not be written
+        vector<float> errors(numPoints + 1, -1.0f), expected(numPoints + 1, -1.0f);
+
+        float F[9];
+        makeFundamentalMatrix(F);
+        if (numPoints != 0) {
+            computeSampsonErrors(F, &x1[0], &y1[0], &x2[0], &y2[0], numPoints, &errors[0]);
+            computeSampsonErrorsScalar(F, &x1[0], &y1[0], &x2[0], &y2[0], numPoints, &expected[0]);
+        }
+        numChecks++;
+
+        for (uint32_t i = 0; i <= numPoints; i++) {
+            if (fabs(errors[i] - expected[i]) > CHECK_MAX_RELATIVE_ERROR * fabs(expected[i]) + CHECK_MAX_ABSOLUTE_ERROR) {
+                cerr << "computeSampsonErrors: point " << i << " of " << numPoints << ": " << errors[i]
+                     << " instead of " << expected[i] << endl;
+                return false;
+            }
+        }
+    }
+
+    // timing ---
+    makeCorrespondences(CHECK_TIMING_POINTS, x1, y1, x2, y2);
+    vector<float> errors(CHECK_TIMING_POINTS);
+    double times[2], total[2] = { 0.0, 0.0 };
+    for (uint32_t version = 0; version < 2; version++) {
+        srand(2);
+        const double start_wall_time = omp_get_wtime();
+        for (uint32_t model = 0; model < CHECK_TIMING_MODELS; model++) {
+            float F[9];
+            makeFundamentalMatrix(F);
+            if (version == 0)
+                computeSampsonErrorsScalar(F, &x1[0], &y1[0], &x2[0], &y2[0], CHECK_TIMING_POINTS, &errors[0]);
+            else
+                computeSampsonErrors(F, &x1[0], &y1[0], &x2[0], &y2[0], CHECK_TIMING_POINTS, &errors[0]);
+            total[version] += errors[model % CHECK_TIMING_POINTS];
+        }
+        times[version] = omp_get_wtime() - start_wall_time;
+    }
+
+    cout << "computeSampsonErrors: " << numChecks << " sets checked, " << CHECK_TIMING_MODELS << " models of "
+         << CHECK_TIMING_POINTS << " correspondences in " << times[1] * 1000.0 << " ms (scalar "
+         << times[0] * 1000.0 << " ms)" << endl;
+
+    return fabs(total[0] - total[1]) <= CHECK_MAX_RELATIVE_ERROR * std::max(fabs(total[0]), 1.0);
+}
+
+static void makeSequenceFrame(const cv::Mat & texture, const uint32_t & frame, cv::Mat & left, cv::Mat & right)
+{
+    const cv::Size size(CHECK_SEQUENCE_WIDTH, CHECK_SEQUENCE_HEIGHT);
+    cv::Mat shift = (cv::Mat_<double>(2, 3) << 1.0, 0.0, -CHECK_SEQUENCE_MOTION * frame, 
+                                               0.0, 1.0, -CHECK_SEQUENCE_MOTION * frame / 3.0);
+    cv::warpAffine(texture, left, shift, size);
+    shift.at<double>(0, 2) -= CHECK_SEQUENCE_DISPARITY;
+    cv::warpAffine(texture, right, shift, size);
+}
+
+static bool isSameCorrespondences(const vector< vector<cv::Point2f> > & correspondences1,
+                                  const vector< vector<cv::Point2f> > & correspondences2)
+{
+    if (correspondences1.size() != correspondences2.size())
+        return false;
+    for (uint32_t i = 0; i < correspondences1.size(); i++) {
+        if ((correspondences1[i].size() != correspondences2[i].size()) ||
+            (! std::equal(correspondences1[i].begin(), correspondences1[i].end(), correspondences2[i].begin())))
+            return false;
+    }
+    
+    return true;
+}
+
+/// findF with the pyramids kept from the last call gives the same correspondences, and so the same F, as
+/// findF building the four pyramids on each call
+static bool checkCachedPyramids()
+{
+    // Blocks of random colors, so there are corners everywhere
+    cv::RNG rng(1);
+    cv::Mat blocks(2 * CHECK_SEQUENCE_HEIGHT / CHECK_SEQUENCE_BLOCK, 2 * CHECK_SEQUENCE_WIDTH / CHECK_SEQUENCE_BLOCK, CV_8UC3);
+    rng.fill(blocks, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(256));
+    cv::Mat texture;
+    cv::resize(blocks, texture, cv::Size(2 * CHECK_SEQUENCE_WIDTH, 2 * CHECK_SEQUENCE_HEIGHT), 0, 0, cv::INTER_NEAREST);
+    cv::GaussianBlur(texture, texture, cv::Size(3, 3), 0.8);
+    
+    vector<cv::Mat> left(CHECK_SEQUENCE_FRAMES), right(CHECK_SEQUENCE_FRAMES);
+    for (uint32_t frame = 0; frame < CHECK_SEQUENCE_FRAMES; frame++)
+        makeSequenceFrame(texture, frame, left[frame], right[frame]);
+    
+    OpticalFlowPyramids pyramids;
+    uint64_t numCorrespondences = 0;
+    for (uint32_t frame = 1; frame < CHECK_SEQUENCE_FRAMES; frame++) {
+        cv::Mat FL[2], FR[2];
+        vector< vector<cv::Point2f> > correspondences[2];
+        const bool found[2] = {
+            FundamentalMatrixEstimator::findF(left[frame - 1], right[frame - 1], left[frame], right[frame], FL[0], FR[0],
+                                              correspondences[0], FundamentalMatrixEstimator::METHOD_OFLOW, 50, &pyramids),
+            FundamentalMatrixEstimator::findF(left[frame - 1], right[frame - 1], left[frame], right[frame], FL[1], FR[1],
+                                              correspondences[1], FundamentalMatrixEstimator::METHOD_OFLOW, 50, NULL)
+        };
+        
+        if ((found[0] != found[1]) || (! isSameCorrespondences(correspondences[0], correspondences[1]))) {
+            cerr << "findF: other correspondences with the kept pyramids in frame " << frame << endl;
+            return false;
+        }
+        if (correspondences[0].empty() || (correspondences[0][0].size() < CHECK_MIN_CORRESPONDENCES)) {
+            cerr << "findF: not enough correspondences in frame " << frame << endl;
+            return false;
+        }
+        if (found[0] && ((cv::norm(FL[0], FL[1], cv::NORM_INF) != 0.0) || (cv::norm(FR[0], FR[1], cv::NORM_INF) != 0.0))) {
+            cerr << "findF: another F with the kept pyramids in frame " << frame << endl;
+            return false;
+        }
+        numCorrespondences += correspondences[0][0].size();
+    }
+    
+    // From the second call on, the t0 pyramids are the t1 ones of the last call
+    const uint64_t expectedReused = 2 * (CHECK_SEQUENCE_FRAMES - 2);
+    if (pyramids.getReusedPyramids() != expectedReused) {
+        cerr << "findF: " << pyramids.getReusedPyramids() << " pyramids reused instead of " << expectedReused << endl;
+        return false;
+    }
+    
+    cout << "findF: " << numCorrespondences << " correspondences in " << CHECK_SEQUENCE_FRAMES - 1 << " pairs of frames, "
+         << pyramids.getReusedPyramids() << " pyramids reused and " << pyramids.getBuiltPyramids() << " built" << endl;
+    
+    return true;
+}
+
+static bool runCheck(const string & name, bool (*check)())
+{
+    const bool passed = check();
+    cout << name << ": " << (passed? "OK" : "FAILED") << endl;
+    return passed;
+}
+
+int main(int argc, char * argv[])
+{
+    srand(1);
+
+    bool passed = true;
+    passed &= runCheck("Sampson errors", checkSampsonErrors);
+    passed &= runCheck("Kept and built optical flow pyramids", checkCachedPyramids);
+
+    return passed? 0 : 1;
+}
@@ -0,0 +1,666 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+// Checks of GroundEstimator: the vectorized v-disparity costs against a plain scalar version, and the
+// estimator itself on a synthetic stereo pair of a flat textured ground, alone and in the asynchronous
+// mode of ExtendedFastGroundPlaneEstimator. Returns 1 when any check fails.
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sstream>
+
+#include "omp.h"
+
+#include <opencv2/opencv.hpp>
+#include <boost/program_options.hpp>
+#include <boost/thread.hpp>
+#include <google/protobuf/text_format.h>
+
+#include "image_processing/IrlsLinesDetector.hpp"
+#include "stereo_matching/ground_plane/GroundPlaneEstimator.hpp"
+#include "stereo_matching/ground_plane/FastGroundPlaneEstimator.hpp"
+#include "video_input/calibration/calibration.pb.h"
+#include "video_input/calibration/StereoCameraCalibration.hpp"
+
+#include "doppia/vdisparitycosts.h"
+#include "doppia/groundestimator.h"
+#include "doppia/extendedfastgroundplaneestimator.h"
+#include "rectification.h"
+#include "utils.h"
+
+using namespace std;
+using namespace stixel_world;
+
+// Widths of the random rows, so every tail of the vectorized loops is reached
+#define CHECK_MAX_WIDTH 700
+#define CHECK_TIMING_WIDTH 640
+#define CHECK_TIMING_ROWS 20000
+
+// Synthetic camera, with the ground CHECK_CAMERA_HEIGHT meters below it
+#define CHECK_IMAGE_WIDTH 640
+#define CHECK_IMAGE_HEIGHT 480
+#define CHECK_FOCAL 500.0
+#define CHECK_BASELINE 0.4
+#define CHECK_CAMERA_HEIGHT 1.2
+#define CHECK_CAMERA_PITCH 0.0
+
+// Tracking of the checks, the synthetic ground gives a confidence close to 1
+#define CHECK_TRACKING_MARGIN 8
+#define CHECK_TRACKING_CONFIDENCE 0.7
+// Error of the estimated ground plane
+#define CHECK_MAX_HEIGHT_ERROR 0.06
+#define CHECK_MAX_PITCH_ERROR 0.01
+// Difference between the planes of the pyramid and of the whole range
+#define CHECK_MAX_PYRAMID_HEIGHT_DIFFERENCE 0.02
+#define CHECK_MAX_PYRAMID_PITCH_DIFFERENCE 0.003
+// Prior whose bounds (GroundEstimator::setGroundPlanePrior) leave the synthetic ground out
+#define CHECK_FAR_PRIOR_HEIGHT_FACTOR 2.0
+// Asynchronous mode: a background estimation every CHECK_ASYNC_PERIOD frames, and a wait after each frame
+// long enough for it to finish, so the estimates arrive in the same frames on any machine
+#define CHECK_ASYNC_FRAMES 9
+#define CHECK_ASYNC_PERIOD 2
+#define CHECK_ASYNC_WAIT_MS 300
+// The scene does not move, so the asynchronous plane is the synchronous one
+#define CHECK_MAX_ASYNC_HEIGHT_DIFFERENCE 1e-3
+#define CHECK_MAX_ASYNC_PITCH_DIFFERENCE 1e-4
+
+static boost::program_options::variables_map g_options;
+
+/// Reference of computeSADRowCosts, one pixel and one disparity at a time
+static void computeSADRowCostsScalar(const uint8_t * const left[3], const uint8_t * const right[3],
+                                     const int32_t & width, const int32_t & firstShift,
+                                     const int32_t & numDisparities, const uint8_t & saturation, uint32_t * costs)
+{
+    for (int32_t i = 0; i < numDisparities; i++) {
+        const int32_t shift = firstShift + i;
+        costs[i] = 0;
+        for (int32_t xL = shift; xL < width; xL++) {
+            uint32_t cost = 0;
+            for (uint32_t c = 0; c < 3; c++)
+                cost += abs((int32_t)left[c][xL] - (int32_t)right[c][xL - shift]);
+            costs[i] += min(cost, (uint32_t)saturation);
+        }
+    }
+}
+
+/// Reference of computeCensusRowCosts
+static void computeCensusRowCostsScalar(const uint32_t * left, const uint32_t * right, const int32_t & width,
+                                        const int32_t & firstShift, const int32_t & numDisparities,
+                                        const uint32_t & saturation, uint32_t * costs)
+{
+    for (int32_t i = 0; i < numDisparities; i++) {
+        const int32_t shift = firstShift + i;
+        costs[i] = 0;
+        for (int32_t xL = shift; xL < width; xL++) {
+            uint32_t bits = left[xL] ^ right[xL - shift], cost = 0;
+            for (; bits != 0; bits >>= 1)
+                cost += bits & 1;
+            costs[i] += min(cost, saturation);
+        }
+    }
+}
+
+static void fillRandom(vector<uint8_t> & plane)
+{
+    for (uint32_t i = 0; i < plane.size(); i++)
+        plane[i] = rand() % 256;
+}
+
+static bool checkSADRowCosts()
+{
+    const uint8_t saturations[] = { 1, 20, 50, 254 };
+
+    vector<uint8_t> leftPlanes[3], rightPlanes[3];
+    const uint8_t * left[3], * right[3];
+    for (uint32_t c = 0; c < 3; c++) {
+        leftPlanes[c].resize(CHECK_MAX_WIDTH);
+        rightPlanes[c].resize(CHECK_MAX_WIDTH);
+        left[c] = &leftPlanes[c][0];
+        right[c] = &rightPlanes[c][0];
+    }
+
+    uint32_t numChecks = 0;
+    for (int32_t width = 1; width <= CHECK_MAX_WIDTH; width += (width < 80)? 1 : 7) {
+        for (uint32_t c = 0; c < 3; c++) {
+            fillRandom(leftPlanes[c]);
+            fillRandom(rightPlanes[c]);
+        }
+
+        for (uint32_t s = 0; s < sizeof(saturations) / sizeof(saturations[0]); s++) {
+            for (int32_t firstShift = 0; firstShift < min(width + 2, 140); firstShift += 3) {
+                for (int32_t numDisparities = 1; numDisparities <= VDISPARITY_DISPARITIES_PER_PASS; numDisparities++) {
+                    uint32_t costs[VDISPARITY_DISPARITIES_PER_PASS], expected[VDISPARITY_DISPARITIES_PER_PASS];
+                    computeSADRowCosts(left, right, width, firstShift, numDisparities, saturations[s], costs);
+                    computeSADRowCostsScalar(left, right, width, firstShift, numDisparities, saturations[s], expected);
+                    numChecks++;
+
+                    for (int32_t i = 0; i < numDisparities; i++) {
+                        if (costs[i] != expected[i]) {
+                            cerr << "computeSADRowCosts: width " << width << ", shift " << firstShift + i
+                                 << ", saturation " << (uint32_t)saturations[s] << ": " << costs[i]
+                                 << " instead of " << expected[i] << endl;
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // timing ---
+    double times[2];
+    uint64_t total[2] = { 0, 0 };
+    for (uint32_t version = 0; version < 2; version++) {
+        const double start_wall_time = omp_get_wtime();
+        for (uint32_t row = 0; row < CHECK_TIMING_ROWS; row++) {
+            uint32_t costs[VDISPARITY_DISPARITIES_PER_PASS];
+            const int32_t firstShift = (row * VDISPARITY_DISPARITIES_PER_PASS) % 128;
+            if (version == 0)
+                computeSADRowCostsScalar(left, right, CHECK_TIMING_WIDTH, firstShift,
+                                         VDISPARITY_DISPARITIES_PER_PASS, 50, costs);
+            else
+                computeSADRowCosts(left, right, CHECK_TIMING_WIDTH, firstShift, VDISPARITY_DISPARITIES_PER_PASS, 50, costs);
+            for (uint32_t i = 0; i < VDISPARITY_DISPARITIES_PER_PASS; i++)
+                total[version] += costs[i];
+        }
+        times[version] = omp_get_wtime() - start_wall_time;
+    }
+
+    cout << "computeSADRowCosts: " << numChecks << " rows checked, " << CHECK_TIMING_ROWS << " rows of "
+         << CHECK_TIMING_WIDTH << " pixels in " << times[1] * 1000.0 << " ms (scalar " << times[0] * 1000.0
+         << " ms)" << endl;
+
+    return total[0] == total[1];
+}
+
+static bool checkCensusRowCosts()
+{
+    const uint32_t saturations[] = { 1, 6, 12, 24, 32 };
+    
+    // 24 bits census values, and some with all the bits, so the 4 bytes of the popcount are reached
+    vector<uint32_t> left(CHECK_MAX_WIDTH), right(CHECK_MAX_WIDTH);
+    
+    uint32_t numChecks = 0;
+    for (int32_t width = 1; width <= CHECK_MAX_WIDTH; width += (width < 80)? 1 : 7) {
+        for (int32_t x = 0; x < CHECK_MAX_WIDTH; x++) {
+            left[x] = ((x % 13) == 0)? 0xFFFFFFFFu : (((uint32_t)rand() << 12) ^ rand()) & 0xFFFFFF;
+            right[x] = ((x % 17) == 0)? 0 : (((uint32_t)rand() << 12) ^ rand()) & 0xFFFFFF;
+        }
+        
+        for (uint32_t s = 0; s < sizeof(saturations) / sizeof(saturations[0]); s++) {
+            for (int32_t firstShift = 0; firstShift < min(width + 2, 140); firstShift += 3) {
+                for (int32_t numDisparities = 1; numDisparities <= VDISPARITY_DISPARITIES_PER_PASS; numDisparities++) {
+                    uint32_t costs[VDISPARITY_DISPARITIES_PER_PASS], expected[VDISPARITY_DISPARITIES_PER_PASS];
+                    computeCensusRowCosts(&left[0], &right[0], width, firstShift, numDisparities, saturations[s], costs);
+                    computeCensusRowCostsScalar(&left[0], &right[0], width, firstShift, numDisparities, 
+                                                saturations[s], expected);
+                    numChecks++;
+                    
+                    for (int32_t i = 0; i < numDisparities; i++) {
+                        if (costs[i] != expected[i]) {
+                            cerr << "computeCensusRowCosts: width " << width << ", shift " << firstShift + i
+                                 << ", saturation " << saturations[s] << ": " << costs[i]
+                                 << " instead of " << expected[i] << endl;
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    
+    // timing ---
+    double times[2];
+    uint64_t total[2] = { 0, 0 };
+    for (uint32_t version = 0; version < 2; version++) {
+        const double start_wall_time = omp_get_wtime();
+        for (uint32_t row = 0; row < CHECK_TIMING_ROWS; row++) {
+            uint32_t costs[VDISPARITY_DISPARITIES_PER_PASS];
+            const int32_t firstShift = (row * VDISPARITY_DISPARITIES_PER_PASS) % 128;
+            if (version == 0)
+                computeCensusRowCostsScalar(&left[0], &right[0], CHECK_TIMING_WIDTH, firstShift,
+                                            VDISPARITY_DISPARITIES_PER_PASS, 12, costs);
+            else
+                computeCensusRowCosts(&left[0], &right[0], CHECK_TIMING_WIDTH, firstShift,
+                                      VDISPARITY_DISPARITIES_PER_PASS, 12, costs);
+            for (uint32_t i = 0; i < VDISPARITY_DISPARITIES_PER_PASS; i++)
+                total[version] += costs[i];
+        }
+        times[version] = omp_get_wtime() - start_wall_time;
+    }
+    
+    cout << "computeCensusRowCosts: " << numChecks << " rows checked, " << CHECK_TIMING_ROWS << " rows of "
+         << CHECK_TIMING_WIDTH << " pixels in " << times[1] * 1000.0 << " ms (scalar " << times[0] * 1000.0
+         << " ms)" << endl;
+    
+    return total[0] == total[1];
+}
+
+/// Rectified pair of a textured flat ground (the lower half) under a random background. For the ground row v,
+/// the disparity is baseline * (v - v_horizon) / height, so right(x, v) = left(x + d, v)
+static void makeGroundPair(cv::Mat & left, cv::Mat & right, const uint32_t & seed)
+{
+    cv::RNG rng(seed);
+    cv::Mat texture(CHECK_IMAGE_HEIGHT, CHECK_IMAGE_WIDTH * 2, CV_8UC3);
+    rng.fill(texture, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(256));
+    cv::GaussianBlur(texture, texture, cv::Size(3, 3), 0.8);
+    
+    left.create(CHECK_IMAGE_HEIGHT, CHECK_IMAGE_WIDTH, CV_8UC3);
+    right.create(CHECK_IMAGE_HEIGHT, CHECK_IMAGE_WIDTH, CV_8UC3);
+    texture.colRange(0, CHECK_IMAGE_WIDTH).copyTo(left);
+    
+    const double horizon = CHECK_IMAGE_HEIGHT / 2.0 - CHECK_FOCAL * tan(CHECK_CAMERA_PITCH);
+    for (int32_t v = 0; v < CHECK_IMAGE_HEIGHT; v++) {
+        if (v <= horizon) {
+            // The background is not seen by the right camera, it does not match at any disparity
+            texture.row(v).colRange(CHECK_IMAGE_WIDTH, 2 * CHECK_IMAGE_WIDTH).copyTo(right.row(v));
+            continue;
+        }
+        
+        const double disparity = CHECK_BASELINE * (v - horizon) / CHECK_CAMERA_HEIGHT;
+        for (int32_t x = 0; x < CHECK_IMAGE_WIDTH; x++) {
+            const double xL = x + disparity;
+            const int32_t x0 = std::min((int32_t)floor(xL), CHECK_IMAGE_WIDTH - 1);
+            const int32_t x1 = std::min(x0 + 1, CHECK_IMAGE_WIDTH - 1);
+            const double alpha = xL - floor(xL);
+            for (uint32_t c = 0; c < 3; c++) {
+                right.at<cv::Vec3b>(v, x)[c] = cv::saturate_cast<uint8_t>((1.0 - alpha) * left.at<cv::Vec3b>(v, x0)[c] +
+                                                                          alpha * left.at<cv::Vec3b>(v, x1)[c]);
+            }
+        }
+    }
+}
+
+static Rectification makeRectification()
+{
+    Rectification rectification;
+    for (uint32_t cameraId = 0; cameraId < 2; cameraId++) {
+        cv::Mat K = cv::Mat::eye(3, 3, CV_64FC1);
+        K.at<double>(0, 0) = CHECK_FOCAL;
+        K.at<double>(1, 1) = CHECK_FOCAL;
+        K.at<double>(0, 2) = CHECK_IMAGE_WIDTH / 2.0;
+        K.at<double>(1, 2) = CHECK_IMAGE_HEIGHT / 2.0;
+        rectification.setIntrinsicCoeffs(K, cameraId);
+        rectification.setDistCoeffs(cv::Mat::zeros(1, 4, CV_64FC1), cameraId);
+    }
+    rectification.setRotationMatrix(cv::Mat::eye(3, 3, CV_64FC1));
+    cv::Mat t = cv::Mat::zeros(3, 1, CV_64FC1);
+    t.at<double>(0) = CHECK_BASELINE;
+    rectification.setTranslationMatrix(t);
+    
+    return rectification;
+}
+
+/// Prior a bit off the synthetic ground, so the estimate has to move
+static doppia::GroundPlane makeGroundPlanePrior()
+{
+    doppia::GroundPlane prior;
+    prior.set_from_metric_units(-CHECK_CAMERA_PITCH - 0.02, 0.0, CHECK_CAMERA_HEIGHT * 1.1);
+    
+    return prior;
+}
+
+/// Disparity of the v-disparity line of the plane in the image row v
+static double getGroundLineDisparity(const doppia::GroundPlane & groundPlane, const double & v)
+{
+    const double theta = -groundPlane.get_pitch();
+    const double origin = CHECK_IMAGE_HEIGHT / 2.0 - CHECK_FOCAL * tan(theta);
+    
+    return (v - origin) * CHECK_BASELINE * cos(theta) / groundPlane.get_height();
+}
+
+static bool isGroundPlaneClose(const doppia::GroundPlane & groundPlane, const string & name)
+{
+    const double heightError = fabs(groundPlane.get_height() - CHECK_CAMERA_HEIGHT);
+    const double pitchError = fabs(groundPlane.get_pitch() + CHECK_CAMERA_PITCH);
+    if ((heightError > CHECK_MAX_HEIGHT_ERROR) || (pitchError > CHECK_MAX_PITCH_ERROR)) {
+        cerr << name << ": height " << groundPlane.get_height() << ", pitch " << groundPlane.get_pitch() 
+             << " instead of " << CHECK_CAMERA_HEIGHT << ", " << -CHECK_CAMERA_PITCH << endl;
+        return false;
+    }
+    
+    return true;
+}
+
+/// The selected points and their weights do not depend on the number of threads
+static bool checkDeterminism()
+{
+    cv::Mat left, right;
+    makeGroundPair(left, right, 1);
+    
+    const uint8_t costModes[] = { GroundEstimator::COST_SAD, GroundEstimator::COST_CENSUS };
+    const int32_t maxThreads = omp_get_max_threads();
+    
+    for (uint32_t m = 0; m < sizeof(costModes) / sizeof(costModes[0]); m++) {
+        GroundEstimator::points_t points[2];
+        Eigen::VectorXf weights[2];
+        
+        for (uint32_t run = 0; run < 2; run++) {
+            omp_set_num_threads((run == 0)? 1 : std::max(4, maxThreads));
+            
+            GroundEstimator estimator(g_options, makeRectification());
+            estimator.setCostMode(costModes[m]);
+            estimator.setGroundPlanePrior(makeGroundPlanePrior());
+            estimator.setImagePair(left, right);
+            estimator.compute();
+            
+            points[run] = estimator.getSelectedPoints();
+            weights[run] = estimator.getPointWeights();
+        }
+        omp_set_num_threads(maxThreads);
+        
+        if (points[0].empty()) {
+            cerr << "determinism: no points selected (cost mode " << (uint32_t)costModes[m] << ")" << endl;
+            return false;
+        }
+        if ((points[0] != points[1]) || (weights[0].size() != weights[1].size()) || (weights[0] != weights[1])) {
+            cerr << "determinism: " << points[0].size() << " points with 1 thread, " << points[1].size() 
+                 << " with " << std::max(4, maxThreads) << " (cost mode " << (uint32_t)costModes[m] << ")" << endl;
+            return false;
+        }
+        
+        cout << "determinism: " << points[0].size() << " identical points (cost mode " 
+             << (uint32_t)costModes[m] << ")" << endl;
+    }
+    
+    return true;
+}
+
+/// Once the line is found, only the disparities around it are searched. A pair that does not match lowers
+/// the confidence, and the next frame searches the whole range again
+static bool checkTracking()
+{
+    cv::Mat left, right, otherLeft, otherRight;
+    makeGroundPair(left, right, 2);
+    makeGroundPair(otherLeft, otherRight, 3);
+    
+    GroundEstimator estimator(g_options, makeRectification());
+    estimator.setTrackingMode(true, CHECK_TRACKING_MARGIN, CHECK_TRACKING_CONFIDENCE);
+    estimator.setGroundPlanePrior(makeGroundPlanePrior());
+    
+    // first frame, whole range --
+    estimator.setImagePair(left, right);
+    if ((! estimator.compute()) || estimator.isSearchingAroundGroundLine()) {
+        cerr << "tracking: the first frame is not a full search with a ground line" << endl;
+        return false;
+    }
+    if ((! isGroundPlaneClose(estimator.getGroundPlane(), "tracking, first frame")) ||
+        (estimator.getGroundLineConfidence() < CHECK_TRACKING_CONFIDENCE))
+        return false;
+    const doppia::GroundPlane trackedPlane = estimator.getGroundPlane();
+    
+    // second frame, around the line --
+    estimator.setImagePair(left, right);
+    if ((! estimator.compute()) || (! estimator.isSearchingAroundGroundLine())) {
+        cerr << "tracking: the second frame does not search around the ground line" << endl;
+        return false;
+    }
+    const GroundEstimator::points_t points = estimator.getSelectedPoints();
+    for (uint32_t i = 0; i < points.size(); i++) {
+        const double disparity = getGroundLineDisparity(trackedPlane, points[i].second + CHECK_IMAGE_HEIGHT / 2);
+        if (fabs(points[i].first - disparity) > CHECK_TRACKING_MARGIN + 1) {
+            cerr << "tracking: point at disparity " << points[i].first << " of row " << points[i].second 
+                 << ", the line is at " << disparity << endl;
+            return false;
+        }
+    }
+    if (! isGroundPlaneClose(estimator.getGroundPlane(), "tracking, second frame"))
+        return false;
+    
+    // a pair that does not match, still searched around the line --
+    estimator.setImagePair(left, otherRight);
+    estimator.compute();
+    if ((! estimator.isSearchingAroundGroundLine()) || 
+        (estimator.getGroundLineConfidence() >= CHECK_TRACKING_CONFIDENCE)) {
+        cerr << "tracking: confidence " << estimator.getGroundLineConfidence() 
+             << " on a pair that does not match" << endl;
+        return false;
+    }
+    
+    // the whole range again --
+    estimator.setImagePair(otherLeft, otherRight);
+    if ((! estimator.compute()) || estimator.isSearchingAroundGroundLine()) {
+        cerr << "tracking: no full search after a frame with low confidence" << endl;
+        return false;
+    }
+    if (! isGroundPlaneClose(estimator.getGroundPlane(), "tracking, after the full search"))
+        return false;
+    
+    cout << "tracking: " << points.size() << " points around the line, " << estimator.getEstimations() 
+         << " frames in " << estimator.getCumulatedTime() * 1000.0 << " ms" << endl;
+    
+    return true;
+}
+
+/// The line refined around the half resolution one gives the same plane as the search over all the disparities
+static bool checkPyramid()
+{
+    const uint8_t costModes[] = { GroundEstimator::COST_SAD, GroundEstimator::COST_CENSUS };
+    
+    cv::Mat left, right;
+    makeGroundPair(left, right, 4);
+    
+    for (uint32_t m = 0; m < sizeof(costModes) / sizeof(costModes[0]); m++) {
+        GroundEstimator fullRange(g_options, makeRectification()), pyramid(g_options, makeRectification());
+        pyramid.setPyramidMode(true);
+        
+        GroundEstimator * estimators[2] = { &fullRange, &pyramid };
+        for (uint32_t e = 0; e < 2; e++) {
+            estimators[e]->setCostMode(costModes[m]);
+            estimators[e]->setGroundPlanePrior(makeGroundPlanePrior());
+            estimators[e]->setImagePair(left, right);
+            if (! estimators[e]->compute()) {
+                cerr << "pyramid: no ground line found (cost mode " << (uint32_t)costModes[m] << ")" << endl;
+                return false;
+            }
+        }
+        
+        if ((! pyramid.isCoarseLineUsed()) || fullRange.isCoarseLineUsed()) {
+            cerr << "pyramid: the full resolution search is not refined around the coarse line" << endl;
+            return false;
+        }
+        
+        const doppia::GroundPlane & fullPlane = fullRange.getGroundPlane();
+        const doppia::GroundPlane & pyramidPlane = pyramid.getGroundPlane();
+        if ((fabs(fullPlane.get_height() - pyramidPlane.get_height()) > CHECK_MAX_PYRAMID_HEIGHT_DIFFERENCE) ||
+            (fabs(fullPlane.get_pitch() - pyramidPlane.get_pitch()) > CHECK_MAX_PYRAMID_PITCH_DIFFERENCE)) {
+            cerr << "pyramid: height " << pyramidPlane.get_height() << ", pitch " << pyramidPlane.get_pitch()
+                 << " instead of " << fullPlane.get_height() << ", " << fullPlane.get_pitch() 
+                 << " (cost mode " << (uint32_t)costModes[m] << ")" << endl;
+            return false;
+        }
+        if (! isGroundPlaneClose(pyramidPlane, "pyramid"))
+            return false;
+        
+        cout << "pyramid: " << pyramid.getSelectedPoints().size() << " points (" 
+             << fullRange.getSelectedPoints().size() << " over the whole range) in " 
+             << pyramid.getCumulatedTime() * 1000.0 << " ms (" << fullRange.getCumulatedTime() * 1000.0 
+             << " ms), cost mode " << (uint32_t)costModes[m] << endl;
+    }
+    
+    return true;
+}
+
+/// A ground line out of the bounds of the prior is not taken, and the plane stays the prior
+static bool checkPriorBounds()
+{
+    cv::Mat left, right;
+    makeGroundPair(left, right, 6);
+    
+    GroundEstimator estimator(g_options, makeRectification());
+    doppia::GroundPlane farPrior;
+    farPrior.set_from_metric_units(-CHECK_CAMERA_PITCH, 0.0, CHECK_CAMERA_HEIGHT * CHECK_FAR_PRIOR_HEIGHT_FACTOR);
+    estimator.setGroundPlanePrior(farPrior);
+    estimator.setImagePair(left, right);
+    if (estimator.compute()) {
+        cerr << "prior bounds: ground line taken with a prior of height " << farPrior.get_height() 
+             << ", height " << estimator.getGroundPlane().get_height() << endl;
+        return false;
+    }
+    if ((estimator.getGroundPlane().get_height() != farPrior.get_height()) ||
+        (estimator.getGroundPlane().get_pitch() != farPrior.get_pitch())) {
+        cerr << "prior bounds: the plane is not the prior after the line was rejected" << endl;
+        return false;
+    }
+    
+    // the same pair, with a prior close to the ground --
+    estimator.setGroundPlanePrior(makeGroundPlanePrior());
+    estimator.setImagePair(left, right);
+    if (! estimator.compute()) {
+        cerr << "prior bounds: no ground line found with a close prior" << endl;
+        return false;
+    }
+    
+    return isGroundPlaneClose(estimator.getGroundPlane(), "prior bounds");
+}
+
+static string getCameraCalibration(const string & name, const double & x)
+{
+    stringstream ss;
+    ss << name << " {" << endl
+       << "    name: \"" << name << "\"" << endl
+       << "    internal_calibration { k11: " << CHECK_FOCAL << " k12: 0 k13: " << CHECK_IMAGE_WIDTH / 2.0
+       << " k22: " << CHECK_FOCAL << " k23: " << CHECK_IMAGE_HEIGHT / 2.0 << " k33: 1 }" << endl
+       << "    pose {" << endl
+       << "        rotation { r11: 1 r12: 0 r13: 0 r21: 0 r22: 1 r23: 0 r31: 0 r32: 0 r33: 1 }" << endl
+       << "        translation { x: " << x << " y: 0 z: 0 }" << endl
+       << "    }" << endl
+       << "    radial_distortion { k1: 0 k2: 0 k3: 0 }" << endl
+       << "    tangential_distortion { p1: 0 p2: 0 }" << endl
+       << "}" << endl;
+    return ss.str();
+}
+
+/// The synthetic camera as a doppia calibration, as makeRectification
+static doppia::StereoCameraCalibration makeStereoCalibration()
+{
+    const string text = "name: \"ground_estimator_check\"\n" + getCameraCalibration("left_camera", 0.0) +
+                        getCameraCalibration("right_camera", CHECK_BASELINE);
+    
+    doppia_protobuf::StereoCameraCalibration calibrationData;
+    if (! google::protobuf::TextFormat::ParseFromString(text, &calibrationData))
+        throw std::runtime_error("Could not parse the calibration of the synthetic camera");
+    
+    return doppia::StereoCameraCalibration(calibrationData);
+}
+
+static void setOption(boost::program_options::variables_map & options, const string & name, const boost::any & value)
+{
+    options.erase(name);
+    options.insert(std::make_pair(name, boost::program_options::variable_value(value, false)));
+}
+
+/// The asynchronous mode gives the plane of the synchronous mode on a still scene, and every frame has
+/// either a new estimate or a predicted plane, counted once
+static bool checkAsynchronous()
+{
+    cv::Mat left, right;
+    makeGroundPair(left, right, 5);
+    doppia::AbstractVideoInput::input_image_t leftImage(CHECK_IMAGE_WIDTH, CHECK_IMAGE_HEIGHT),
+                                              rightImage(CHECK_IMAGE_WIDTH, CHECK_IMAGE_HEIGHT);
+    boost::gil::rgb8_view_t leftView = boost::gil::view(leftImage), rightView = boost::gil::view(rightImage);
+    opencv2gil(left, leftView);
+    opencv2gil(right, rightView);
+    
+    const doppia::StereoCameraCalibration calibration = makeStereoCalibration();
+    boost::program_options::variables_map options = g_options;
+    setOption(options, "ground_plane_estimator.use_ground_estimator", true);
+    setOption(options, "ground_plane_estimator.period", (int)CHECK_ASYNC_PERIOD);
+    setOption(options, "ground_plane_estimator.asynchronous", false);
+    ExtendedFastGroundPlaneEstimator synchronous(options, calibration);
+    setOption(options, "ground_plane_estimator.asynchronous", true);
+    ExtendedFastGroundPlaneEstimator asynchronous(options, calibration);
+    
+    for (uint32_t frame = 1; frame <= CHECK_ASYNC_FRAMES; frame++) {
+        ExtendedFastGroundPlaneEstimator * estimators[2] = { &synchronous, &asynchronous };
+        for (uint32_t e = 0; e < 2; e++) {
+            doppia::AbstractVideoInput::input_image_view_t left_view(leftView), right_view(rightView);
+            estimators[e]->set_rectified_images_pair(left_view, right_view);
+            estimators[e]->compute();
+        }
+        
+        const doppia::GroundPlane & synchronousPlane = synchronous.get_ground_plane();
+        const doppia::GroundPlane & asynchronousPlane = asynchronous.get_ground_plane();
+        if ((fabs(synchronousPlane.get_height() - asynchronousPlane.get_height()) > CHECK_MAX_ASYNC_HEIGHT_DIFFERENCE) ||
+            (fabs(synchronousPlane.get_pitch() - asynchronousPlane.get_pitch()) > CHECK_MAX_ASYNC_PITCH_DIFFERENCE)) {
+            cerr << "asynchronous: height " << asynchronousPlane.get_height() << ", pitch " 
+                 << asynchronousPlane.get_pitch() << " instead of " << synchronousPlane.get_height() << ", " 
+                 << synchronousPlane.get_pitch() << " in frame " << frame << endl;
+            return false;
+        }
+        if (asynchronous.getEstimations() + asynchronous.getPredictedFrames() != frame) {
+            cerr << "asynchronous: " << asynchronous.getEstimations() << " estimates and " 
+                 << asynchronous.getPredictedFrames() << " predicted frames after " << frame << " frames" << endl;
+            return false;
+        }
+        
+        boost::this_thread::sleep(boost::posix_time::milliseconds(CHECK_ASYNC_WAIT_MS));
+    }
+    
+    // The first frame waits for its estimate. Then an estimation is started every CHECK_ASYNC_PERIOD frames,
+    // and it arrives in the next frame
+    if ((synchronous.getEstimations() != CHECK_ASYNC_FRAMES) || 
+        (asynchronous.getEstimations() != 1 + (CHECK_ASYNC_FRAMES - 2) / CHECK_ASYNC_PERIOD)) {
+        cerr << "asynchronous: " << asynchronous.getEstimations() << " background estimates and " 
+             << synchronous.getEstimations() << " synchronous ones in " << CHECK_ASYNC_FRAMES << " frames" << endl;
+        return false;
+    }
+    
+    cout << "asynchronous: " << asynchronous.getEstimations() << " estimates and " 
+         << asynchronous.getPredictedFrames() << " predicted frames" << endl;
+    
+    return true;
+}
+
+static bool runCheck(const string & name, bool (*check)())
+{
+    const bool passed = check();
+    cout << name << ": " << (passed? "OK" : "FAILED") << endl;
+    return passed;
+}
+
+int main(int argc, char * argv[])
+{
+    srand(1);
+    
+    // Default options of the line fit and of the ground plane estimators, they can be changed from the command line
+    boost::program_options::options_description desc("ground_estimator_check options");
+    desc.add_options()
+    ("max_disparity", boost::program_options::value<int>()->default_value(128), "disparities of the v-disparity")
+    ;
+    desc.add(doppia::BaseGroundPlaneEstimator::get_args_options());
+    desc.add(doppia::GroundPlaneEstimator::get_args_options());
+    desc.add(doppia::FastGroundPlaneEstimator::get_args_options());
+    desc.add(ExtendedFastGroundPlaneEstimator::get_args_options());
+    desc.add(doppia::IrlsLinesDetector::get_args_options());
+    boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), g_options);
+    boost::program_options::notify(g_options);
+
+    bool passed = true;
+    passed &= runCheck("SAD row costs", checkSADRowCosts);
+    passed &= runCheck("Census row costs", checkCensusRowCosts);
+    passed &= runCheck("Serial and parallel v-disparity", checkDeterminism);
+    passed &= runCheck("Ground line tracking", checkTracking);
+    passed &= runCheck("Pyramid and whole range", checkPyramid);
+    passed &= runCheck("Prior bounds", checkPriorBounds);
+    passed &= runCheck("Asynchronous and synchronous ground plane", checkAsynchronous);
+
+    return passed? 0 : 1;
+}
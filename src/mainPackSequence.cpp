@@ -0,0 +1,112 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+// Converts a mask based stereo sequence (video_input.left_filename_mask / right_filename_mask)
+// into a packed stereo sequence, usable with video_input.source = packed.
+// The frames are stored after the preprocessing configured in the [preprocess] section. When it
+// rectifies them, the pack is marked as rectified, so they are not rectified again when read.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "utils.h"
+#include "doppia/extendedvideoinputfactory.h"
+#include "doppia/packedstereosequence.h"
+
+#include "helpers/get_option_value.hpp"
+
+using namespace std;
+
+static void copyView(const doppia::AbstractVideoInput::input_image_view_t & view, vector<uint8_t> & buffer)
+{
+    const uint32_t rowSize = view.width() * sizeof(boost::gil::rgb8_pixel_t);
+    buffer.resize(rowSize * view.height());
+    for (uint32_t y = 0; y < view.height(); y++) {
+        memcpy(&buffer[y * rowSize], &view.row_begin(y)[0], rowSize);
+    }
+}
+
+int main(int argC, char * argV[]) {
+    boost::program_options::options_description desc("pack_stereo_sequence options");
+    desc.add_options()
+    ("help,h", "produce this help message")
+    ("configuration_file,c", boost::program_options::value<string>(), "stixel_world configuration file (.ini)")
+    ("output,o", boost::program_options::value<string>(), "output packed sequence")
+    ("lz4", boost::program_options::value<bool>()->default_value(false), "store the frames compressed with LZ4")
+    ;
+
+    boost::program_options::variables_map args;
+    boost::program_options::store(boost::program_options::parse_command_line(argC, argV, desc), args);
+    boost::program_options::notify(args);
+
+    if ((args.count("help") > 0) || (args.count("configuration_file") == 0) || (args.count("output") == 0)) {
+        cout << desc << endl;
+        return 1;
+    }
+
+    const string configurationFile = args["configuration_file"].as<string>();
+    if (! boost::filesystem::exists(configurationFile)) {
+        cout << "\033[1;31mCould not find the configuration file:\033[0m " << configurationFile << endl;
+        return 1;
+    }
+
+    boost::program_options::variables_map options;
+    const boost::program_options::options_description inputDesc = doppia::ExtendedVideoInputFactory::get_args_options();
+    ifstream configuration(configurationFile.c_str());
+    boost::program_options::store(boost::program_options::parse_config_file(configuration, inputDesc, true), options);
+    boost::program_options::notify(options);
+
+    // directory_skip would jump frames, the packed sequence keeps all of them
+    stixel_world::modify_variable_map(options, "video_input.source", string("directory"));
+
+    boost::scoped_ptr<doppia::AbstractVideoInput> videoInput(doppia::ExtendedVideoInputFactory::new_instance(options));
+
+    ifstream calibrationFile(doppia::get_option_value<string>(options, "video_input.calibration_filename").c_str());
+    stringstream calibration;
+    calibration << calibrationFile.rdbuf();
+
+    const doppia::AbstractVideoInput::dimensions_t dimensions = videoInput->get_left_image().dimensions();
+    const uint8_t compression = args["lz4"].as<bool>()? doppia::PackedStereoSequence::COMPRESSION_LZ4 :
+                                                        doppia::PackedStereoSequence::COMPRESSION_RAW;
+
+    doppia::PackedStereoSequenceWriter writer(args["output"].as<string>(), dimensions.x, dimensions.y,
+                                              videoInput->get_current_frame_number(), compression);
+    writer.setCalibration(calibration.str());
+    writer.setRectified(doppia::get_option_value<bool>(options, "preprocess.rectify"));
+
+    vector<uint8_t> left, right;
+    do {
+        copyView(videoInput->get_left_image(), left);
+        copyView(videoInput->get_right_image(), right);
+        writer.addFrame(&left[0], &right[0]);
+
+        if (writer.getNumberOfFrames() % 50 == 0)
+            cout << "Packed " << writer.getNumberOfFrames() << " frames" << endl;
+    } while (videoInput->next_frame());
+
+    writer.close();
+
+    cout << "Packed " << writer.getNumberOfFrames() << " frames into " << args["output"].as<string>() << endl;
+
+    return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+// Check of StixelsRecording: the whole pipeline is run on a sequence while the tracker input is
+// recorded, and then only the tracker is run on the recording. Replaying has to process the same
+// frames and give the same digest as the run that recorded it. Returns 1 otherwise.
+
+#include <iostream>
+
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+
+#include "stixelsbenchmark.h"
+
+using namespace std;
+using namespace stixel_world;
+
+int main(int argC, char * argV[]) {
+    boost::program_options::options_description desc("stixels_recording_check options");
+    desc.add_options()
+    ("help,h", "produce this help message")
+    ("configuration_file,c", boost::program_options::value<string>(), "stixel_world configuration file (.ini), as written by synthetic_stereo_sequence")
+    ;
+    desc.add(StixelsBenchmark::get_args_options());
+
+    boost::program_options::variables_map args;
+    boost::program_options::store(boost::program_options::parse_command_line(argC, argV, desc), args);
+    boost::program_options::notify(args);
+
+    if ((args.count("help") > 0) || (args.count("configuration_file") == 0)) {
+        cout << desc << endl;
+        return 1;
+    }
+
+    const string configurationFile = args["configuration_file"].as<string>();
+    const boost::filesystem::path recordFile =
+        boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("stixels_recording_check_%%%%%%%%.rec");
+
+    StixelsBenchmark::t_benchmark_params params = StixelsBenchmark::get_params(args);
+    params.captureDir = "";
+    params.replayFile = "";
+    params.recordFile = recordFile.string();
+
+    uint64_t recordedFrames, recordedDigest;
+    {
+        // The recording is closed when the benchmark is destroyed
+        StixelsBenchmark recording(configurationFile, params);
+        recording.run();
+        recordedFrames = recording.getProcessedFrames();
+        recordedDigest = recording.getDigest();
+    }
+
+    params.recordFile = "";
+    params.replayFile = recordFile.string();
+
+    StixelsBenchmark replay(configurationFile, params);
+    replay.run();
+
+    boost::filesystem::remove(recordFile);
+
+    cout << "Recorded: " << recordedFrames << " frames, digest " << hex << recordedDigest << dec << endl;
+    cout << "Replayed: " << replay.getProcessedFrames() << " frames, digest " << hex << replay.getDigest() << dec << endl;
+
+    const bool passed = (recordedFrames > 0) && (replay.getProcessedFrames() == recordedFrames) &&
+                        (replay.getDigest() == recordedDigest);
+
+    cout << "Record and replay: " << (passed? "OK" : "FAILED") << endl;
+
+    return passed? 0 : 1;
+}
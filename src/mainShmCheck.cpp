@@ -0,0 +1,190 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+// Check of the stixels shared memory ring: a writer that never waits fills a small ring as fast as it can,
+// while forked readers read the frames in place and by copy. Every field of a frame is derived from its
+// seq, so a frame that mixes two writes is seen. Returns 1 when a reader accepted a torn frame or saw
+// the seq go back.
+
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "stixelsshm.h"
+
+using namespace std;
+using namespace stixel_world;
+
+// Few slots, so the readers are often overtaken by the writer
+#define CHECK_SLOTS 3
+#define CHECK_FRAMES 200000
+#define CHECK_READERS 4
+#define CHECK_TIMEOUT_MS 10000
+// Every other in place read goes over the frame this many times, like a slow consumer, so the writer
+// overwrites it in the meantime
+#define CHECK_SLOW_READ_PASSES 200
+
+// Reader exit status
+#define READER_OK 0
+#define READER_TORN_FRAME 1
+#define READER_SEQUENCE_BACK 2
+#define READER_TIMEOUT 3
+#define READER_ERROR 4
+
+static void fillFrame(StixelsShm::t_frame * frame, const uint64_t & sequence)
+{
+    frame->frame = sequence;
+    frame->stamp = sequence;
+    frame->numStixels = 1 + (sequence * 37) % StixelsShm::MAX_STIXELS;
+    frame->numObstacles = sequence % StixelsShm::MAX_OBSTACLES;
+    for (uint32_t i = 0; i < frame->numStixels; i++) {
+        StixelsShm::t_stixel & stixel = frame->stixels[i];
+        stixel.x = (sequence + i) & 0xFFFF;
+        stixel.width = sequence & 0xFFFF;
+        stixel.top_y = i & 0xFFFF;
+        stixel.bottom_y = (i + sequence) & 0xFFFF;
+        stixel.disparity = sequence % 1000;
+        stixel.motion = i;
+        stixel.track_id = (int32_t)(sequence ^ i);
+        stixel.velocity_x = stixel.velocity_z = sequence % 1000;
+    }
+    for (uint32_t i = 0; i < frame->numObstacles; i++)
+        frame->obstacles[i].track_id = (uint32_t)(sequence + i);
+}
+
+/// True if every field of the frame is the one written for its seq
+static bool isFrameWhole(const StixelsShm::t_frame & frame, const uint64_t & sequence)
+{
+    if ((frame.frame != sequence) || (frame.stamp != sequence) ||
+        (frame.numStixels != 1 + (sequence * 37) % StixelsShm::MAX_STIXELS) ||
+        (frame.numObstacles != sequence % StixelsShm::MAX_OBSTACLES))
+        return false;
+
+    for (uint32_t i = 0; i < frame.numStixels; i++) {
+        const StixelsShm::t_stixel & stixel = frame.stixels[i];
+        if ((stixel.x != ((sequence + i) & 0xFFFF)) || (stixel.width != (sequence & 0xFFFF)) ||
+            (stixel.top_y != (i & 0xFFFF)) || (stixel.bottom_y != ((i + sequence) & 0xFFFF)) ||
+            (stixel.disparity != sequence % 1000) || (stixel.motion != (int32_t)i) ||
+            (stixel.track_id != (int32_t)(sequence ^ i)) || (stixel.velocity_x != sequence % 1000) ||
+            (stixel.velocity_z != sequence % 1000))
+            return false;
+    }
+    for (uint32_t i = 0; i < frame.numObstacles; i++) {
+        if (frame.obstacles[i].track_id != (uint32_t)(sequence + i))
+            return false;
+    }
+
+    return true;
+}
+
+/// Reads until the last frame, alternating in place and copied reads
+static int runReader(const string & name)
+{
+    try {
+        StixelsShmReader reader(name);
+        StixelsShm::t_frame * copy = new StixelsShm::t_frame;
+
+        uint64_t lastSequence = 0, readFrames = 0, overwrittenFrames = 0;
+        while (lastSequence < CHECK_FRAMES) {
+            if (! reader.waitForFrame(lastSequence, CHECK_TIMEOUT_MS))
+                return READER_TIMEOUT;
+
+            uint64_t sequence;
+            bool whole;
+            if ((readFrames % 2) == 0) {
+                const StixelsShm::t_frame * frame = reader.acquireLatest(sequence);
+                const uint32_t passes = ((readFrames % 64) == 0)? CHECK_SLOW_READ_PASSES : 1;
+                whole = true;
+                for (uint32_t pass = 0; pass < passes; pass++) {
+                    // The frame is read again on each pass
+                    __sync_synchronize();
+                    whole &= isFrameWhole(*frame, sequence);
+                }
+                if (! reader.isValid(frame, sequence)) {
+                    // Overwritten while it was read, what was read is not used
+                    overwrittenFrames++;
+                    continue;
+                }
+            } else {
+                sequence = reader.readLatest(*copy);
+                whole = (copy->sequence == 2 * sequence) && isFrameWhole(*copy, sequence);
+            }
+
+            if (! whole) {
+                cerr << "reader " << getpid() << ": torn frame " << sequence << endl;
+                return READER_TORN_FRAME;
+            }
+            if (sequence <= lastSequence) {
+                cerr << "reader " << getpid() << ": frame " << sequence << " after " << lastSequence << endl;
+                return READER_SEQUENCE_BACK;
+            }
+            lastSequence = sequence;
+            readFrames++;
+        }
+
+        cout << "reader " << getpid() << ": " << readFrames << " frames read, " << overwrittenFrames
+             << " overwritten while read" << endl;
+        delete copy;
+    } catch (std::exception & e) {
+        cerr << "reader " << getpid() << ": " << e.what() << endl;
+        return READER_ERROR;
+    }
+
+    return READER_OK;
+}
+
+int main(int argc, char * argv[])
+{
+    stringstream name;
+    name << "/stixels_shm_check_" << getpid();
+
+    StixelsShmWriter writer(name.str(), CHECK_SLOTS);
+
+    pid_t readers[CHECK_READERS];
+    for (uint32_t r = 0; r < CHECK_READERS; r++) {
+        readers[r] = fork();
+        if (readers[r] == 0) {
+            // The ring is owned by the writer, the reader does not run its destructor
+            cout.flush();
+            _exit(runReader(name.str()));
+        }
+        if (readers[r] < 0) {
+            cerr << "Could not fork the readers" << endl;
+            return 1;
+        }
+    }
+
+    for (uint64_t sequence = 1; sequence <= CHECK_FRAMES; sequence++) {
+        fillFrame(writer.beginFrame(), sequence);
+        writer.commitFrame();
+    }
+
+    bool passed = true;
+    for (uint32_t r = 0; r < CHECK_READERS; r++) {
+        int status;
+        waitpid(readers[r], &status, 0);
+        if ((! WIFEXITED(status)) || (WEXITSTATUS(status) != READER_OK)) {
+            cerr << "reader " << readers[r] << " failed with status " << WEXITSTATUS(status) << endl;
+            passed = false;
+        }
+    }
+
+    cout << "Shared memory ring: " << (passed? "OK" : "FAILED") << endl;
+
+    return passed? 0 : 1;
+}
@@ -0,0 +1,107 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+// Local consumer of the stixels shared memory ring written by stixels_world_node (shmName).
+// Reads the frames in place, checks that they are consistent, and reports the frames it could
+// not read and the delay from the frame stamp to the moment it was read.
+
+#include <iostream>
+#include <sys/time.h>
+
+#include <boost/program_options.hpp>
+
+#include "stixelsshm.h"
+
+using namespace std;
+using namespace stixel_world;
+
+static double getWallTime()
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec + now.tv_usec * 1e-6;
+}
+
+int main(int argC, char * argV[]) {
+    boost::program_options::options_description desc("stixels_shm_reader options");
+    desc.add_options()
+    ("help,h", "produce this help message")
+    ("name", boost::program_options::value<string>()->default_value("/stixel_world"), "shared memory object")
+    ("frames", boost::program_options::value<uint32_t>()->default_value(0), "frames to read, 0 to read until the writer stops")
+    ("timeout", boost::program_options::value<uint32_t>()->default_value(5000), "ms without frames before giving up")
+    ("verbose", boost::program_options::value<bool>()->default_value(false), "print every frame")
+    ;
+
+    boost::program_options::variables_map args;
+    boost::program_options::store(boost::program_options::parse_command_line(argC, argV, desc), args);
+    boost::program_options::notify(args);
+
+    if (args.count("help") > 0) {
+        cout << desc << endl;
+        return 1;
+    }
+
+    const uint32_t maxFrames = args["frames"].as<uint32_t>();
+    const uint32_t timeout = args["timeout"].as<uint32_t>();
+    const bool verbose = args["verbose"].as<bool>();
+
+    StixelsShmReader reader(args["name"].as<string>());
+
+    uint64_t lastSequence = reader.getLastSequence();
+    uint64_t readFrames = 0, lostFrames = 0, invalidFrames = 0, inconsistentFrames = 0;
+    double accDelay = 0.0, maxDelay = 0.0;
+    while (((maxFrames == 0) || (readFrames < maxFrames)) && reader.waitForFrame(lastSequence, timeout)) {
+        uint64_t sequence;
+        const StixelsShm::t_frame * frame = reader.acquireLatest(sequence);
+        const double delay = getWallTime() - frame->stamp;
+
+        // Same checks a consumer would do on its data, while the frame could be overwritten
+        bool consistent = (frame->numStixels <= StixelsShm::MAX_STIXELS);
+        for (uint32_t i = 0; consistent && (i < frame->numStixels); i++)
+            consistent = (frame->stixels[i].top_y <= frame->stixels[i].bottom_y) &&
+                         (frame->stixels[i].motion < (int32_t)StixelsShm::MAX_STIXELS);
+        const uint64_t frameNumber = frame->frame;
+        const uint32_t numStixels = frame->numStixels, numObstacles = frame->numObstacles;
+
+        if (! reader.isValid(frame, sequence)) {
+            // Overwritten while it was read, the next one is taken instead
+            invalidFrames++;
+            continue;
+        }
+        if (! consistent)
+            inconsistentFrames++;
+
+        if ((lastSequence != 0) && (sequence > lastSequence + 1))
+            lostFrames += sequence - lastSequence - 1;
+        lastSequence = sequence;
+        readFrames++;
+        accDelay += delay;
+        maxDelay = std::max(maxDelay, delay);
+
+        if (verbose)
+            cout << "seq " << sequence << " frame " << frameNumber << " stixels " << numStixels
+                 << " obstacles " << numObstacles << " delay " << delay * 1e6 << " us" << endl;
+    }
+
+    cout << "Frames read: " << readFrames << endl;
+    cout << "Frames lost: " << lostFrames << endl;
+    cout << "Frames overwritten while read: " << invalidFrames << endl;
+    cout << "Inconsistent frames: " << inconsistentFrames << endl;
+    if (readFrames != 0)
+        cout << "Delay (us): mean " << accDelay / readFrames * 1e6 << ", max " << maxDelay * 1e6 << endl;
+
+    return (inconsistentFrames == 0)? 0 : 1;
+}
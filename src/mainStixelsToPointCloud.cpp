@@ -0,0 +1,82 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+// Expands the compact stixels published by stixels_world_node (stixel_world/StixelsFrame) into a
+// point cloud, for the tools that need one (rviz). Points are colored by obstacle track.
+
+#include <ros/ros.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
+
+#include <stixel_world/StixelsFrame.h>
+
+#include "stixelpointcloudpublisher.h"
+
+#define CAMERA_FRAME_ID "left_cam"
+
+using namespace std;
+using namespace stixel_world_ros;
+
+static cv::Vec3b getTrackColor(const int32_t & trackId)
+{
+    if (trackId < 0)
+        return cv::Vec3b(128, 128, 128);
+
+    // Same color for a track in every frame
+    const uint32_t hash = (uint32_t)trackId * 2654435761u;
+    return cv::Vec3b(hash & 0xFF, (hash >> 8) & 0xFF, (hash >> 16) & 0xFF);
+}
+
+static void stixelsCallback(const stixel_world::StixelsFrame::ConstPtr & frame,
+                            StixelPointCloudPublisher * p_publisher, const bool & onlyObstacles)
+{
+    p_publisher->clear();
+    for (uint32_t i = 0; i < frame->stixels.size(); i++) {
+        const stixel_world::CompactStixel & stixel = frame->stixels[i];
+        if ((stixel.disparity <= 0.0f) || (stixel.bottom_y < stixel.top_y) ||
+            (onlyObstacles && (stixel.track_id < 0)))
+            continue;
+
+        const float z = frame->focal_x * frame->baseline / stixel.disparity;
+        const float x = (stixel.x - frame->center_x) * z / frame->focal_x;
+        const Eigen::Vector3f top3d(x, (stixel.top_y - frame->center_y) * z / frame->focal_y, z);
+        const Eigen::Vector3f bottom3d(x, (stixel.bottom_y - frame->center_y) * z / frame->focal_y, z);
+
+        p_publisher->addSegment(top3d, bottom3d, stixel.bottom_y - stixel.top_y + 1, frame->camera_height,
+                                getTrackColor(stixel.track_id));
+    }
+
+    p_publisher->publish(frame->header.stamp);
+}
+
+int main(int argC, char * argV[]) {
+    ros::init(argC, argV, "stixels_to_pointcloud");
+
+    ros::NodeHandle nh("~");
+    bool onlyObstacles;
+    int maxPoints;
+    nh.param("onlyObstacles", onlyObstacles, false);
+    nh.param("maxPoints", maxPoints, 640 * 480);
+
+    StixelPointCloudPublisher publisher(nh, "pointCloudStixels", CAMERA_FRAME_ID, maxPoints);
+    ros::Subscriber subscriber = nh.subscribe<stixel_world::StixelsFrame>("stixels", 1,
+                                     boost::bind(stixelsCallback, _1, &publisher, onlyObstacles));
+
+    ros::spin();
+
+    return 0;
+}
@@ -0,0 +1,404 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+// Renders a synthetic rectified stereo sequence: a textured flat ground plane seen from a camera
+// moving forward, with boxes moving over it. Together with the images, it writes the stereo
+// calibration, the ground truth annotations (in the format read by MotionEvaluation) and a
+// configuration file ready to be used with stixels_world_node or stixels_benchmark.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <opencv2/opencv.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+
+#include <google/protobuf/text_format.h>
+
+#include "video_input/calibration/calibration.pb.h"
+#include "video_input/calibration/StereoCameraCalibration.hpp"
+
+using namespace std;
+
+// Texture cells, in meters
+#define GROUND_CELL_SIZE 0.05
+#define OBSTACLE_CELL_SIZE 0.04
+// Obstacles are kept in front of the camera, between the depth giving 80% of max_disparity and this one
+#define MAXIMUM_OBSTACLE_DEPTH 25.0
+// Annotations lower than this are ignored by MotionEvaluation::readAnnotationFile
+#define MINIMUM_ANNOTATION_HEIGHT 40
+
+typedef struct {
+    uint32_t id;
+    double x, z;            // world position of the center of the front face (z along the motion of the camera)
+    double width, height;
+    double vx, vz;          // m/s
+    cv::Vec3b color;
+} t_synthetic_obstacle;
+
+typedef struct {
+    uint32_t width, height;
+    double focal, cx, cy;
+    double baseline;
+    double cameraHeight;
+} t_synthetic_camera;
+
+static inline uint32_t hashCell(const int32_t & i, const int32_t & j, const uint32_t & seed)
+{
+    uint32_t h = seed * 0x9E3779B1u;
+    h ^= (uint32_t)i * 0x85EBCA6Bu;
+    h = (h << 13) | (h >> 19);
+    h ^= (uint32_t)j * 0xC2B2AE35u;
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return h;
+}
+
+/// Bilinearly interpolated value noise in [0, 255], so the texture is continuous at any distance
+static inline double valueNoise(const double & u, const double & v, const uint32_t & seed)
+{
+    const double fu = floor(u), fv = floor(v);
+    const int32_t i = (int32_t)fu, j = (int32_t)fv;
+    const double du = u - fu, dv = v - fv;
+
+    const double v00 = hashCell(i, j, seed) & 0xFF;
+    const double v10 = hashCell(i + 1, j, seed) & 0xFF;
+    const double v01 = hashCell(i, j + 1, seed) & 0xFF;
+    const double v11 = hashCell(i + 1, j + 1, seed) & 0xFF;
+
+    return (v00 * (1.0 - du) + v10 * du) * (1.0 - dv) + (v01 * (1.0 - du) + v11 * du) * dv;
+}
+
+static void renderView(const t_synthetic_camera & camera, const double & cameraX, const double & cameraZ,
+                       const vector<t_synthetic_obstacle> & obstacles, const uint32_t & seed, cv::Mat & img)
+{
+    img = cv::Mat(camera.height, camera.width, CV_8UC3);
+
+    // Sky and ground (the camera has no pitch, so the horizon is at cy)
+    for (uint32_t v = 0; v < camera.height; v++) {
+        cv::Vec3b * row = img.ptr<cv::Vec3b>(v);
+        const double dy = v + 0.5 - camera.cy;
+        if (dy <= 0.5) {
+            const uint8_t sky = 255 - (uint8_t)(80.0 * v / camera.cy);
+            for (uint32_t u = 0; u < camera.width; u++)
+                row[u] = cv::Vec3b(sky, sky - 20, sky - 60);
+            continue;
+        }
+
+        const double depth = camera.focal * camera.cameraHeight / dy;
+        const double worldZ = cameraZ + depth;
+        for (uint32_t u = 0; u < camera.width; u++) {
+            const double worldX = cameraX + (u + 0.5 - camera.cx) * depth / camera.focal;
+            const double value = 0.6 * valueNoise(worldX / GROUND_CELL_SIZE, worldZ / GROUND_CELL_SIZE, seed) +
+                                 0.4 * valueNoise(worldX / (4 * GROUND_CELL_SIZE), worldZ / (4 * GROUND_CELL_SIZE), seed + 1);
+            const uint8_t gray = (uint8_t)(40.0 + 0.6 * value);
+            row[u] = cv::Vec3b(gray, gray, gray);
+        }
+    }
+
+    // Painter's algorithm, from the farthest obstacle to the closest one
+    vector< pair<double, uint32_t> > order;
+    for (uint32_t i = 0; i < obstacles.size(); i++)
+        order.push_back(make_pair(-obstacles[i].z, i));
+    std::sort(order.begin(), order.end());
+
+    for (uint32_t k = 0; k < order.size(); k++) {
+        const t_synthetic_obstacle & obstacle = obstacles[order[k].second];
+        const double depth = obstacle.z - cameraZ;
+        if (depth <= 0.0)
+            continue;
+
+        const double scale = camera.focal / depth;
+        const int32_t u0 = std::max(0, (int32_t)ceil(camera.cx + (obstacle.x - obstacle.width / 2.0 - cameraX) * scale - 0.5));
+        const int32_t u1 = std::min((int32_t)camera.width - 1, (int32_t)floor(camera.cx + (obstacle.x + obstacle.width / 2.0 - cameraX) * scale - 0.5));
+        const int32_t v0 = std::max(0, (int32_t)ceil(camera.cy + (camera.cameraHeight - obstacle.height) * scale - 0.5));
+        const int32_t v1 = std::min((int32_t)camera.height - 1, (int32_t)floor(camera.cy + camera.cameraHeight * scale - 0.5));
+
+        for (int32_t v = v0; v <= v1; v++) {
+            cv::Vec3b * row = img.ptr<cv::Vec3b>(v);
+            // Texture coordinates are attached to the obstacle, so the texture moves with it
+            const double localY = (v + 0.5 - camera.cy) / scale - camera.cameraHeight + obstacle.height;
+            for (int32_t u = u0; u <= u1; u++) {
+                const double localX = (u + 0.5 - camera.cx) / scale + cameraX - obstacle.x + obstacle.width / 2.0;
+                const double value = valueNoise(localX / OBSTACLE_CELL_SIZE, localY / OBSTACLE_CELL_SIZE,
+                                                seed + 2 + obstacle.id) / 255.0;
+                for (uint32_t c = 0; c < 3; c++)
+                    row[u][c] = (uint8_t)(obstacle.color[c] * (0.5 + 0.5 * value));
+            }
+        }
+    }
+}
+
+static bool getAnnotation(const t_synthetic_camera & camera, const double & cameraZ,
+                          const t_synthetic_obstacle & obstacle, cv::Rect & roi)
+{
+    const double depth = obstacle.z - cameraZ;
+    if (depth <= 0.0)
+        return false;
+
+    const double scale = camera.focal / depth;
+    const cv::Point2i ul(std::max(0, (int32_t)(camera.cx + (obstacle.x - obstacle.width / 2.0) * scale)),
+                         std::max(0, (int32_t)(camera.cy + (camera.cameraHeight - obstacle.height) * scale)));
+    const cv::Point2i br(std::min((int32_t)camera.width - 1, (int32_t)(camera.cx + (obstacle.x + obstacle.width / 2.0) * scale)),
+                         std::min((int32_t)camera.height - 1, (int32_t)(camera.cy + camera.cameraHeight * scale)));
+    if ((br.x <= ul.x) || (br.y - ul.y < MINIMUM_ANNOTATION_HEIGHT))
+        return false;
+
+    roi = cv::Rect(ul, br);
+    return true;
+}
+
+static void resetObstacle(t_synthetic_obstacle & obstacle, cv::RNG & rng, const double & cameraZ,
+                          const double & minDepth, const double & maxDepth, const double & speed)
+{
+    obstacle.z = cameraZ + rng.uniform(minDepth, maxDepth);
+    obstacle.x = rng.uniform(-4.0, 4.0);
+    obstacle.width = rng.uniform(0.5, 1.2);
+    obstacle.height = rng.uniform(1.5, 2.0);
+    obstacle.vx = rng.uniform(-speed, speed);
+    obstacle.vz = rng.uniform(-speed, speed) * 0.5;
+    obstacle.color = cv::Vec3b(rng.uniform(60, 256), rng.uniform(60, 256), rng.uniform(60, 256));
+}
+
+static string getCameraCalibration(const string & name, const t_synthetic_camera & camera, const double & x)
+{
+    stringstream ss;
+    ss << "    " << name << " {" << endl
+       << "        name: \"" << name << "\"" << endl
+       << "        internal_calibration {" << endl
+       << "            k11: " << camera.focal << endl
+       << "            k12: 0" << endl
+       << "            k13: " << camera.cx << endl
+       << "            k22: " << camera.focal << endl
+       << "            k23: " << camera.cy << endl
+       << "            k33: 1" << endl
+       << "        }" << endl
+       << "        pose {" << endl
+       << "            rotation { r11: 1 r12: 0 r13: 0 r21: 0 r22: 1 r23: 0 r31: 0 r32: 0 r33: 1 }" << endl
+       << "            translation { x: " << x << " y: 0 z: 0 }" << endl
+       << "        }" << endl
+       << "        radial_distortion { k1: 0 k2: 0 k3: 0 }" << endl
+       << "        tangential_distortion { p1: 0 p2: 0 }" << endl
+       << "    }" << endl;
+    return ss.str();
+}
+
+static void writeCalibration(const string & filename, const t_synthetic_camera & camera)
+{
+    stringstream ss;
+    ss << "# Synthetic stereo camera, rectified and without distortion" << endl
+       << "name: \"synthetic " << camera.width << "x" << camera.height << "\"" << endl
+       << getCameraCalibration("left_camera", camera, 0.0)
+       << getCameraCalibration("right_camera", camera, camera.baseline);
+
+    // Make sure the calibration can be read back before writing it
+    doppia_protobuf::StereoCameraCalibration calibrationData;
+    if (! google::protobuf::TextFormat::ParseFromString(ss.str(), &calibrationData))
+        throw std::runtime_error("Could not generate a valid stereo calibration");
+    doppia::StereoCameraCalibration calibration(calibrationData);
+
+    ofstream fout(filename.c_str());
+    fout << ss.str();
+}
+
+static void writeConfiguration(const string & filename, const boost::filesystem::path & outputDir,
+                               const t_synthetic_camera & camera, const uint32_t & numFrames,
+                               const uint32_t & maxDisparity, const uint32_t & frameRate)
+{
+    ofstream fout(filename.c_str());
+    fout << "# configuration file for a synthetic sequence, created by synthetic_stereo_sequence" << endl
+         << "max_disparity = " << maxDisparity << endl
+         << "pixels_matching = sad" << endl
+         << endl
+         << "[video_input]" << endl
+         << "source = directory" << endl
+         << "left_filename_mask  = " << (outputDir / "left" / "image_%08i_0.png").string() << endl
+         << "right_filename_mask = " << (outputDir / "right" / "image_%08i_1.png").string() << endl
+         << "calibration_filename = " << (outputDir / "stereo_calibration.proto.txt").string() << endl
+         << "start_frame = 0" << endl
+         << "end_frame = " << numFrames - 1 << endl
+         << "frame_rate = " << frameRate << endl
+         << "camera_height = " << camera.cameraHeight << endl
+         << "camera_roll = 0" << endl
+         << "camera_pitch = 0" << endl
+         << endl
+         << "[preprocess]" << endl
+         << "unbayer = false" << endl
+         << "undistort = false" << endl
+         << "rectify = false" << endl
+         << "smooth = false" << endl
+         << "residual = false" << endl
+         << "specular = false" << endl
+         << endl
+         << "[ground_plane_estimator]" << endl
+         << "filter_estimates = true" << endl
+         << "use_residual = true" << endl
+         << endl
+         << "[stixel_world]" << endl
+         << "method = fast" << endl
+         << "expected_object_height = 1.8" << endl
+         << "height_method = fixed" << endl
+         << "use_stixels_for_ground_estimation = false" << endl
+         << "stixel_width=1" << endl
+         << endl
+         << "[stixel_world.motion]" << endl
+         << "average_pedestrian_speed = 1.5" << endl
+         << endl
+         << "[stixel_world.motion.evaluation]" << endl
+         << "annotations = " << (outputDir / "annotations.idl.gz").string() << endl
+         << "output_folder = " << (outputDir / "evaluation").string() << endl;
+}
+
+int main(int argC, char * argV[]) {
+    boost::program_options::options_description desc("synthetic_stereo_sequence options");
+    desc.add_options()
+    ("help,h", "produce this help message")
+    ("output,o", boost::program_options::value<string>(), "output folder")
+    ("width", boost::program_options::value<uint32_t>()->default_value(640), "image width")
+    ("height", boost::program_options::value<uint32_t>()->default_value(0), "image height (0 for 3/4 of the width)")
+    ("frames", boost::program_options::value<uint32_t>()->default_value(100), "number of frames")
+    ("obstacles", boost::program_options::value<uint32_t>()->default_value(5), "number of moving obstacles")
+    ("obstacle_speed", boost::program_options::value<double>()->default_value(1.5), "maximum obstacle speed (m/s)")
+    ("camera_speed", boost::program_options::value<double>()->default_value(2.0), "forward speed of the camera (m/s)")
+    ("camera_height", boost::program_options::value<double>()->default_value(1.0), "height of the camera over the ground (m)")
+    ("baseline", boost::program_options::value<double>()->default_value(0.4), "stereo baseline (m)")
+    ("fov", boost::program_options::value<double>()->default_value(50.0), "horizontal field of view (degrees)")
+    ("max_disparity", boost::program_options::value<uint32_t>()->default_value(128), "max_disparity of the generated configuration")
+    ("frame_rate", boost::program_options::value<uint32_t>()->default_value(15), "frames per second")
+    ("seed", boost::program_options::value<uint32_t>()->default_value(1), "random seed, the same seed gives the same sequence")
+    ;
+
+    boost::program_options::variables_map args;
+    boost::program_options::store(boost::program_options::parse_command_line(argC, argV, desc), args);
+    boost::program_options::notify(args);
+
+    if ((args.count("help") > 0) || (args.count("output") == 0)) {
+        cout << desc << endl;
+        return 1;
+    }
+
+    const boost::filesystem::path outputDir = boost::filesystem::absolute(args["output"].as<string>());
+    boost::filesystem::create_directories(outputDir / "left");
+    boost::filesystem::create_directories(outputDir / "right");
+    boost::filesystem::create_directories(outputDir / "evaluation");
+
+    t_synthetic_camera camera;
+    camera.width = args["width"].as<uint32_t>();
+    camera.height = args["height"].as<uint32_t>();
+    if (camera.height == 0)
+        camera.height = camera.width * 3 / 4;
+    camera.focal = (camera.width / 2.0) / tan(args["fov"].as<double>() * M_PI / 360.0);
+    camera.cx = camera.width / 2.0;
+    camera.cy = camera.height / 2.0;
+    camera.baseline = args["baseline"].as<double>();
+    camera.cameraHeight = args["camera_height"].as<double>();
+
+    const uint32_t numFrames = args["frames"].as<uint32_t>();
+    const uint32_t frameRate = args["frame_rate"].as<uint32_t>();
+    const uint32_t maxDisparity = args["max_disparity"].as<uint32_t>();
+    const uint32_t seed = args["seed"].as<uint32_t>();
+    const double cameraSpeed = args["camera_speed"].as<double>();
+    const double obstacleSpeed = args["obstacle_speed"].as<double>();
+
+    // Closer obstacles would have a disparity out of the search range
+    const double minDepth = camera.focal * camera.baseline / (0.8 * maxDisparity);
+    const double maxDepth = std::max(MAXIMUM_OBSTACLE_DEPTH, 2.0 * minDepth);
+
+    cv::RNG rng(seed);
+    uint32_t nextObstacleId = 0;
+    vector<t_synthetic_obstacle> obstacles(args["obstacles"].as<uint32_t>());
+    for (uint32_t i = 0; i < obstacles.size(); i++) {
+        obstacles[i].id = nextObstacleId++;
+        resetObstacle(obstacles[i], rng, 0.0, minDepth, maxDepth, obstacleSpeed);
+    }
+
+    writeCalibration((outputDir / "stereo_calibration.proto.txt").string(), camera);
+    writeConfiguration((outputDir / "synthetic.config.ini").string(), outputDir, camera, numFrames,
+                       maxDisparity, frameRate);
+
+    stringstream annotations;
+    double cameraZ = 0.0;
+    for (uint32_t frame = 0; frame < numFrames; frame++) {
+        cv::Mat left, right;
+        renderView(camera, 0.0, cameraZ, obstacles, seed, left);
+        renderView(camera, camera.baseline, cameraZ, obstacles, seed, right);
+
+        char leftName[64], rightName[64];
+        sprintf(leftName, "image_%08i_0.png", frame);
+        sprintf(rightName, "image_%08i_1.png", frame);
+        cv::imwrite((outputDir / "left" / leftName).string(), left);
+        cv::imwrite((outputDir / "right" / rightName).string(), right);
+
+        // Frames without visible obstacles get an empty box, discarded when the annotations are read
+        annotations << "\"left/" << leftName << "\":";
+        uint32_t numAnnotations = 0;
+        for (uint32_t i = 0; i < obstacles.size(); i++) {
+            cv::Rect roi;
+            if (! getAnnotation(camera, cameraZ, obstacles[i], roi))
+                continue;
+            annotations << (numAnnotations == 0? " " : ", ")
+                        << "(" << roi.x << ", " << roi.y << ", " << roi.br().x << ", " << roi.br().y << "):" << obstacles[i].id;
+            numAnnotations++;
+        }
+        if (numAnnotations == 0)
+            annotations << " (0, 0, 0, 0):0";
+        annotations << ";" << endl;
+
+        // Motion until the next frame
+        cameraZ += cameraSpeed / frameRate;
+        for (uint32_t i = 0; i < obstacles.size(); i++) {
+            t_synthetic_obstacle & obstacle = obstacles[i];
+            obstacle.x += obstacle.vx / frameRate;
+            obstacle.z += obstacle.vz / frameRate;
+            if (fabs(obstacle.x) > 5.0)
+                obstacle.vx = -obstacle.vx;
+            if ((obstacle.z - cameraZ < minDepth) || (obstacle.z - cameraZ > maxDepth)) {
+                obstacle.id = nextObstacleId++;
+                resetObstacle(obstacle, rng, cameraZ, minDepth, maxDepth, obstacleSpeed);
+            }
+        }
+
+        if ((frame + 1) % 50 == 0)
+            cout << "Rendered " << frame + 1 << " frames" << endl;
+    }
+    // The last entry of an annotation file is not stored by MotionEvaluation, so a dummy one closes it
+    annotations << "\"end\": (0, 0, 0, 0):0." << endl;
+
+    ofstream annotationsFile((outputDir / "annotations.idl.gz").string().c_str(), ios_base::out | ios_base::binary);
+    boost::iostreams::filtering_ostream out;
+    out.push(boost::iostreams::gzip_compressor());
+    out.push(annotationsFile);
+    out << annotations.str();
+    out.reset();
+
+    cout << "Synthetic sequence with " << numFrames << " frames of " << camera.width << "x" << camera.height
+         << " written to " << outputDir.string() << endl;
+    cout << "Configuration file: " << (outputDir / "synthetic.config.ini").string() << endl;
+
+    return 0;
+}
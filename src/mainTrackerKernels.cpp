@@ -0,0 +1,527 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+// Micro-benchmarks of the StixelsTracker kernels (Google Benchmark).
+//
+// Every benchmark is parameterized by the number of stixels and the motion band
+// (stixel_world.motion.maximum_possible_motion_in_pixels). The two frames fed to the tracker are
+// read from a capture folder when STIXEL_KERNELS_CAPTURE points to one (see stixels_benchmark
+// --capture_dir), cropping or tiling them to the requested width. Otherwise, a synthetic pair of
+// frames is generated: a textured image with some obstacles, and the same scene after the camera
+// moved forward.
+//
+// The robust estimation of F (RobustFundamentalMatrix against LMedS) is measured on synthetic
+// correspondences of that same forward motion, by number of points and percentage of outliers.
+// The label of each run is the epipolar error (measureFundMatrixQuality) on the true correspondences.
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/program_options.hpp>
+
+#include <google/protobuf/text_format.h>
+
+#include "utils.h"
+#include "polarcalibration.h"
+#include "stixelstracker.h"
+#include "stixelscapture.h"
+#include "fundamentalmatrixestimator.h"
+#include "robustfundamentalmatrix.h"
+
+#include "applications/stixel_world_lib/stixel_world_lib.hpp"
+#include "video_input/AbstractVideoInput.hpp"
+#include "video_input/MetricStereoCamera.hpp"
+#include "video_input/calibration/StereoCameraCalibration.hpp"
+#include "video_input/calibration/calibration.pb.h"
+
+// Synthetic scene
+#define SYNTHETIC_IMAGE_HEIGHT 480
+#define SYNTHETIC_BASELINE 0.4
+#define SYNTHETIC_CAMERA_HEIGHT 1.0
+#define SYNTHETIC_OBJECT_HEIGHT 1.8
+#define SYNTHETIC_BACKGROUND_DISPARITY 4
+// Zoom between both frames, as seen from a camera moving forward
+#define SYNTHETIC_ZOOM 1.02
+
+using namespace std;
+using namespace stixel_world;
+
+/// Gives access to the protected kernels of the tracker
+class StixelsTrackerKernels : public StixelsTracker
+{
+public:
+    StixelsTrackerKernels(const boost::program_options::variables_map & options, const MetricStereoCamera & camera,
+                          boost::shared_ptr<PolarCalibration> p_polarCalibration) :
+                          StixelsTracker(options, camera, 1, p_polarCalibration) {}
+
+    using StixelsTracker::fetch_polar_products;
+    using StixelsTracker::compute_motion_cost_matrix;
+    using StixelsTracker::computeMotionWithGraphs;
+    using DummyStixelMotionEstimator::compute_motion;
+    using StixelsTracker::updateTracker;
+    using StixelsTracker::getClusters;
+    using StixelsTracker::computeObstacles;
+    using StixelsTracker::filterObstacles;
+    using StixelsTracker::trackObstacles;
+    using StixelsTracker::compute_polar_SAD;
+    using StixelsTracker::computeHistogram;
+
+    const stixels_t & getCurrentStixels() const { return *current_stixels_p; }
+    const stixels_t & getPreviousStixels() const { return *previous_stixels_p; }
+    const cv::Mat & getCurrentImage() const { return m_currImg; }
+
+    /// trackObstacles consumes its previous state, so it is restored before each run
+    void saveObstacles() { m_savedObstacles = m_obstacles; m_savedObstaclesTracker = m_obstaclesTracker; }
+    void restoreObstacles() { m_obstacles = m_savedObstacles; m_obstaclesTracker = m_savedObstaclesTracker; }
+private:
+    vector<t_obstacle> m_savedObstacles;
+    t_obstaclesTracker m_savedObstaclesTracker;
+};
+
+typedef struct {
+    cv::Mat prevLeft, prevRight, currLeft, currRight;
+    stixels_t prevStixels, currStixels;
+    string calibration;
+    bool captured;
+} t_kernel_frames;
+
+static string getSyntheticCalibration(const double & focal, const double & cx, const double & cy)
+{
+    stringstream ss;
+    for (uint32_t camera = 0; camera < 2; camera++) {
+        ss << (camera == 0? "left_camera" : "right_camera") << " {" << endl
+           << "    internal_calibration { k11: " << focal << " k12: 0 k13: " << cx
+           << " k22: " << focal << " k23: " << cy << " k33: 1 }" << endl
+           << "    pose {" << endl
+           << "        rotation { r11: 1 r12: 0 r13: 0 r21: 0 r22: 1 r23: 0 r31: 0 r32: 0 r33: 1 }" << endl
+           << "        translation { x: " << camera * SYNTHETIC_BASELINE << " y: 0 z: 0 }" << endl
+           << "    }" << endl
+           << "}" << endl;
+    }
+    return ss.str();
+}
+
+/// Disparity of the obstacle covering column x (0 for the background)
+static int getSyntheticDisparity(const double & x, const uint32_t & width)
+{
+    // An obstacle every 160 pixels, 40 pixels wide, with disparities between 10 and 70
+    const int32_t cell = (int32_t)floor(x / 160.0);
+    const double offset = x - cell * 160.0;
+    if ((x < 0) || (x >= width) || (offset < 60.0) || (offset >= 100.0))
+        return 0;
+
+    return 10 + (cell * 37) % 61;
+}
+
+static void getSyntheticStixels(const uint32_t & width, const double & zoom, stixels_t & stixels)
+{
+    const double cx = width / 2.0;
+    const double cy = SYNTHETIC_IMAGE_HEIGHT / 2.0;
+
+    stixels.resize(width);
+    for (uint32_t x = 0; x < width; x++) {
+        int disparity = getSyntheticDisparity(cx + (x - cx) / zoom, width);
+        const bool isObstacle = disparity != 0;
+        if (! isObstacle)
+            disparity = SYNTHETIC_BACKGROUND_DISPARITY;
+
+        // Stixels standing on the ground plane of a camera without pitch
+        const double scale = disparity / SYNTHETIC_BASELINE;
+        Stixel & stixel = stixels[x];
+        stixel.x = x;
+        stixel.width = 1;
+        stixel.disparity = disparity;
+        stixel.bottom_y = std::min(SYNTHETIC_IMAGE_HEIGHT - 1, (int)(cy + SYNTHETIC_CAMERA_HEIGHT * scale));
+        stixel.top_y = std::max(0, (int)(stixel.bottom_y - SYNTHETIC_OBJECT_HEIGHT * scale));
+        stixel.type = isObstacle? Stixel::Pedestrian : Stixel::Unknown;
+    }
+}
+
+static void getSyntheticFrames(const uint32_t & width, t_kernel_frames & frames)
+{
+    // Smooth random texture, the same for both cameras (the disparity is not relevant for the tracker)
+    cv::RNG rng(1);
+    cv::Mat noise(SYNTHETIC_IMAGE_HEIGHT / 4, width / 4, CV_8UC3);
+    rng.fill(noise, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(256));
+    cv::resize(noise, frames.prevLeft, cv::Size(width, SYNTHETIC_IMAGE_HEIGHT), 0, 0, cv::INTER_LINEAR);
+    frames.prevRight = frames.prevLeft.clone();
+
+    const cv::Point2f center(width / 2.0f, SYNTHETIC_IMAGE_HEIGHT / 2.0f);
+    const cv::Mat zoom = cv::getRotationMatrix2D(center, 0.0, SYNTHETIC_ZOOM);
+    cv::warpAffine(frames.prevLeft, frames.currLeft, zoom, frames.prevLeft.size(), cv::INTER_LINEAR, cv::BORDER_REFLECT);
+    frames.currRight = frames.currLeft.clone();
+
+    getSyntheticStixels(width, 1.0, frames.prevStixels);
+    getSyntheticStixels(width, SYNTHETIC_ZOOM, frames.currStixels);
+
+    frames.calibration = getSyntheticCalibration(width, center.x, center.y);
+    frames.captured = false;
+}
+
+/// Crops or tiles the image so it has the given width
+static void fitWidth(const cv::Mat & img, const uint32_t & width, cv::Mat & output)
+{
+    const uint32_t numTiles = (width + img.cols - 1) / img.cols;
+    cv::Mat tiled;
+    cv::repeat(img, 1, numTiles, tiled);
+    output = tiled(cv::Rect(0, 0, width, img.rows)).clone();
+}
+
+static void fitWidth(const stixels_t & stixels, const uint32_t & imageWidth, const uint32_t & width, stixels_t & output)
+{
+    output.clear();
+    for (uint32_t offset = 0; offset < width; offset += imageWidth) {
+        for (stixels_t::const_iterator it = stixels.begin(); it != stixels.end(); it++) {
+            if (it->x + offset < width) {
+                output.push_back(*it);
+                output.back().x += offset;
+            }
+        }
+    }
+}
+
+static bool getCapturedFrames(const uint32_t & width, t_kernel_frames & frames)
+{
+    const char * folder = getenv("STIXEL_KERNELS_CAPTURE");
+    if (folder == NULL)
+        return false;
+
+    vector<uint32_t> capturedFrames;
+    StixelsCapture::listFrames(folder, capturedFrames);
+    if (capturedFrames.size() < 2)
+        return false;
+
+    cv::Mat prevLeft, prevRight, currLeft, currRight;
+    stixels_t prevStixels, currStixels;
+    if ((! StixelsCapture::readFrame(folder, capturedFrames[0], prevLeft, prevRight, prevStixels)) ||
+        (! StixelsCapture::readFrame(folder, capturedFrames[1], currLeft, currRight, currStixels)))
+        return false;
+
+    fitWidth(prevLeft, width, frames.prevLeft);
+    fitWidth(prevRight, width, frames.prevRight);
+    fitWidth(currLeft, width, frames.currLeft);
+    fitWidth(currRight, width, frames.currRight);
+    fitWidth(prevStixels, prevLeft.cols, width, frames.prevStixels);
+    fitWidth(currStixels, currLeft.cols, width, frames.currStixels);
+
+    ifstream calibrationFile(StixelsCapture::getCalibrationFilename(folder).c_str());
+    if (calibrationFile.good()) {
+        stringstream calibration;
+        calibration << calibrationFile.rdbuf();
+        frames.calibration = calibration.str();
+    } else {
+        frames.calibration = getSyntheticCalibration(width, width / 2.0, prevLeft.rows / 2.0);
+    }
+    frames.captured = true;
+
+    return true;
+}
+
+class TrackerKernels : public benchmark::Fixture
+{
+public:
+    void SetUp(const benchmark::State & state) {
+        const uint32_t numStixels = state.range(0);
+        const uint32_t motionBand = state.range(1);
+
+        if (! getCapturedFrames(numStixels, m_frames))
+            getSyntheticFrames(numStixels, m_frames);
+
+        boost::program_options::options_description desc;
+        get_options_description(desc);
+        desc.add(StixelsTracker::get_args_options());
+
+        stringstream configuration;
+        configuration << "[video_input]" << endl
+                      << "frame_rate = 15" << endl
+                      << "[stixel_world.motion]" << endl
+                      << "average_pedestrian_speed = 1.5" << endl
+                      << "maximum_possible_motion_in_pixels = " << motionBand << endl;
+        boost::program_options::store(boost::program_options::parse_config_file(configuration, desc), m_options);
+        boost::program_options::notify(m_options);
+
+        doppia_protobuf::StereoCameraCalibration calibrationData;
+        google::protobuf::TextFormat::ParseFromString(m_frames.calibration, &calibrationData);
+        mp_calibration.reset(new doppia::StereoCameraCalibration(calibrationData));
+        mp_camera.reset(new doppia::MetricStereoCamera(*mp_calibration));
+
+        computePolarCalibration();
+
+        mp_tracker.reset(new StixelsTrackerKernels(m_options, *mp_camera, mp_polarCalibration));
+        mp_tracker->set_motion_cost_factors(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, true, true, true, false);
+        mp_tracker->set_visualization(false);
+
+        m_prevImage = doppia::AbstractVideoInput::input_image_t(m_frames.prevLeft.cols, m_frames.prevLeft.rows);
+        m_currImage = doppia::AbstractVideoInput::input_image_t(m_frames.currLeft.cols, m_frames.currLeft.rows);
+        doppia::AbstractVideoInput::input_image_view_t prevView = boost::gil::view(m_prevImage);
+        doppia::AbstractVideoInput::input_image_view_t currView = boost::gil::view(m_currImage);
+        opencv2gil(m_frames.prevLeft, prevView);
+        opencv2gil(m_frames.currLeft, currView);
+
+        mp_tracker->set_new_rectified_image(prevView);
+        mp_tracker->set_estimated_stixels(m_frames.prevStixels);
+        mp_tracker->set_new_rectified_image(currView);
+        mp_tracker->set_estimated_stixels(m_frames.currStixels);
+
+        // Inputs of the later stages
+        mp_tracker->fetch_polar_products();
+        mp_tracker->compute_motion_cost_matrix();
+        mp_tracker->computeMotionWithGraphs();
+        mp_tracker->updateTracker();
+        mp_tracker->trackObstacles();
+        mp_tracker->saveObstacles();
+    }
+
+    void TearDown(const benchmark::State & state) {
+        mp_tracker.reset();
+        mp_polarCalibration.reset();
+        mp_camera.reset();
+        mp_calibration.reset();
+    }
+
+protected:
+    void computePolarCalibration() {
+        mp_polarCalibration.reset(new PolarCalibration());
+
+        cv::Mat F;
+        vector<cv::Point2f> prevPoints, currPoints;
+        if (m_frames.captured) {
+            cv::Mat FR;
+            vector < vector < cv::Point2f > > correspondences;
+            if (! FundamentalMatrixEstimator::findF(m_frames.prevLeft, m_frames.prevRight, m_frames.currLeft,
+                                                    m_frames.currRight, F, FR, correspondences, 50)) {
+                mp_polarCalibration.reset();
+                return;
+            }
+            prevPoints = correspondences[0];
+            currPoints = correspondences[3];
+        } else {
+            // Pure forward motion: the epipole is the center of the zoom, and F = [e]x
+            const double ex = m_frames.prevLeft.cols / 2.0, ey = m_frames.prevLeft.rows / 2.0;
+            F = (cv::Mat_<double>(3, 3) << 0.0, -1.0, ey, 1.0, 0.0, -ex, -ey, ex, 0.0);
+            cv::RNG rng(2);
+            for (uint32_t i = 0; i < 50; i++) {
+                const cv::Point2f point(rng.uniform(0.0f, (float)m_frames.prevLeft.cols),
+                                        rng.uniform(0.0f, (float)m_frames.prevLeft.rows));
+                prevPoints.push_back(point);
+                currPoints.push_back(cv::Point2f(ex + (point.x - ex) * SYNTHETIC_ZOOM, ey + (point.y - ey) * SYNTHETIC_ZOOM));
+            }
+        }
+
+        if (! mp_polarCalibration->compute(m_frames.prevLeft, m_frames.currLeft, F, prevPoints, currPoints)) {
+            mp_polarCalibration.reset();
+            return;
+        }
+        mp_polarCalibration->rectifyAndStoreImages(m_frames.prevLeft, m_frames.currLeft);
+    }
+
+    t_kernel_frames m_frames;
+    boost::program_options::variables_map m_options;
+    boost::shared_ptr<doppia::StereoCameraCalibration> mp_calibration;
+    boost::shared_ptr<doppia::MetricStereoCamera> mp_camera;
+    boost::shared_ptr<PolarCalibration> mp_polarCalibration;
+    boost::shared_ptr<StixelsTrackerKernels> mp_tracker;
+    doppia::AbstractVideoInput::input_image_t m_prevImage, m_currImage;
+};
+
+BENCHMARK_DEFINE_F(TrackerKernels, compute_motion_cost_matrix)(benchmark::State & state) {
+    while (state.KeepRunning())
+        mp_tracker->compute_motion_cost_matrix();
+    state.SetItemsProcessed(state.iterations() * mp_tracker->getCurrentStixels().size());
+}
+
+BENCHMARK_DEFINE_F(TrackerKernels, computeMotionWithGraphs)(benchmark::State & state) {
+    while (state.KeepRunning())
+        mp_tracker->computeMotionWithGraphs();
+    state.SetItemsProcessed(state.iterations() * mp_tracker->getCurrentStixels().size());
+}
+
+BENCHMARK_DEFINE_F(TrackerKernels, compute_motion)(benchmark::State & state) {
+    while (state.KeepRunning())
+        mp_tracker->compute_motion();
+    state.SetItemsProcessed(state.iterations() * mp_tracker->getCurrentStixels().size());
+}
+
+BENCHMARK_DEFINE_F(TrackerKernels, getClusters)(benchmark::State & state) {
+    while (state.KeepRunning())
+        mp_tracker->getClusters();
+    state.SetItemsProcessed(state.iterations() * mp_tracker->getCurrentStixels().size());
+}
+
+BENCHMARK_DEFINE_F(TrackerKernels, computeObstacles)(benchmark::State & state) {
+    while (state.KeepRunning())
+        mp_tracker->computeObstacles();
+    state.SetItemsProcessed(state.iterations() * mp_tracker->getCurrentStixels().size());
+}
+
+BENCHMARK_DEFINE_F(TrackerKernels, filterObstacles)(benchmark::State & state) {
+    mp_tracker->computeObstacles();
+    while (state.KeepRunning())
+        mp_tracker->filterObstacles();
+    state.SetItemsProcessed(state.iterations() * mp_tracker->getCurrentStixels().size());
+}
+
+BENCHMARK_DEFINE_F(TrackerKernels, trackObstacles)(benchmark::State & state) {
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        mp_tracker->restoreObstacles();
+        state.ResumeTiming();
+        mp_tracker->trackObstacles();
+    }
+    state.SetItemsProcessed(state.iterations() * mp_tracker->getCurrentStixels().size());
+}
+
+BENCHMARK_DEFINE_F(TrackerKernels, compute_polar_SAD)(benchmark::State & state) {
+    if (! mp_polarCalibration) {
+        state.SkipWithError("The polar calibration could not be computed for these frames");
+        return;
+    }
+
+    // Each stixel against the previous stixel in the same column
+    const stixels_t & currStixels = mp_tracker->getCurrentStixels();
+    const stixels_t & prevStixels = mp_tracker->getPreviousStixels();
+    const uint32_t numStixels = std::min(currStixels.size(), prevStixels.size());
+    while (state.KeepRunning()) {
+        float total = 0.0f;
+        for (uint32_t i = 0; i < numStixels; i++)
+            total += mp_tracker->compute_polar_SAD(currStixels[i], prevStixels[i]);
+        benchmark::DoNotOptimize(total);
+    }
+    state.SetItemsProcessed(state.iterations() * numStixels);
+}
+
+BENCHMARK_DEFINE_F(TrackerKernels, computeHistogram)(benchmark::State & state) {
+    const stixels_t & currStixels = mp_tracker->getCurrentStixels();
+    const cv::Mat & currImg = mp_tracker->getCurrentImage();
+    cv::Mat hist;
+    while (state.KeepRunning()) {
+        for (uint32_t i = 0; i < currStixels.size(); i++)
+            mp_tracker->computeHistogram(hist, currImg, currStixels[i]);
+    }
+    state.SetItemsProcessed(state.iterations() * currStixels.size());
+}
+
+/// Forward motion as in the synthetic frames, with 0.3 pixels of noise. The outliers go at the end
+static void getSyntheticCorrespondences(const uint32_t & numPoints, const uint32_t & outliersPercent,
+                                        vector<cv::Point2f> & points1, vector<cv::Point2f> & points2,
+                                        uint32_t & numInliers)
+{
+    const double width = 640.0, height = SYNTHETIC_IMAGE_HEIGHT;
+    const double ex = width / 2.0, ey = height / 2.0;
+    numInliers = numPoints - numPoints * outliersPercent / 100;
+
+    cv::RNG rng(3);
+    points1.resize(numPoints);
+    points2.resize(numPoints);
+    for (uint32_t i = 0; i < numPoints; i++) {
+        points1[i] = cv::Point2f(rng.uniform(0.0, width), rng.uniform(0.0, height));
+        if (i < numInliers) {
+            points2[i] = cv::Point2f(ex + (points1[i].x - ex) * SYNTHETIC_ZOOM + rng.gaussian(0.3),
+                                     ey + (points1[i].y - ey) * SYNTHETIC_ZOOM + rng.gaussian(0.3));
+        } else {
+            points2[i] = cv::Point2f(rng.uniform(0.0, width), rng.uniform(0.0, height));
+        }
+    }
+}
+
+static void setEpipolarErrorLabel(benchmark::State & state, const vector<cv::Point2f> & points1,
+                                  const vector<cv::Point2f> & points2, const uint32_t & numInliers, const cv::Mat & F)
+{
+    if (F.rows != 3) {
+        state.SetLabel("no F");
+        return;
+    }
+
+    const vector<cv::Point2f> inliers1(points1.begin(), points1.begin() + numInliers);
+    const vector<cv::Point2f> inliers2(points2.begin(), points2.begin() + numInliers);
+    stringstream ss;
+    ss << "epipolar_error " << FundamentalMatrixEstimator::measureFundMatrixQuality(inliers1, inliers2, F);
+    state.SetLabel(ss.str());
+}
+
+static void findFundamentalMatLMedS(benchmark::State & state)
+{
+    vector<cv::Point2f> points1, points2;
+    uint32_t numInliers;
+    getSyntheticCorrespondences(state.range(0), state.range(1), points1, points2, numInliers);
+
+    cv::Mat F;
+    while (state.KeepRunning())
+        F = cv::findFundamentalMat(points1, points2, CV_FM_LMEDS);
+
+    setEpipolarErrorLabel(state, points1, points2, numInliers, F);
+    state.SetItemsProcessed(state.iterations() * points1.size());
+}
+
+static void robustFundamentalMatrix(benchmark::State & state)
+{
+    vector<cv::Point2f> points1, points2;
+    uint32_t numInliers;
+    getSyntheticCorrespondences(state.range(0), state.range(1), points1, points2, numInliers);
+
+    // No time budget, and the same estimator through the runs, so all but the first one are seeded
+    // with the previous F, as it happens between frames
+    RobustFundamentalMatrix estimator(1.0, 0.99, 1000, 0.0);
+    cv::Mat F;
+    while (state.KeepRunning())
+        estimator.estimate(points1, points2, RobustFundamentalMatrix::SEED_LEFT, F);
+
+    setEpipolarErrorLabel(state, points1, points2, numInliers, F);
+    state.SetItemsProcessed(state.iterations() * points1.size());
+}
+
+/// Number of correspondences and percentage of outliers
+static void fundamentalMatrixArguments(benchmark::internal::Benchmark * benchmark)
+{
+    const int numPoints[] = { 100, 500, 2000 };
+    const int outliersPercent[] = { 10, 30, 50 };
+    for (uint32_t i = 0; i < sizeof(numPoints) / sizeof(int); i++)
+        for (uint32_t j = 0; j < sizeof(outliersPercent) / sizeof(int); j++)
+            benchmark->ArgPair(numPoints[i], outliersPercent[j]);
+    benchmark->Unit(benchmark::kMillisecond);
+}
+
+/// Stixel counts (image widths with stixel_width = 1) and motion bands
+static void kernelArguments(benchmark::internal::Benchmark * benchmark)
+{
+    const int numStixels[] = { 320, 640, 1280, 2048 };
+    const int motionBands[] = { 16, 33, 66 };
+    for (uint32_t i = 0; i < sizeof(numStixels) / sizeof(int); i++)
+        for (uint32_t j = 0; j < sizeof(motionBands) / sizeof(int); j++)
+            benchmark->ArgPair(numStixels[i], motionBands[j]);
+    benchmark->Unit(benchmark::kMillisecond);
+}
+
+BENCHMARK_REGISTER_F(TrackerKernels, compute_motion_cost_matrix)->Apply(kernelArguments);
+BENCHMARK_REGISTER_F(TrackerKernels, computeMotionWithGraphs)->Apply(kernelArguments);
+BENCHMARK_REGISTER_F(TrackerKernels, compute_motion)->Apply(kernelArguments);
+BENCHMARK_REGISTER_F(TrackerKernels, getClusters)->Apply(kernelArguments);
+BENCHMARK_REGISTER_F(TrackerKernels, computeObstacles)->Apply(kernelArguments);
+BENCHMARK_REGISTER_F(TrackerKernels, filterObstacles)->Apply(kernelArguments);
+BENCHMARK_REGISTER_F(TrackerKernels, trackObstacles)->Apply(kernelArguments);
+BENCHMARK_REGISTER_F(TrackerKernels, compute_polar_SAD)->Apply(kernelArguments);
+BENCHMARK_REGISTER_F(TrackerKernels, computeHistogram)->Apply(kernelArguments);
+BENCHMARK(findFundamentalMatLMedS)->Apply(fundamentalMatrixArguments);
+BENCHMARK(robustFundamentalMatrix)->Apply(fundamentalMatrixArguments);
+
+BENCHMARK_MAIN();
@@ -21,6 +21,8 @@
 #include <limits.h>
 
 #include "utils.h"
+#include "stagetimings.h"
+#include "visualizationsink.h"
 #include <densetracker.h>
 
 #include <omp.h>
@@ -41,7 +43,7 @@ oFlowTracker::oFlowTracker()
 // http://www.inf.ethz.ch/personal/chzach/opensource.html
 void oFlowTracker::compute(const cv::Mat& currImgL, const cv::Mat& currImgR, const stixels_t & stixels)
 {
-    const double & startWallTime = omp_get_wtime();
+    STIXEL_TIMER_START(oflowTimer, "oFlowTracker::compute");
 //     cv::imshow("currImgL", currImgL);
 //     cv::imshow("currImgR", currImgR);
     m_pDenseTrackerL->compute(currImgR);
@@ -79,9 +81,12 @@ void oFlowTracker::compute(const cv::Mat& currImgL, const cv::Mat& currImgR, con
 //         cv::imshow("m_lastImgL", m_lastImgL);
 //         cv::imshow("m_lastImgR", m_lastImgR);
     
-        cout << "Time for oflowtracker:" << __FUNCTION__ << ": " << omp_get_wtime() - startWallTime << endl;
-        
-        cv::Mat outputR(currImgR);
+        STIXEL_TIMER_STOP(oflowTimer);
+    }
+    
+    // The displacement of each stixel is just drawn
+    if ((! m_lastImgL.empty()) && VisualizationSink::isAttached()) {
+        cv::Mat outputR = currImgR.clone();
         for (uint32_t x = 0; x < stixels.size(); x++) {
 
             
@@ -116,14 +121,17 @@ void oFlowTracker::compute(const cv::Mat& currImgL, const cv::Mat& currImgR, con
             outputR.at<cv::Vec3b>(stixels[x].bottom_y, x) = cv::Vec3b(0, 255, 0);
 //             exit(0);
         }
-        cv::imshow("outputL", outputR);
+        VisualizationSink::show("outputL", outputR);
         
-        cv::Mat outputFlow(currImgR);
+        cv::Mat outputFlow = currImgR.clone();
         m_pDenseTrackerL->drawTracks(outputFlow);
-        cv::imshow("outputFlow", outputFlow);
-        cv::imshow("m_lastImgR", m_lastImgR);
+        VisualizationSink::show("outputFlow", outputFlow);
+        VisualizationSink::show("m_lastImgR", m_lastImgR);
     }
     
+    // m_lastImgR could still be waiting to be shown, so it is not overwritten in place
+    if (VisualizationSink::isAttached())
+        m_lastImgR.release();
     currImgL.copyTo(m_lastImgL);
     currImgR.copyTo(m_lastImgR);
 
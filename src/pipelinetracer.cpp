@@ -0,0 +1,126 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include "pipelinetracer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+namespace stixel_world {
+
+PipelineTracer::t_trace_event * PipelineTracer::sp_events = NULL;
+uint32_t PipelineTracer::s_maxEvents = 0;
+volatile uint32_t PipelineTracer::s_numEvents = 0;
+volatile uint64_t PipelineTracer::s_droppedEvents = 0;
+volatile int32_t PipelineTracer::s_frame = -1;
+double PipelineTracer::s_origin = 0.0;
+std::string PipelineTracer::s_filename;
+
+static volatile uint32_t s_numThreads = 0;
+static __thread uint32_t t_threadId = 0;
+
+static void flushAtExit()
+{
+    PipelineTracer::flush();
+}
+
+void PipelineTracer::enable(const string& filename, const uint32_t& maxEvents)
+{
+    if (isEnabled())
+        return;
+
+    s_filename = filename;
+    s_maxEvents = maxEvents;
+    s_numEvents = 0;
+    s_droppedEvents = 0;
+    s_origin = omp_get_wtime();
+
+    sp_events = new t_trace_event[s_maxEvents];
+    __sync_synchronize();
+
+    atexit(flushAtExit);
+}
+
+inline uint32_t PipelineTracer::threadId()
+{
+    // 0 means not assigned yet
+    if (t_threadId == 0)
+        t_threadId = __sync_add_and_fetch(&s_numThreads, 1);
+
+    return t_threadId;
+}
+
+void PipelineTracer::addSpan(const char* name, const char* category, const int32_t& frame,
+                             const double& start, const double& end)
+{
+    const uint32_t idx = __sync_fetch_and_add(&s_numEvents, 1);
+    if (idx >= s_maxEvents) {
+        __sync_fetch_and_add(&s_droppedEvents, 1);
+        return;
+    }
+
+    t_trace_event & event = sp_events[idx];
+    event.name = name;
+    event.category = category;
+    event.start = start;
+    event.end = end;
+    event.frame = frame;
+    event.threadId = threadId();
+}
+
+void PipelineTracer::flush()
+{
+    if (! isEnabled())
+        return;
+
+    FILE * traceFile = fopen(s_filename.c_str(), "w");
+    if (traceFile == NULL) {
+        cerr << "Could not write the trace file " << s_filename << endl;
+        return;
+    }
+
+    // Events being recorded right now by other threads might be incomplete, this is meant
+    // to be called once the pipeline finished.
+    const uint32_t numEvents = std::min((uint32_t)s_numEvents, s_maxEvents);
+    const int pid = getpid();
+
+    fprintf(traceFile, "{\"traceEvents\":[\n");
+    fprintf(traceFile, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"stixel_world\"}}", pid);
+    for (uint32_t i = 0; i < numEvents; i++) {
+        const t_trace_event & event = sp_events[i];
+        fprintf(traceFile, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                           "\"pid\":%d,\"tid\":%u,\"args\":{\"frame\":%d}}",
+                event.name, event.category, (event.start - s_origin) * 1e6, (event.end - event.start) * 1e6,
+                pid, event.threadId, event.frame);
+    }
+    fprintf(traceFile, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":%llu}}\n",
+            (unsigned long long)s_droppedEvents);
+    fclose(traceFile);
+
+    cout << "Trace with " << numEvents << " events written to " << s_filename;
+    if (s_droppedEvents != 0)
+        cout << " (" << s_droppedEvents << " events dropped, the buffer was full)";
+    cout << endl;
+}
+
+}
@@ -0,0 +1,122 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#ifndef PIPELINETRACER_H
+#define PIPELINETRACER_H
+
+#include <stdint.h>
+#include <string>
+
+#include <omp.h>
+
+///
+/// Trace of the pipeline in the Chrome trace event format (chrome://tracing, ui.perfetto.dev).
+///
+/// STIXEL_TRACE_SCOPE("name") records a span per thread until the end of the scope, tagged with
+/// the frame set by STIXEL_TRACE_FRAME(id). STIXEL_TRACE_OMP_REGION("name") is meant to be the first
+/// statement inside an omp parallel block, so each thread of the team shows its part of the region.
+/// Names must be string literals, as only the pointer is stored.
+///
+/// Events go to a bounded buffer allocated by PipelineTracer::enable and are written to disk at exit
+/// (or by PipelineTracer::flush). When the buffer is full, new events are dropped and counted.
+/// While tracing is not enabled each span costs a single branch. Without STIXEL_WORLD_WITH_TRACING
+/// the macros expand to nothing.
+///
+#ifdef STIXEL_WORLD_WITH_TRACING
+#define STIXEL_TRACE_CONCAT_IMPL(a, b) a##b
+#define STIXEL_TRACE_CONCAT(a, b) STIXEL_TRACE_CONCAT_IMPL(a, b)
+#define STIXEL_TRACE_SPAN_START(span, name) stixel_world::ScopedTraceSpan span(name, "stage")
+#define STIXEL_TRACE_SPAN_STOP(span) span.stop()
+#define STIXEL_TRACE_SCOPE(name) STIXEL_TRACE_SPAN_START(STIXEL_TRACE_CONCAT(traceSpan_, __LINE__), name)
+#define STIXEL_TRACE_OMP_REGION(name) \
+    stixel_world::ScopedTraceSpan STIXEL_TRACE_CONCAT(traceSpan_, __LINE__)(name, "omp")
+#define STIXEL_TRACE_FRAME(frame) stixel_world::PipelineTracer::setFrame(frame)
+#else
+#define STIXEL_TRACE_SPAN_START(span, name)
+#define STIXEL_TRACE_SPAN_STOP(span)
+#define STIXEL_TRACE_SCOPE(name)
+#define STIXEL_TRACE_OMP_REGION(name)
+#define STIXEL_TRACE_FRAME(frame)
+#endif
+
+namespace stixel_world {
+
+class PipelineTracer
+{
+public:
+    /// Starts recording up to maxEvents events, that will be written to filename
+    static void enable(const std::string & filename, const uint32_t & maxEvents = 1 << 20);
+    static bool isEnabled() { return sp_events != NULL; }
+
+    static void setFrame(const int32_t & frame) { s_frame = frame; }
+    static int32_t getFrame() { return s_frame; }
+
+    static void addSpan(const char * name, const char * category, const int32_t & frame,
+                        const double & start, const double & end);
+
+    /// Writes the recorded events. Called automatically at exit.
+    static void flush();
+
+    static uint64_t getDroppedEvents() { return s_droppedEvents; }
+private:
+    typedef struct {
+        const char * name;
+        const char * category;
+        double start, end;
+        int32_t frame;
+        uint32_t threadId;
+    } t_trace_event;
+
+    static uint32_t threadId();
+
+    static t_trace_event * sp_events;
+    static uint32_t s_maxEvents;
+    static volatile uint32_t s_numEvents;
+    static volatile uint64_t s_droppedEvents;
+    static volatile int32_t s_frame;
+    static double s_origin;
+    static std::string s_filename;
+};
+
+class ScopedTraceSpan
+{
+public:
+    ScopedTraceSpan(const char * name, const char * category) : mp_name(NULL) {
+        if (PipelineTracer::isEnabled()) {
+            mp_name = name;
+            mp_category = category;
+            m_start = omp_get_wtime();
+        }
+    }
+    ~ScopedTraceSpan() { stop(); }
+
+    void stop() {
+        if (mp_name != NULL) {
+            // The frame is taken at the end, so a span that reads the next frame is tagged with it
+            PipelineTracer::addSpan(mp_name, mp_category, PipelineTracer::getFrame(), m_start, omp_get_wtime());
+            mp_name = NULL;
+        }
+    }
+private:
+    const char * mp_name;
+    const char * mp_category;
+    double m_start;
+};
+
+}
+
+#endif // PIPELINETRACER_H
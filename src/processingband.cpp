@@ -0,0 +1,137 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include "processingband.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "video_input/MetricStereoCamera.hpp"
+#include "video_input/MetricCamera.hpp"
+#include "helpers/get_option_value.hpp"
+
+#include "pipelinetracer.h"
+
+using namespace std;
+
+namespace stixel_world {
+
+/// Image row of a point at the given distance and height over the ground
+static inline double getRow(const double & focalY, const double & centerY, const double & cameraHeight,
+                            const double & cameraPitch, const double & distance, const double & height)
+{
+    const double angleBelowHorizon = atan2(cameraHeight - height, distance);
+    return centerY + focalY * tan(angleBelowHorizon - cameraPitch);
+}
+
+ProcessingBand::ProcessingBand() : m_firstRow(0), m_lastRow(-1)
+{
+
+}
+
+ProcessingBand::ProcessingBand(const int32_t& firstRow, const int32_t& lastRow) : m_firstRow(firstRow), m_lastRow(lastRow)
+{
+    if ((m_lastRow >= 0) && (m_lastRow <= m_firstRow))
+        throw std::invalid_argument("The processing band must have at least one row");
+}
+
+ProcessingBand ProcessingBand::fromGroundPlanePrior(const int32_t& imageHeight, const double& focalY, const double& centerY,
+                                                    const double& cameraHeight, const double& cameraPitch,
+                                                    const double& objectHeight, const double& minDistance,
+                                                    const int32_t& margin)
+{
+    if (minDistance <= 0.0)
+        throw std::invalid_argument("The minimum distance of the processing band must be positive");
+
+    // Far objects end at the horizon, tall objects closer than the horizon end above it
+    const double horizon = getRow(focalY, centerY, cameraHeight, cameraPitch, 1e6, cameraHeight);
+    const double objectTop = getRow(focalY, centerY, cameraHeight, cameraPitch, minDistance, objectHeight);
+    const int32_t firstRow = (int32_t)floor(std::min(horizon, objectTop)) - margin;
+
+    // A prior that leaves nothing to process is wrong, everything is kept then
+    if ((firstRow <= 0) || (firstRow >= imageHeight - 1))
+        return ProcessingBand();
+
+    return ProcessingBand(firstRow);
+}
+
+ProcessingBand ProcessingBand::fromVideoInput(const boost::program_options::variables_map& options,
+                                              doppia::AbstractVideoInput& videoInput,
+                                              const double& minDistance, const int32_t& margin)
+{
+    // Focal length and center recovered by back projecting at depth 1
+    const doppia::MetricCamera & camera = videoInput.get_metric_camera().get_left_camera();
+    Eigen::Vector2f point2d;
+    point2d << 0.0f, 0.0f;
+    const Eigen::Vector3f origin = camera.back_project_2d_point_to_3d(point2d, 1.0);
+    point2d << 1.0f, 1.0f;
+    const Eigen::Vector3f unit = camera.back_project_2d_point_to_3d(point2d, 1.0);
+    const double focalY = 1.0 / (unit(1) - origin(1));
+    const double centerY = -origin(1) * focalY;
+
+    return fromGroundPlanePrior(videoInput.get_left_image().height(), focalY, centerY,
+                                videoInput.camera_height, videoInput.camera_pitch,
+                                doppia::get_option_value<float>(options, "stixel_world.expected_object_height"),
+                                minDistance, margin);
+}
+
+cv::Range ProcessingBand::getRows(const int32_t& imageHeight) const
+{
+    const int32_t lastRow = (m_lastRow < 0)? imageHeight : std::min(m_lastRow, imageHeight);
+    const int32_t firstRow = std::min(std::max(m_firstRow, 0), lastRow);
+
+    return cv::Range(firstRow, lastRow);
+}
+
+void ProcessingBand::remap(const cv::Mat& src, cv::Mat& dst, const cv::Mat& mapX, const cv::Mat& mapY,
+                           const int& interpolation, const int& borderMode) const
+{
+    // cv::remap runs on the OpenCV threads, the span shows where they are busy
+    STIXEL_TRACE_SCOPE("ProcessingBand::remap");
+
+    if (isWholeImage()) {
+        cv::remap(src, dst, mapX, mapY, interpolation, borderMode);
+        return;
+    }
+
+    // dst could be reallocated before src is read
+    const cv::Mat input = (src.data == dst.data)? src.clone() : src;
+    const cv::Range rows = getRows(mapX.rows);
+
+    dst.create(mapX.size(), input.type());
+    clearOutside(dst);
+    if (rows.size() == 0)
+        return;
+
+    cv::Mat dstRows = dst.rowRange(rows);
+    if (borderMode == cv::BORDER_TRANSPARENT)
+        dstRows.setTo(cv::Scalar::all(0));
+    cv::remap(input, dstRows, mapX.rowRange(rows), mapY.empty()? cv::Mat() : mapY.rowRange(rows),
+              interpolation, borderMode);
+}
+
+void ProcessingBand::clearOutside(cv::Mat& img) const
+{
+    const cv::Range rows = getRows(img.rows);
+    if (rows.start > 0)
+        img.rowRange(0, rows.start).setTo(cv::Scalar::all(0));
+    if (rows.end < img.rows)
+        img.rowRange(rows.end, img.rows).setTo(cv::Scalar::all(0));
+}
+
+}
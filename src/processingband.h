@@ -0,0 +1,72 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#ifndef PROCESSINGBAND_H
+#define PROCESSINGBAND_H
+
+#include <stdint.h>
+
+#include <opencv2/opencv.hpp>
+#include <boost/program_options.hpp>
+
+#include "video_input/AbstractVideoInput.hpp"
+
+namespace stixel_world {
+
+///
+/// Rows of the image the stixels can lie on: from the top of an object of expected_object_height
+/// at the minimum distance (or the horizon, if it is higher) down to the bottom of the image.
+/// Images processed in the band keep their full size, so every coordinate is still in full image
+/// space; the rows outside the band are left black.
+///
+class ProcessingBand
+{
+public:
+    /// The whole image
+    ProcessingBand();
+    /// Rows in [firstRow, lastRow). A negative lastRow is the bottom of the image
+    ProcessingBand(const int32_t & firstRow, const int32_t & lastRow = -1);
+
+    /// From the ground plane prior. cameraPitch in radians (positive looking down, as video_input.camera_pitch),
+    /// heights and distances in meters, margin in pixels
+    static ProcessingBand fromGroundPlanePrior(const int32_t & imageHeight, const double & focalY, const double & centerY,
+                                               const double & cameraHeight, const double & cameraPitch,
+                                               const double & objectHeight, const double & minDistance,
+                                               const int32_t & margin);
+    /// Same, with the camera and the prior (camera_pitch, camera_height) of the video input, and
+    /// stixel_world.expected_object_height
+    static ProcessingBand fromVideoInput(const boost::program_options::variables_map & options,
+                                         doppia::AbstractVideoInput & videoInput,
+                                         const double & minDistance, const int32_t & margin);
+
+    bool isWholeImage() const { return (m_firstRow <= 0) && (m_lastRow < 0); }
+    /// Rows of the band in an image with the given height
+    cv::Range getRows(const int32_t & imageHeight) const;
+
+    /// cv::remap of the band rows only. dst gets the size of the maps, and is black outside the band
+    /// (and where nothing is mapped with BORDER_TRANSPARENT). src and dst can be the same image
+    void remap(const cv::Mat & src, cv::Mat & dst, const cv::Mat & mapX, const cv::Mat & mapY,
+               const int & interpolation, const int & borderMode = cv::BORDER_CONSTANT) const;
+    /// Sets to black the rows of img outside the band
+    void clearOutside(cv::Mat & img) const;
+private:
+    int32_t m_firstRow, m_lastRow;
+};
+
+}
+
+#endif // PROCESSINGBAND_H
@@ -18,10 +18,39 @@
 #include "rectification.h"
 
 #include<fstream>
+#include<sstream>
+#include<iomanip>
+#include<stdio.h>
+#include<boost/filesystem.hpp>
+#include<omp.h>
+
+#include "pipelinetracer.h"
+
+// FNV-1a, 64 bits
+#define HASH_OFFSET_BASIS 14695981039346656037ULL
+#define HASH_PRIME 1099511628211ULL
 
 using namespace stixel_world;
 
-Rectification::Rectification()
+static const char MAPS_MAGIC[8] = { 'S', 'W', 'R', 'E', 'C', 'M', 'A', 'P' };
+
+/// Cached maps: this header, then the CV_16SC2 map of each camera
+typedef struct {
+    char magic[8];
+    int32_t rows, cols;
+    int32_t roi[2][4];
+} t_maps_header;
+
+static inline void hashBytes(uint64_t & hash, const void * data, const size_t & size)
+{
+    const uint8_t * bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= HASH_PRIME;
+    }
+}
+
+Rectification::Rectification() : m_mapsValid(false)
 {
 
 }
@@ -72,34 +101,41 @@ void Rectification::readParamsFromFile(const string& fileName, const uint32_t& c
     }
     
     fin.close();
+    
+    m_mapsValid = false;
 }
 
 void Rectification::setIntrinsicCoeffs(const cv::Mat& intrinsicCoeffs, const uint32_t& cameraId)
 {
     m_intrinsicCoeffs[cameraId] = intrinsicCoeffs;
+    m_mapsValid = false;
 }
 
 void Rectification::setDistCoeffs(const cv::Mat& distCoeffs, const uint32_t& cameraId)
 {
     m_distCoeffs[cameraId] = distCoeffs;
+    m_mapsValid = false;
 }
 
 void Rectification::setRotationMatrix(const cv::Mat& R)
 {
     m_R = R;
+    m_mapsValid = false;
 }
 
 void Rectification::setTranslationMatrix(const cv::Mat& t)
 {
     m_t = t;
+    m_mapsValid = false;
 }
 
 bool Rectification::doRectification(const cv::Mat& img1, const cv::Mat& img2, 
-                                    cv::Mat& rectified1, cv::Mat& rectified2, const uint32_t method)
+                                    cv::Mat& rectified1, cv::Mat& rectified2, const uint32_t method,
+                                    const cv::Range & rows)
 {
     switch(method) {
         case RECTIFICATION_LINEAR:
-            return doRectificationLinear(img1, img2, rectified1, rectified2);
+            return doRectificationLinear(img1, img2, rectified1, rectified2, rows);
 //         case RECTIFICATION_POLAR:
             //TODO: Fundamental matrix could be found using a four-image scheme
 //             return doRectificationPolar(img1, img2, rectified1, rectified2);
@@ -108,22 +144,109 @@ bool Rectification::doRectification(const cv::Mat& img1, const cv::Mat& img2,
     return false;
 }
 
-bool Rectification::doRectificationLinear(const cv::Mat& img1, const cv::Mat& img2, cv::Mat& rectified1, cv::Mat& rectified2)
+bool Rectification::doRectification(const cv::Mat& img1, const cv::Mat& img2, 
+                                    cv::Mat& rectified1, cv::Mat& rectified2, const ProcessingBand& band,
+                                    const uint32_t method)
 {
-    m_distCoeffs[0] = cv::Mat::zeros(1, 4, CV_64FC1);
-    m_distCoeffs[1] = cv::Mat::zeros(1, 4, CV_64FC1);
+    switch(method) {
+        case RECTIFICATION_LINEAR:
+            return doRectificationLinear(img1, img2, rectified1, rectified2, band.getRows(img1.rows), true);
+    }
     
+    return false;
+}
+
+bool Rectification::doRectificationLinear(const cv::Mat& img1, const cv::Mat& img2, cv::Mat& rectified1, cv::Mat& rectified2,
+                                          const cv::Range & rows, const bool & keepAllRows)
+{
+    prepareMaps(img1.size());
+    
+    cv::Range range(0, img1.rows);
+    if (rows != cv::Range::all())
+        range = cv::Range(max(0, rows.start), min(img1.rows, rows.end));
+    if (range.size() <= 0)
+        return false;
+    
+    remapRows(img1, rectified1, m_maps[0], range, keepAllRows);
+    remapRows(img2, rectified2, m_maps[1], range, keepAllRows);
+    
+    rectified1 = rectified1(cv::Rect(m_roi[0].x, 0, m_roi[0].width, rectified1.rows));
+    rectified2 = rectified2(cv::Rect(m_roi[1].x, 0, m_roi[1].width, rectified2.rows));
+    
+    return true;
+}
+
+void Rectification::prepareMaps(const cv::Size& imgSize)
+{
     assert((! m_intrinsicCoeffs[0].empty()) && (! m_intrinsicCoeffs[1].empty()) &&
-            (! m_distCoeffs[0].empty()) && (! m_distCoeffs[1].empty()) &&
             (! m_R.empty()) && (! m_t.empty()));
     
+    if ((! m_mapsValid) || (m_mapsSize != imgSize))
+        updateMaps(imgSize);
+}
+
+bool Rectification::rectifyImage(const cv::Mat& img, const uint32_t& cameraId, cv::Mat& rectified) const
+{
+    if ((! m_mapsValid) || (m_mapsSize != img.size()) || (cameraId > 1))
+        return false;
+    
+    remapRows(img, rectified, m_maps[cameraId], cv::Range(0, img.rows), false);
+    
+    return true;
+}
+
+void Rectification::remapRows(const cv::Mat& img, cv::Mat& rectified, const cv::Mat& map, const cv::Range& rows,
+                              const bool & keepAllRows)
+{
+    // Rows of the output image, the band is at its place when all the rows are kept
+    const int32_t outputOffset = keepAllRows? 0 : rows.start;
+    if (keepAllRows) {
+        rectified.create(map.rows, map.cols, img.type());
+        ProcessingBand(rows.start, rows.end).clearOutside(rectified);
+    } else {
+        rectified.create(rows.size(), map.cols, img.type());
+    }
+    
+    // Each thread remaps a block of rows, straight into its part of the output
+    const int32_t numBlocks = min(omp_get_max_threads(), rows.size());
+    #pragma omp parallel
+    {
+        STIXEL_TRACE_OMP_REGION("Rectification::remapRows");
+
+        #pragma omp for schedule(static)
+        for (int32_t block = 0; block < numBlocks; block++) {
+            const int32_t first = rows.start + rows.size() * block / numBlocks;
+            const int32_t last = rows.start + rows.size() * (block + 1) / numBlocks;
+        
+            cv::Mat rectifiedRows = rectified.rowRange(first - outputOffset, last - outputOffset);
+            cv::remap(img, rectifiedRows, map.rowRange(first, last), cv::Mat(), cv::INTER_NEAREST);
+        }
+    }
+}
+
+void Rectification::updateMaps(const cv::Size& imgSize)
+{
+    // Distortion is not used for the linear rectification
+    m_distCoeffs[0] = cv::Mat::zeros(1, 4, CV_64FC1);
+    m_distCoeffs[1] = cv::Mat::zeros(1, 4, CV_64FC1);
+    
+    stringstream cacheFile;
+    if (! m_mapCacheDir.empty()) {
+        cacheFile << m_mapCacheDir << "/rectification_" << hex << setw(16) << setfill('0') 
+                  << getCalibrationHash(imgSize) << ".bin";
+        if (loadMaps(cacheFile.str(), imgSize)) {
+            m_mapsSize = imgSize;
+            m_mapsValid = true;
+            return;
+        }
+    }
+    
     cv::Mat R1, R2, P1, P2, Q;
-    cv::Rect roi1, roi2;
-    cv::stereoRectify(m_intrinsicCoeffs[0], m_distCoeffs[0], m_intrinsicCoeffs[1], m_distCoeffs[1], img1.size(), 
-                    m_R, m_t, R1, R2, P1, P2, Q, CV_CALIB_ZERO_DISPARITY, -1, cv::Size(), &roi1, & roi2);
+    cv::stereoRectify(m_intrinsicCoeffs[0], m_distCoeffs[0], m_intrinsicCoeffs[1], m_distCoeffs[1], imgSize, 
+                    m_R, m_t, R1, R2, P1, P2, Q, CV_CALIB_ZERO_DISPARITY, -1, cv::Size(), &m_roi[0], &m_roi[1]);
     
     cv::Mat mapX1, mapY1, mapX2, mapY2;
-    cv::initUndistortRectifyMap(m_intrinsicCoeffs[0], m_distCoeffs[0], R1, P1, img1.size(), 
+    cv::initUndistortRectifyMap(m_intrinsicCoeffs[0], m_distCoeffs[0], R1, P1, imgSize, 
                                 CV_32FC1, mapX1,  mapY1);
     
 //     R2 = cv::Mat(3, 4, CV_64FC1);
@@ -132,23 +255,96 @@ bool Rectification::doRectificationLinear(const cv::Mat& img1, const cv::Mat& im
 //         for (uint32_t j = 0; j < 3; j++)
 //             R2.at<double_t>(i, j) = m_R.at<double_t>(i, j);
 //     }
-    cv::initUndistortRectifyMap(m_intrinsicCoeffs[1], m_distCoeffs[1], R2, P2, img1.size(), 
+    cv::initUndistortRectifyMap(m_intrinsicCoeffs[1], m_distCoeffs[1], R2, P2, imgSize, 
                                 CV_32FC1, mapX2,  mapY2);
 //     mapX2 -= m_t.at<double>(0);
     
-    cv::remap(img1, rectified1, mapX1, mapY1, cv::INTER_NEAREST);
-    cv::remap(img2, rectified2, mapX2, mapY2, cv::INTER_NEAREST);
+    // Rounded as remap does with float maps and INTER_NEAREST, so the result is the same
+    cv::Mat unused;
+    cv::convertMaps(mapX1, mapY1, m_maps[0], unused, CV_16SC2, true);
+    cv::convertMaps(mapX2, mapY2, m_maps[1], unused, CV_16SC2, true);
     
-    cout << "roi1 " << roi1 << endl;
-    cout << "roi2 " << roi2 << endl;
-    roi1.width = roi2.width = min(roi1.width, roi2.width);
-    roi1.height = roi2.height = img1.rows; //min(roi1.height, roi2.height);
-    roi1.y = roi2.y = 0;
+    m_roi[0].width = m_roi[1].width = min(m_roi[0].width, m_roi[1].width);
+    m_roi[0].height = m_roi[1].height = imgSize.height; //min(roi1.height, roi2.height);
+    m_roi[0].y = m_roi[1].y = 0;
     
-    rectified1 = rectified1(roi1);
-    rectified2 = rectified2(roi2);
+    m_mapsSize = imgSize;
+    m_mapsValid = true;
     
-    return true;
+    if (! m_mapCacheDir.empty())
+        saveMaps(cacheFile.str());
+}
+
+uint64_t Rectification::getCalibrationHash(const cv::Size& imgSize) const
+{
+    const cv::Mat * params[6] = { &m_intrinsicCoeffs[0], &m_intrinsicCoeffs[1], 
+                                  &m_distCoeffs[0], &m_distCoeffs[1], &m_R, &m_t };
+    
+    uint64_t hash = HASH_OFFSET_BASIS;
+    hashBytes(hash, &imgSize.width, sizeof(int32_t));
+    hashBytes(hash, &imgSize.height, sizeof(int32_t));
+    for (uint32_t i = 0; i < 6; i++) {
+        cv::Mat values;
+        params[i]->convertTo(values, CV_64F);
+        for (int32_t y = 0; y < values.rows; y++)
+            hashBytes(hash, values.ptr(y), values.cols * values.elemSize());
+    }
+    
+    return hash;
+}
+
+bool Rectification::loadMaps(const string& fileName, const cv::Size& imgSize)
+{
+    FILE * file = fopen(fileName.c_str(), "rb");
+    if (file == NULL)
+        return false;
+    
+    t_maps_header header;
+    bool valid = (fread(&header, sizeof(header), 1, file) == 1) && 
+                 (memcmp(header.magic, MAPS_MAGIC, sizeof(MAPS_MAGIC)) == 0) &&
+                 (header.rows == imgSize.height) && (header.cols == imgSize.width);
+    for (uint32_t i = 0; valid && (i < 2); i++) {
+        m_maps[i].create(imgSize, CV_16SC2);
+        valid = (fread(m_maps[i].data, m_maps[i].elemSize(), m_maps[i].total(), file) == m_maps[i].total());
+        m_roi[i] = cv::Rect(header.roi[i][0], header.roi[i][1], header.roi[i][2], header.roi[i][3]);
+    }
+    fclose(file);
+    
+    return valid;
+}
+
+void Rectification::saveMaps(const string& fileName) const
+{
+    boost::filesystem::create_directories(m_mapCacheDir);
+    
+    // Written aside and renamed, so other runs never read a partial file
+    const string tmpFileName = fileName + ".tmp";
+    FILE * file = fopen(tmpFileName.c_str(), "wb");
+    if (file == NULL) {
+        cerr << "Could not write the rectification maps to " << fileName << endl;
+        return;
+    }
+    
+    t_maps_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAPS_MAGIC, sizeof(MAPS_MAGIC));
+    header.rows = m_mapsSize.height;
+    header.cols = m_mapsSize.width;
+    for (uint32_t i = 0; i < 2; i++) {
+        header.roi[i][0] = m_roi[i].x;
+        header.roi[i][1] = m_roi[i].y;
+        header.roi[i][2] = m_roi[i].width;
+        header.roi[i][3] = m_roi[i].height;
+    }
+    bool written = (fwrite(&header, sizeof(header), 1, file) == 1);
+    for (uint32_t i = 0; written && (i < 2); i++)
+        written = (fwrite(m_maps[i].data, m_maps[i].elemSize(), m_maps[i].total(), file) == m_maps[i].total());
+    fclose(file);
+    
+    if (written)
+        rename(tmpFileName.c_str(), fileName.c_str());
+    else
+        remove(tmpFileName.c_str());
 }
 
 uint32_t Rectification::getDisparityOffsetX()
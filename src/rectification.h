@@ -21,9 +21,18 @@
 #include<string.h>
 #include<opencv2/opencv.hpp>
 
+#include "processingband.h"
+
 using namespace std;
 
 namespace stixel_world {
+    
+///
+/// Linear rectification of a stereo pair. The rectification maps only depend on the calibration and
+/// the image size, so they are computed the first time they are needed after any of them changes,
+/// and kept as fixed point maps (CV_16SC2). With a cache folder, maps are also stored there, named
+/// after a hash of the calibration, so the next runs with the same calibration just read them.
+///
 class Rectification
 {
 
@@ -39,9 +48,22 @@ public:
     void setDistCoeffs(const cv::Mat & distCoeffs, const uint32_t & cameraId);
     void setRotationMatrix(const cv::Mat & R);
     void setTranslationMatrix(const cv::Mat & t);
+    /// Folder for the maps of each calibration, empty to always compute them
+    void setMapCacheDir(const string & mapCacheDir) { m_mapCacheDir = mapCacheDir; }
     
+    /// With a row range, only those rows of the rectified images are computed (and returned)
     bool doRectification(const cv::Mat & img1, const cv::Mat & img2, 
-                         cv::Mat & rectified1, cv::Mat & rectified2, const uint32_t method = RECTIFICATION_LINEAR);
+                         cv::Mat & rectified1, cv::Mat & rectified2, const uint32_t method = RECTIFICATION_LINEAR,
+                         const cv::Range & rows = cv::Range::all());
+    /// Only the rows in the band are computed, but the rectified images keep all the rows (black outside the band)
+    bool doRectification(const cv::Mat & img1, const cv::Mat & img2, 
+                         cv::Mat & rectified1, cv::Mat & rectified2, const ProcessingBand & band, 
+                         const uint32_t method = RECTIFICATION_LINEAR);
+    /// Computes (or reads from the cache) the maps for that image size, if they are not there yet
+    void prepareMaps(const cv::Size & imgSize);
+    /// Rectifies the image of a single camera with the maps of prepareMaps, keeping the whole image
+    /// (it is not cropped to the common roi). Only reads the maps, so both cameras can run at once
+    bool rectifyImage(const cv::Mat & img, const uint32_t & cameraId, cv::Mat & rectified) const;
     
     cv::Mat getIntrinsicCoeffs(const uint32_t & cameraId) { return m_intrinsicCoeffs[cameraId]; }
     cv::Mat getDistCoeffs(const uint32_t & cameraId) { return m_distCoeffs[cameraId]; }
@@ -56,12 +78,26 @@ public:
     
 private:
     bool doRectificationLinear(const cv::Mat & img1, const cv::Mat & img2, 
-                               cv::Mat & rectified1, cv::Mat & rectified2);
+                               cv::Mat & rectified1, cv::Mat & rectified2, const cv::Range & rows,
+                               const bool & keepAllRows = false);
+    void updateMaps(const cv::Size & imgSize);
+    uint64_t getCalibrationHash(const cv::Size & imgSize) const;
+    bool loadMaps(const string & fileName, const cv::Size & imgSize);
+    void saveMaps(const string & fileName) const;
+    static void remapRows(const cv::Mat & img, cv::Mat & rectified, const cv::Mat & map, const cv::Range & rows,
+                          const bool & keepAllRows);
     
     cv::Mat m_intrinsicCoeffs[2];
     cv::Mat m_distCoeffs[2];
     cv::Mat m_R;
     cv::Mat m_t;
+    
+    string m_mapCacheDir;
+    bool m_mapsValid;
+    cv::Size m_mapsSize;
+    /// Fixed point maps for INTER_NEAREST, so there is no interpolation table
+    cv::Mat m_maps[2];
+    cv::Rect m_roi[2];
 };
 }
 #endif // RECTIFICATION_H
@@ -0,0 +1,250 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include "robustfundamentalmatrix.h"
+#include "sampsonerrors.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <omp.h>
+
+// Points in a minimal sample (7 point algorithm)
+#define SAMPLE_SIZE 7
+// Iterations until the PROSAC sampling set includes every correspondence
+#define PROSAC_GROWTH_ITERATIONS 200
+// Refits of a new best model in the local optimization
+#define LO_ITERATIONS 4
+
+using namespace std;
+
+namespace stixel_world {
+
+const uint32_t RobustFundamentalMatrix::SEED_LEFT;
+const uint32_t RobustFundamentalMatrix::SEED_RIGHT;
+
+/// Correspondences sorted by their error to the seed
+struct ErrorOrder {
+    const float * errors;
+    bool operator()(const uint32_t & idx1, const uint32_t & idx2) const { return errors[idx1] < errors[idx2]; }
+};
+
+/// Iterations needed to draw a sample without outliers with the given confidence
+static inline uint32_t getRequiredIterations(const double & inlierRatio, const double & confidence, 
+                                             const uint32_t & maxIterations)
+{
+    const double noOutliersProbability = 1.0 - pow(inlierRatio, SAMPLE_SIZE);
+    if (noOutliersProbability <= 0.0)
+        return 1;
+    if (noOutliersProbability >= 1.0)
+        return maxIterations;
+
+    return (uint32_t)std::min((double)maxIterations, ceil(log(1.0 - confidence) / log(noOutliersProbability)));
+}
+
+static inline void getCoefficients(const cv::Mat & F, float coefficients[9])
+{
+    for (uint32_t i = 0; i < 9; i++)
+        coefficients[i] = F.at<double>(i / 3, i % 3);
+}
+
+RobustFundamentalMatrix::RobustFundamentalMatrix(const double& inlierThreshold, const double& confidence,
+                                                 const uint32_t& maxIterations, const double& timeBudget) :
+                                                 m_inlierThreshold(inlierThreshold), m_confidence(confidence),
+                                                 m_maxIterations(maxIterations), m_timeBudget(timeBudget)
+{
+    if ((confidence <= 0.0) || (confidence >= 1.0))
+        throw std::invalid_argument("The confidence of the robust F estimation must be in (0, 1)");
+
+    m_lastIterations = 0;
+    m_lastInliers = 0;
+}
+
+void RobustFundamentalMatrix::reset()
+{
+    m_seeds[SEED_LEFT].release();
+    m_seeds[SEED_RIGHT].release();
+}
+
+void RobustFundamentalMatrix::computeErrors(const float F[9])
+{
+    computeSampsonErrors(F, &m_x1[0], &m_y1[0], &m_x2[0], &m_y2[0], m_x1.size(), &m_errors[0]);
+}
+
+uint32_t RobustFundamentalMatrix::countInliers() const
+{
+    const float threshold = m_inlierThreshold * m_inlierThreshold;
+    const uint32_t numPoints = m_errors.size();
+    const float * errors = &m_errors[0];
+
+    uint32_t numInliers = 0;
+    for (uint32_t i = 0; i < numPoints; i++)
+        numInliers += (errors[i] < threshold)? 1 : 0;
+
+    return numInliers;
+}
+
+uint32_t RobustFundamentalMatrix::optimizeLocally(cv::Mat& F, uint32_t numInliers)
+{
+    const float threshold = m_inlierThreshold * m_inlierThreshold;
+    vector<cv::Point2f> inliers1, inliers2;
+    inliers1.reserve(m_errors.size());
+    inliers2.reserve(m_errors.size());
+
+    // m_errors are the errors to F on entry
+    for (uint32_t iteration = 0; iteration < LO_ITERATIONS; iteration++) {
+        inliers1.clear();
+        inliers2.clear();
+        for (uint32_t i = 0; i < m_errors.size(); i++) {
+            if (m_errors[i] < threshold) {
+                inliers1.push_back(cv::Point2f(m_x1[i], m_y1[i]));
+                inliers2.push_back(cv::Point2f(m_x2[i], m_y2[i]));
+            }
+        }
+        if (inliers1.size() < 8)
+            break;
+
+        const cv::Mat refined = cv::findFundamentalMat(inliers1, inliers2, CV_FM_8POINT);
+        if (refined.rows != 3)
+            break;
+
+        float coefficients[9];
+        getCoefficients(refined, coefficients);
+        computeErrors(coefficients);
+        const uint32_t refinedInliers = countInliers();
+        if (refinedInliers <= numInliers)
+            break;
+
+        refined.copyTo(F);
+        numInliers = refinedInliers;
+    }
+
+    return numInliers;
+}
+
+bool RobustFundamentalMatrix::estimate(const vector< cv::Point2f >& points1, const vector< cv::Point2f >& points2,
+                                       const uint32_t& seed, cv::Mat& F)
+{
+    if (points1.size() != points2.size())
+        throw std::invalid_argument("The robust F estimation needs the same number of points in both images");
+    if (seed > SEED_RIGHT)
+        throw std::invalid_argument("Unknown seed for the robust F estimation");
+
+    m_lastIterations = 0;
+    m_lastInliers = 0;
+
+    const uint32_t numPoints = points1.size();
+    if (numPoints < 8)
+        return false;
+
+    const double startTime = omp_get_wtime();
+
+    m_x1.resize(numPoints);
+    m_y1.resize(numPoints);
+    m_x2.resize(numPoints);
+    m_y2.resize(numPoints);
+    m_errors.resize(numPoints);
+    for (uint32_t i = 0; i < numPoints; i++) {
+        m_x1[i] = points1[i].x;
+        m_y1[i] = points1[i].y;
+        m_x2[i] = points2[i].x;
+        m_y2[i] = points2[i].y;
+    }
+
+    cv::Mat bestF;
+    uint32_t bestInliers = 0;
+    float coefficients[9];
+
+    // The previous F is the first hypothesis, and gives the order for the progressive sampling
+    vector<uint32_t> order(numPoints);
+    for (uint32_t i = 0; i < numPoints; i++)
+        order[i] = i;
+    const bool progressive = ! m_seeds[seed].empty();
+    if (progressive) {
+        getCoefficients(m_seeds[seed], coefficients);
+        computeErrors(coefficients);
+
+        ErrorOrder errorOrder;
+        errorOrder.errors = &m_errors[0];
+        std::stable_sort(order.begin(), order.end(), errorOrder);
+
+        const uint32_t seedInliers = countInliers();
+        if (seedInliers >= 8) {
+            bestF = m_seeds[seed].clone();
+            bestInliers = optimizeLocally(bestF, seedInliers);
+        }
+    }
+    uint32_t requiredIterations = getRequiredIterations((double)bestInliers / numPoints, m_confidence, m_maxIterations);
+
+    // Fixed RNG seed, so the results do not change between runs (unless the time budget stops the iterations)
+    cv::RNG rng(numPoints);
+    vector<cv::Point2f> sample1(SAMPLE_SIZE), sample2(SAMPLE_SIZE);
+    uint32_t iteration = 0;
+    for (; iteration < requiredIterations; iteration++) {
+        if ((m_timeBudget > 0.0) && (omp_get_wtime() - startTime > m_timeBudget))
+            break;
+
+        const uint32_t setSize = progressive?
+                std::min(numPoints, SAMPLE_SIZE + iteration * (numPoints - SAMPLE_SIZE) / PROSAC_GROWTH_ITERATIONS) :
+                numPoints;
+
+        uint32_t sample[SAMPLE_SIZE];
+        for (uint32_t i = 0; i < SAMPLE_SIZE; i++) {
+            bool repeated;
+            do {
+                sample[i] = rng.uniform(0, (int)setSize);
+                repeated = false;
+                for (uint32_t j = 0; j < i; j++)
+                    repeated = repeated || (sample[j] == sample[i]);
+            } while (repeated);
+
+            sample1[i] = points1[order[sample[i]]];
+            sample2[i] = points2[order[sample[i]]];
+        }
+
+        // Up to 3 solutions, one below the other
+        const cv::Mat solutions = cv::findFundamentalMat(sample1, sample2, CV_FM_7POINT);
+        for (int32_t row = 0; row + 3 <= solutions.rows; row += 3) {
+            const cv::Mat solution = solutions.rowRange(row, row + 3);
+            getCoefficients(solution, coefficients);
+            computeErrors(coefficients);
+            uint32_t numInliers = countInliers();
+            if (numInliers <= bestInliers)
+                continue;
+
+            cv::Mat candidate = solution.clone();
+            numInliers = optimizeLocally(candidate, numInliers);
+            bestF = candidate;
+            bestInliers = numInliers;
+            requiredIterations = getRequiredIterations((double)bestInliers / numPoints, m_confidence, m_maxIterations);
+        }
+    }
+    m_lastIterations = iteration;
+
+    if (bestInliers < 8) {
+        m_seeds[seed].release();
+        return false;
+    }
+
+    bestF.copyTo(F);
+    bestF.copyTo(m_seeds[seed]);
+    m_lastInliers = bestInliers;
+
+    return true;
+}
+
+}
@@ -0,0 +1,82 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#ifndef ROBUSTFUNDAMENTALMATRIX_H
+#define ROBUSTFUNDAMENTALMATRIX_H
+
+#include <stdint.h>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+namespace stixel_world {
+
+///
+/// Robust estimation of F (points2^T F points1 = 0, as cv::findFundamentalMat) that replaces LMedS
+/// in findF. It is a RANSAC on 7 point samples, scored with the Sampson error, with:
+///  - a local optimization (LO-RANSAC): each new best model is refitted with the 8 point algorithm
+///    on its inliers, a few times while the number of inliers grows.
+///  - the F of the previous frame (one per seed, FL and FR) tried as the first hypothesis, and used to
+///    sort the correspondences by their error, so the samples are drawn first from the best ones
+///    and then from a growing set (PROSAC).
+///  - an adaptive number of iterations for the given confidence, up to maxIterations, and an optional
+///    time budget. The result only depends on the correspondences and the seed without a time budget.
+///
+class RobustFundamentalMatrix
+{
+public:
+    static const uint32_t SEED_LEFT = 0;
+    static const uint32_t SEED_RIGHT = 1;
+
+    /// inlierThreshold in pixels (Sampson distance), timeBudget in seconds (0 for no limit)
+    RobustFundamentalMatrix(const double & inlierThreshold = 1.0, const double & confidence = 0.99,
+                            const uint32_t & maxIterations = 1000, const double & timeBudget = 0.0);
+
+    /// Returns false if there is no F with at least 8 inliers. F is kept as the seed for the next call
+    bool estimate(const std::vector<cv::Point2f> & points1, const std::vector<cv::Point2f> & points2,
+                  const uint32_t & seed, cv::Mat & F);
+
+    /// The next calls start without seeds
+    void reset();
+
+    uint32_t getLastIterations() const { return m_lastIterations; }
+    uint32_t getLastInliers() const { return m_lastInliers; }
+private:
+    /// Squared Sampson distance of every correspondence to F (row major)
+    void computeErrors(const float F[9]);
+    uint32_t countInliers() const;
+    /// 8 point fit on the inliers of F, as long as the number of inliers grows
+    uint32_t optimizeLocally(cv::Mat & F, uint32_t numInliers);
+
+    double m_inlierThreshold;
+    double m_confidence;
+    uint32_t m_maxIterations;
+    double m_timeBudget;
+
+    cv::Mat m_seeds[2];
+
+    // Correspondences as structure of arrays, for the vectorized Sampson errors
+    std::vector<float> m_x1, m_y1, m_x2, m_y2;
+    std::vector<float> m_errors;
+
+    uint32_t m_lastIterations;
+    uint32_t m_lastInliers;
+};
+
+}
+
+#endif // ROBUSTFUNDAMENTALMATRIX_H
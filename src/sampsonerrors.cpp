@@ -0,0 +1,108 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include "sampsonerrors.h"
+
+#if defined(__SSE__) || defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+// Keeps the denominator away from 0 for points on the epipoles
+#define SAMPSON_EPSILON 1e-12f
+
+namespace stixel_world {
+
+static inline float getSampsonError(const float F[9], const float & x1, const float & y1, 
+                                    const float & x2, const float & y2)
+{
+    // Epipolar lines F x1 and F^T x2
+    const float l1 = F[0] * x1 + F[1] * y1 + F[2];
+    const float l2 = F[3] * x1 + F[4] * y1 + F[5];
+    const float l3 = F[6] * x1 + F[7] * y1 + F[8];
+    const float m1 = F[0] * x2 + F[3] * y2 + F[6];
+    const float m2 = F[1] * x2 + F[4] * y2 + F[7];
+
+    const float e = x2 * l1 + y2 * l2 + l3;
+    return e * e / (l1 * l1 + l2 * l2 + m1 * m1 + m2 * m2 + SAMPSON_EPSILON);
+}
+
+/// 8 (AVX) or 4 (SSE) correspondences at once, with the coefficients of F broadcast once for all of them.
+/// The division is exact (no reciprocal approximation), so the inliers are the same as with the scalar code
+void computeSampsonErrors(const float F[9], const float * x1, const float * y1, const float * x2, const float * y2,
+                          const uint32_t & numPoints, float * errors)
+{
+    uint32_t i = 0;
+#if defined(__AVX__)
+    {
+        __m256 f[9];
+        for (uint32_t k = 0; k < 9; k++)
+            f[k] = _mm256_set1_ps(F[k]);
+        const __m256 epsilon = _mm256_set1_ps(SAMPSON_EPSILON);
+
+        for (; i + 8 <= numPoints; i += 8) {
+            const __m256 px1 = _mm256_loadu_ps(x1 + i);
+            const __m256 py1 = _mm256_loadu_ps(y1 + i);
+            const __m256 px2 = _mm256_loadu_ps(x2 + i);
+            const __m256 py2 = _mm256_loadu_ps(y2 + i);
+
+            const __m256 l1 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(f[0], px1), _mm256_mul_ps(f[1], py1)), f[2]);
+            const __m256 l2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(f[3], px1), _mm256_mul_ps(f[4], py1)), f[5]);
+            const __m256 l3 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(f[6], px1), _mm256_mul_ps(f[7], py1)), f[8]);
+            const __m256 m1 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(f[0], px2), _mm256_mul_ps(f[3], py2)), f[6]);
+            const __m256 m2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(f[1], px2), _mm256_mul_ps(f[4], py2)), f[7]);
+
+            const __m256 e = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px2, l1), _mm256_mul_ps(py2, l2)), l3);
+            __m256 norm = _mm256_add_ps(_mm256_mul_ps(l1, l1), _mm256_mul_ps(l2, l2));
+            norm = _mm256_add_ps(norm, _mm256_add_ps(_mm256_mul_ps(m1, m1), _mm256_mul_ps(m2, m2)));
+            norm = _mm256_add_ps(norm, epsilon);
+            _mm256_storeu_ps(errors + i, _mm256_div_ps(_mm256_mul_ps(e, e), norm));
+        }
+    }
+#endif
+#if defined(__SSE__)
+    {
+        __m128 f[9];
+        for (uint32_t k = 0; k < 9; k++)
+            f[k] = _mm_set1_ps(F[k]);
+        const __m128 epsilon = _mm_set1_ps(SAMPSON_EPSILON);
+
+        for (; i + 4 <= numPoints; i += 4) {
+            const __m128 px1 = _mm_loadu_ps(x1 + i);
+            const __m128 py1 = _mm_loadu_ps(y1 + i);
+            const __m128 px2 = _mm_loadu_ps(x2 + i);
+            const __m128 py2 = _mm_loadu_ps(y2 + i);
+
+            const __m128 l1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(f[0], px1), _mm_mul_ps(f[1], py1)), f[2]);
+            const __m128 l2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(f[3], px1), _mm_mul_ps(f[4], py1)), f[5]);
+            const __m128 l3 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(f[6], px1), _mm_mul_ps(f[7], py1)), f[8]);
+            const __m128 m1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(f[0], px2), _mm_mul_ps(f[3], py2)), f[6]);
+            const __m128 m2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(f[1], px2), _mm_mul_ps(f[4], py2)), f[7]);
+
+            const __m128 e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px2, l1), _mm_mul_ps(py2, l2)), l3);
+            __m128 norm = _mm_add_ps(_mm_mul_ps(l1, l1), _mm_mul_ps(l2, l2));
+            norm = _mm_add_ps(norm, _mm_add_ps(_mm_mul_ps(m1, m1), _mm_mul_ps(m2, m2)));
+            norm = _mm_add_ps(norm, epsilon);
+            _mm_storeu_ps(errors + i, _mm_div_ps(_mm_mul_ps(e, e), norm));
+        }
+    }
+#endif
+
+    for (; i < numPoints; i++)
+        errors[i] = getSampsonError(F, x1[i], y1[i], x2[i], y2[i]);
+}
+
+}
@@ -0,0 +1,32 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#ifndef SAMPSONERRORS_H
+#define SAMPSONERRORS_H
+
+#include <stdint.h>
+
+namespace stixel_world {
+
+/// Squared Sampson distance of the correspondences (x1[i], y1[i]) - (x2[i], y2[i]) to F (row major, 
+/// x2^T F x1 = 0), for RobustFundamentalMatrix. Without OpenCV, so it can be checked on its own
+void computeSampsonErrors(const float F[9], const float * x1, const float * y1, const float * x2, const float * y2,
+                          const uint32_t & numPoints, float * errors);
+
+}
+
+#endif // SAMPSONERRORS_H
@@ -0,0 +1,190 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include "stagetimings.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include <boost/thread/mutex.hpp>
+
+using namespace std;
+
+namespace stixel_world {
+
+const uint32_t StageTimings::MAX_STAGES;
+const uint32_t StageTimings::LINEAR_BUCKETS;
+const uint32_t StageTimings::SUB_BUCKETS;
+const uint32_t StageTimings::NUM_BUCKETS;
+
+// Registration is the only place where locks are taken: once per call site and once per thread
+static boost::mutex s_registryMutex;
+static vector<string> s_stageNames;
+static vector<void *> s_threads;
+
+static __thread void * tp_threadTimings = NULL;
+
+bool StageTimings::enabled()
+{
+#ifdef STIXEL_WORLD_WITH_TIMING
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint32_t StageTimings::registerStage(const string& name)
+{
+    boost::mutex::scoped_lock lock(s_registryMutex);
+
+    vector<string>::iterator it = std::find(s_stageNames.begin(), s_stageNames.end(), name);
+    if (it != s_stageNames.end())
+        return it - s_stageNames.begin();
+
+    if (s_stageNames.size() == MAX_STAGES)
+        throw std::runtime_error("Too many timed stages, increase StageTimings::MAX_STAGES");
+
+    s_stageNames.push_back(name);
+    return s_stageNames.size() - 1;
+}
+
+StageTimings::t_thread_timings * StageTimings::registerThread()
+{
+    t_thread_timings * timings = new t_thread_timings;
+    memset(timings, 0, sizeof(t_thread_timings));
+
+    // Never released: other threads can still read it after this thread finished
+    boost::mutex::scoped_lock lock(s_registryMutex);
+    s_threads.push_back(timings);
+
+    return timings;
+}
+
+inline uint32_t StageTimings::bucketIndex(const uint64_t& microseconds)
+{
+    if (microseconds < LINEAR_BUCKETS)
+        return microseconds;
+
+    // Longer times (more than an hour) are stored in the last bucket
+    const uint32_t clamped = std::min<uint64_t>(microseconds, 0xFFFFFFFFu);
+    const uint32_t exponent = 31 - __builtin_clz(clamped);
+    const uint32_t subBucket = (clamped >> (exponent - 3)) & (SUB_BUCKETS - 1);
+
+    return LINEAR_BUCKETS + (exponent - 4) * SUB_BUCKETS + subBucket;
+}
+
+double StageTimings::bucketValue(const uint32_t& bucket)
+{
+    if (bucket < LINEAR_BUCKETS)
+        return bucket;
+
+    const uint32_t exponent = (bucket - LINEAR_BUCKETS) / SUB_BUCKETS + 4;
+    const uint32_t subBucket = (bucket - LINEAR_BUCKETS) % SUB_BUCKETS;
+    const double lower = (double)((SUB_BUCKETS + subBucket) << (exponent - 3));
+
+    return lower + (double)(1ULL << (exponent - 3)) / 2.0;
+}
+
+void StageTimings::record(const uint32_t& stageId, const double& elapsed)
+{
+    t_thread_timings * timings = (t_thread_timings *)tp_threadTimings;
+    if (timings == NULL) {
+        timings = registerThread();
+        tp_threadTimings = timings;
+    }
+
+    // Only this thread writes on its own histograms. Readers may see a slightly stale snapshot.
+    const uint64_t microseconds = (uint64_t)(std::max(0.0, elapsed) * 1e6);
+    timings->buckets[stageId][bucketIndex(microseconds)]++;
+    timings->count[stageId]++;
+    timings->totalMicroseconds[stageId] += microseconds;
+    timings->maxMicroseconds[stageId] = std::max(timings->maxMicroseconds[stageId], microseconds);
+}
+
+void StageTimings::getStatistics(vector<t_stage_statistics>& statistics)
+{
+    statistics.clear();
+
+    boost::mutex::scoped_lock lock(s_registryMutex);
+
+    vector<uint64_t> buckets(NUM_BUCKETS);
+    for (uint32_t stage = 0; stage < s_stageNames.size(); stage++) {
+        t_stage_statistics stats;
+        stats.name = s_stageNames[stage];
+        stats.count = 0;
+        stats.mean = stats.p50 = stats.p95 = stats.p99 = stats.max = 0.0;
+
+        std::fill(buckets.begin(), buckets.end(), 0);
+        uint64_t total = 0, maximum = 0;
+        for (uint32_t t = 0; t < s_threads.size(); t++) {
+            const t_thread_timings * timings = (const t_thread_timings *)s_threads[t];
+            for (uint32_t b = 0; b < NUM_BUCKETS; b++)
+                buckets[b] += timings->buckets[stage][b];
+            stats.count += timings->count[stage];
+            total += timings->totalMicroseconds[stage];
+            maximum = std::max(maximum, timings->maxMicroseconds[stage]);
+        }
+
+        if (stats.count != 0) {
+            stats.mean = total * 1e-6 / stats.count;
+            stats.max = maximum * 1e-6;
+
+            const double percentiles[3] = { 0.50, 0.95, 0.99 };
+            double * values[3] = { &stats.p50, &stats.p95, &stats.p99 };
+            uint64_t accumulated = 0;
+            uint32_t currentPercentile = 0;
+            for (uint32_t b = 0; (b < NUM_BUCKETS) && (currentPercentile < 3); b++) {
+                accumulated += buckets[b];
+                while ((currentPercentile < 3) && (accumulated >= percentiles[currentPercentile] * stats.count)) {
+                    *(values[currentPercentile]) = std::min(bucketValue(b) * 1e-6, stats.max);
+                    currentPercentile++;
+                }
+            }
+        }
+
+        statistics.push_back(stats);
+    }
+}
+
+void StageTimings::writeCsv(const string& filename, const int32_t& frame)
+{
+    vector<t_stage_statistics> statistics;
+    getStatistics(statistics);
+
+    ifstream existing(filename.c_str());
+    const bool writeHeader = ! existing.good();
+    existing.close();
+
+    ofstream fout(filename.c_str(), ios::app);
+    if (! fout.good())
+        throw std::runtime_error("Could not open the timings file " + filename);
+
+    if (writeHeader)
+        fout << "frame,stage,count,mean_ms,p50_ms,p95_ms,p99_ms,max_ms" << endl;
+
+    for (uint32_t i = 0; i < statistics.size(); i++) {
+        const t_stage_statistics & stats = statistics[i];
+        fout << frame << "," << stats.name << "," << stats.count << ","
+             << stats.mean * 1e3 << "," << stats.p50 * 1e3 << "," << stats.p95 * 1e3 << ","
+             << stats.p99 * 1e3 << "," << stats.max * 1e3 << endl;
+    }
+}
+
+}
@@ -0,0 +1,132 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#ifndef STAGETIMINGS_H
+#define STAGETIMINGS_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <omp.h>
+
+#include "pipelinetracer.h"
+
+///
+/// Per stage timing instrumentation.
+///
+/// STIXEL_TIMED_SCOPE("name") measures the time until the end of the enclosing scope and
+/// records it in a histogram of the calling thread, without locks. Statistics of all the
+/// threads are merged on demand by StageTimings::getStatistics.
+///
+/// STIXEL_TIMER_START(timer, "name") / STIXEL_TIMER_STOP(timer) do the same for a part of a scope,
+/// and STIXEL_TIMING_RECORD("name", seconds) records a time measured elsewhere.
+///
+/// Without STIXEL_WORLD_WITH_TIMING no statistics are collected, and the macros only feed the
+/// pipeline trace when it is built in.
+///
+#define STIXEL_TIMING_CONCAT_IMPL(a, b) a##b
+#define STIXEL_TIMING_CONCAT(a, b) STIXEL_TIMING_CONCAT_IMPL(a, b)
+#ifdef STIXEL_WORLD_WITH_TIMING
+#define STIXEL_STAGE_TIMER_START_IMPL(timer, stageId, name) \
+    static const uint32_t stageId = stixel_world::StageTimings::registerStage(name); \
+    stixel_world::ScopedStageTimer timer(stageId)
+#define STIXEL_STAGE_TIMER_START(timer, name) STIXEL_STAGE_TIMER_START_IMPL(timer, STIXEL_TIMING_CONCAT(timer, _stageId), name)
+#define STIXEL_STAGE_TIMER_STOP(timer) timer.stop()
+#define STIXEL_TIMING_RECORD_IMPL(stageId, name, elapsed) { \
+    static const uint32_t stageId = stixel_world::StageTimings::registerStage(name); \
+    stixel_world::StageTimings::record(stageId, elapsed); }
+#define STIXEL_TIMING_RECORD(name, elapsed) STIXEL_TIMING_RECORD_IMPL(STIXEL_TIMING_CONCAT(stageId_, __LINE__), name, elapsed)
+#else
+#define STIXEL_STAGE_TIMER_START(timer, name)
+#define STIXEL_STAGE_TIMER_STOP(timer)
+#define STIXEL_TIMING_RECORD(name, elapsed)
+#endif
+
+// Timed stages are also spans of the pipeline trace (see pipelinetracer.h)
+#define STIXEL_TIMER_START(timer, name) \
+    STIXEL_STAGE_TIMER_START(timer, name); \
+    STIXEL_TRACE_SPAN_START(STIXEL_TIMING_CONCAT(timer, _traceSpan), name)
+#define STIXEL_TIMER_STOP(timer) \
+    STIXEL_STAGE_TIMER_STOP(timer); \
+    STIXEL_TRACE_SPAN_STOP(STIXEL_TIMING_CONCAT(timer, _traceSpan))
+#define STIXEL_TIMED_SCOPE(name) STIXEL_TIMER_START(STIXEL_TIMING_CONCAT(stageTimer_, __LINE__), name)
+
+namespace stixel_world {
+
+class StageTimings
+{
+public:
+    static const uint32_t MAX_STAGES = 64;
+    // Buckets 0..15 hold exact microseconds, then 8 buckets per power of two (error < 12.5%)
+    static const uint32_t LINEAR_BUCKETS = 16;
+    static const uint32_t SUB_BUCKETS = 8;
+    static const uint32_t NUM_BUCKETS = LINEAR_BUCKETS + (32 - 4) * SUB_BUCKETS;
+
+    typedef struct {
+        std::string name;
+        uint64_t count;
+        double mean;        // all the times are in seconds
+        double p50, p95, p99;
+        double max;
+    } t_stage_statistics;
+
+    /// Returns the id of the stage, registering it the first time the name is seen
+    static uint32_t registerStage(const std::string & name);
+
+    static void record(const uint32_t & stageId, const double & elapsed);
+
+    static void getStatistics(std::vector<t_stage_statistics> & statistics);
+
+    /// Appends the current statistics to a CSV file, tagged with the given frame
+    static void writeCsv(const std::string & filename, const int32_t & frame);
+
+    static bool enabled();
+private:
+    typedef struct {
+        uint64_t buckets[MAX_STAGES][NUM_BUCKETS];
+        uint64_t count[MAX_STAGES];
+        uint64_t totalMicroseconds[MAX_STAGES];
+        uint64_t maxMicroseconds[MAX_STAGES];
+    } t_thread_timings;
+
+    static t_thread_timings * registerThread();
+    static uint32_t bucketIndex(const uint64_t & microseconds);
+    static double bucketValue(const uint32_t & bucket);
+};
+
+class ScopedStageTimer
+{
+public:
+    explicit ScopedStageTimer(const uint32_t & stageId) : m_stageId(stageId), m_start(omp_get_wtime()), m_running(true) {}
+    ~ScopedStageTimer() { stop(); }
+    
+    void stop() {
+        if (m_running) {
+            StageTimings::record(m_stageId, omp_get_wtime() - m_start);
+            m_running = false;
+        }
+    }
+private:
+    uint32_t m_stageId;
+    double m_start;
+    bool m_running;
+};
+
+}
+
+#endif // STAGETIMINGS_H
@@ -0,0 +1,126 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include "stixelpointcloudpublisher.h"
+
+#include <sensor_msgs/PointField.h>
+
+#include "video_input/MetricCamera.hpp"
+
+namespace stixel_world_ros {
+
+const uint32_t StixelPointCloudPublisher::POINT_STEP;
+
+StixelPointCloudPublisher::StixelPointCloudPublisher(ros::NodeHandle& nh, const std::string& topic,
+                                                     const std::string& frameId, const uint32_t& maxPoints)
+{
+    m_publisher = nh.advertise<sensor_msgs::PointCloud2>(topic, 1);
+
+    const char * names[] = { "x", "y", "z", "rgb" };
+    m_cloud.fields.resize(4);
+    for (uint32_t i = 0; i < m_cloud.fields.size(); i++) {
+        m_cloud.fields[i].name = names[i];
+        m_cloud.fields[i].offset = i * sizeof(float);
+        m_cloud.fields[i].datatype = sensor_msgs::PointField::FLOAT32;
+        m_cloud.fields[i].count = 1;
+    }
+
+    m_cloud.header.frame_id = frameId;
+    m_cloud.height = 1;
+    m_cloud.width = 0;
+    m_cloud.is_bigendian = false;
+    m_cloud.point_step = POINT_STEP;
+    m_cloud.row_step = 0;
+    m_cloud.is_dense = true;
+    m_cloud.data.reserve(maxPoints * POINT_STEP);
+
+    m_numPoints = 0;
+}
+
+void StixelPointCloudPublisher::clear()
+{
+    m_numPoints = 0;
+}
+
+void StixelPointCloudPublisher::addStixel(const doppia::Stixel& stixel, const float& disparity,
+                                          const doppia::MetricStereoCamera& camera, const double& cameraHeight,
+                                          const cv::Mat& img)
+{
+    // Stixels without disparity would be at infinite depth
+    if ((stixel.bottom_y < stixel.top_y) || (disparity <= 0.0f))
+        return;
+
+    const double depth = camera.disparity_to_depth(disparity);
+
+    // At a fixed depth, the back projection is affine in y, so only both ends are projected
+    Eigen::Vector2f top2d, bottom2d;
+    top2d << stixel.x, stixel.top_y;
+    bottom2d << stixel.x, stixel.bottom_y;
+    const Eigen::Vector3f top3d = camera.get_left_camera().back_project_2d_point_to_3d(top2d, depth);
+    const Eigen::Vector3f bottom3d = camera.get_left_camera().back_project_2d_point_to_3d(bottom2d, depth);
+
+    addSegment(top3d, bottom3d, stixel.bottom_y - stixel.top_y + 1, cameraHeight, cv::Vec3b(),
+               img(cv::Range(stixel.top_y, stixel.bottom_y + 1), cv::Range(stixel.x, stixel.x + 1)));
+}
+
+void StixelPointCloudPublisher::addSegment(const Eigen::Vector3f& top3d, const Eigen::Vector3f& bottom3d,
+                                           const uint32_t& numPoints, const double& cameraHeight,
+                                           const cv::Vec3b& color, const cv::Mat& colors)
+{
+    if (numPoints == 0)
+        return;
+
+    const Eigen::Vector3f step = (numPoints > 1)? Eigen::Vector3f((bottom3d - top3d) / (numPoints - 1)) :
+                                                  Eigen::Vector3f::Zero();
+
+    // The buffer is only zero filled when it grows beyond the size of the last published cloud
+    if (m_cloud.data.size() < (m_numPoints + numPoints) * POINT_STEP)
+        m_cloud.data.resize((m_numPoints + numPoints) * POINT_STEP);
+    uint8_t * data = &m_cloud.data[m_numPoints * POINT_STEP];
+    for (uint32_t i = 0; i < numPoints; i++, data += POINT_STEP) {
+        const Eigen::Vector3f point3d = top3d + step * i;
+        const cv::Vec3b & pixel = colors.empty()? color : colors.at<cv::Vec3b>(i, 0);
+
+        // Same axes as the ones used with pcl::PointXYZRGB
+        float * coords = (float *)data;
+        coords[0] = point3d(0);
+        coords[1] = point3d(2);
+        coords[2] = cameraHeight - point3d(1);
+
+        // rgb is packed as in PCL: b, g, r, 0 in little endian
+        data[12] = pixel[0];
+        data[13] = pixel[1];
+        data[14] = pixel[2];
+        data[15] = 0;
+    }
+
+    m_numPoints += numPoints;
+}
+
+void StixelPointCloudPublisher::publish(const ros::Time& stamp)
+{
+    m_cloud.header.stamp = stamp;
+    m_cloud.width = m_numPoints;
+    m_cloud.row_step = m_numPoints * POINT_STEP;
+    // Shrinking keeps the capacity
+    m_cloud.data.resize(m_cloud.row_step);
+
+    // The message is serialized here, so the buffer can be reused right after
+    m_publisher.publish(m_cloud);
+}
+
+}
@@ -0,0 +1,72 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#ifndef STIXELPOINTCLOUDPUBLISHER_H
+#define STIXELPOINTCLOUDPUBLISHER_H
+
+#include <stdint.h>
+#include <string>
+
+#include <opencv2/opencv.hpp>
+#include <Eigen/Core>
+
+#include <ros/ros.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include "stereo_matching/stixels/Stixel.hpp"
+#include "video_input/MetricStereoCamera.hpp"
+
+namespace stixel_world_ros {
+
+///
+/// Publishes the pixels of the stixels as a sensor_msgs::PointCloud2, written directly into a
+/// message that is reused between frames (no pcl::PointCloud in between).
+///
+/// The layout is fixed: x, y, z and rgb as float32 (16 bytes per point), as pcl::PointXYZRGB.
+/// The buffer is allocated at construction for maxPoints points, and only grows if a frame has more.
+///
+class StixelPointCloudPublisher
+{
+public:
+    StixelPointCloudPublisher(ros::NodeHandle & nh, const std::string & topic, const std::string & frameId,
+                              const uint32_t & maxPoints);
+
+    /// Starts a new cloud
+    void clear();
+
+    /// Adds a point per pixel of the stixel, at the depth given by disparity, colored from img
+    void addStixel(const doppia::Stixel & stixel, const float & disparity, const doppia::MetricStereoCamera & camera,
+                   const double & cameraHeight, const cv::Mat & img);
+    /// Adds numPoints points evenly spaced from top3d to bottom3d (camera coordinates), with a single color
+    /// or, if colors is given, the colors of its numPoints rows
+    void addSegment(const Eigen::Vector3f & top3d, const Eigen::Vector3f & bottom3d, const uint32_t & numPoints,
+                    const double & cameraHeight, const cv::Vec3b & color, const cv::Mat & colors = cv::Mat());
+
+    void publish(const ros::Time & stamp);
+
+    uint32_t getNumPoints() const { return m_numPoints; }
+private:
+    static const uint32_t POINT_STEP = 16;
+
+    ros::Publisher m_publisher;
+    sensor_msgs::PointCloud2 m_cloud;
+    uint32_t m_numPoints;
+};
+
+}
+
+#endif // STIXELPOINTCLOUDPUBLISHER_H
@@ -21,6 +21,8 @@
 
 #include "utils.h"
 #include "fundamentalmatrixestimator.h"
+#include "visualizationsink.h"
+#include "stagetimings.h"
 
 #include <boost/filesystem.hpp>
 
@@ -85,7 +87,6 @@ StixelsApplication::StixelsApplication(const string& optionsFile)
         mp_stixel_motion_estimator = mp_stixels_tests[0];
     }
     
-    m_waitTime = 20;
     
     return;
 }
@@ -157,19 +158,8 @@ boost::program_options::variables_map StixelsApplication::parseOptionsFile(const
 
 void StixelsApplication::runStixelsApplication()
 {
-    cv::namedWindow("output");
-    cv::moveWindow("output", 1366, 0);
-    
-    
-    cv::namedWindow("polar");
-    if (mp_stixels_tests.size() == 0)
-        cv::moveWindow("polar", 2646, 0);
-    
-    cv::namedWindow("denseTrack");
-    cv::moveWindow("denseTrack", 1366, 480);
-    
-//     cv::namedWindow("polarTrack");
-//     cv::moveWindow("polarTrack", 1366, 0);
+    // Windows are handled by the viewer thread
+    VisualizationSink::attach();
     
     m_prevLeftRectified = doppia::AbstractVideoInput::input_image_t(mp_video_input->get_left_image().dimensions());
     m_prevRightRectified = doppia::AbstractVideoInput::input_image_t(mp_video_input->get_right_image().dimensions());
@@ -178,16 +168,19 @@ void StixelsApplication::runStixelsApplication()
     while (iterate()) {
         visualize();
         update();
-        cout << "Time for " << __FUNCTION__ << ": " << omp_get_wtime() - startWallTime << endl;
+        STIXEL_TIMING_RECORD("StixelsApplication::frame", omp_get_wtime() - startWallTime);
         startWallTime = omp_get_wtime();
-        cout << "********************************" << endl;
+        
+        if (VisualizationSink::isQuitRequested())
+            break;
     }
+    
+    VisualizationSink::detach();
 }
 
 void StixelsApplication::update()
 {
-
-    const double & startWallTime = omp_get_wtime();
+    STIXEL_TIMED_SCOPE("StixelsApplication::update");
     
     // Updating the rectified images
     const stixel_world::input_image_const_view_t & currLeft = mp_video_input->get_left_image();
@@ -206,14 +199,11 @@ void StixelsApplication::update()
     std::copy(mp_stixel_world_estimator->get_stixels().begin(), 
                 mp_stixel_world_estimator->get_stixels().end(), 
                 mp_prevStixels->begin());
-    
-    cout << "Time for " << __FUNCTION__ << ": " << omp_get_wtime() - startWallTime << endl;
 }
 
 bool StixelsApplication::iterate()
 {
-    const double & startWallTime = omp_get_wtime();
-    
+    STIXEL_TIMED_SCOPE("StixelsApplication::iterate");
     
     if ((mp_video_input->get_current_frame_number() == mp_video_input->get_number_of_frames()) || (! mp_video_input->next_frame()))
         return false;
@@ -250,14 +240,12 @@ bool StixelsApplication::iterate()
     
     mp_stixel_motion_evaluator->evaluate(mp_video_input->get_current_frame_number() - 1);
     
-    cout << "Time for " << __FUNCTION__ << ": " << omp_get_wtime() - startWallTime << endl;
-    
     return true;
 }
 
 bool StixelsApplication::rectifyPolar()
 {
-    const double & startWallTime = omp_get_wtime();
+    STIXEL_TIMED_SCOPE("StixelsApplication::rectifyPolar");
     
     if (mp_video_input->get_current_frame_number() == m_initialFrame)
         return true;
@@ -339,8 +327,6 @@ bool StixelsApplication::rectifyPolar()
     opencv2gil(Rt0, viewRt0);
     opencv2gil(Lt1, viewLt1);
     opencv2gil(Rt1, viewRt1);
-        
-    cout << "Time for " << __FUNCTION__ << ": " << omp_get_wtime() - startWallTime << endl;
     
     return true;
 }
@@ -467,7 +453,7 @@ void StixelsApplication::visualize2()
     cv::resize(imgTracking, scale, cv::Size(400, 300));
     scale.copyTo(output(cv::Rect(800, 0, 400, 300)));
     
-    cv::imshow("output", output);
+    VisualizationSink::show("output", output);
         
     //NOTE: Remove after debugging
 //     {
@@ -483,13 +469,11 @@ void StixelsApplication::visualize2()
 //         cv::imwrite(string(testName), saveImg);
 //     }
     // end of NOTE
-    
-    waitForKey(&m_waitTime);
 }
 
 void StixelsApplication::visualize3()
 {
-    const double & startWallTime = omp_get_wtime();
+    STIXEL_TIMED_SCOPE("StixelsApplication::visualize3");
     
     if (mp_video_input->get_current_frame_number() == m_initialFrame)
         return;
@@ -527,11 +511,7 @@ void StixelsApplication::visualize3()
     
 //     imgCurrent.copyTo(output(cv::Rect(imgPrev.cols, 0, imgCurrent.cols, imgCurrent.rows)));
     
-    cv::imshow("output", output);
-    
-    cout << "Time for " << __FUNCTION__ << ": " << omp_get_wtime() - startWallTime << endl;
-    
-    waitForKey(&m_waitTime);
+    VisualizationSink::show("output", output);
 }
 
 void StixelsApplication::visualize()
@@ -549,7 +529,7 @@ void StixelsApplication::visualize()
     cv::remap(diffPolar, diffRect, inverseX, inverseY, cv::INTER_CUBIC, cv::BORDER_TRANSPARENT);
     cv::resize(diffPolar, polarOutput, cv::Size(640, 720));
     mp_stixel_motion_estimator->drawTracker(diffRect);
-    cv::imshow("polar", diffRect);
+    VisualizationSink::show("polar", diffRect);
     
 //     cv::Mat outputDenseTrack;
 //     mp_stixel_motion_estimator->drawDenseTracker(outputDenseTrack);
@@ -560,7 +540,7 @@ void StixelsApplication::visualize()
         return;
     }
         
-    const double & startWallTime = omp_get_wtime();
+    STIXEL_TIMED_SCOPE("StixelsApplication::visualize");
     
     cv::Mat imgCurrent[6], topView[6];
     gil2opencv(stixel_world::input_image_const_view_t(mp_video_input->get_left_image()), imgCurrent[0]);
@@ -589,11 +569,6 @@ void StixelsApplication::visualize()
     imgCurrent[4].copyTo(output(cv::Rect(imgCurrent[0].cols, imgCurrent[0].rows, imgCurrent[4].cols, imgCurrent[4].rows)));
     imgCurrent[5].copyTo(output(cv::Rect(2 * imgCurrent[0].cols, imgCurrent[0].rows, imgCurrent[5].cols, imgCurrent[5].rows)));
     
-    cv::imshow("output", output);
-    
-    cout << "Time for " << __FUNCTION__ << ": " << omp_get_wtime() - startWallTime << endl;
-    
-    waitForKey(&m_waitTime);
-        
+    VisualizationSink::show("output", output);
 }
 
@@ -77,8 +77,6 @@ private:
     
     uint32_t m_initialFrame;
     
-    uint32_t m_waitTime;
-    
     cv::Mat m_currLeft;
 };
 
@@ -26,11 +26,19 @@
 #include "utils.h"
 #include "fundamentalmatrixestimator.h"
 
+#include "stagetimings.h"
+#include "visualizationsink.h"
+
+#include "helpers/get_option_value.hpp"
+
 #include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/concept_check.hpp>
 #include <boost/graph/graph_concepts.hpp>
 
 #include <fstream>
+#include <limits>
+#include <sstream>
 #include <eigen3/Eigen/src/Core/Matrix.h>
 
 #include <omp.h>
@@ -46,6 +54,13 @@ StixelsApplicationROS::StixelsApplicationROS(const string& optionsFile)
 {
     m_options = parseOptionsFile(optionsFile);
     
+    // Rectification maps are kept in rectificationCacheDir (if given, it overrides preprocess.rectification_cache_dir),
+    // so they are computed only once per calibration
+    std::string rectificationCacheDir;
+    ros::NodeHandle("~").param("rectificationCacheDir", rectificationCacheDir, std::string(""));
+    if (! rectificationCacheDir.empty())
+        doppia::ExtendedVideoInputFactory::set_rectification_cache_dir(m_options, rectificationCacheDir);
+    
     mp_video_input.reset(doppia::ExtendedVideoInputFactory::new_instance(m_options));
     
     if(not mp_video_input)
@@ -66,7 +81,12 @@ StixelsApplicationROS::StixelsApplicationROS(const string& optionsFile)
     bool m_useGraph, m_useCostMatrix, m_useObjects, twoLevelsTracking;
     double m_SADFactor, m_heightFactor, m_polarDistFactor, m_polarSADFactor, m_histBatFactor;
     ros::NodeHandle nh("~");
-    m_pointCloudPub = nh.advertise<sensor_msgs::PointCloud2> ("pointCloudStixels", 1);
+    // At most a point per pixel
+    const uint32_t maxStixelPoints = mp_video_input->get_left_image().width() * mp_video_input->get_left_image().height() /
+                                     mp_stixel_world_estimator->get_stixel_width();
+    mp_pointCloudPublisher.reset(new StixelPointCloudPublisher(nh, "pointCloudStixels", CAMERA_FRAME_ID, maxStixelPoints));
+    m_stixelsFramePub = nh.advertise<stixel_world::StixelsFrame>("stixels", 1);
+    setStixelsFrameCamera();
     nh.param("useGraph", m_useGraph, true);
     nh.param("useCostMatrix", m_useCostMatrix, true);
     nh.param("useObjects", m_useObjects, true);
@@ -80,6 +100,101 @@ StixelsApplicationROS::StixelsApplicationROS(const string& optionsFile)
     
     nh.param("increment", m_increment, 1);
     
+    // Stage timings are exported every timingsExportPeriod frames to the diagnostics topic and,
+    // if given, appended to timingsFile
+    nh.param("timingsExportPeriod", m_timingsExportPeriod, 100);
+    nh.param("timingsFile", m_timingsFile, std::string(""));
+    if (StageTimings::enabled())
+        m_diagnosticsPub = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+    m_processedFrames = 0;
+    
+    // Chrome trace of the pipeline, written at exit when traceFile is given
+    std::string traceFile;
+    int traceBufferEvents;
+    nh.param("traceFile", traceFile, std::string(""));
+    nh.param("traceBufferEvents", traceBufferEvents, 1 << 20);
+    if (! traceFile.empty()) {
+#ifdef STIXEL_WORLD_WITH_TRACING
+        PipelineTracer::enable(traceFile, traceBufferEvents);
+#else
+        ROS_WARN("traceFile was given, but tracing was disabled at build time (STIXEL_WORLD_TRACING)");
+#endif
+    }
+    
+    // Real time mode: frames are dropped at the input when processing does not fit in the deadline
+    bool realTime;
+    double frameDeadline;
+    int maxFrameGap;
+    nh.param("realTime", realTime, false);
+    nh.param("frameDeadline", frameDeadline, 0.0);
+    nh.param("maxFrameGap", maxFrameGap, 10);
+    if (maxFrameGap < 1)
+        throw std::invalid_argument("maxFrameGap must be at least 1");
+    
+    // The fundamental matrix (and the polar maps) is only estimated again when it stops holding
+    double fReuseMaxError;
+    int fReuseMaxFrames;
+    nh.param("fReuseMaxError", fReuseMaxError, 1.0);
+    nh.param("fReuseMaxFrames", fReuseMaxFrames, 30);
+    m_fReusePolicy = FundamentalMatrixReusePolicy(fReuseMaxError, fReuseMaxFrames);
+    // Corners for F are followed between frames, and only detected again where they got lost
+    nh.param("fFeatureTracks", m_useFeatureTracks, true);
+    // ORB descriptors instead of optical flow for the correspondences (the tracks do not apply then)
+    bool fBinaryMatching;
+    nh.param("fBinaryMatching", fBinaryMatching, false);
+    m_fMethod = fBinaryMatching? FundamentalMatrixEstimator::METHOD_BINARY : FundamentalMatrixEstimator::METHOD_OFLOW;
+    // LO-RANSAC seeded with the previous F instead of LMedS. Without a time budget (seconds), it is bounded
+    // by the number of iterations only, and F does not depend on the load of the machine
+    bool fRobust;
+    double fRobustBudget;
+    nh.param("fRobust", fRobust, true);
+    nh.param("fRobustBudget", fRobustBudget, 0.0);
+    if (fRobust)
+        mp_robustF.reset(new RobustFundamentalMatrix(1.0, 0.99, 1000, fRobustBudget));
+    // Rows the stixels can lie on, from the ground plane prior and stixel_world.expected_object_height.
+    // The tracker images, its difference images and the right image are only computed there
+    bool processingBand;
+    double processingBandMinDistance;
+    int processingBandMargin;
+    nh.param("processingBand", processingBand, false);
+    nh.param("processingBandMinDistance", processingBandMinDistance, 3.0);
+    nh.param("processingBandMargin", processingBandMargin, 10);
+    if (processingBand)
+        m_processingBand = ProcessingBand::fromVideoInput(m_options, *mp_video_input, 
+                                                          processingBandMinDistance, processingBandMargin);
+    
+    if (! doppia::ExtendedVideoInputFactory::set_frame_increment(*mp_video_input, m_increment)) {
+        ROS_WARN("The video input does not support skipping frames, increment %d will be ignored", m_increment);
+        m_increment = 1;
+        realTime = false;
+    }
+    
+    // Debug windows, shown by a viewer thread so they never block the pipeline
+    bool viewer;
+    int viewerRefreshPeriod;
+    nh.param("viewer", viewer, false);
+    nh.param("viewerRefreshPeriod", viewerRefreshPeriod, 30);
+    if (viewer)
+        VisualizationSink::attach(32, viewerRefreshPeriod);
+    
+    // Stixels and tracks for the consumers on this host, through shared memory instead of a topic
+    std::string shmName;
+    int shmSlots;
+    nh.param("shmName", shmName, std::string(""));
+    nh.param("shmSlots", shmSlots, 8);
+    if (! shmName.empty()) {
+        mp_shmWriter.reset(new StixelsShmWriter(shmName, shmSlots));
+        mp_shmWriter->setCamera(m_stixelsFrame.focal_x, m_stixelsFrame.focal_y, 
+                                m_stixelsFrame.center_x, m_stixelsFrame.center_y, 
+                                m_stixelsFrame.baseline, m_stixelsFrame.camera_height);
+    }
+    
+    if (realTime) {
+        if (frameDeadline <= 0.0)
+            frameDeadline = 1.0 / doppia::get_option_value<int>(m_options, "video_input.frame_rate");
+        mp_deadlineController.reset(new FrameDeadlineController(frameDeadline * m_increment, maxFrameGap));
+    }
+    
     if (twoLevelsTracking) {
         m_useCostMatrix = true;
         m_useObjects = true;
@@ -104,6 +219,14 @@ StixelsApplicationROS::StixelsApplicationROS(const string& optionsFile)
     cout << "m_histBatFactor " << m_histBatFactor << endl;
     cout << "twoLevelsTracking " << twoLevelsTracking << endl;
     cout << "m_doPolarCalib " << m_doPolarCalib << endl;
+    cout << "processingBand " << processingBand << endl;
+    if (processingBand) {
+        cout << "processingBandMinDistance " << processingBandMinDistance << endl;
+        cout << "processingBandMargin " << processingBandMargin << endl;
+    }
+    cout << "realTime " << realTime << endl;
+    if (realTime)
+        cout << "frameDeadline " << frameDeadline << endl;
     cout << "***********************" << endl;
     
 //     NOTE: This is just for fast tuning of the motion estimators
@@ -143,6 +266,8 @@ StixelsApplicationROS::StixelsApplicationROS(const string& optionsFile)
                                                             m_polarSADFactor, 0.0f, m_histBatFactor, 
                                                             m_useGraph, m_useCostMatrix, m_useObjects,
                                                             twoLevelsTracking);
+        mp_stixel_motion_estimator->set_frame_gap(m_increment);
+        mp_stixel_motion_estimator->set_processing_band(m_processingBand);
         mp_stixel_motion_evaluator->addStixelMotionEstimator(mp_stixel_world_estimator, mp_stixel_motion_estimator);
 //         mp_stixel_oflow_motion_estimator.reset(new oFlowTracker());
         
@@ -151,8 +276,6 @@ StixelsApplicationROS::StixelsApplicationROS(const string& optionsFile)
     }
     
     
-    m_waitTime = 0;
-    
     m_accTime = 0.0;
     
     m_firstIteration = true;
@@ -249,17 +372,58 @@ void StixelsApplicationROS::runStixelsApplication()
 //         visualize();
 //         publishStixels();
 //         publishStixelsInObjects();
+        publishStixelsFrame();
         update();
-        cout << "Time for " << __FUNCTION__ << ": " << omp_get_wtime() - startWallTime << endl;
+        
+        const double latency = omp_get_wtime() - startWallTime;
+        STIXEL_TIMING_RECORD("StixelsApplicationROS::frame", latency);
+        m_processedFrames++;
+        
+        if ((m_timingsExportPeriod > 0) && (m_processedFrames % m_timingsExportPeriod == 0))
+            exportTimings();
+        
+        if (mp_deadlineController) {
+            // The gap is applied to the next frame read from the input
+            const uint32_t frameGap = mp_deadlineController->update(latency);
+            doppia::ExtendedVideoInputFactory::set_frame_increment(*mp_video_input, frameGap * m_increment);
+            if (mp_stixel_motion_estimator)
+                mp_stixel_motion_estimator->set_frame_gap(frameGap * m_increment);
+            
+            if (mp_deadlineController->getProcessedFrames() % 100 == 0) {
+                stringstream ss;
+                mp_deadlineController->printStatistics(ss);
+                ROS_INFO("[REAL TIME] %s", ss.str().c_str());
+            }
+        }
+        
+        if (m_fReusePolicy.enabled() && (m_processedFrames % 100 == 0)) {
+            ROS_INFO("[F REUSE] reused %lu, recomputed %lu, last epipolar error %f", 
+                     (unsigned long)m_fReusePolicy.getReusedFrames(), 
+                     (unsigned long)m_fReusePolicy.getRecomputedFrames(), m_fReusePolicy.getLastEpipolarError());
+        }
+        
+        ros::spinOnce();
+        if (VisualizationSink::isQuitRequested() || (! ros::ok()))
+            break;
+        
         startWallTime = omp_get_wtime();
-        cout << "********************************" << endl;
+    }
+    
+    VisualizationSink::detach();
+    
+    exportTimings();
+    
+    if (mp_deadlineController) {
+        stringstream ss;
+        mp_deadlineController->printStatistics(ss);
+        ROS_INFO("[REAL TIME] %s", ss.str().c_str());
     }
 }
 
 void StixelsApplicationROS::update()
 {
 
-    const double & startWallTime = omp_get_wtime();
+    STIXEL_TIMED_SCOPE("StixelsApplicationROS::update");
     
     // Updating the rectified images
     const stixel_world::input_image_const_view_t & currLeft = mp_video_input->get_left_image();
@@ -294,17 +458,17 @@ void StixelsApplicationROS::update()
     std::copy(mp_stixel_world_estimator->get_stixels().begin(), 
                 mp_stixel_world_estimator->get_stixels().end(), 
                 mp_prevStixels->begin());
-    
-    cout << "Time for " << __FUNCTION__ << ": " << omp_get_wtime() - startWallTime << endl;
 }
 
 bool StixelsApplicationROS::iterate()
 {
-    const double & startWallTime = omp_get_wtime();
+    STIXEL_TIMED_SCOPE("StixelsApplicationROS::iterate");
     
     if ((mp_video_input->get_current_frame_number() == mp_video_input->get_number_of_frames()) || (! mp_video_input->next_frame()))
         return false;
     
+    STIXEL_TRACE_FRAME(mp_video_input->get_current_frame_number());
+    
 //     if (m_frameBufferLeft.size() < m_frameBufferLength)
 //         return true;
     
@@ -314,10 +478,14 @@ bool StixelsApplicationROS::iterate()
                         left_view(mp_video_input->get_left_image()),
                         right_view(mp_video_input->get_right_image());  
                         
+    // F is estimated on the whole left image, the features above the band are the most stable ones
     gil2opencv(mp_video_input->get_left_image(), m_currLeft);
-    gil2opencv(mp_video_input->get_right_image(), m_currRight);
+    gil2opencv(mp_video_input->get_right_image(), m_currRight, m_processingBand.getRows(m_currLeft.rows));
     mp_stixel_world_estimator->set_rectified_images_pair(left_view, right_view);
-    mp_stixel_world_estimator->compute();
+    {
+        STIXEL_TIMED_SCOPE("StixelWorldEstimator::compute");
+        mp_stixel_world_estimator->compute();
+    }
     
     if (! rectifyPolar()) {
 //         TODO: Do something in this case
@@ -327,7 +495,10 @@ bool StixelsApplicationROS::iterate()
     // TODO: Use again when speed information is needed
     if (mp_stixel_motion_estimator) {
         mp_stixel_motion_estimator->set_new_rectified_image(left_view);
-        mp_stixel_motion_estimator->updateDenseTracker(m_currLeft);
+        {
+            STIXEL_TIMED_SCOPE("StixelsTracker::updateDenseTracker");
+            mp_stixel_motion_estimator->updateDenseTracker(m_currLeft);
+        }
         mp_stixel_motion_estimator->set_estimated_stixels(mp_stixel_world_estimator->get_stixels());
         
 //         if(mp_video_input->get_current_frame_number() > m_initialFrame - 10)
@@ -351,20 +522,20 @@ bool StixelsApplicationROS::iterate()
 //     }
     
 //     if (! m_useObjects)
-        mp_stixel_motion_evaluator->evaluatePerFrame(mp_video_input->get_current_frame_number() - m_frameBufferLength - 1, m_increment); 
+        // The frames skipped by the deadline controller are part of the gap the tracker used
+        mp_stixel_motion_evaluator->evaluatePerFrame(mp_video_input->get_current_frame_number() - m_frameBufferLength - 1, 
+                                                     mp_stixel_motion_estimator->get_frame_gap()); 
 //     else
 //         mp_stixel_motion_evaluator->evaluatePerFrameWithObstacles(mp_video_input->get_current_frame_number() - 1);
 //     mp_stixel_motion_evaluator->evaluateDisparity(left_view, right_view,
 //                                                   mp_video_input->get_current_frame_number() - 1);
     
-    cout << "Time for " << __FUNCTION__ << ": " << omp_get_wtime() - startWallTime << endl;
-    
     return true;
 }
 
 bool StixelsApplicationROS::rectifyPolar()
 {
-    const double & startWallTime = omp_get_wtime();
+    STIXEL_TIMED_SCOPE("StixelsApplicationROS::rectifyPolar");
     
     if (! m_doPolarCalib)
         return true;
@@ -374,27 +545,86 @@ bool StixelsApplicationROS::rectifyPolar()
     
     cv::Mat prevLeft, prevRight, currRight, FL, FR;
     gil2opencv(boost::gil::view(m_frameBufferLeft[0]), prevLeft);
-    gil2opencv(boost::gil::view(m_frameBufferRight[0]), prevRight);
-
-    //     gil2opencv(mp_video_input->get_left_image(), m_currLeft);
-    gil2opencv(mp_video_input->get_right_image(), currRight);
-    vector < vector < cv::Point2f > > correspondences;
     
-    if (! FundamentalMatrixEstimator::findF(prevLeft, prevRight, m_currLeft, currRight, FL, FR, correspondences, 50))
-        return false;
-    
-    if (!  mp_polarCalibration->compute(prevLeft, m_currLeft, FL, correspondences[0], correspondences[3])) {
-        cout << "Error while trying to get the polar alignment for the images in the left" << endl;
-        return false;
+    // While F still holds for the new pair of images, the polar maps computed from it are kept
+    bool reuseF;
+    {
+        STIXEL_TIMED_SCOPE("FundamentalMatrixReusePolicy::canReuse");
+        reuseF = m_fReusePolicy.canReuse(prevLeft, m_currLeft);
     }
     
-    mp_polarCalibration->rectifyAndStoreImages(prevLeft, m_currLeft);
+    if (! reuseF) {
+        gil2opencv(boost::gil::view(m_frameBufferRight[0]), prevRight);
+        //     gil2opencv(mp_video_input->get_left_image(), m_currLeft);
+        gil2opencv(mp_video_input->get_right_image(), currRight);
+        vector < vector < cv::Point2f > > correspondences;
+        
+        STIXEL_TIMER_START(findFTimer, "FundamentalMatrixEstimator::findF");
+        if (! FundamentalMatrixEstimator::findF(prevLeft, prevRight, m_currLeft, currRight, FL, FR, correspondences, 
+                                                m_fMethod, 50, &m_flowPyramids,
+                                                m_useFeatureTracks? &m_featureTracks : NULL, mp_robustF.get())) {
+            m_fReusePolicy.reset();
+            m_featureTracks.reset();
+            if (mp_robustF)
+                mp_robustF->reset();
+            return false;
+        }
+        STIXEL_TIMER_STOP(findFTimer);
+        
+        STIXEL_TIMER_START(polarTimer, "PolarCalibration::compute");
+        if (!  mp_polarCalibration->compute(prevLeft, m_currLeft, FL, correspondences[0], correspondences[3])) {
+            cout << "Error while trying to get the polar alignment for the images in the left" << endl;
+            m_fReusePolicy.reset();
+            return false;
+        }
+        STIXEL_TIMER_STOP(polarTimer);
+        
+        m_fReusePolicy.setF(FL);
+    }
     
-    cout << "Time for " << __FUNCTION__ << ": " << omp_get_wtime() - startWallTime << endl;
+    {
+        STIXEL_TIMED_SCOPE("PolarCalibration::rectifyAndStoreImages");
+        mp_polarCalibration->rectifyAndStoreImages(prevLeft, m_currLeft);
+    }
     
     return true;
 }
 
+void StixelsApplicationROS::exportTimings()
+{
+    if (! StageTimings::enabled())
+        return;
+    
+    vector<StageTimings::t_stage_statistics> statistics;
+    StageTimings::getStatistics(statistics);
+    
+    diagnostic_msgs::DiagnosticArray diagnostics;
+    diagnostics.header.stamp = ros::Time::now();
+    for (uint32_t i = 0; i < statistics.size(); i++) {
+        const StageTimings::t_stage_statistics & stats = statistics[i];
+        
+        diagnostic_msgs::DiagnosticStatus status;
+        status.level = diagnostic_msgs::DiagnosticStatus::OK;
+        status.name = "stixel_world: " + stats.name;
+        status.hardware_id = "stixel_world";
+        
+        const string keys[6] = { "count", "mean (ms)", "p50 (ms)", "p95 (ms)", "p99 (ms)", "max (ms)" };
+        const double values[6] = { (double)stats.count, stats.mean * 1e3, stats.p50 * 1e3,
+                                   stats.p95 * 1e3, stats.p99 * 1e3, stats.max * 1e3 };
+        for (uint32_t k = 0; k < 6; k++) {
+            diagnostic_msgs::KeyValue keyValue;
+            keyValue.key = keys[k];
+            keyValue.value = boost::lexical_cast<string>(values[k]);
+            status.values.push_back(keyValue);
+        }
+        diagnostics.status.push_back(status);
+    }
+    m_diagnosticsPub.publish(diagnostics);
+    
+    if (! m_timingsFile.empty())
+        StageTimings::writeCsv(m_timingsFile, mp_video_input->get_current_frame_number());
+}
+
 void StixelsApplicationROS::transformStixels()
 {
     const stixels_t & prevStixels = *mp_prevStixels;
@@ -446,7 +676,7 @@ void drawLine(cv::Mat & img, const cv::Point2d & p1,
 
 void StixelsApplicationROS::visualize2()
 {
-    if (mp_video_input->get_current_frame_number() == m_initialFrame)
+    if ((mp_video_input->get_current_frame_number() == m_initialFrame) || (! VisualizationSink::isAttached()))
         return;
     
     cv::Mat img1Current, img2Current, imgTracking;
@@ -517,7 +747,7 @@ void StixelsApplicationROS::visualize2()
     cv::resize(imgTracking, scale, cv::Size(400, 300));
     scale.copyTo(output(cv::Rect(800, 0, 400, 300)));
     
-    cv::imshow("output", output);
+    VisualizationSink::show("output", output);
         
     //NOTE: Remove after debugging
 //     {
@@ -533,15 +763,13 @@ void StixelsApplicationROS::visualize2()
 //         cv::imwrite(string(testName), saveImg);
 //     }
     // end of NOTE
-    
-    waitForKey(&m_waitTime);
 }
 
 void StixelsApplicationROS::visualize3()
 {
-    const double & startWallTime = omp_get_wtime();
+    STIXEL_TIMED_SCOPE("StixelsApplicationROS::visualize3");
     
-    if (mp_video_input->get_current_frame_number() == m_initialFrame)
+    if ((mp_video_input->get_current_frame_number() == m_initialFrame) || (! VisualizationSink::isAttached()))
         return;
     
     cv::Mat imgCurrent, imgPrev;
@@ -578,12 +806,8 @@ void StixelsApplicationROS::visualize3()
     
 //     imgCurrent.copyTo(output(cv::Rect(imgPrev.cols, 0, imgCurrent.cols, imgCurrent.rows)));
     
-        cv::imshow("output", output);
+        VisualizationSink::show("output", output);
     }
-    
-    cout << "Time for " << __FUNCTION__ << ": " << omp_get_wtime() - startWallTime << endl;
-    
-    waitForKey(&m_waitTime);
 }
 
 void StixelsApplicationROS::visualize()
@@ -591,7 +815,7 @@ void StixelsApplicationROS::visualize()
 //     if (mp_video_input->get_current_frame_number() == m_initialFrame)
 //         return;
     
-    if (m_frameBufferLeft.size() < m_frameBufferLength)
+    if ((m_frameBufferLeft.size() < m_frameBufferLength) || (! VisualizationSink::isAttached()))
         return;
     
     if (mp_polarCalibration) {
@@ -606,7 +830,7 @@ void StixelsApplicationROS::visualize()
         cv::resize(diffPolar, polarOutput, cv::Size(640, 720));
         if (mp_stixel_motion_estimator)
             mp_stixel_motion_estimator->drawTracker(diffRect);
-        cv::imshow("polar", diffRect);
+        VisualizationSink::show("polar", diffRect);
     }
     
 //     cv::Mat outputDenseTrack;
@@ -618,7 +842,7 @@ void StixelsApplicationROS::visualize()
         return;
     }
         
-    const double & startWallTime = omp_get_wtime();
+    STIXEL_TIMED_SCOPE("StixelsApplicationROS::visualize");
     
     cv::Mat imgCurrent[6], topView[6];
     gil2opencv(stixel_world::input_image_const_view_t(mp_video_input->get_left_image()), imgCurrent[0]);
@@ -647,28 +871,10 @@ void StixelsApplicationROS::visualize()
     imgCurrent[4].copyTo(output(cv::Rect(imgCurrent[0].cols, imgCurrent[0].rows, imgCurrent[4].cols, imgCurrent[4].rows)));
     imgCurrent[5].copyTo(output(cv::Rect(2 * imgCurrent[0].cols, imgCurrent[0].rows, imgCurrent[5].cols, imgCurrent[5].rows)));
     
-    cv::imshow("output", output);
-    
-    cout << "Time for " << __FUNCTION__ << ": " << omp_get_wtime() - startWallTime << endl;
-    
-//     waitForKey(&m_waitTime);
+    VisualizationSink::show("output", output);
         
 }
 
-void StixelsApplicationROS::publishPointCloud(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr & pointCloud) {
-    
-    cout << "Publishing Stixels" << endl;   
-    
-    sensor_msgs::PointCloud2 cloudMsg;
-    pcl::toROSMsg (*pointCloud, cloudMsg);
-    cloudMsg.header.frame_id = CAMERA_FRAME_ID;
-    cloudMsg.header.stamp = ros::Time();
-         
-    m_pointCloudPub.publish(cloudMsg);
-         
-    ros::spinOnce();
-}
-
 void StixelsApplicationROS::publishStixels()
 {
     cv::Mat imgLeft;
@@ -677,37 +883,15 @@ void StixelsApplicationROS::publishStixels()
     const stixels_t & stixels = mp_stixel_world_estimator->get_stixels();
 //     const stixels3d_t & stixels = mp_stixel_motion_estimator->getLastStixelsAfterTracking();
     
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr pointCloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+    const doppia::MetricStereoCamera& camera = mp_video_input->get_metric_camera();
+    const double & camera_height = mp_video_input->camera_height;
+    
+    mp_pointCloudPublisher->clear();
     for (stixels_t::const_iterator it = stixels.begin(); it != stixels.end(); it++) {
         cv::Point2i p1(it->x, it->bottom_y);
         cv::Point2i p2(it->x, it->top_y);
 
-        const doppia::MetricStereoCamera& camera = mp_video_input->get_metric_camera();
-        const double & camera_height = mp_video_input->camera_height;
-        
-        double depth = std::numeric_limits<double>::max();
-        if (it->disparity > 0.0f)
-            depth = camera.disparity_to_depth(it->disparity );
-            
-        for (uint32_t y = it->top_y; y <= it->bottom_y; y++) {
-            
-            Eigen::Vector2f point2d;
-            point2d << it->x, y;
-            
-            
-            Eigen::Vector3f point3d = camera.get_left_camera().back_project_2d_point_to_3d(point2d, depth);
-            
-            cv::Vec3b pixel = imgLeft.at<cv::Vec3b>(y, it->x);
-            
-            pcl::PointXYZRGB point;
-            point.x = point3d(0);
-            point.y = point3d(2);
-            point.z = camera_height - point3d(1);
-            point.r = pixel[2];
-            point.g = pixel[1];
-            point.b = pixel[0];
-            pointCloud->push_back(point);
-        }
+        mp_pointCloudPublisher->addStixel(*it, it->disparity, camera, camera_height, imgLeft);
         
 //         cv::line(imgLeft, p1, p2, cv::Scalar(0, 255, 0));
         imgLeft.at<cv::Vec3b>(p1.y, p1.x) = cv::Vec3b(0, 255, 0);
@@ -732,15 +916,13 @@ void StixelsApplicationROS::publishStixels()
     transform.setOrigin(tf::Vector3(posX, posY, m_accTime));
     transform.setRotation( tf::createQuaternionFromRPY(0.0, 0.0, posTheta) );
 
-    publishPointCloud(pointCloud);
+    mp_pointCloudPublisher->publish(ros::Time());
     const tf::StampedTransform stamped = tf::StampedTransform(transform, ros::Time::now(), "/map", "/odom");
     cout << "stamped " << stamped.stamp_ << endl;
     broadcaster.sendTransform(stamped);
     
     
-    cv::imshow("imgLeft", imgLeft);
-    
-    waitForKey(&m_waitTime);
+    VisualizationSink::show("imgLeft", imgLeft);
 }
 
 void StixelsApplicationROS::publishStixelsInObjects()
@@ -750,45 +932,17 @@ void StixelsApplicationROS::publishStixelsInObjects()
     
     const StixelsTracker::t_obstaclesTracker & obstaclesTracker = (/*(StixelsTracker)*/mp_stixel_motion_estimator)->getObstaclesTracker();
     
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr pointCloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+    const doppia::MetricStereoCamera& camera = mp_video_input->get_metric_camera();
+    const double & camera_height = mp_video_input->camera_height;
+    
+    mp_pointCloudPublisher->clear();
     BOOST_FOREACH(const StixelsTracker::t_obstaclesTrack & obstacleTrack, obstaclesTracker) {
         if (obstacleTrack.validCount >= 0) {
             const StixelsTracker::t_obstacle & obstacle = obstacleTrack.track[0];
             
-            
-            BOOST_FOREACH(Stixel stixel, obstacle.stixels) {
-                
-                stixel.disparity = obstacle.disparity;
-                
-                cv::Point2i p1(stixel.x, stixel.bottom_y);
-                cv::Point2i p2(stixel.x, stixel.top_y);
-                
-                const doppia::MetricStereoCamera& camera = mp_video_input->get_metric_camera();
-                const double & camera_height = mp_video_input->camera_height;
-                
-                double depth = std::numeric_limits<double>::max();
-                if (stixel.disparity > 0.0f)
-                    depth = camera.disparity_to_depth(stixel.disparity );
-                
-                for (uint32_t y = stixel.top_y; y <= stixel.bottom_y; y++) {
-                    
-                    Eigen::Vector2f point2d;
-                    point2d << stixel.x, y;
-                    
-                    
-                    Eigen::Vector3f point3d = camera.get_left_camera().back_project_2d_point_to_3d(point2d, depth);
-                    
-                    cv::Vec3b pixel = imgLeft.at<cv::Vec3b>(y, stixel.x);
-                    
-                    pcl::PointXYZRGB point;
-                    point.x = point3d(0);
-                    point.y = point3d(2);
-                    point.z = camera_height - point3d(1);
-                    point.r = pixel[2];
-                    point.g = pixel[1];
-                    point.b = pixel[0];
-                    pointCloud->push_back(point);
-                }
+            // All the stixels of the obstacle are placed at its disparity
+            BOOST_FOREACH(const Stixel & stixel, obstacle.stixels) {
+                mp_pointCloudPublisher->addStixel(stixel, obstacle.disparity, camera, camera_height, imgLeft);
             }
         }
     }
@@ -810,10 +964,185 @@ void StixelsApplicationROS::publishStixelsInObjects()
     transform.setOrigin(tf::Vector3(posX, posY, m_accTime));
     transform.setRotation( tf::createQuaternionFromRPY(0.0, 0.0, posTheta) );
     
-    publishPointCloud(pointCloud);
+    mp_pointCloudPublisher->publish(ros::Time());
     const tf::StampedTransform stamped = tf::StampedTransform(transform, ros::Time::now(), "/map", "/odom");
     cout << "stamped " << stamped.stamp_ << endl;
     broadcaster.sendTransform(stamped);
 }
 
+void StixelsApplicationROS::setStixelsFrameCamera()
+{
+    // The intrinsics are recovered by back projecting at depth 1, so subscribers can use a plain pinhole model
+    const doppia::MetricStereoCamera & camera = mp_video_input->get_metric_camera();
+    Eigen::Vector2f point2d;
+    point2d << 0.0f, 0.0f;
+    const Eigen::Vector3f origin = camera.get_left_camera().back_project_2d_point_to_3d(point2d, 1.0);
+    point2d << 1.0f, 1.0f;
+    const Eigen::Vector3f unit = camera.get_left_camera().back_project_2d_point_to_3d(point2d, 1.0);
+    
+    m_stixelsFrame.header.frame_id = CAMERA_FRAME_ID;
+    m_stixelsFrame.focal_x = 1.0 / (unit(0) - origin(0));
+    m_stixelsFrame.focal_y = 1.0 / (unit(1) - origin(1));
+    m_stixelsFrame.center_x = -origin(0) * m_stixelsFrame.focal_x;
+    m_stixelsFrame.center_y = -origin(1) * m_stixelsFrame.focal_y;
+    // depth = focal * baseline / disparity
+    m_stixelsFrame.baseline = camera.disparity_to_depth(1.0f) / m_stixelsFrame.focal_x;
+    m_stixelsFrame.camera_height = mp_video_input->camera_height;
+}
+
+void StixelsApplicationROS::publishStixelsFrame()
+{
+    // Nothing is built without subscribers nor shared memory ring
+    const bool hasSubscribers = (m_stixelsFramePub.getNumSubscribers() != 0);
+    if ((! hasSubscribers) && (! mp_shmWriter))
+        return;
+    
+    STIXEL_TIMED_SCOPE("StixelsApplicationROS::publishStixelsFrame");
+    
+    const stixels_t & stixels = mp_stixel_world_estimator->get_stixels();
+    const doppia::MetricStereoCamera & camera = mp_video_input->get_metric_camera();
+    
+    m_stixelsFrame.header.stamp = ros::Time::now();
+    m_stixelsFrame.frame = mp_video_input->get_current_frame_number();
+    
+    m_stixelsFrame.stixels.resize(stixels.size());
+    for (uint32_t i = 0; i < stixels.size(); i++) {
+        stixel_world::CompactStixel & stixelMsg = m_stixelsFrame.stixels[i];
+        stixelMsg.x = stixels[i].x;
+        stixelMsg.width = stixels[i].width;
+        stixelMsg.top_y = stixels[i].top_y;
+        stixelMsg.bottom_y = stixels[i].bottom_y;
+        stixelMsg.disparity = stixels[i].disparity;
+        stixelMsg.track_id = -1;
+        stixelMsg.velocity_x = 0.0f;
+        stixelMsg.velocity_z = 0.0f;
+    }
+    m_stixelsFrame.obstacles.clear();
+    
+    if (mp_stixel_motion_estimator) {
+        const double framesPerSecond = doppia::get_option_value<int>(m_options, "video_input.frame_rate") /
+                                       (double)mp_stixel_motion_estimator->get_frame_gap();
+        
+        // Velocity of each stixel from the stixel it was matched to in the previous frame
+        const stixels_t & prevStixels = mp_stixel_motion_estimator->get_previous_stixels();
+        const AbstractStixelMotionEstimator::stixels_motion_t & corresp = mp_stixel_motion_estimator->get_stixels_motion();
+        if (corresp.size() == stixels.size()) {
+            for (uint32_t i = 0; i < stixels.size(); i++) {
+                if ((corresp[i] < 0) || (corresp[i] >= (int32_t)prevStixels.size()) ||
+                    (stixels[i].disparity <= 0.0f) || (prevStixels[corresp[i]].disparity <= 0.0f))
+                    continue;
+                
+                const Stixel & prevStixel = prevStixels[corresp[i]];
+                Eigen::Vector2f currPoint, prevPoint;
+                currPoint << stixels[i].x, stixels[i].bottom_y;
+                prevPoint << prevStixel.x, prevStixel.bottom_y;
+                const Eigen::Vector3f curr3d = camera.get_left_camera().back_project_2d_point_to_3d(
+                                                    currPoint, camera.disparity_to_depth(stixels[i].disparity));
+                const Eigen::Vector3f prev3d = camera.get_left_camera().back_project_2d_point_to_3d(
+                                                    prevPoint, camera.disparity_to_depth(prevStixel.disparity));
+                m_stixelsFrame.stixels[i].velocity_x = (curr3d(0) - prev3d(0)) * framesPerSecond;
+                m_stixelsFrame.stixels[i].velocity_z = (curr3d(2) - prev3d(2)) * framesPerSecond;
+            }
+        }
+        
+        // Same criteria as publishStixelsInObjects
+        const StixelsTracker::t_obstaclesTracker & obstaclesTracker = mp_stixel_motion_estimator->getObstaclesTracker();
+        const uint32_t stixelWidth = mp_stixel_world_estimator->get_stixel_width();
+        BOOST_FOREACH(const StixelsTracker::t_obstaclesTrack & obstacleTrack, obstaclesTracker) {
+            if ((obstacleTrack.validCount < 0) || (obstacleTrack.track.empty()))
+                continue;
+            
+            const StixelsTracker::t_obstacle & obstacle = obstacleTrack.track[0];
+            
+            stixel_world::ObstacleSummary obstacleMsg;
+            obstacleMsg.track_id = obstacleTrack.id;
+            obstacleMsg.x = obstacle.roi.x;
+            obstacleMsg.y = obstacle.roi.y;
+            obstacleMsg.width = obstacle.roi.width;
+            obstacleMsg.height = obstacle.roi.height;
+            obstacleMsg.disparity = obstacle.disparity;
+            obstacleMsg.position_x = obstacle.roi3d.mean.x;
+            obstacleMsg.position_y = obstacle.roi3d.mean.y;
+            obstacleMsg.position_z = obstacle.roi3d.mean.z;
+            obstacleMsg.size_x = obstacle.roi3d.width;
+            obstacleMsg.size_y = obstacle.roi3d.height;
+            obstacleMsg.size_z = obstacle.roi3d.length;
+            obstacleMsg.velocity_x = 0.0f;
+            obstacleMsg.velocity_z = 0.0f;
+            if (obstacleTrack.track.size() > 1) {
+                const StixelsTracker::t_obstacle & prevObstacle = obstacleTrack.track[1];
+                obstacleMsg.velocity_x = (obstacle.roi3d.mean.x - prevObstacle.roi3d.mean.x) * framesPerSecond;
+                obstacleMsg.velocity_z = (obstacle.roi3d.mean.z - prevObstacle.roi3d.mean.z) * framesPerSecond;
+            }
+            obstacleMsg.age = std::min(obstacleTrack.track.size(), (size_t)std::numeric_limits<uint16_t>::max());
+            obstacleMsg.valid_count = obstacleTrack.validCount;
+            m_stixelsFrame.obstacles.push_back(obstacleMsg);
+            
+            BOOST_FOREACH(const Stixel & stixel, obstacle.stixels) {
+                const uint32_t idx = stixel.x / stixelWidth;
+                if ((idx < stixels.size()) && (stixels[idx].x == stixel.x))
+                    m_stixelsFrame.stixels[idx].track_id = obstacleTrack.id;
+            }
+        }
+    }
+    
+    if (hasSubscribers)
+        m_stixelsFramePub.publish(m_stixelsFrame);
+    if (mp_shmWriter)
+        writeStixelsShm();
+}
+
+void StixelsApplicationROS::writeStixelsShm()
+{
+    STIXEL_TIMED_SCOPE("StixelsApplicationROS::writeStixelsShm");
+    
+    // The frame is written in place in the ring
+    StixelsShm::t_frame * frame = mp_shmWriter->beginFrame();
+    frame->frame = m_stixelsFrame.frame;
+    frame->stamp = m_stixelsFrame.header.stamp.toSec();
+    
+    AbstractStixelMotionEstimator::stixels_motion_t emptyMotion;
+    const AbstractStixelMotionEstimator::stixels_motion_t & corresp = mp_stixel_motion_estimator? 
+                                                mp_stixel_motion_estimator->get_stixels_motion() : emptyMotion;
+    
+    frame->numStixels = std::min((uint32_t)m_stixelsFrame.stixels.size(), StixelsShm::MAX_STIXELS);
+    for (uint32_t i = 0; i < frame->numStixels; i++) {
+        const stixel_world::CompactStixel & stixelMsg = m_stixelsFrame.stixels[i];
+        StixelsShm::t_stixel & stixel = frame->stixels[i];
+        stixel.x = stixelMsg.x;
+        stixel.width = stixelMsg.width;
+        stixel.top_y = stixelMsg.top_y;
+        stixel.bottom_y = stixelMsg.bottom_y;
+        stixel.disparity = stixelMsg.disparity;
+        stixel.motion = (i < corresp.size())? corresp[i] : -1;
+        stixel.track_id = stixelMsg.track_id;
+        stixel.velocity_x = stixelMsg.velocity_x;
+        stixel.velocity_z = stixelMsg.velocity_z;
+    }
+    
+    frame->numObstacles = std::min((uint32_t)m_stixelsFrame.obstacles.size(), StixelsShm::MAX_OBSTACLES);
+    for (uint32_t i = 0; i < frame->numObstacles; i++) {
+        const stixel_world::ObstacleSummary & obstacleMsg = m_stixelsFrame.obstacles[i];
+        StixelsShm::t_obstacle & obstacle = frame->obstacles[i];
+        obstacle.track_id = obstacleMsg.track_id;
+        obstacle.x = obstacleMsg.x;
+        obstacle.y = obstacleMsg.y;
+        obstacle.width = obstacleMsg.width;
+        obstacle.height = obstacleMsg.height;
+        obstacle.disparity = obstacleMsg.disparity;
+        obstacle.position_x = obstacleMsg.position_x;
+        obstacle.position_y = obstacleMsg.position_y;
+        obstacle.position_z = obstacleMsg.position_z;
+        obstacle.size_x = obstacleMsg.size_x;
+        obstacle.size_y = obstacleMsg.size_y;
+        obstacle.size_z = obstacleMsg.size_z;
+        obstacle.velocity_x = obstacleMsg.velocity_x;
+        obstacle.velocity_z = obstacleMsg.velocity_z;
+        obstacle.age = obstacleMsg.age;
+        obstacle.valid_count = obstacleMsg.valid_count;
+    }
+    
+    mp_shmWriter->commitFrame();
+}
+
 }
\ No newline at end of file
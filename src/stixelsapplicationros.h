@@ -32,13 +32,18 @@
 #include "stereo_matching/stixels/motion/DummyStixelMotionEstimator.hpp"
 #include "stixelstracker.h"
 #include "oflowtracker.h"
+#include "framedeadlinecontroller.h"
+#include "stixelpointcloudpublisher.h"
+#include "stixelsshm.h"
+#include "fundamentalmatrixestimator.h"
 
-#include<pcl_ros/point_cloud.h>
+#include <stixel_world/StixelsFrame.h>
 
 #include <ros/ros.h>
 #include <tf/transform_broadcaster.h>
 #include <tf/transform_datatypes.h>
 #include "std_msgs/String.h"
+#include <diagnostic_msgs/DiagnosticArray.h>
 
 #include <boost/thread/thread.hpp>
 
@@ -62,10 +67,12 @@ private:
     void visualize3();
     void publishStixels();
     void publishStixelsInObjects();
+    void publishStixelsFrame();
+    void setStixelsFrameCamera();
+    void writeStixelsShm();
     bool rectifyPolar();
     void transformStixels();
-    
-    void publishPointCloud(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr & pointCloud);
+    void exportTimings();
     
     boost::shared_ptr<doppia::AbstractVideoInput> mp_video_input;
     boost::shared_ptr<doppia::AbstractStixelWorldEstimator> mp_stixel_world_estimator;
@@ -92,13 +99,21 @@ private:
     
     uint32_t m_initialFrame;
     
-    uint32_t m_waitTime;
-    
     cv::Mat m_currLeft, m_currRight;
     
     bool m_doPolarCalib;
-    
-    ros::Publisher m_pointCloudPub;
+    FundamentalMatrixReusePolicy m_fReusePolicy;
+    OpticalFlowPyramids m_flowPyramids;
+    FeatureTracks m_featureTracks;
+    bool m_useFeatureTracks;
+    uint8_t m_fMethod;
+    boost::shared_ptr<RobustFundamentalMatrix> mp_robustF;
+    ProcessingBand m_processingBand;
+    
+    boost::shared_ptr<StixelPointCloudPublisher> mp_pointCloudPublisher;
+    ros::Publisher m_stixelsFramePub;
+    stixel_world::StixelsFrame m_stixelsFrame;
+    boost::shared_ptr<StixelsShmWriter> mp_shmWriter;
     tf::TransformBroadcaster m_map2odomTfBroadcaster;
     double m_accTime;
     
@@ -108,6 +123,13 @@ private:
     
     int m_increment;
     
+    boost::shared_ptr<FrameDeadlineController> mp_deadlineController;
+    
+    ros::Publisher m_diagnosticsPub;
+    int m_timingsExportPeriod;
+    string m_timingsFile;
+    uint64_t m_processedFrames;
+    
 // protected:
 //     void waitForKey(&m_waitTime arg1);
 };
@@ -0,0 +1,513 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include "stixelsbenchmark.h"
+
+#include "doppia/extendedvideoinputfactory.h"
+
+#include "fundamentalmatrixestimator.h"
+#include "motionevaluation.h"
+#include "stagetimings.h"
+#include "stixelscapture.h"
+
+#include "helpers/get_option_value.hpp"
+
+#include "applications/stixel_world_lib/stixel_world_lib.hpp"
+#include "stereo_matching/stixels/StixelWorldEstimatorFactory.hpp"
+
+#include <sys/resource.h>
+
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+
+#include <omp.h>
+
+// FNV-1a, 64 bits
+#define DIGEST_OFFSET_BASIS 14695981039346656037ULL
+#define DIGEST_PRIME 1099511628211ULL
+
+using namespace std;
+
+namespace stixel_world {
+
+static inline void hashValue(uint64_t & digest, const int32_t & value)
+{
+    const uint8_t * bytes = (const uint8_t *)&value;
+    for (uint32_t i = 0; i < sizeof(int32_t); i++) {
+        digest ^= bytes[i];
+        digest *= DIGEST_PRIME;
+    }
+}
+
+StixelsBenchmark::StixelsBenchmark(const string& optionsFile, const t_benchmark_params& params) : m_params(params)
+{
+    m_options = parseOptionsFile(optionsFile);
+    if (! m_params.rectificationCacheDir.empty())
+        doppia::ExtendedVideoInputFactory::set_rectification_cache_dir(m_options, m_params.rectificationCacheDir);
+
+    mp_video_input.reset(doppia::ExtendedVideoInputFactory::new_instance(m_options));
+    if (! mp_video_input)
+        throw std::invalid_argument("Failed to initialize a video input module. "
+                                    "No images to read, nothing to compute.");
+
+    if (! doppia::ExtendedVideoInputFactory::set_frame_increment(*mp_video_input, m_params.increment))
+        m_params.increment = 1;
+
+    // When replaying, the video input is only used for the camera, and the stixels come from the recording
+    uint32_t stixelWidth;
+    if (! m_params.replayFile.empty()) {
+        mp_recordingReader.reset(new StixelsRecordingReader(m_params.replayFile));
+        stixelWidth = mp_recordingReader->getStixelWidth();
+        m_params.increment = mp_recordingReader->getFrameGap();
+    } else {
+        mp_stixel_world_estimator.reset(doppia::StixelWorldEstimatorFactory::new_instance(m_options, *mp_video_input));
+        stixelWidth = mp_stixel_world_estimator->get_stixel_width();
+    }
+
+    mp_polarCalibration.reset(new PolarCalibration());
+    m_fReusePolicy = FundamentalMatrixReusePolicy(m_params.fReuseMaxError, m_params.fReuseMaxFrames);
+    if (m_params.fRobust)
+        mp_robustF.reset(new RobustFundamentalMatrix(1.0, 0.99, 1000, m_params.fRobustBudget));
+    mp_stixel_motion_estimator.reset(new StixelsTracker(m_options, mp_video_input->get_metric_camera(),
+                                                       stixelWidth, mp_polarCalibration));
+    mp_stixel_motion_estimator->set_motion_cost_factors(m_params.SADFactor, m_params.heightFactor,
+                                                        m_params.polarDistFactor, m_params.polarSADFactor,
+                                                        0.0f, m_params.histBatFactor,
+                                                        m_params.useGraph, m_params.useCostMatrix,
+                                                        m_params.useObjects, m_params.twoLevelsTracking);
+    mp_stixel_motion_estimator->set_frame_gap(m_params.increment);
+    if (m_params.processingBand)
+        mp_stixel_motion_estimator->set_processing_band(
+            ProcessingBand::fromVideoInput(m_options, *mp_video_input,
+                                           m_params.processingBandMinDistance, m_params.processingBandMargin));
+    mp_stixel_motion_estimator->set_visualization(false);
+
+    if ((! m_params.captureDir.empty()) && (m_options.count("video_input.calibration_filename") > 0)) {
+        boost::filesystem::create_directories(m_params.captureDir);
+        boost::filesystem::copy_file(doppia::get_option_value<string>(m_options, "video_input.calibration_filename"),
+                                     StixelsCapture::getCalibrationFilename(m_params.captureDir),
+                                     boost::filesystem::copy_option::overwrite_if_exists);
+    }
+
+    if ((! m_params.recordFile.empty()) && (! mp_recordingReader))
+        mp_recordingWriter.reset(new StixelsRecordingWriter(m_params.recordFile, stixelWidth, m_params.increment));
+
+    m_frameBufferLength = 2;
+    m_firstIteration = true;
+    m_rectified = false;
+    m_tracked = false;
+
+    m_processedFrames = 0;
+    m_elapsedTime = 0.0;
+    m_digest = DIGEST_OFFSET_BASIS;
+}
+
+boost::program_options::options_description StixelsBenchmark::get_args_options()
+{
+    boost::program_options::options_description desc("StixelsBenchmark options");
+
+    // Same names and defaults as the parameters in launch/stixel_world.launch
+    desc.add_options()
+    ("useGraph", boost::program_options::value<bool>()->default_value(true), "track with graphs")
+    ("useCostMatrix", boost::program_options::value<bool>()->default_value(true), "use the motion cost matrix")
+    ("useObjects", boost::program_options::value<bool>()->default_value(true), "track obstacles")
+    ("twoLevelsTracking", boost::program_options::value<bool>()->default_value(true), "track stixels and obstacles")
+    ("SADFactor", boost::program_options::value<double>()->default_value(1.0), "SAD factor")
+    ("heightFactor", boost::program_options::value<double>()->default_value(0.0), "height factor")
+    ("polarDistFactor", boost::program_options::value<double>()->default_value(0.0), "polar distance factor")
+    ("polarSADFactor", boost::program_options::value<double>()->default_value(0.0), "polar SAD factor")
+    ("histBatFactor", boost::program_options::value<double>()->default_value(0.0), "histogram similarity factor")
+    ("increment", boost::program_options::value<int>()->default_value(1), "frames read at each iteration")
+    ("frames", boost::program_options::value<uint32_t>()->default_value(0), "frames to process (0 for all)")
+    ("capture_dir", boost::program_options::value<string>()->default_value(""), "store the images and stixels of each frame in this folder")
+    ("record_file", boost::program_options::value<string>()->default_value(""), "record the tracker input of each frame in this file")
+    ("replay_file", boost::program_options::value<string>()->default_value(""), "only run the tracker, on a file written with record_file")
+    ("fReuseMaxError", boost::program_options::value<double>()->default_value(1.0), "keep F and the polar maps while their epipolar error is below this (0 to always recompute)")
+    ("fReuseMaxFrames", boost::program_options::value<uint32_t>()->default_value(30), "frames in a row F can be kept")
+    ("fFeatureTracks", boost::program_options::value<bool>()->default_value(true), "follow the corners used for F between frames")
+    ("fBinaryMatching", boost::program_options::value<bool>()->default_value(false), "match ORB descriptors instead of optical flow for F")
+    ("fRobust", boost::program_options::value<bool>()->default_value(false), "estimate F with LO-RANSAC seeded with the previous F instead of LMedS")
+    ("fRobustBudget", boost::program_options::value<double>()->default_value(0.0), "time budget of the robust F estimation, in seconds (0 for no limit, so F does not depend on the load)")
+    ("processingBand", boost::program_options::value<bool>()->default_value(false), "only process the rows from the horizon (or the top of the closest objects) down")
+    ("processingBandMinDistance", boost::program_options::value<double>()->default_value(3.0), "distance of the closest objects kept whole in the band, in meters")
+    ("processingBandMargin", boost::program_options::value<int32_t>()->default_value(10), "rows added over the band")
+    ("rectificationCacheDir", boost::program_options::value<string>()->default_value(""), "keep the rectification maps of each calibration in this folder")
+    ;
+
+    return desc;
+}
+
+StixelsBenchmark::t_benchmark_params StixelsBenchmark::get_params(const boost::program_options::variables_map & args)
+{
+    t_benchmark_params params;
+    params.useGraph = args["useGraph"].as<bool>();
+    params.useCostMatrix = args["useCostMatrix"].as<bool>();
+    params.useObjects = args["useObjects"].as<bool>();
+    params.twoLevelsTracking = args["twoLevelsTracking"].as<bool>();
+    params.SADFactor = args["SADFactor"].as<double>();
+    params.heightFactor = args["heightFactor"].as<double>();
+    params.polarDistFactor = args["polarDistFactor"].as<double>();
+    params.polarSADFactor = args["polarSADFactor"].as<double>();
+    params.histBatFactor = args["histBatFactor"].as<double>();
+    params.increment = args["increment"].as<int>();
+    params.maxFrames = args["frames"].as<uint32_t>();
+    params.captureDir = args["capture_dir"].as<string>();
+    params.recordFile = args["record_file"].as<string>();
+    params.replayFile = args["replay_file"].as<string>();
+    params.fReuseMaxError = args["fReuseMaxError"].as<double>();
+    params.fReuseMaxFrames = args["fReuseMaxFrames"].as<uint32_t>();
+    params.fFeatureTracks = args["fFeatureTracks"].as<bool>();
+    params.fBinaryMatching = args["fBinaryMatching"].as<bool>();
+    params.fRobust = args["fRobust"].as<bool>();
+    params.fRobustBudget = args["fRobustBudget"].as<double>();
+    params.processingBand = args["processingBand"].as<bool>();
+    params.processingBandMinDistance = args["processingBandMinDistance"].as<double>();
+    params.processingBandMargin = args["processingBandMargin"].as<int32_t>();
+    params.rectificationCacheDir = args["rectificationCacheDir"].as<string>();
+    return params;
+}
+
+boost::program_options::variables_map StixelsBenchmark::parseOptionsFile(const string& optionsFile)
+{
+    if (! boost::filesystem::exists(optionsFile))
+        throw std::invalid_argument("Could not find the configuration file " + optionsFile);
+
+    boost::program_options::options_description desc;
+    get_options_description(desc);
+    desc.add(StixelsTracker::get_args_options());
+    desc.add(MotionEvaluation::get_args_options());
+
+    boost::program_options::variables_map options;
+    fstream configurationFile(optionsFile.c_str(), fstream::in);
+    boost::program_options::store(boost::program_options::parse_config_file(configurationFile, desc), options);
+    configurationFile.close();
+
+    return options;
+}
+
+void StixelsBenchmark::run()
+{
+    const double startTime = omp_get_wtime();
+    double frameStartTime = startTime;
+    while ((m_params.maxFrames == 0) || (m_processedFrames < m_params.maxFrames)) {
+        if (mp_recordingReader) {
+            if (! replay())
+                break;
+        } else {
+            if (! iterate())
+                break;
+            update();
+        }
+
+        const double now = omp_get_wtime();
+        STIXEL_TIMING_RECORD("StixelsBenchmark::frame", now - frameStartTime);
+        frameStartTime = now;
+
+        m_processedFrames++;
+    }
+    m_elapsedTime = omp_get_wtime() - startTime;
+}
+
+bool StixelsBenchmark::iterate()
+{
+    STIXEL_TIMED_SCOPE("StixelsBenchmark::iterate");
+
+    if ((mp_video_input->get_current_frame_number() == mp_video_input->get_number_of_frames()) || (! mp_video_input->next_frame()))
+        return false;
+
+    STIXEL_TRACE_FRAME(mp_video_input->get_current_frame_number());
+
+    doppia::AbstractVideoInput::input_image_view_t
+                        left_view(mp_video_input->get_left_image()),
+                        right_view(mp_video_input->get_right_image());
+
+    gil2opencv(mp_video_input->get_left_image(), m_currLeft);
+    mp_stixel_world_estimator->set_rectified_images_pair(left_view, right_view);
+    {
+        STIXEL_TIMED_SCOPE("StixelWorldEstimator::compute");
+        mp_stixel_world_estimator->compute();
+    }
+
+    m_rectified = false;
+    m_tracked = false;
+    if (! rectifyPolar())
+        return true;
+    m_rectified = true;
+
+    mp_stixel_motion_estimator->set_new_rectified_image(left_view);
+    {
+        STIXEL_TIMED_SCOPE("StixelsTracker::updateDenseTracker");
+        mp_stixel_motion_estimator->updateDenseTracker(m_currLeft);
+    }
+    mp_stixel_motion_estimator->set_estimated_stixels(mp_stixel_world_estimator->get_stixels());
+
+    if (! m_firstIteration) {
+        mp_stixel_motion_estimator->compute();
+        m_tracked = true;
+    } else {
+        m_firstIteration = false;
+    }
+
+    return true;
+}
+
+void StixelsBenchmark::update()
+{
+    STIXEL_TIMED_SCOPE("StixelsBenchmark::update");
+
+    const stixel_world::input_image_const_view_t & currLeft = mp_video_input->get_left_image();
+    const stixel_world::input_image_const_view_t & currRight = mp_video_input->get_right_image();
+
+    doppia::AbstractVideoInput::input_image_t bufferImgL(currLeft.dimensions());
+    doppia::AbstractVideoInput::input_image_t bufferImgR(currRight.dimensions());
+    boost::gil::copy_pixels(currLeft, boost::gil::view(bufferImgL));
+    boost::gil::copy_pixels(currRight, boost::gil::view(bufferImgR));
+
+    m_frameBufferLeft.push_back(bufferImgL);
+    m_frameBufferRight.push_back(bufferImgR);
+
+    if (m_frameBufferLeft.size() > m_frameBufferLength)
+        m_frameBufferLeft.pop_front();
+    if (m_frameBufferRight.size() > m_frameBufferLength)
+        m_frameBufferRight.pop_front();
+
+    mp_stixel_motion_estimator->set_estimated_stixels(mp_stixel_world_estimator->get_stixels());
+
+    updateDigest(mp_video_input->get_current_frame_number(), mp_stixel_world_estimator->get_stixels());
+
+    if (mp_recordingWriter)
+        recordFrame();
+
+    if (! m_params.captureDir.empty()) {
+        cv::Mat currRightImg;
+        gil2opencv(currRight, currRightImg);
+        StixelsCapture::writeFrame(m_params.captureDir, mp_video_input->get_current_frame_number(),
+                                   m_currLeft, currRightImg, mp_stixel_world_estimator->get_stixels());
+    }
+}
+
+bool StixelsBenchmark::rectifyPolar()
+{
+    STIXEL_TIMED_SCOPE("StixelsBenchmark::rectifyPolar");
+
+    if (m_frameBufferLeft.size() < m_frameBufferLength)
+        return false;
+
+    cv::Mat prevLeft, prevRight, currRight, FL, FR;
+    gil2opencv(boost::gil::view(m_frameBufferLeft[0]), prevLeft);
+
+    bool reuseF;
+    {
+        STIXEL_TIMED_SCOPE("FundamentalMatrixReusePolicy::canReuse");
+        reuseF = m_fReusePolicy.canReuse(prevLeft, m_currLeft);
+    }
+
+    if (! reuseF) {
+        gil2opencv(boost::gil::view(m_frameBufferRight[0]), prevRight);
+        gil2opencv(mp_video_input->get_right_image(), currRight);
+        vector < vector < cv::Point2f > > correspondences;
+
+        STIXEL_TIMER_START(findFTimer, "FundamentalMatrixEstimator::findF");
+        if (! FundamentalMatrixEstimator::findF(prevLeft, prevRight, m_currLeft, currRight, FL, FR, correspondences,
+                                                m_params.fBinaryMatching? FundamentalMatrixEstimator::METHOD_BINARY :
+                                                                          FundamentalMatrixEstimator::METHOD_OFLOW,
+                                                50, &m_flowPyramids,
+                                                m_params.fFeatureTracks? &m_featureTracks : NULL, mp_robustF.get())) {
+            m_fReusePolicy.reset();
+            m_featureTracks.reset();
+            if (mp_robustF)
+                mp_robustF->reset();
+            return false;
+        }
+        STIXEL_TIMER_STOP(findFTimer);
+
+        STIXEL_TIMER_START(polarTimer, "PolarCalibration::compute");
+        if (! mp_polarCalibration->compute(prevLeft, m_currLeft, FL, correspondences[0], correspondences[3])) {
+            m_fReusePolicy.reset();
+            return false;
+        }
+        STIXEL_TIMER_STOP(polarTimer);
+
+        m_fReusePolicy.setF(FL);
+    }
+
+    {
+        STIXEL_TIMED_SCOPE("PolarCalibration::rectifyAndStoreImages");
+        mp_polarCalibration->rectifyAndStoreImages(prevLeft, m_currLeft);
+    }
+
+    return true;
+}
+
+void StixelsBenchmark::recordFrame()
+{
+    STIXEL_TIMED_SCOPE("StixelsBenchmark::recordFrame");
+
+    StixelsRecording::t_frame frame;
+    frame.frame = mp_video_input->get_current_frame_number();
+    frame.rectified = m_rectified;
+    frame.tracked = m_tracked;
+    if (m_rectified)
+        frame.left = m_currLeft;
+    frame.stixels = mp_stixel_world_estimator->get_stixels();
+    // What the tracker read in compute()
+    frame.hasPolarProducts = m_tracked;
+    if (m_tracked)
+        frame.polarProducts = mp_stixel_motion_estimator->get_polar_products();
+    frame.hasDenseFlowVotes = m_tracked && (! mp_stixel_motion_estimator->get_dense_flow_votes().empty());
+    if (frame.hasDenseFlowVotes)
+        frame.denseFlowVotes = mp_stixel_motion_estimator->get_dense_flow_votes();
+
+    mp_recordingWriter->addFrame(frame);
+}
+
+bool StixelsBenchmark::replay()
+{
+    STIXEL_TIMED_SCOPE("StixelsBenchmark::replay");
+
+    {
+        STIXEL_TIMED_SCOPE("StixelsRecordingReader::readFrame");
+        if (! mp_recordingReader->readFrame(m_replayFrame))
+            return false;
+    }
+
+    STIXEL_TRACE_FRAME(m_replayFrame.frame);
+
+    // Same calls as iterate() and update() do on the tracker
+    m_rectified = m_replayFrame.rectified;
+    m_tracked = false;
+    if (m_replayFrame.rectified) {
+        if ((m_replayImage.width() != m_replayFrame.left.cols) || (m_replayImage.height() != m_replayFrame.left.rows))
+            m_replayImage = doppia::AbstractVideoInput::input_image_t(m_replayFrame.left.cols, m_replayFrame.left.rows);
+        doppia::AbstractVideoInput::input_image_view_t replayView = boost::gil::view(m_replayImage);
+        opencv2gil(m_replayFrame.left, replayView);
+
+        mp_stixel_motion_estimator->set_new_rectified_image(replayView);
+        mp_stixel_motion_estimator->set_estimated_stixels(m_replayFrame.stixels);
+
+        if (m_replayFrame.tracked) {
+            if (m_replayFrame.hasPolarProducts)
+                mp_stixel_motion_estimator->set_polar_products(m_replayFrame.polarProducts);
+            if (m_replayFrame.hasDenseFlowVotes)
+                mp_stixel_motion_estimator->set_dense_flow_votes(m_replayFrame.denseFlowVotes);
+            mp_stixel_motion_estimator->compute();
+            m_tracked = true;
+        }
+    }
+    mp_stixel_motion_estimator->set_estimated_stixels(m_replayFrame.stixels);
+
+    updateDigest(m_replayFrame.frame, m_replayFrame.stixels);
+
+    return true;
+}
+
+void StixelsBenchmark::updateDigest(const int32_t& frame, const stixels_t& stixels)
+{
+    hashValue(m_digest, frame);
+
+    hashValue(m_digest, stixels.size());
+    for (stixels_t::const_iterator it = stixels.begin(); it != stixels.end(); it++) {
+        hashValue(m_digest, it->x);
+        hashValue(m_digest, it->bottom_y);
+        hashValue(m_digest, it->top_y);
+        hashValue(m_digest, it->disparity);
+    }
+
+    // Frames in which the tracker did not run leave the previous results untouched
+    hashValue(m_digest, m_tracked);
+    if (! m_tracked)
+        return;
+
+    const doppia::AbstractStixelMotionEstimator::stixels_motion_t & motion =
+                                                        mp_stixel_motion_estimator->get_stixels_motion();
+    hashValue(m_digest, motion.size());
+    for (uint32_t i = 0; i < motion.size(); i++)
+        hashValue(m_digest, motion[i]);
+
+    const StixelsTracker::t_obstaclesTracker & obstaclesTracker = mp_stixel_motion_estimator->getObstaclesTracker();
+    hashValue(m_digest, obstaclesTracker.size());
+    for (uint32_t i = 0; i < obstaclesTracker.size(); i++) {
+        const StixelsTracker::t_obstaclesTrack & obstacleTrack = obstaclesTracker[i];
+        hashValue(m_digest, obstacleTrack.track.size());
+        hashValue(m_digest, obstacleTrack.validCount);
+        if (obstacleTrack.track.empty())
+            continue;
+
+        const cv::Rect & roi = obstacleTrack.track.front().roi;
+        hashValue(m_digest, roi.x);
+        hashValue(m_digest, roi.y);
+        hashValue(m_digest, roi.width);
+        hashValue(m_digest, roi.height);
+    }
+}
+
+double StixelsBenchmark::getFramesPerSecond() const
+{
+    if (m_elapsedTime <= 0.0)
+        return 0.0;
+
+    return m_processedFrames / m_elapsedTime;
+}
+
+uint64_t StixelsBenchmark::getPeakRSS()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+    return usage.ru_maxrss;
+}
+
+void StixelsBenchmark::printReport(ostream& out) const
+{
+    out << "frames " << m_processedFrames << endl;
+    out << "elapsed_s " << m_elapsedTime << endl;
+    out << "fps " << getFramesPerSecond() << endl;
+    out << "peak_rss_kb " << getPeakRSS() << endl;
+    out << "digest " << hex << setw(16) << setfill('0') << m_digest << dec << setfill(' ') << endl;
+    if (m_fReusePolicy.enabled()) {
+        out << "f_reused " << m_fReusePolicy.getReusedFrames() << endl;
+        out << "f_recomputed " << m_fReusePolicy.getRecomputedFrames() << endl;
+    }
+    if (m_params.fFeatureTracks) {
+        out << "f_tracked_points " << m_featureTracks.getTrackedPoints() << endl;
+        out << "f_detected_points " << m_featureTracks.getDetectedPoints() << endl;
+    }
+
+    if (! StageTimings::enabled())
+        return;
+
+    vector<StageTimings::t_stage_statistics> statistics;
+    StageTimings::getStatistics(statistics);
+
+    out << endl << left << setw(48) << "stage" << right << setw(8) << "count"
+        << setw(12) << "mean_ms" << setw(12) << "p50_ms" << setw(12) << "p95_ms"
+        << setw(12) << "p99_ms" << setw(12) << "max_ms" << endl;
+    out << fixed << setprecision(3);
+    for (uint32_t i = 0; i < statistics.size(); i++) {
+        const StageTimings::t_stage_statistics & stats = statistics[i];
+        out << left << setw(48) << stats.name << right << setw(8) << stats.count
+            << setw(12) << stats.mean * 1e3 << setw(12) << stats.p50 * 1e3 << setw(12) << stats.p95 * 1e3
+            << setw(12) << stats.p99 * 1e3 << setw(12) << stats.max * 1e3 << endl;
+    }
+    out.unsetf(ios::fixed);
+}
+
+}
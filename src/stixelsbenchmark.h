@@ -0,0 +1,127 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef STIXELSBENCHMARK_H
+#define STIXELSBENCHMARK_H
+
+#include <string>
+#include <deque>
+#include <ostream>
+
+#include <boost/program_options.hpp>
+
+#include "utils.h"
+#include "polarcalibration.h"
+
+#include "video_input/AbstractVideoInput.hpp"
+#include "stereo_matching/stixels/AbstractStixelWorldEstimator.hpp"
+#include "stixelstracker.h"
+#include "stixelsrecording.h"
+#include "fundamentalmatrixestimator.h"
+
+namespace stixel_world {
+
+///
+/// Runs the same pipeline as StixelsApplicationROS (stixels, polar rectification and tracking)
+/// without ROS and without windows, so it can be timed on any machine.
+/// Besides the stage timings, it keeps a digest of the tracking output, that should not change
+/// between runs of the same sequence unless the results of the pipeline change.
+///
+/// In replay mode, the tracker is fed from a StixelsRecording instead, so it can be tuned and timed
+/// without the rest of the pipeline. Replaying a recording gives the same digest as the run that
+/// recorded it, as long as the tracker parameters are the same.
+///
+class StixelsBenchmark
+{
+public:
+    typedef struct {
+        bool useGraph, useCostMatrix, useObjects, twoLevelsTracking;
+        double SADFactor, heightFactor, polarDistFactor, polarSADFactor, histBatFactor;
+        int increment;
+        uint32_t maxFrames;     // 0 processes the whole sequence
+        std::string captureDir; // if not empty, the tracker input of each frame is stored there (see StixelsCapture)
+        std::string recordFile; // if not empty, everything the tracker reads is appended there (see StixelsRecording)
+        std::string replayFile; // if not empty, only the tracker is run, on this recording
+        double fReuseMaxError;  // 0 estimates F again at every frame (see FundamentalMatrixReusePolicy)
+        uint32_t fReuseMaxFrames;
+        bool fFeatureTracks;    // corners for F followed between frames (see FeatureTracks)
+        bool fBinaryMatching;   // FundamentalMatrixEstimator::METHOD_BINARY instead of METHOD_OFLOW
+        bool fRobust;           // RobustFundamentalMatrix instead of LMedS
+        double fRobustBudget;
+        bool processingBand;    // the tracker only works on the rows the stixels can lie on (see ProcessingBand)
+        double processingBandMinDistance;
+        int32_t processingBandMargin;
+        std::string rectificationCacheDir; // if not empty, overrides preprocess.rectification_cache_dir
+    } t_benchmark_params;
+
+    StixelsBenchmark(const std::string & optionsFile, const t_benchmark_params & params);
+
+    void run();
+
+    uint64_t getProcessedFrames() const { return m_processedFrames; }
+    double getElapsedTime() const { return m_elapsedTime; }
+    double getFramesPerSecond() const;
+    uint64_t getDigest() const { return m_digest; }
+    /// Peak resident set size of the process, in kB
+    static uint64_t getPeakRSS();
+
+    void printReport(std::ostream & out) const;
+
+    static boost::program_options::options_description get_args_options();
+    /// Parameters from arguments parsed with get_args_options
+    static t_benchmark_params get_params(const boost::program_options::variables_map & args);
+private:
+    boost::program_options::variables_map parseOptionsFile(const std::string & optionsFile);
+    bool iterate();
+    void update();
+    bool rectifyPolar();
+    bool replay();
+    void recordFrame();
+    void updateDigest(const int32_t & frame, const doppia::stixels_t & stixels);
+
+    boost::shared_ptr<doppia::AbstractVideoInput> mp_video_input;
+    boost::shared_ptr<doppia::AbstractStixelWorldEstimator> mp_stixel_world_estimator;
+    boost::shared_ptr<StixelsTracker> mp_stixel_motion_estimator;
+    boost::shared_ptr<PolarCalibration> mp_polarCalibration;
+    FundamentalMatrixReusePolicy m_fReusePolicy;
+    OpticalFlowPyramids m_flowPyramids;
+    FeatureTracks m_featureTracks;
+    boost::shared_ptr<RobustFundamentalMatrix> mp_robustF;
+
+    std::deque <doppia::AbstractVideoInput::input_image_t> m_frameBufferLeft, m_frameBufferRight;
+    uint32_t m_frameBufferLength;
+
+    boost::program_options::variables_map m_options;
+    t_benchmark_params m_params;
+
+    cv::Mat m_currLeft;
+    bool m_firstIteration;
+    bool m_rectified;
+    bool m_tracked;
+
+    boost::shared_ptr<StixelsRecordingWriter> mp_recordingWriter;
+    boost::shared_ptr<StixelsRecordingReader> mp_recordingReader;
+    StixelsRecording::t_frame m_replayFrame;
+    doppia::AbstractVideoInput::input_image_t m_replayImage;
+
+    uint64_t m_processedFrames;
+    double m_elapsedTime;
+    uint64_t m_digest;
+};
+
+}
+
+#endif // STIXELSBENCHMARK_H
@@ -0,0 +1,105 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include "stixelscapture.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+
+using namespace std;
+
+namespace stixel_world {
+
+static string getFramePath(const string & folder, const string & prefix, const uint32_t & frame, const string & extension)
+{
+    char name[64];
+    sprintf(name, "%s_%08u.%s", prefix.c_str(), frame, extension.c_str());
+    return (boost::filesystem::path(folder) / name).string();
+}
+
+template <typename T>
+static inline void setEnumValue(T & value, const int & rawValue)
+{
+    value = (T)rawValue;
+}
+
+void StixelsCapture::writeFrame(const string& folder, const uint32_t& frame,
+                                const cv::Mat& left, const cv::Mat& right, const doppia::stixels_t& stixels)
+{
+    boost::filesystem::create_directories(folder);
+
+    cv::imwrite(getFramePath(folder, "left", frame, "png"), left);
+    cv::imwrite(getFramePath(folder, "right", frame, "png"), right);
+
+    const string stixelsFilename = getFramePath(folder, "stixels", frame, "txt");
+    ofstream fout(stixelsFilename.c_str());
+    if (! fout.good())
+        throw std::runtime_error("Could not write " + stixelsFilename);
+
+    for (doppia::stixels_t::const_iterator it = stixels.begin(); it != stixels.end(); it++) {
+        fout << it->x << " " << it->width << " " << it->bottom_y << " " << it->top_y << " "
+             << it->disparity << " " << (int)it->type << endl;
+    }
+}
+
+bool StixelsCapture::readFrame(const string& folder, const uint32_t& frame,
+                               cv::Mat& left, cv::Mat& right, doppia::stixels_t& stixels)
+{
+    left = cv::imread(getFramePath(folder, "left", frame, "png"));
+    right = cv::imread(getFramePath(folder, "right", frame, "png"));
+    ifstream fin(getFramePath(folder, "stixels", frame, "txt").c_str());
+    if (left.empty() || right.empty() || (! fin.good()))
+        return false;
+
+    stixels.clear();
+    doppia::Stixel stixel;
+    float disparity;
+    int type;
+    while (fin >> stixel.x >> stixel.width >> stixel.bottom_y >> stixel.top_y >> disparity >> type) {
+        stixel.disparity = disparity;
+        setEnumValue(stixel.type, type);
+        stixels.push_back(stixel);
+    }
+
+    return true;
+}
+
+void StixelsCapture::listFrames(const string& folder, vector<uint32_t>& frames)
+{
+    frames.clear();
+    if (! boost::filesystem::is_directory(folder))
+        return;
+
+    for (boost::filesystem::directory_iterator it(folder), end; it != end; it++) {
+        uint32_t frame;
+        if (sscanf(it->path().filename().string().c_str(), "stixels_%08u.txt", &frame) == 1)
+            frames.push_back(frame);
+    }
+    std::sort(frames.begin(), frames.end());
+}
+
+string StixelsCapture::getCalibrationFilename(const string& folder)
+{
+    return (boost::filesystem::path(folder) / "stereo_calibration.proto.txt").string();
+}
+
+}
@@ -0,0 +1,53 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef STIXELSCAPTURE_H
+#define STIXELSCAPTURE_H
+
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "stereo_matching/stixels/Stixel.hpp"
+
+namespace stixel_world {
+
+///
+/// Frames captured from the pipeline (rectified images and estimated stixels), so the tracker
+/// can be fed with real data without running the rest of the pipeline.
+///
+/// Each frame is stored in a folder as left_%08i.png, right_%08i.png and stixels_%08i.txt, with a
+/// stixel per line (x width bottom_y top_y disparity type). The stereo calibration is copied
+/// as stereo_calibration.proto.txt.
+///
+class StixelsCapture
+{
+public:
+    static void writeFrame(const std::string & folder, const uint32_t & frame,
+                           const cv::Mat & left, const cv::Mat & right, const doppia::stixels_t & stixels);
+    static bool readFrame(const std::string & folder, const uint32_t & frame,
+                          cv::Mat & left, cv::Mat & right, doppia::stixels_t & stixels);
+
+    /// Frame numbers available in the folder, sorted
+    static void listFrames(const std::string & folder, std::vector<uint32_t> & frames);
+
+    static std::string getCalibrationFilename(const std::string & folder);
+};
+
+}
+
+#endif // STIXELSCAPTURE_H
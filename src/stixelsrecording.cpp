@@ -0,0 +1,265 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include "stixelsrecording.h"
+
+#include <string.h>
+#include <stdexcept>
+
+using namespace std;
+
+namespace stixel_world {
+
+static const char RECORDING_MAGIC[8] = { 'S', 'W', 'R', 'E', 'C', 'O', 'R', 'D' };
+
+const uint32_t StixelsRecording::VERSION;
+const uint32_t StixelsRecording::FLAG_RECTIFIED;
+const uint32_t StixelsRecording::FLAG_TRACKED;
+const uint32_t StixelsRecording::FLAG_POLAR;
+const uint32_t StixelsRecording::FLAG_DENSE_FLOW;
+
+template <class T>
+static inline void setEnumValue(T & value, const int & rawValue)
+{
+    value = (T)rawValue;
+}
+
+static inline uint64_t getMatSize(const cv::Mat & mat)
+{
+    return sizeof(StixelsRecording::t_mat_header) + (uint64_t)mat.total() * mat.elemSize();
+}
+
+// The polar products in the order they are stored
+static inline void getPolarMats(const StixelsTracker::t_polar_products & polar, const cv::Mat * mats[8])
+{
+    mats[0] = &polar.polarImg1;
+    mats[1] = &polar.polarImg2;
+    mats[2] = &polar.mapXprev;
+    mats[3] = &polar.mapYprev;
+    mats[4] = &polar.mapXcurr;
+    mats[5] = &polar.mapYcurr;
+    mats[6] = &polar.currPolar2LinearX;
+    mats[7] = &polar.currPolar2LinearY;
+}
+
+StixelsRecordingWriter::StixelsRecordingWriter(const string& filename, const uint32_t& stixelWidth,
+                                               const uint32_t& frameGap) : m_numFrames(0)
+{
+    mp_file = fopen(filename.c_str(), "wb");
+    if (mp_file == NULL)
+        throw std::runtime_error("Could not create the stixels recording " + filename);
+
+    StixelsRecording::t_file_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+    header.version = StixelsRecording::VERSION;
+    header.stixelWidth = stixelWidth;
+    header.frameGap = frameGap;
+    write(&header, sizeof(header));
+}
+
+StixelsRecordingWriter::~StixelsRecordingWriter()
+{
+    fclose(mp_file);
+}
+
+void StixelsRecordingWriter::write(const void* data, const uint64_t& size)
+{
+    if (fwrite(data, 1, size, mp_file) != size)
+        throw std::runtime_error("Error writing the stixels recording");
+}
+
+void StixelsRecordingWriter::writeMat(const cv::Mat& mat)
+{
+    StixelsRecording::t_mat_header header;
+    header.rows = mat.rows;
+    header.cols = mat.cols;
+    header.type = mat.type();
+    write(&header, sizeof(header));
+
+    for (int32_t y = 0; y < mat.rows; y++)
+        write(mat.ptr(y), mat.cols * mat.elemSize());
+}
+
+void StixelsRecordingWriter::addFrame(const StixelsRecording::t_frame& frame)
+{
+    const cv::Mat * polarMats[8];
+    getPolarMats(frame.polarProducts, polarMats);
+
+    StixelsRecording::t_record_header header;
+    memset(&header, 0, sizeof(header));
+    header.frame = frame.frame;
+    header.flags = (frame.rectified? StixelsRecording::FLAG_RECTIFIED : 0) |
+                   (frame.tracked? StixelsRecording::FLAG_TRACKED : 0) |
+                   (frame.hasPolarProducts? StixelsRecording::FLAG_POLAR : 0) |
+                   (frame.hasDenseFlowVotes? StixelsRecording::FLAG_DENSE_FLOW : 0);
+    header.numStixels = frame.stixels.size();
+
+    // The size goes first, so the record is written in a single pass
+    header.size = getMatSize(frame.left) + frame.stixels.size() * sizeof(StixelsRecording::t_recorded_stixel);
+    if (frame.hasPolarProducts) {
+        for (uint32_t i = 0; i < 8; i++)
+            header.size += getMatSize(*polarMats[i]);
+    }
+    if (frame.hasDenseFlowVotes) {
+        if (frame.denseFlowVotes.size() != frame.stixels.size())
+            throw std::invalid_argument("The dense flow votes do not correspond to the recorded stixels");
+        for (uint32_t i = 0; i < frame.denseFlowVotes.size(); i++)
+            header.size += sizeof(uint32_t) + frame.denseFlowVotes[i].size() * 2 * sizeof(uint32_t);
+    }
+    write(&header, sizeof(header));
+
+    writeMat(frame.left);
+
+    for (doppia::stixels_t::const_iterator it = frame.stixels.begin(); it != frame.stixels.end(); it++) {
+        StixelsRecording::t_recorded_stixel stixel;
+        stixel.x = it->x;
+        stixel.width = it->width;
+        stixel.bottom_y = it->bottom_y;
+        stixel.top_y = it->top_y;
+        stixel.disparity = it->disparity;
+        stixel.type = it->type;
+        write(&stixel, sizeof(stixel));
+    }
+
+    if (frame.hasPolarProducts) {
+        for (uint32_t i = 0; i < 8; i++)
+            writeMat(*polarMats[i]);
+    }
+
+    if (frame.hasDenseFlowVotes) {
+        for (uint32_t i = 0; i < frame.denseFlowVotes.size(); i++) {
+            const uint32_t numVotes = frame.denseFlowVotes[i].size();
+            write(&numVotes, sizeof(uint32_t));
+            for (uint32_t j = 0; j < numVotes; j++) {
+                const int32_t column = frame.denseFlowVotes[i][j].first;
+                const uint32_t rows = frame.denseFlowVotes[i][j].second;
+                write(&column, sizeof(int32_t));
+                write(&rows, sizeof(uint32_t));
+            }
+        }
+    }
+
+    // A crash only loses the frame being written
+    fflush(mp_file);
+    m_numFrames++;
+}
+
+StixelsRecordingReader::StixelsRecordingReader(const string& filename)
+{
+    mp_file = fopen(filename.c_str(), "rb");
+    if (mp_file == NULL)
+        throw std::invalid_argument("Could not open the stixels recording " + filename);
+
+    if ((! read(&m_header, sizeof(m_header))) || (memcmp(m_header.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) != 0)) {
+        fclose(mp_file);
+        throw std::invalid_argument("The file " + filename + " is not a stixels recording");
+    }
+    if (m_header.version != StixelsRecording::VERSION) {
+        fclose(mp_file);
+        throw std::invalid_argument("Unsupported stixels recording version");
+    }
+}
+
+StixelsRecordingReader::~StixelsRecordingReader()
+{
+    fclose(mp_file);
+}
+
+bool StixelsRecordingReader::read(void* data, const uint64_t& size)
+{
+    return fread(data, 1, size, mp_file) == size;
+}
+
+bool StixelsRecordingReader::readMat(cv::Mat& mat)
+{
+    StixelsRecording::t_mat_header header;
+    if (! read(&header, sizeof(header)))
+        return false;
+
+    // Buffers are reused between frames when the size does not change
+    mat.create(header.rows, header.cols, header.type);
+    if (mat.empty())
+        return true;
+
+    return read(mat.data, (uint64_t)mat.total() * mat.elemSize());
+}
+
+bool StixelsRecordingReader::readFrame(StixelsRecording::t_frame& frame)
+{
+    StixelsRecording::t_record_header header;
+    if (! read(&header, sizeof(header)))
+        return false;
+
+    frame.frame = header.frame;
+    frame.rectified = (header.flags & StixelsRecording::FLAG_RECTIFIED) != 0;
+    frame.tracked = (header.flags & StixelsRecording::FLAG_TRACKED) != 0;
+    frame.hasPolarProducts = (header.flags & StixelsRecording::FLAG_POLAR) != 0;
+    frame.hasDenseFlowVotes = (header.flags & StixelsRecording::FLAG_DENSE_FLOW) != 0;
+
+    if (! readMat(frame.left))
+        return false;
+
+    frame.stixels.resize(header.numStixels);
+    for (uint32_t i = 0; i < header.numStixels; i++) {
+        StixelsRecording::t_recorded_stixel recorded;
+        if (! read(&recorded, sizeof(recorded)))
+            return false;
+
+        doppia::Stixel & stixel = frame.stixels[i];
+        stixel.x = recorded.x;
+        stixel.width = recorded.width;
+        stixel.bottom_y = recorded.bottom_y;
+        stixel.top_y = recorded.top_y;
+        stixel.disparity = recorded.disparity;
+        setEnumValue(stixel.type, recorded.type);
+    }
+
+    if (frame.hasPolarProducts) {
+        cv::Mat * polarMats[8] = {
+            &frame.polarProducts.polarImg1, &frame.polarProducts.polarImg2,
+            &frame.polarProducts.mapXprev, &frame.polarProducts.mapYprev,
+            &frame.polarProducts.mapXcurr, &frame.polarProducts.mapYcurr,
+            &frame.polarProducts.currPolar2LinearX, &frame.polarProducts.currPolar2LinearY
+        };
+        for (uint32_t i = 0; i < 8; i++) {
+            if (! readMat(*polarMats[i]))
+                return false;
+        }
+    }
+
+    if (frame.hasDenseFlowVotes) {
+        frame.denseFlowVotes.resize(header.numStixels);
+        for (uint32_t i = 0; i < header.numStixels; i++) {
+            uint32_t numVotes;
+            if (! read(&numVotes, sizeof(uint32_t)))
+                return false;
+            frame.denseFlowVotes[i].resize(numVotes);
+            for (uint32_t j = 0; j < numVotes; j++) {
+                int32_t column;
+                uint32_t rows;
+                if ((! read(&column, sizeof(int32_t))) || (! read(&rows, sizeof(uint32_t))))
+                    return false;
+                frame.denseFlowVotes[i][j] = make_pair(column, rows);
+            }
+        }
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,135 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef STIXELSRECORDING_H
+#define STIXELSRECORDING_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+
+#include <opencv2/opencv.hpp>
+
+#include "stereo_matching/stixels/Stixel.hpp"
+#include "stixelstracker.h"
+
+namespace stixel_world {
+
+///
+/// Everything StixelsTracker reads in a frame, so the tracker can be replayed without running
+/// the stixels estimation, the fundamental matrix estimation nor the polar rectification.
+///
+/// Layout (little endian, append only):
+///   t_file_header
+///   records: t_record_header, then
+///     left image (empty if not FLAG_RECTIFIED)
+///     numStixels x t_recorded_stixel
+///     if FLAG_POLAR: polarImg1, polarImg2, mapXprev, mapYprev, mapXcurr, mapYcurr,
+///                    currPolar2LinearX, currPolar2LinearY
+///     if FLAG_DENSE_FLOW: for each stixel, uint32 numVotes and numVotes x (int32 column, uint32 rows)
+///
+/// Images are stored as t_mat_header followed by the raw rows. Each record is flushed once written,
+/// and a truncated last record (an interrupted recording) is ignored by the reader.
+///
+class StixelsRecording
+{
+public:
+    static const uint32_t VERSION = 1;
+
+    static const uint32_t FLAG_RECTIFIED = 1;       // polar rectification worked, the tracker got the image
+    static const uint32_t FLAG_TRACKED = 2;         // the tracker ran in this frame
+    static const uint32_t FLAG_POLAR = 4;
+    static const uint32_t FLAG_DENSE_FLOW = 8;
+
+    typedef struct {
+        char magic[8];
+        uint32_t version;
+        uint32_t stixelWidth;
+        uint32_t frameGap;
+        uint32_t reserved;
+    } t_file_header;
+
+    typedef struct {
+        int32_t frame;
+        uint32_t flags;
+        uint32_t numStixels;
+        uint32_t reserved;
+        uint64_t size;          // bytes after this header
+    } t_record_header;
+
+    typedef struct {
+        int32_t x, width, bottom_y, top_y;
+        float disparity;
+        int32_t type;
+    } t_recorded_stixel;
+
+    typedef struct {
+        int32_t rows, cols, type;
+    } t_mat_header;
+
+    typedef struct {
+        int32_t frame;
+        bool rectified;
+        bool tracked;
+        cv::Mat left;
+        doppia::stixels_t stixels;
+        bool hasPolarProducts;
+        StixelsTracker::t_polar_products polarProducts;
+        bool hasDenseFlowVotes;
+        StixelsTracker::t_dense_flow_votes denseFlowVotes;
+    } t_frame;
+};
+
+class StixelsRecordingWriter
+{
+public:
+    StixelsRecordingWriter(const std::string & filename, const uint32_t & stixelWidth, const uint32_t & frameGap);
+    ~StixelsRecordingWriter();
+
+    void addFrame(const StixelsRecording::t_frame & frame);
+
+    uint32_t getNumberOfFrames() const { return m_numFrames; }
+protected:
+    void write(const void * data, const uint64_t & size);
+    void writeMat(const cv::Mat & mat);
+
+    FILE * mp_file;
+    uint32_t m_numFrames;
+};
+
+class StixelsRecordingReader
+{
+public:
+    StixelsRecordingReader(const std::string & filename);
+    ~StixelsRecordingReader();
+
+    uint32_t getStixelWidth() const { return m_header.stixelWidth; }
+    uint32_t getFrameGap() const { return m_header.frameGap; }
+
+    /// Reads the next frame. Returns false at the end of the recording
+    bool readFrame(StixelsRecording::t_frame & frame);
+protected:
+    bool read(void * data, const uint64_t & size);
+    bool readMat(cv::Mat & mat);
+
+    FILE * mp_file;
+    StixelsRecording::t_file_header m_header;
+};
+
+}
+
+#endif // STIXELSRECORDING_H
@@ -0,0 +1,221 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include "stixelsshm.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace stixel_world {
+
+const uint32_t StixelsShm::MAGIC;
+const uint32_t StixelsShm::VERSION;
+const uint32_t StixelsShm::MAX_STIXELS;
+const uint32_t StixelsShm::MAX_OBSTACLES;
+
+size_t StixelsShm::getMappingSize(const uint32_t& numSlots)
+{
+    // The header is padded to the cache line, and so is each frame (t_frame is aligned to 64 bytes)
+    const size_t headerSize = (sizeof(t_header) + 63) & ~(size_t)63;
+    return headerSize + numSlots * sizeof(t_frame);
+}
+
+static size_t getFramesOffset()
+{
+    return StixelsShm::getMappingSize(0);
+}
+
+StixelsShmWriter::StixelsShmWriter(const string& name, const uint32_t& numSlots) : m_name(name)
+{
+    if (numSlots < 2)
+        throw std::invalid_argument("The stixels shared memory ring needs at least 2 slots");
+
+    // A ring left by a previous run that crashed is replaced
+    shm_unlink(name.c_str());
+    const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+        throw std::runtime_error("Could not create the shared memory object " + name);
+
+    m_size = StixelsShm::getMappingSize(numSlots);
+    void * mapping = MAP_FAILED;
+    if (ftruncate(fd, m_size) == 0)
+        mapping = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        throw std::runtime_error("Could not map the shared memory object " + name);
+    }
+
+    // ftruncate already zero filled it, so every slot starts as an empty frame with sequence 0
+    mp_header = (StixelsShm::t_header *)mapping;
+    mp_frames = (StixelsShm::t_frame *)((uint8_t *)mapping + getFramesOffset());
+    mp_header->version = StixelsShm::VERSION;
+    mp_header->numSlots = numSlots;
+    mp_header->frameSize = sizeof(StixelsShm::t_frame);
+    mp_header->lastSequence = 0;
+    m_sequence = 0;
+
+    // Readers check the magic last, so they never see a partially initialized header
+    __sync_synchronize();
+    mp_header->magic = StixelsShm::MAGIC;
+}
+
+StixelsShmWriter::~StixelsShmWriter()
+{
+    // Readers keep their mapping until they unmap it
+    munmap(mp_header, m_size);
+    shm_unlink(m_name.c_str());
+}
+
+void StixelsShmWriter::setCamera(const float& focalX, const float& focalY, const float& centerX, const float& centerY,
+                                 const float& baseline, const float& cameraHeight)
+{
+    mp_header->focal_x = focalX;
+    mp_header->focal_y = focalY;
+    mp_header->center_x = centerX;
+    mp_header->center_y = centerY;
+    mp_header->baseline = baseline;
+    mp_header->camera_height = cameraHeight;
+}
+
+StixelsShm::t_frame * StixelsShmWriter::beginFrame()
+{
+    StixelsShm::t_frame * frame = &mp_frames[(m_sequence + 1) % mp_header->numSlots];
+    frame->sequence = 2 * m_sequence + 1;
+    __sync_synchronize();
+
+    return frame;
+}
+
+void StixelsShmWriter::commitFrame()
+{
+    m_sequence++;
+    StixelsShm::t_frame * frame = &mp_frames[m_sequence % mp_header->numSlots];
+    frame->numStixels = std::min(frame->numStixels, StixelsShm::MAX_STIXELS);
+    frame->numObstacles = std::min(frame->numObstacles, StixelsShm::MAX_OBSTACLES);
+    __sync_synchronize();
+    frame->sequence = 2 * m_sequence;
+    __sync_synchronize();
+    mp_header->lastSequence = m_sequence;
+}
+
+StixelsShmReader::StixelsShmReader(const string& name)
+{
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        throw std::invalid_argument("The shared memory object " + name + " does not exist");
+
+    struct stat fileStat;
+    void * mapping = MAP_FAILED;
+    if ((fstat(fd, &fileStat) == 0) && ((size_t)fileStat.st_size >= sizeof(StixelsShm::t_header))) {
+        m_size = fileStat.st_size;
+        mapping = mmap(NULL, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error("Could not map the shared memory object " + name);
+
+    mp_header = (const StixelsShm::t_header *)mapping;
+    mp_frames = (const StixelsShm::t_frame *)((const uint8_t *)mapping + getFramesOffset());
+
+    const bool valid = (mp_header->magic == StixelsShm::MAGIC) && (mp_header->version == StixelsShm::VERSION) &&
+                       (mp_header->frameSize == sizeof(StixelsShm::t_frame)) &&
+                       (m_size >= StixelsShm::getMappingSize(mp_header->numSlots));
+    __sync_synchronize();
+    if (! valid) {
+        munmap((void *)mp_header, m_size);
+        throw std::invalid_argument("The shared memory object " + name + " is not a compatible stixels ring");
+    }
+}
+
+StixelsShmReader::~StixelsShmReader()
+{
+    munmap((void *)mp_header, m_size);
+}
+
+const StixelsShm::t_frame* StixelsShmReader::acquireLatest(uint64_t& sequence) const
+{
+    for (;;) {
+        sequence = mp_header->lastSequence;
+        if (sequence == 0)
+            return NULL;
+        __sync_synchronize();
+
+        const StixelsShm::t_frame * frame = &mp_frames[sequence % mp_header->numSlots];
+        if (frame->sequence == 2 * sequence) {
+            __sync_synchronize();
+            return frame;
+        }
+        // The writer already went around the ring, there is a newer frame
+    }
+}
+
+bool StixelsShmReader::isValid(const StixelsShm::t_frame* frame, const uint64_t& sequence) const
+{
+    __sync_synchronize();
+    return frame->sequence == 2 * sequence;
+}
+
+uint64_t StixelsShmReader::readLatest(StixelsShm::t_frame& frame) const
+{
+    for (;;) {
+        uint64_t sequence;
+        const StixelsShm::t_frame * source = acquireLatest(sequence);
+        if (source == NULL)
+            return 0;
+
+        // Counts could be torn if the frame is being overwritten, so they are clamped before copying
+        frame.frame = source->frame;
+        frame.stamp = source->stamp;
+        frame.numStixels = std::min(source->numStixels, StixelsShm::MAX_STIXELS);
+        frame.numObstacles = std::min(source->numObstacles, StixelsShm::MAX_OBSTACLES);
+        memcpy(frame.stixels, source->stixels, frame.numStixels * sizeof(StixelsShm::t_stixel));
+        memcpy(frame.obstacles, source->obstacles, frame.numObstacles * sizeof(StixelsShm::t_obstacle));
+
+        if (isValid(source, sequence)) {
+            frame.sequence = 2 * sequence;
+            return sequence;
+        }
+    }
+}
+
+bool StixelsShmReader::waitForFrame(const uint64_t& lastSequence, const uint32_t& timeoutMs) const
+{
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    // Short sleeps keep the latency in the tens of microseconds without burning a core
+    const struct timespec pause = { 0, 20000 };
+    while (mp_header->lastSequence <= lastSequence) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        const uint64_t elapsedMs = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+        if (elapsedMs >= timeoutMs)
+            return false;
+        nanosleep(&pause, NULL);
+    }
+
+    return true;
+}
+
+}
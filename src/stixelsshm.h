@@ -0,0 +1,155 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#ifndef STIXELSSHM_H
+#define STIXELSSHM_H
+
+#include <stdint.h>
+#include <string>
+
+// Only depends on POSIX, so local consumers can link it without the rest of the pipeline
+
+namespace stixel_world {
+
+///
+/// Stixels, their motion and the obstacle tracks of a frame, shared with the processes of the same
+/// host through a POSIX shared memory ring (shm_open), without serialization.
+///
+/// There is a single writer and any number of readers, none of them locks. The ring has numSlots
+/// fixed size frames. Each frame has a sequence that is odd while the writer fills it and 2 * seq
+/// once frame seq is complete (seqlock), and the header keeps the seq of the last complete frame.
+/// Readers never block the writer: a reader that is too slow just sees its frame being overwritten,
+/// and tries again with the newest one.
+///
+/// Coordinates are the same as in the stixel_world/StixelsFrame message.
+///
+class StixelsShm
+{
+public:
+    static const uint32_t MAGIC = 0x53545853;  // "STXS"
+    static const uint32_t VERSION = 2;
+    static const uint32_t MAX_STIXELS = 2048;
+    static const uint32_t MAX_OBSTACLES = 256;
+
+    typedef struct {
+        uint16_t x, width, top_y, bottom_y;
+        float disparity;
+        /// Index of the matched stixel in the previous frame (stixels_motion), -1 if none
+        int32_t motion;
+        /// -1 when the stixel is not part of a tracked obstacle
+        int32_t track_id;
+        float velocity_x, velocity_z;
+    } t_stixel;
+
+    typedef struct {
+        uint32_t track_id;
+        uint16_t x, y, width, height;
+        float disparity;
+        float position_x, position_y, position_z;
+        float size_x, size_y, size_z;
+        float velocity_x, velocity_z;
+        uint16_t age;
+        int16_t valid_count;
+    } t_obstacle;
+
+    /// Padded to the cache line, so the sequence of a slot does not share it with the end of the previous one
+    typedef struct __attribute__((aligned(64))) {
+        /// Odd while the frame is written, 2 * seq when frame seq is complete
+        volatile uint64_t sequence;
+        uint64_t frame;
+        /// Seconds since the epoch
+        double stamp;
+        uint32_t numStixels;
+        uint32_t numObstacles;
+        t_stixel stixels[MAX_STIXELS];
+        t_obstacle obstacles[MAX_OBSTACLES];
+    } t_frame;
+
+    typedef struct {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t numSlots;
+        uint32_t frameSize;
+        float focal_x, focal_y, center_x, center_y;
+        float baseline, camera_height;
+        /// seq of the last complete frame, 0 before the first one
+        volatile uint64_t lastSequence;
+    } t_header;
+
+    static size_t getMappingSize(const uint32_t & numSlots);
+};
+
+///
+/// Owns the shared memory object: creates it, and removes it when destroyed.
+///
+class StixelsShmWriter
+{
+public:
+    StixelsShmWriter(const std::string & name, const uint32_t & numSlots = 8);
+    ~StixelsShmWriter();
+
+    void setCamera(const float & focalX, const float & focalY, const float & centerX, const float & centerY,
+                   const float & baseline, const float & cameraHeight);
+
+    /// Slot for the next frame, to be filled in place and published with commitFrame()
+    StixelsShm::t_frame * beginFrame();
+    void commitFrame();
+
+    uint64_t getSequence() const { return m_sequence; }
+private:
+    std::string m_name;
+    size_t m_size;
+    StixelsShm::t_header * mp_header;
+    StixelsShm::t_frame * mp_frames;
+    uint64_t m_sequence;
+};
+
+///
+/// Maps the ring read only. Frames can be copied out (readLatest) or read in place (acquireLatest),
+/// in which case isValid() tells afterwards whether the writer overwrote the frame in the meantime.
+///
+class StixelsShmReader
+{
+public:
+    /// Throws if the ring does not exist (yet) or was written by an incompatible version
+    StixelsShmReader(const std::string & name);
+    ~StixelsShmReader();
+
+    const StixelsShm::t_header & getHeader() const { return *mp_header; }
+
+    /// seq of the last complete frame, 0 if none
+    uint64_t getLastSequence() const { return mp_header->lastSequence; }
+
+    /// Copies the last complete frame. Returns its seq, or 0 if there is no frame yet
+    uint64_t readLatest(StixelsShm::t_frame & frame) const;
+
+    /// Last complete frame, read in place. Returns NULL if there is no frame yet
+    const StixelsShm::t_frame * acquireLatest(uint64_t & sequence) const;
+    /// True if frame is still the complete frame seq, so what was read from it is consistent
+    bool isValid(const StixelsShm::t_frame * frame, const uint64_t & sequence) const;
+
+    /// Polls until a frame newer than lastSequence is complete. Returns false on timeout
+    bool waitForFrame(const uint64_t & lastSequence, const uint32_t & timeoutMs) const;
+private:
+    size_t m_size;
+    const StixelsShm::t_header * mp_header;
+    const StixelsShm::t_frame * mp_frames;
+};
+
+}
+
+#endif // STIXELSSHM_H
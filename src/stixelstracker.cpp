@@ -45,6 +45,8 @@
 #include "kalmanfilter.h"
 
 #include "utils.h"
+#include "stagetimings.h"
+#include "visualizationsink.h"
 
 using namespace std;
 using namespace stixel_world;
@@ -76,6 +78,14 @@ StixelsTracker::StixelsTracker::StixelsTracker(const boost::program_options::var
     
     m_minPolarSADForBeingStatic = 10;
     
+    m_frameGap = 1;
+    m_visualize = true;
+    
+    m_nextTrackId = 0;
+    
+    m_externalPolarProducts = false;
+    m_externalDenseFlowVotes = false;
+    
 //     mp_denseTracker.reset(new dense_tracker::DenseTracker());
 }
 
@@ -110,11 +120,25 @@ void StixelsTracker::set_motion_cost_factors(const float& sad_factor, const floa
     }
 }
 
+void StixelsTracker::set_frame_gap(const uint32_t& frameGap)
+{
+    m_frameGap = std::max(1u, frameGap);
+}
+
+void StixelsTracker::set_processing_band(const ProcessingBand& band)
+{
+    m_processingBand = band;
+}
+
+void StixelsTracker::set_visualization(const bool& visualize)
+{
+    m_visualize = visualize;
+}
+
 void StixelsTracker::transform_stixels_polar()
 {
-    cv::Mat mapXprev, mapYprev, mapXcurr, mapYcurr;
-    mp_polarCalibration->getInverseMaps(mapXprev, mapYprev, 1);
-    mp_polarCalibration->getInverseMaps(mapXcurr, mapYcurr, 2);
+    const cv::Mat & mapXprev = m_polar.mapXprev, & mapYprev = m_polar.mapYprev;
+    const cv::Mat & mapXcurr = m_polar.mapXcurr, & mapYcurr = m_polar.mapYcurr;
     
     m_previous_stixels_polar.clear();
     m_current_stixels_polar.clear();
@@ -203,19 +227,18 @@ void StixelsTracker::compute()
 // //     estimate_stixel_direction();
 // //     getClusters();
     ///////////////////////////////////////
-    cout << "m_useGraph " << m_useGraphs << endl;
-    cout << "m_useCostMatrix " << m_useCostMatrix << endl;
-    cout << "m_useObjects " << m_useObjects << endl;
-    cout << "m_SADFactor " << m_sad_factor << endl;
-    cout << "heightFactor " << m_height_factor << endl;
-    cout << "m_polarDistFactor " << m_polar_dist_factor << endl;
-    cout << "m_polarSADFactor " << m_polar_sad_factor << endl;
-    cout << "m_histBatFactor " << m_hist_similarity_factor << endl;
-    cout << "twoLevelsTracking " << m_twoLevelsTracking << endl;
-    cout << "***********************" << endl;
-    
-    double startWallTime = omp_get_wtime();
-    gil2opencv(current_image_view, m_currImg);
+    
+    STIXEL_TIMED_SCOPE("StixelsTracker::compute");
+    
+    // Read once per frame, unless they were given (replay of a recording)
+    if (! m_externalPolarProducts)
+        fetch_polar_products();
+    if (! m_externalDenseFlowVotes)
+        fetch_dense_flow_votes();
+    m_externalPolarProducts = false;
+    m_externalDenseFlowVotes = false;
+    
+    gil2opencv(current_image_view, m_currImg, m_processingBand.getRows(current_image_view.height()));
     if (m_useCostMatrix) {
         compute_motion_cost_matrix();
     }
@@ -258,7 +281,6 @@ void StixelsTracker::compute()
 // 
 //     updateTracker();
 // #endif
-ROS_ERROR("[TIMES] Time %f", omp_get_wtime() - startWallTime);
     
     return;
 }
@@ -266,7 +288,7 @@ ROS_ERROR("[TIMES] Time %f", omp_get_wtime() - startWallTime);
 void StixelsTracker::compute_motion_cost_matrix()
 {    
     
-    const double & startWallTime = omp_get_wtime();
+    STIXEL_TIMED_SCOPE("StixelsTracker::compute_motion_cost_matrix");
     
     const float maximum_depth_difference = 1.0;
     
@@ -274,20 +296,12 @@ void StixelsTracker::compute_motion_cost_matrix()
     const float maximum_allowed_polar_distance = 50.0f;
     assert((m_sad_factor + m_height_factor + m_polar_dist_factor + m_polar_sad_factor + m_dense_tracking_factor + m_hist_similarity_factor) == 1.0f);
     
-    const float maximum_real_motion = maximum_pedestrian_speed / video_frame_rate;
+    const float maximum_real_motion = m_frameGap * maximum_pedestrian_speed / video_frame_rate;
     
     const unsigned int number_of_current_stixels = current_stixels_p->size();
     const unsigned int number_of_previous_stixels = previous_stixels_p->size();
 
-    cv::Mat currPolar2LinearX, currPolar2LinearY;
-    if (mp_polarCalibration) {
-        mp_polarCalibration->getStoredRectifiedImages(m_polarImg1, m_polarImg2);
-        
-        mp_polarCalibration->getInverseMaps(m_mapXprev, m_mapYprev, 1);
-        mp_polarCalibration->getInverseMaps(m_mapXcurr, m_mapYcurr, 2);
-        
-        mp_polarCalibration->getMaps(currPolar2LinearX, currPolar2LinearY, 2);
-    }
+    const cv::Mat & currPolar2LinearX = m_polar.currPolar2LinearX, & currPolar2LinearY = m_polar.currPolar2LinearY;
     
     motion_cost_matrix.fill( 0.f );
     pixelwise_sad_matrix.fill( 0.f );
@@ -304,8 +318,8 @@ void StixelsTracker::compute_motion_cost_matrix()
     cv::MatND hist1, hist2;
     cv::Mat lastImg = m_currImg;
     if (lastImg.empty())
-        gil2opencv(previous_image_view, lastImg);
-    gil2opencv(current_image_view, m_currImg);
+        gil2opencv(previous_image_view, lastImg, m_processingBand.getRows(previous_image_view.height()));
+    gil2opencv(current_image_view, m_currImg, m_processingBand.getRows(current_image_view.height()));
     
     // Fill in the motion cost matrix
 //     #pragma omp parallel for schedule(dynamic)
@@ -315,7 +329,7 @@ void StixelsTracker::compute_motion_cost_matrix()
 //         const cv::Point2d current_polar = get_polar_point(mapXcurr, mapYcurr, current_stixel);
         cv::Point2d current_polar;
         if (mp_polarCalibration)
-            current_polar = get_polar_point(m_mapXcurr, m_mapYcurr, currPolar2LinearX, currPolar2LinearY, current_stixel);
+            current_polar = get_polar_point(m_polar.mapXcurr, m_polar.mapYcurr, currPolar2LinearX, currPolar2LinearY, current_stixel);
         
         if (m_hist_similarity_factor != 0.0) computeHistogram(hist1, m_currImg, current_stixel);
         
@@ -341,7 +355,7 @@ void StixelsTracker::compute_motion_cost_matrix()
 //                 const cv::Point2d previous_polar = get_polar_point(mapXprev, mapYprev, previous_stixel);
                 cv::Point2d previous_polar;
                 if (mp_polarCalibration)
-                    previous_polar = get_polar_point(m_mapXprev, m_mapYprev, currPolar2LinearX, currPolar2LinearY, previous_stixel);
+                    previous_polar = get_polar_point(m_polar.mapXprev, m_polar.mapYprev, currPolar2LinearX, currPolar2LinearY, previous_stixel);
                 
                 if (m_hist_similarity_factor != 0.0) computeHistogram(hist2, lastImg, previous_stixel);
                 
@@ -374,7 +388,7 @@ void StixelsTracker::compute_motion_cost_matrix()
                                 polar_distance = (m_polar_dist_factor == 0.0f)? 0.0f : cv::norm(previous_polar - current_polar);
 //                                 polar_SAD = (m_polar_sad_factor == 0.0f)? 0.0f : compute_polar_SAD(current_stixel, previous_stixel, current_image_view, previous_image_view, stixel_horizontal_padding);
                                 polar_SAD = (m_polar_sad_factor == 0.0f)? 0.0f : compute_polar_SAD(current_stixel, previous_stixel);
-                                denseTrackingScore = (m_dense_tracking_factor == 0.0f)? 0.0f : compute_dense_tracking_score(current_stixel, previous_stixel);
+                                denseTrackingScore = (m_dense_tracking_factor == 0.0f)? 0.0f : compute_dense_tracking_score(s_current, previous_stixel);
                                 histogramComparisonScore = (m_hist_similarity_factor == 0.0)? 0.0f : compareHistogram(hist1, hist2, current_stixel, previous_stixel);
                             }
                             else
@@ -540,7 +554,6 @@ void StixelsTracker::compute_motion_cost_matrix()
      **/
     
     //    fill_in_visualization_motion_cost_matrix();
-    cout << "Time for " << __FUNCTION__ << ":" << __LINE__ << " " << omp_get_wtime() - startWallTime << endl;
     
     return;
 }
@@ -567,7 +580,10 @@ void StixelsTracker::compute_maximum_pixelwise_motion_for_stixel_lut( )
 inline
 uint32_t StixelsTracker::compute_maximum_pixelwise_motion_for_stixel( const Stixel& stixel )
 {
-    return m_maximal_pixelwise_motion_by_disp(stixel.disparity, 0);
+    // The LUT is computed for consecutive frames. When frames are dropped, the stixel could have
+    // moved further, but never beyond the rows available in the motion cost matrices.
+    const uint32_t maximumMotion = m_maximal_pixelwise_motion_by_disp(stixel.disparity, 0) * m_frameGap;
+    return std::min(maximumMotion, (uint32_t)maximum_possible_motion_in_pixels);
 }
 
 void StixelsTracker::estimate_stixel_direction()
@@ -595,33 +611,32 @@ void StixelsTracker::estimate_stixel_direction()
 
 void StixelsTracker::compute_static_stixels()
 {
+    // Only the debug windows below depend on this
+    if (! VisualizationSink::isAttached())
+        return;
     
-    cv::Mat mapXprev, mapYprev;
-    mp_polarCalibration->getInverseMaps(mapXprev, mapYprev, 1);
-    cv::Mat currPolar2LinearX, currPolar2LinearY;
-    mp_polarCalibration->getMaps(currPolar2LinearX, currPolar2LinearY, 2);
+    const cv::Mat & mapXprev = m_polar.mapXprev, & mapYprev = m_polar.mapYprev;
+    const cv::Mat & currPolar2LinearX = m_polar.currPolar2LinearX, & currPolar2LinearY = m_polar.currPolar2LinearY;
     
     // Rectified difference is obtained
     cv::Mat diffRect;
     {
-        cv::Mat polar1, polar2, diffPolar;
-        mp_polarCalibration->getStoredRectifiedImages(polar1, polar2);
+        const cv::Mat & polar1 = m_polar.polarImg1, & polar2 = m_polar.polarImg2;
+        cv::Mat diffPolar;
         cv::Mat polar1gray(polar1.size(), CV_8UC1);
         cv::Mat polar2gray(polar1.size(), CV_8UC1);
         cv::cvtColor(polar1, polar1gray, CV_BGR2GRAY);
         cv::cvtColor(polar2, polar2gray, CV_BGR2GRAY);
         cv::absdiff(polar1gray, polar2gray, diffPolar);
         
-        cv::Mat inverseX, inverseY;
-        mp_polarCalibration->getInverseMaps(inverseX, inverseY, 1);
-        cv::remap(diffPolar, diffRect, inverseX, inverseY, cv::INTER_CUBIC, cv::BORDER_CONSTANT);
+        m_processingBand.remap(diffPolar, diffRect, mapXprev, mapYprev, cv::INTER_CUBIC, cv::BORDER_CONSTANT);
     }
 //     cv::threshold(diffRect, diffRect, 30, 255, cv::THRESH_BINARY);
     
     cv::Mat diffRectColor(diffRect.size(), CV_8UC3);
     cv::cvtColor(diffRect, diffRectColor, CV_GRAY2BGR);
-    cv::Mat diffRectColorBig;
-    cv::resize(diffRectColor, diffRectColorBig, cv::Size(1920, 1200));
+    // Scaled up to 1920x1200 by the viewer
+    cv::Mat diffRectColorTrack = diffRectColor.clone();
     
     for (stixels_t::iterator it = current_stixels_p->begin(), it2 = previous_stixels_p->begin(); 
                     it != current_stixels_p->end(); it++, it2++) {
@@ -669,48 +684,84 @@ void StixelsTracker::compute_static_stixels()
         cv::circle(diffRectColor, lastPointNow, 1, cv::Scalar(255, 0, 0), -1);
         cv::circle(diffRectColor, lastPoint, 1, cv::Scalar(0, 255, 0), -1);
         
-        const float factorX = (float)diffRectColorBig.cols / (float)diffRectColor.cols;
-        const float factorY = (float)diffRectColorBig.rows / (float)diffRectColor.rows;
-        const cv::Point2d currPointBig(currPoint.x * factorX, currPoint.y * factorY);
-        const cv::Point2d lastPointBig(lastPoint.x * factorX, lastPoint.y * factorY);
-        const cv::Point2d lastPointNowBig(lastPointNow.x * factorX, lastPointNow.y * factorY);
-        
         cv::Scalar color(rand() & 0xFF, rand() & 0xFF, rand() & 0xFF);
         if ((currPoint != cv::Point2d(-1, -1)) && (lastPointNow != cv::Point2d(-1, -1)))
-            cv::line(diffRectColorBig, currPointBig, lastPointNowBig, color);
+            cv::line(diffRectColorTrack, currPoint, lastPointNow, color);
         if ((lastPointNow != cv::Point2d(-1, -1)) && (lastPoint != cv::Point2d(-1, -1)))
-            cv::line(diffRectColorBig, lastPointNowBig, lastPointBig, color);
+            cv::line(diffRectColorTrack, lastPointNow, lastPoint, color);
         
-        cv::circle(diffRectColorBig, currPointBig, 1, cv::Scalar(0, 0, 255), -1);
-        cv::circle(diffRectColorBig, lastPointNowBig, 1, cv::Scalar(255, 0, 0), -1);
-        cv::circle(diffRectColorBig, lastPointBig, 1, cv::Scalar(0, 255, 0), -1);
+        cv::circle(diffRectColorTrack, currPoint, 1, cv::Scalar(0, 0, 255), -1);
+        cv::circle(diffRectColorTrack, lastPointNow, 1, cv::Scalar(255, 0, 0), -1);
+        cv::circle(diffRectColorTrack, lastPoint, 1, cv::Scalar(0, 255, 0), -1);
     }
     
-    cv::imshow("Thresh1", diffRectColor);
-    cv::imshow("polarTrack", diffRectColorBig);
+    VisualizationSink::show("Thresh1", diffRectColor);
+    VisualizationSink::show("polarTrack", diffRectColorTrack, cv::Size(1920, 1200));
 }
 
-float StixelsTracker::compute_dense_tracking_score(const Stixel& currStixel, const Stixel& prevStixel)
+float StixelsTracker::compute_dense_tracking_score(const uint32_t& currIdx, const Stixel& prevStixel)
 {
+    // Rows of the current stixel whose dense track comes from the column of prevStixel
+    if (currIdx >= m_denseFlowVotes.size())
+        return 0.0f;
+    
+    const vector< pair<int32_t, uint32_t> > & votes = m_denseFlowVotes[currIdx];
+    for (uint32_t i = 0; i < votes.size(); i++) {
+        if (votes[i].first == prevStixel.x)
+            return votes[i].second;
+    }
+    
+    return 0.0f;
+}
 
-    float matched = 0.0f, unmatched = 0.0f;
-    for (uint32_t y = currStixel.top_y; y <= currStixel.bottom_y; y++) {
-        const cv::Point2i currPoint(currStixel.x, y);
-        const cv::Point2i prevPoint = mp_denseTracker->getPrevPoint(currPoint);
-        
-        if (prevPoint != cv::Point2i(-1, -1)) {
-            if (prevPoint.x == prevStixel.x)
-                matched += 1.0f;
-            else
-                unmatched += 1.0f;
+void StixelsTracker::fetch_polar_products()
+{
+    if (! mp_polarCalibration)
+        return;
+    
+    mp_polarCalibration->getStoredRectifiedImages(m_polar.polarImg1, m_polar.polarImg2);
+    
+    mp_polarCalibration->getInverseMaps(m_polar.mapXprev, m_polar.mapYprev, 1);
+    mp_polarCalibration->getInverseMaps(m_polar.mapXcurr, m_polar.mapYcurr, 2);
+    
+    mp_polarCalibration->getMaps(m_polar.currPolar2LinearX, m_polar.currPolar2LinearY, 2);
+}
+
+void StixelsTracker::fetch_dense_flow_votes()
+{
+    m_denseFlowVotes.clear();
+    if ((m_dense_tracking_factor == 0.0f) || (! mp_denseTracker))
+        return;
+    
+    // The columns the rows of each current stixel come from, with the number of rows for each one
+    m_denseFlowVotes.resize(current_stixels_p->size());
+    for (uint32_t i = 0; i < current_stixels_p->size(); i++) {
+        const Stixel & currStixel = (*current_stixels_p)[i];
+        vector< pair<int32_t, uint32_t> > & votes = m_denseFlowVotes[i];
+        for (int32_t y = currStixel.top_y; y <= currStixel.bottom_y; y++) {
+            const cv::Point2i prevPoint = mp_denseTracker->getPrevPoint(cv::Point2i(currStixel.x, y));
+            if (prevPoint == cv::Point2i(-1, -1))
+                continue;
+            
+            uint32_t j = 0;
+            for (; (j < votes.size()) && (votes[j].first != prevPoint.x); j++);
+            if (j == votes.size())
+                votes.push_back(make_pair(prevPoint.x, 0u));
+            votes[j].second++;
         }
     }
-    
-//     if ((matched + unmatched) == 0)
-//         return 0;
-//     else
-//         return 255 * matched / (matched + unmatched);
-    return matched;
+}
+
+void StixelsTracker::set_polar_products(const t_polar_products& polarProducts)
+{
+    m_polar = polarProducts;
+    m_externalPolarProducts = true;
+}
+
+void StixelsTracker::set_dense_flow_votes(const t_dense_flow_votes& denseFlowVotes)
+{
+    m_denseFlowVotes = denseFlowVotes;
+    m_externalDenseFlowVotes = true;
 }
 
 float StixelsTracker::compute_polar_SAD(const Stixel& stixel1, const Stixel& stixel2)
@@ -726,12 +777,10 @@ float StixelsTracker::compute_polar_SAD(const Stixel& stixel1, const Stixel& sti
     const double factor1 = height1 / height;
     const double factor2 = height2 / height;
     
-    cv::Mat polarImg1, polarImg2;
-    mp_polarCalibration->getStoredRectifiedImages(polarImg1, polarImg2);
+    const cv::Mat & polarImg1 = m_polar.polarImg1, & polarImg2 = m_polar.polarImg2;
     
-    cv::Mat mapXprev, mapYprev, mapXcurr, mapYcurr;
-    mp_polarCalibration->getInverseMaps(mapXprev, mapYprev, 1);
-    mp_polarCalibration->getInverseMaps(mapXcurr, mapYcurr, 2);
+    const cv::Mat & mapXprev = m_polar.mapXprev, & mapYprev = m_polar.mapYprev;
+    const cv::Mat & mapXcurr = m_polar.mapXcurr, & mapYcurr = m_polar.mapYcurr;
     
     float sad = 0.0;
     double validPoints = 0.0f;
@@ -770,8 +819,8 @@ float StixelsTracker::compute_polar_SAD(const Stixel& stixel1, const Stixel& sti
     stixel_representation_t stixel_representation1;
     stixel_representation_t stixel_representation2;
     
-    compute_stixel_representation_polar( stixel1, image_view1, stixel_representation1, stixel_horizontal_padding, m_mapXcurr, m_mapYcurr, m_polarImg2 );    
-    compute_stixel_representation_polar( stixel2, image_view2, stixel_representation2, stixel_horizontal_padding, m_mapXprev, m_mapYprev, m_polarImg1 );
+    compute_stixel_representation_polar( stixel1, image_view1, stixel_representation1, stixel_horizontal_padding, m_polar.mapXcurr, m_polar.mapYcurr, m_polar.polarImg2 );    
+    compute_stixel_representation_polar( stixel2, image_view2, stixel_representation2, stixel_horizontal_padding, m_polar.mapXprev, m_polar.mapYprev, m_polar.polarImg1 );
     
     float pixelwise_sad = 0;
     
@@ -950,12 +999,10 @@ void StixelsTracker::draw_polar_SAD(cv::Mat& img, const Stixel& stixel1, const S
     const double factor1 = height1 / height;
     const double factor2 = height2 / height;
     
-    cv::Mat polarImg1, polarImg2;
-    mp_polarCalibration->getStoredRectifiedImages(polarImg1, polarImg2);
+    const cv::Mat & polarImg1 = m_polar.polarImg1, & polarImg2 = m_polar.polarImg2;
     
-    cv::Mat mapXprev, mapYprev, mapXcurr, mapYcurr;
-    mp_polarCalibration->getInverseMaps(mapXprev, mapYprev, 1);
-    mp_polarCalibration->getInverseMaps(mapXcurr, mapYcurr, 2);
+    const cv::Mat & mapXprev = m_polar.mapXprev, & mapYprev = m_polar.mapYprev;
+    const cv::Mat & mapXcurr = m_polar.mapXcurr, & mapYcurr = m_polar.mapYcurr;
     
     for (uint32_t i = 0; i <= height; i++) {
         const cv::Point2d pos1 = cv::Point2d(stixel1.x, stixel1.top_y + factor1 * i);
@@ -995,8 +1042,8 @@ void StixelsTracker::computeMotionWithGraphsAndHistogram()
     cv::MatND hist1, hist2;
     cv::Mat lastImg = m_currImg;
     if (lastImg.empty())
-        gil2opencv(previous_image_view, lastImg);
-    gil2opencv(current_image_view, m_currImg);
+        gil2opencv(previous_image_view, lastImg, m_processingBand.getRows(previous_image_view.height()));
+    gil2opencv(current_image_view, m_currImg, m_processingBand.getRows(current_image_view.height()));
     BOOST_FOREACH (const Stixel & currStixel, *current_stixels_p) {
         
         const uint32_t & maxMotionForStixel = compute_maximum_pixelwise_motion_for_stixel( currStixel );
@@ -1525,7 +1572,7 @@ float StixelsTracker::compareHistograms(const cv::Mat& img1, const cv::Mat& img2
 }
 
 void StixelsTracker::computeObstacles() {
-    const double & startWallTime = omp_get_wtime();
+    STIXEL_TIMED_SCOPE("StixelsTracker::computeObstacles");
     // TODO: Parameterize
     const int max2DWidthToAcceptObstacle = 10;
     const int max2DHeightToAcceptObstacle = 40;
@@ -1578,7 +1625,6 @@ void StixelsTracker::computeObstacles() {
             currObstacle.stixels.push_back(stixel3dL);
         }
     }
-    cout << "Time for " << __FUNCTION__ << ": " << omp_get_wtime() - startWallTime << endl;
 }
 
 void StixelsTracker::getObstacleFromStixelsList(const stixels_t & stixels, const uint32_t & idx1, const uint32_t & idx2, 
@@ -1682,7 +1728,7 @@ void StixelsTracker::aggregateObstacles()
 
 void StixelsTracker::filterObstacles()
 {
-    const double & startWallTime = omp_get_wtime();
+    STIXEL_TIMED_SCOPE("StixelsTracker::filterObstacles");
     // TODO: Parameterize
     const double gridSize = 0.10;
     const double occupancyThresh = 100;
@@ -1690,11 +1736,9 @@ void StixelsTracker::filterObstacles()
     if (mp_polarCalibration) {
         
         // Initial images and mapping is obtained
-        cv::Mat polar1, polar2;
+        const cv::Mat & polar1 = m_polar.polarImg1, & polar2 = m_polar.polarImg2;
         cv:: Mat diffPolar, diffPolarGray;
-        cv::Mat inverseX, inverseY;
-        mp_polarCalibration->getStoredRectifiedImages(polar1, polar2);
-        mp_polarCalibration->getInverseMaps(inverseX, inverseY, 1);
+        const cv::Mat & inverseX = m_polar.mapXprev, & inverseY = m_polar.mapYprev;
         
         // Mask generation
         cv::Mat mask;
@@ -1703,8 +1747,8 @@ void StixelsTracker::filterObstacles()
         mask1.setTo(cv::Scalar(255));
         mask2.setTo(cv::Scalar(255));
         
-        cv::remap(mask1, mask1, inverseX, inverseY, cv::INTER_NEAREST, cv::BORDER_TRANSPARENT);
-        cv::remap(mask2, mask2, inverseX, inverseY, cv::INTER_NEAREST, cv::BORDER_TRANSPARENT);
+        m_processingBand.remap(mask1, mask1, inverseX, inverseY, cv::INTER_NEAREST, cv::BORDER_TRANSPARENT);
+        m_processingBand.remap(mask2, mask2, inverseX, inverseY, cv::INTER_NEAREST, cv::BORDER_TRANSPARENT);
         
         cv::bitwise_and(mask1, mask2, mask);
         cv::threshold(mask, mask, 254, 255, cv::THRESH_BINARY);
@@ -1715,7 +1759,7 @@ void StixelsTracker::filterObstacles()
         
         // Polar difference generation
         cv::absdiff(polar1, polar2, diffPolar);
-        cv::remap(diffPolar, diffPolar, inverseX, inverseY, cv::INTER_CUBIC, cv::BORDER_TRANSPARENT);        
+        m_processingBand.remap(diffPolar, diffPolar, inverseX, inverseY, cv::INTER_CUBIC, cv::BORDER_TRANSPARENT);        
         cv::multiply(diffPolar, maskCopy, diffPolar);
         diffPolar.copyTo(diffPolar, mask);
         
@@ -1748,7 +1792,6 @@ void StixelsTracker::filterObstacles()
                 currObstacle.valid = false;
         }
     }
-    cout << "Time for " << __FUNCTION__ << ": " << omp_get_wtime() - startWallTime << endl;
 }
 
 double StixelsTracker::getNcc(const cv::Mat& img1, const cv::Mat& img2, 
@@ -1854,11 +1897,12 @@ void StixelsTracker::trackObstacles()
 
 //     aggregateObstacles();
     
-    const double & startWallTime = omp_get_wtime();
+    STIXEL_TIMER_START(trackingTimer, "StixelsTracker::trackObstacles");
     if (prevObstacles.size() == 0) {
         m_obstaclesTracker.resize(m_obstacles.size());
 
         for (uint32_t i = 0; i < m_obstacles.size(); i++) {
+            m_obstaclesTracker[i].id = m_nextTrackId++;
             m_obstaclesTracker[i].track.push_front(m_obstacles[i]);
             m_obstaclesTracker[i].validCount = (m_obstacles[i].valid)? 1 : -1;
         }
@@ -1867,18 +1911,17 @@ void StixelsTracker::trackObstacles()
     }
     
     cv::Mat lastImg, currImg;
-    gil2opencv(previous_image_view, lastImg);
-    gil2opencv(current_image_view, currImg);
+    gil2opencv(previous_image_view, lastImg, m_processingBand.getRows(previous_image_view.height()));
+    gil2opencv(current_image_view, currImg, m_processingBand.getRows(current_image_view.height()));
 
     cv::Mat polarPrevGray, polarCurrGray;
     if (mp_polarCalibration) {
         cv::Mat polarOutput;
-        cv::Mat polar1, polar2, polarPrev, polarCurr, diffPolar, diffPolarMapped;
-        mp_polarCalibration->getStoredRectifiedImages(polar1, polar2);
-        cv::Mat inverseX, inverseY;
-        mp_polarCalibration->getInverseMaps(inverseX, inverseY, 1);
-        cv::remap(polar1, polarPrev, inverseX, inverseY, cv::INTER_CUBIC, cv::BORDER_TRANSPARENT);
-        cv::remap(polar2, polarCurr, inverseX, inverseY, cv::INTER_CUBIC, cv::BORDER_TRANSPARENT);
+        cv::Mat polarPrev, polarCurr, diffPolar, diffPolarMapped;
+        const cv::Mat & polar1 = m_polar.polarImg1, & polar2 = m_polar.polarImg2;
+        const cv::Mat & inverseX = m_polar.mapXprev, & inverseY = m_polar.mapYprev;
+        m_processingBand.remap(polar1, polarPrev, inverseX, inverseY, cv::INTER_CUBIC, cv::BORDER_TRANSPARENT);
+        m_processingBand.remap(polar2, polarCurr, inverseX, inverseY, cv::INTER_CUBIC, cv::BORDER_TRANSPARENT);
         
         cv::cvtColor(polarPrev, polarPrevGray, CV_BGR2GRAY);
         cv::cvtColor(polarCurr, polarCurrGray, CV_BGR2GRAY);
@@ -1982,17 +2025,21 @@ void StixelsTracker::trackObstacles()
             lemon::SmartGraph::Arc arc = matchingMap[currNode];
             int prevIdx = graph.id(graph.target(arc));
             obstacleTrack = prevObstaclesTracker[prevIdx];
+        } else {
+            obstacleTrack.id = m_nextTrackId++;
+            obstacleTrack.validCount = 0;
         }
         obstacleTrack.track.push_front(m_obstacles[i]);
         obstacleTrack.validCount += m_obstacles[i].valid? 1 : -1;
         
         m_obstaclesTracker.push_back(obstacleTrack);
     }
-    cout << "Time for " << __FUNCTION__ << ": " << omp_get_wtime() - startWallTime << endl;
+    STIXEL_TIMER_STOP(trackingTimer);
     ////////////////////////////////////////////////////////////////////////////////////////////////////
     // VISUALIZATION
     ////////////////////////////////////////////////////////////////////////////////////////////////////
-//     return;
+    if ((! m_visualize) || (! VisualizationSink::isAttached()))
+        return;
     cv::Mat img = cv::Mat::zeros(m_currImg.rows * 2, m_currImg.cols * 2, CV_8UC3);
     cv::Rect roi(0, 0, m_currImg.cols, m_currImg.rows);
     cv::Mat roiImgPrev = img(roi);
@@ -2087,11 +2134,9 @@ void StixelsTracker::trackObstacles()
         const double gridSize = 0.10;
         
         // Initial images and mapping is obtained
-        cv::Mat polar1, polar2;
+        const cv::Mat & polar1 = m_polar.polarImg1, & polar2 = m_polar.polarImg2;
         cv:: Mat diffPolar, diffPolarGray;
-        cv::Mat inverseX, inverseY;
-        mp_polarCalibration->getStoredRectifiedImages(polar1, polar2);
-        mp_polarCalibration->getInverseMaps(inverseX, inverseY, 1);
+        const cv::Mat & inverseX = m_polar.mapXprev, & inverseY = m_polar.mapYprev;
         
         // Mask generation
         cv::Mat mask;
@@ -2100,8 +2145,8 @@ void StixelsTracker::trackObstacles()
         mask1.setTo(cv::Scalar(255));
         mask2.setTo(cv::Scalar(255));
         
-        cv::remap(mask1, mask1, inverseX, inverseY, cv::INTER_NEAREST, cv::BORDER_TRANSPARENT);
-        cv::remap(mask2, mask2, inverseX, inverseY, cv::INTER_NEAREST, cv::BORDER_TRANSPARENT);
+        m_processingBand.remap(mask1, mask1, inverseX, inverseY, cv::INTER_NEAREST, cv::BORDER_TRANSPARENT);
+        m_processingBand.remap(mask2, mask2, inverseX, inverseY, cv::INTER_NEAREST, cv::BORDER_TRANSPARENT);
         
         cv::bitwise_and(mask1, mask2, mask);
         cv::threshold(mask, mask, 254, 255, cv::THRESH_BINARY);
@@ -2112,7 +2157,7 @@ void StixelsTracker::trackObstacles()
         
         // Polar difference generation
         cv::absdiff(polar1, polar2, diffPolar);
-        cv::remap(diffPolar, diffPolar, inverseX, inverseY, cv::INTER_CUBIC, cv::BORDER_TRANSPARENT);        
+        m_processingBand.remap(diffPolar, diffPolar, inverseX, inverseY, cv::INTER_CUBIC, cv::BORDER_TRANSPARENT);        
         cv::multiply(diffPolar, maskCopy, diffPolar);
         diffPolar.copyTo(diffPolar, mask);
         
@@ -2142,7 +2187,5 @@ void StixelsTracker::trackObstacles()
         }
     }
 
-    cv::imshow("StixelsEvol", img);
-    uint32_t time;
-    waitForKey(&time);
+    VisualizationSink::show("StixelsEvol", img);
 }
@@ -24,6 +24,7 @@
 #include "polarcalibration.h"
 #include "doppia/stixel3d.h"
 #include "densetracker.h"
+#include "processingband.h"
 
 using namespace doppia;
 
@@ -45,6 +46,32 @@ public:
     
     void updateDenseTracker(const cv::Mat & frame);
     
+    /// Number of input frames between the previous and the current images (> 1 when frames are dropped)
+    void set_frame_gap(const uint32_t & frameGap);
+    uint32_t get_frame_gap() const { return m_frameGap; }
+    
+    /// Rows the images and the difference images are computed on (the whole image by default)
+    void set_processing_band(const ProcessingBand & band);
+    
+    /// Debug windows shown while tracking obstacles (enabled by default)
+    void set_visualization(const bool & visualize);
+    
+    /// Polar rectification products of the frame, read from the PolarCalibration at each compute()
+    typedef struct {
+        cv::Mat polarImg1, polarImg2;
+        cv::Mat mapXprev, mapYprev, mapXcurr, mapYcurr;         // rectified to polar
+        cv::Mat currPolar2LinearX, currPolar2LinearY;           // polar to rectified
+    } t_polar_products;
+    /// For each current stixel, the columns its rows come from according to the dense tracker,
+    /// with the number of rows for each column
+    typedef vector< vector< pair<int32_t, uint32_t> > > t_dense_flow_votes;
+    
+    /// Used instead of the PolarCalibration and the dense tracker in the next compute()
+    void set_polar_products(const t_polar_products & polarProducts);
+    void set_dense_flow_votes(const t_dense_flow_votes & denseFlowVotes);
+    const t_polar_products & get_polar_products() const { return m_polar; }
+    const t_dense_flow_votes & get_dense_flow_votes() const { return m_denseFlowVotes; }
+    
     void drawTracker(cv::Mat & img, cv::Mat & imgTop);
     void drawTracker(cv::Mat & img);
     void drawDenseTracker(cv::Mat & img);
@@ -78,6 +105,7 @@ public:
     
     typedef deque < t_obstacle> t_track;
     typedef struct {
+        uint32_t id;        // Kept while the obstacle is tracked
         t_track track;
         int validCount;
     } t_obstaclesTrack;
@@ -87,7 +115,7 @@ public:
     
     t_tracker getTracker() const { return m_tracker; }
     t_historic getHistoric() const{ return m_stixelsHistoric; }
-    t_obstaclesTracker getObstaclesTracker() const { return m_obstaclesTracker; }
+    const t_obstaclesTracker & getObstaclesTracker() const { return m_obstaclesTracker; }
     
     stixels3d_t getLastStixelsAfterTracking();
 
@@ -115,7 +143,9 @@ protected:
     void compute_stixel_representation_polar( const Stixel &stixel, const input_image_const_view_t& image_view_hosting_the_stixel,
                                                stixel_representation_t &stixel_representation, const unsigned int stixel_horizontal_padding,
                                               const cv::Mat & mapX, const cv::Mat & mapY, const cv::Mat & polarImg);
-    float compute_dense_tracking_score(const Stixel& currStixel, const Stixel& prevStixel);
+    float compute_dense_tracking_score(const uint32_t& currIdx, const Stixel& prevStixel);
+    void fetch_polar_products();
+    void fetch_dense_flow_votes();
     void draw_polar_SAD(cv::Mat & img, const Stixel& stixel1, const Stixel& stixel2);
     
     void projectPointInTopView(const cv::Point3d & point3d, const cv::Mat & imgTop, cv::Point2d & point2d);
@@ -149,8 +179,9 @@ protected:
     stixels_t m_previous_stixels_polar;
     stixels_t m_current_stixels_polar;
     
-    cv::Mat m_mapXprev, m_mapYprev, m_mapXcurr, m_mapYcurr;
-    cv::Mat m_polarImg1, m_polarImg2;
+    t_polar_products m_polar;
+    t_dense_flow_votes m_denseFlowVotes;
+    bool m_externalPolarProducts, m_externalDenseFlowVotes;
     
     float m_sad_factor; // SAD factor
     float m_height_factor; // height factor
@@ -161,6 +192,10 @@ protected:
     
     bool m_useGraphs, m_useCostMatrix, m_useObjects, m_twoLevelsTracking;
     
+    uint32_t m_frameGap;
+    ProcessingBand m_processingBand;
+    bool m_visualize;
+    
     float m_minPolarSADForBeingStatic;
     
     t_tracker m_tracker;
@@ -176,6 +211,7 @@ protected:
     vector <int> m_prevObstacleCorresp;
     
     t_obstaclesTracker m_obstaclesTracker;
+    uint32_t m_nextTrackId;
     
     double m_minAllowedObjectWidth;
     double m_minDistBetweenClusters;
@@ -21,6 +21,8 @@
 #include <boost/gil/gil_all.hpp>
 #include <boost/program_options.hpp>
 
+#include "pipelinetracer.h"
+
 namespace stixel_world {
     extern "C" {
         uint8_t waitForKey(uint32_t * time = NULL);
@@ -42,18 +44,54 @@ namespace stixel_world {
     inline void gil2opencv(const T & view, cv::Mat & imgOpenCV) {    
         imgOpenCV = cv::Mat(view.height(), view.width(), CV_8UC3);
         
-        #pragma omp parallel for schedule(static)
-        for (uint32_t y = 0; y < imgOpenCV.rows; y++) {
-            for (uint32_t x = 0; x < imgOpenCV.cols; x++) {
-                cv::Vec3b & pxOCV = imgOpenCV.at<cv::Vec3b>(y, x);
-                pxOCV[0] = (uint8_t)view(x, y)[2];
-                pxOCV[1] = (uint8_t)view(x, y)[1];
-                pxOCV[2] = (uint8_t)view(x, y)[0];
+        #pragma omp parallel
+        {
+            STIXEL_TRACE_OMP_REGION("gil2opencv");
+            
+            #pragma omp for schedule(static)
+            for (uint32_t y = 0; y < imgOpenCV.rows; y++) {
+                for (uint32_t x = 0; x < imgOpenCV.cols; x++) {
+                    cv::Vec3b & pxOCV = imgOpenCV.at<cv::Vec3b>(y, x);
+                    pxOCV[0] = (uint8_t)view(x, y)[2];
+                    pxOCV[1] = (uint8_t)view(x, y)[1];
+                    pxOCV[2] = (uint8_t)view(x, y)[0];
+                }
             }
         }
     }
-    
-    template<class T> 
+
+    /// Only the given rows are converted, the rest of the (full size) image is black
+    template <class T>
+    inline void gil2opencv(const T & view, cv::Mat & imgOpenCV, const cv::Range & rows) {
+        if (rows == cv::Range::all()) {
+            gil2opencv(view, imgOpenCV);
+            return;
+        }
+
+        imgOpenCV = cv::Mat(view.height(), view.width(), CV_8UC3);
+        const int32_t firstRow = std::max(0, rows.start), lastRow = std::min((int32_t)imgOpenCV.rows, rows.end);
+        if (firstRow > 0)
+            imgOpenCV.rowRange(0, firstRow).setTo(cv::Scalar::all(0));
+        if (lastRow < imgOpenCV.rows)
+            imgOpenCV.rowRange(std::max(firstRow, lastRow), imgOpenCV.rows).setTo(cv::Scalar::all(0));
+
+        #pragma omp parallel
+        {
+            STIXEL_TRACE_OMP_REGION("gil2opencv");
+
+            #pragma omp for schedule(static)
+            for (int32_t y = firstRow; y < lastRow; y++) {
+                for (uint32_t x = 0; x < imgOpenCV.cols; x++) {
+                    cv::Vec3b & pxOCV = imgOpenCV.at<cv::Vec3b>(y, x);
+                    pxOCV[0] = (uint8_t)view(x, y)[2];
+                    pxOCV[1] = (uint8_t)view(x, y)[1];
+                    pxOCV[2] = (uint8_t)view(x, y)[0];
+                }
+            }
+        }
+    }
+
+    template<class T>
     void modify_variable_map(std::map<std::string, boost::program_options::variable_value>& vm, const std::string& opt, const T& val) { 
         vm[opt].value() = boost::any(val);
     }
@@ -0,0 +1,180 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include "visualizationsink.h"
+
+#include <map>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+using namespace std;
+
+namespace stixel_world {
+
+VisualizationSink::t_draw_record * VisualizationSink::sp_records = NULL;
+uint32_t VisualizationSink::s_capacity = 0;
+volatile uint32_t VisualizationSink::s_enqueuePos = 0;
+uint32_t VisualizationSink::s_dequeuePos = 0;
+uint32_t VisualizationSink::s_refreshPeriod = 30;
+volatile bool VisualizationSink::s_attached = false;
+volatile bool VisualizationSink::s_quitRequested = false;
+volatile uint64_t VisualizationSink::s_droppedImages = 0;
+
+static boost::shared_ptr<boost::thread> sp_viewerThread;
+
+void VisualizationSink::attach(const uint32_t& capacity, const uint32_t& refreshPeriod)
+{
+    if (s_attached)
+        return;
+
+    // The ring is kept after detaching, as a late producer could still be posting into it
+    if (sp_records == NULL) {
+        s_capacity = 1;
+        while (s_capacity < capacity)
+            s_capacity <<= 1;
+
+        sp_records = new t_draw_record[s_capacity];
+        for (uint32_t i = 0; i < s_capacity; i++)
+            sp_records[i].sequence = i;
+        s_enqueuePos = 0;
+        s_dequeuePos = 0;
+    }
+
+    s_refreshPeriod = std::max(refreshPeriod, 1u);
+    s_quitRequested = false;
+    __sync_synchronize();
+    s_attached = true;
+
+    sp_viewerThread.reset(new boost::thread(&VisualizationSink::viewerLoop));
+}
+
+void VisualizationSink::detach()
+{
+    if (! s_attached)
+        return;
+
+    s_attached = false;
+    __sync_synchronize();
+    sp_viewerThread->join();
+    sp_viewerThread.reset();
+}
+
+bool VisualizationSink::show(const string& window, const cv::Mat& image, const cv::Size& displaySize)
+{
+    if ((! s_attached) || image.empty())
+        return false;
+
+    // Bounded multi-producer queue: each slot sequence tells whether it is free for position pos
+    const uint32_t mask = s_capacity - 1;
+    t_draw_record * record;
+    uint32_t pos = s_enqueuePos;
+    for (;;) {
+        record = &sp_records[pos & mask];
+        const int32_t diff = (int32_t)(record->sequence - pos);
+        if (diff == 0) {
+            if (__sync_bool_compare_and_swap(&s_enqueuePos, pos, pos + 1))
+                break;
+            pos = s_enqueuePos;
+        } else if (diff < 0) {
+            // The viewer is behind, the image is dropped
+            __sync_fetch_and_add(&s_droppedImages, 1);
+            return false;
+        } else {
+            pos = s_enqueuePos;
+        }
+    }
+
+    record->window = window;
+    record->image = image;
+    record->displaySize = displaySize;
+    __sync_synchronize();
+    record->sequence = pos + 1;
+
+    return true;
+}
+
+bool VisualizationSink::pop(t_draw_record& record)
+{
+    t_draw_record & slot = sp_records[s_dequeuePos & (s_capacity - 1)];
+    if (slot.sequence != s_dequeuePos + 1)
+        return false;
+    __sync_synchronize();
+
+    record.window = slot.window;
+    record.image = slot.image;
+    record.displaySize = slot.displaySize;
+    slot.image.release();
+    __sync_synchronize();
+
+    slot.sequence = s_dequeuePos + s_capacity;
+    s_dequeuePos++;
+
+    return true;
+}
+
+void VisualizationSink::viewerLoop()
+{
+    bool frozen = false;
+    bool hasWindows = false;
+    while (s_attached) {
+        // Only the last image of each window is shown
+        map <string, t_draw_record> lastRecords;
+        t_draw_record record;
+        while (pop(record)) {
+            if (! frozen)
+                lastRecords[record.window] = record;
+        }
+
+        for (map <string, t_draw_record>::iterator it = lastRecords.begin(); it != lastRecords.end(); it++) {
+            if (it->second.displaySize.area() != 0) {
+                cv::Mat resized;
+                cv::resize(it->second.image, resized, it->second.displaySize);
+                cv::imshow(it->first, resized);
+            } else {
+                cv::imshow(it->first, it->second.image);
+            }
+            hasWindows = true;
+        }
+
+        // Without windows, waitKey would return immediately
+        if (! hasWindows) {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(s_refreshPeriod));
+            continue;
+        }
+
+        switch (cv::waitKey(s_refreshPeriod) & 0xFF) {
+            case 'q':
+            case 0x1B:  // ESC
+                s_quitRequested = true;
+                break;
+            case 0x20:  // SPACE
+                frozen = true;
+                break;
+            case 0x43:  // C
+            case 0x63:  // c
+                frozen = false;
+                break;
+            default:
+                ;
+        }
+    }
+
+    cv::destroyAllWindows();
+}
+
+}
@@ -0,0 +1,79 @@
+/*
+ *  Copyright 2013 Néstor Morales Hernández <nestor@isaatc.ull.es>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#ifndef VISUALIZATIONSINK_H
+#define VISUALIZATIONSINK_H
+
+#include <stdint.h>
+#include <string>
+
+#include <opencv2/opencv.hpp>
+
+namespace stixel_world {
+
+///
+/// Debug windows shown out of the processing thread.
+///
+/// Compute code checks isAttached() before drawing anything, and posts the image it drew with
+/// show(). Posting is lock-free: the image is moved into a bounded ring that a viewer thread drains
+/// at its own rate, showing the last image of each window. If the ring is full the image is dropped,
+/// so the pipeline never waits for the windows. The posted image must not be modified afterwards.
+///
+/// Resizing for display (displaySize) is done by the viewer thread too.
+///
+/// Keys are read by the viewer thread: SPACE freezes the windows, 'c' resumes them, and 'q' or ESC
+/// sets isQuitRequested(), that the application is expected to check.
+///
+/// While no viewer is attached, nothing is drawn nor posted.
+///
+class VisualizationSink
+{
+public:
+    /// Starts the viewer thread, that refreshes the windows every refreshPeriod ms
+    static void attach(const uint32_t & capacity = 32, const uint32_t & refreshPeriod = 30);
+    /// Stops the viewer thread and closes the windows
+    static void detach();
+    static bool isAttached() { return s_attached; }
+
+    static bool show(const std::string & window, const cv::Mat & image, const cv::Size & displaySize = cv::Size());
+
+    static bool isQuitRequested() { return s_quitRequested; }
+    static uint64_t getDroppedImages() { return s_droppedImages; }
+private:
+    typedef struct {
+        std::string window;
+        cv::Mat image;
+        cv::Size displaySize;
+        volatile uint32_t sequence;
+    } t_draw_record;
+
+    static bool pop(t_draw_record & record);
+    static void viewerLoop();
+
+    static t_draw_record * sp_records;
+    static uint32_t s_capacity;
+    static volatile uint32_t s_enqueuePos;
+    static uint32_t s_dequeuePos;
+    static uint32_t s_refreshPeriod;
+    static volatile bool s_attached;
+    static volatile bool s_quitRequested;
+    static volatile uint64_t s_droppedImages;
+};
+
+}
+
+#endif // VISUALIZATIONSINK_H